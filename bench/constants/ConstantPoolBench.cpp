@@ -0,0 +1,139 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <BytecodeWriter.hpp>
+#include <ConstantPoolBuilder.hpp>
+#include <LuminFile.hpp>
+#include <LuminRuntime.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "constant-pool-bench";
+}
+
+namespace {
+
+constexpr int IDENTIFIERS = 300;
+constexpr size_t REFERENCES = 65000;
+constexpr int RESOLVES = 1000000;
+
+std::string Identifier( const size_t reference ) {
+    return std::format( "identifier_{}", reference % IDENTIFIERS );
+}
+
+// One method per identifier, so every method reference resolves
+LuminFile Program( std::vector<ConstantPoolEntry> pool, const std::vector<uint16_t>& names ) {
+    LuminFile file {};
+    file.magicNumber = LUMIN_MAGIC_NUMBER;
+    file.versionMajor = LUMIN_VERSION_MAJOR;
+    for ( size_t method = 0; method < names.size(); ++method ) {
+        Bytecode::BytecodeWriter body;
+        body.EmitIConst( static_cast<int32_t>( method ) );
+        body.Emit( Bytecode::OpCode::RETURN );
+        body.Finish();
+        file.methods.push_back( { FLAG_PUBLIC, names[method], 0, 1, 0, 0,
+            static_cast<uint32_t>( file.bytecode.size() ), static_cast<uint32_t>( body.bytecode.size() ) } );
+        file.bytecode.insert( file.bytecode.end(), body.bytecode.begin(), body.bytecode.end() );
+    }
+    file.constantPool = std::move( pool );
+    return file;
+}
+
+// A pool the way a naive emitter writes one, a UTF8 name and a method
+// reference for every use
+LuminFile NaiveProgram() {
+    std::vector<ConstantPoolEntry> pool;
+    for ( size_t reference = 0; pool.size() + 2 <= REFERENCES; ++reference ) {
+        pool.push_back( { ConstantPoolTag::CONST_UTF8, Identifier( reference ) } );
+        pool.push_back( { ConstantPoolTag::CONST_METHOD_REF, static_cast<uint16_t>( pool.size() - 1 ) } );
+    }
+    std::vector<uint16_t> names;
+    for ( int identifier = 0; identifier < IDENTIFIERS; ++identifier ) {
+        names.push_back( static_cast<uint16_t>( identifier * 2 ) );
+    }
+    return Program( std::move( pool ), names );
+}
+
+LuminFile DedupedProgram( uint16_t& firstReference ) {
+    Utils::ConstantPoolBuilder pool;
+    for ( size_t reference = 0; reference < REFERENCES / 2; ++reference ) {
+        const uint16_t index = pool.AddMethodRef( Identifier( reference ) );
+        if ( reference == 0 ) {
+            firstReference = index;
+        }
+    }
+    std::vector<uint16_t> names;
+    for ( int identifier = 0; identifier < IDENTIFIERS; ++identifier ) {
+        names.push_back( pool.AddUtf8( Identifier( identifier ) ) );
+    }
+    return Program( pool.Release(), names );
+}
+
+// Best of a few map and validate runs
+LuminFileView Map( const std::string& name, const LuminFile& program ) {
+    const std::string path = ( std::filesystem::temp_directory_path() / ( "lumin-" + name + ".lmn" ) ).string();
+    if ( !Utils::WriteLuminFile( path, program ) ) {
+        throw std::runtime_error( "Could not write " + path );
+    }
+
+    double best = 1e9;
+    for ( int run = 0; run < 10; ++run ) {
+        const auto start = std::chrono::steady_clock::now();
+        const LuminFileView view = Utils::MapLuminFile( path );
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min( best, std::chrono::duration<double, std::micro>( end - start ).count() );
+    }
+
+    LuminFileView view = Utils::MapLuminFile( path );
+    std::filesystem::remove( path );
+    LOG_INFO( std::format( "{}: {} entries, {} bytes in the pool, map and validate in {} us",
+        name, view.constantCount, view.constantPool.size(), best ) )
+    return view;
+}
+
+}
+
+/*
+ Writes the same 65k method references to 300 identifiers through a naive
+ pool and through ConstantPoolBuilder, compares their size and load time,
+ then times a cached ResolveMethodRef.
+ */
+int main() {
+    Map( "naive-pool", NaiveProgram() );
+    uint16_t reference = 0;
+    VM::LuminRuntime runtime( Map( "deduped-pool", DedupedProgram( reference ) ) );
+
+    runtime.ResolveMethodRef( reference );
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t checksum = 0;
+    for ( int resolve = 0; resolve < RESOLVES; ++resolve ) {
+        checksum += runtime.ResolveMethodRef( reference ).index;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    LOG_INFO( std::format( "cached ResolveMethodRef: {} ns (checksum {})",
+        std::chrono::duration<double, std::nano>( end - start ).count() / RESOLVES, checksum ) )
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <BytecodeWriter.hpp>
+#include <LuminFile.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+using Bytecode::BytecodeWriter;
+using Bytecode::Label;
+
+std::string GetLoggerName() {
+    return "branch-bench";
+}
+
+namespace {
+
+constexpr int INSTRUCTIONS = 5000000;
+constexpr int RUNS = 3;
+
+double Milliseconds( const std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+}
+
+// Sums 100 down to 1 with the loop body padded, so the back edge and the
+// exit branch outgrow the 8-bit form. Returns the sum and the code size.
+int32_t PaddedLoop( const int padding, size_t& size ) {
+    BytecodeWriter writer;
+    const Label top = writer.NewLabel();
+    const Label done = writer.NewLabel();
+    writer.EmitIConst( 100 );
+    writer.EmitIStore( 0 );
+    writer.EmitIConst( 0 );
+    writer.EmitIStore( 1 );
+    writer.Bind( top );
+    writer.EmitILoad( 0 );
+    writer.EmitBranch( OpCode::IFLE, done );
+    writer.EmitILoad( 1 );
+    writer.EmitILoad( 0 );
+    writer.Emit( OpCode::IADD );
+    writer.EmitIStore( 1 );
+    for ( int instruction = 0; instruction < padding; ++instruction ) {
+        writer.EmitIConst( 0 );
+        writer.EmitIStore( 2 );
+    }
+    writer.EmitILoad( 0 );
+    writer.EmitIConst( -1 );
+    writer.Emit( OpCode::IADD );
+    writer.EmitIStore( 0 );
+    writer.EmitBranch( OpCode::GOTO, top );
+    writer.Bind( done );
+    writer.EmitILoad( 1 );
+    writer.Emit( OpCode::RETURN );
+    writer.Finish();
+    size = writer.bytecode.size();
+
+    LuminFile file {};
+    file.magicNumber = LUMIN_MAGIC_NUMBER;
+    file.versionMajor = LUMIN_VERSION_MAJOR;
+    file.entryMethod = 0;
+    file.bytecode = writer.bytecode;
+    file.methods.push_back( { FLAG_PUBLIC, 0, 0, 4, 3, 0, 0, static_cast<uint32_t>( file.bytecode.size() ) } );
+
+    VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( file ) );
+    vm.Run();
+    return vm.stack.Empty() ? 0 : std::get<int32_t>( vm.stack.Top() );
+}
+
+// 5M ICONSTs with their int32 operand, with or without reserving the code first
+double EmitConstants( const bool reserve ) {
+    const auto start = std::chrono::steady_clock::now();
+    BytecodeWriter writer;
+    if ( reserve ) {
+        writer.Reserve( static_cast<size_t>( INSTRUCTIONS ) * 5 );
+    }
+    for ( int instruction = 0; instruction < INSTRUCTIONS; ++instruction ) {
+        writer.Emit( OpCode::ICONST );
+        writer.Emit( static_cast<int32_t>( instruction ) );
+    }
+    return Milliseconds( start );
+}
+
+// Every eighth instruction branches back to one of the last 40 labels
+double FinishBranches( size_t& size, size_t& branches ) {
+    BytecodeWriter writer;
+    std::vector<Label> labels;
+    labels.reserve( INSTRUCTIONS / 8 + 1 );
+    branches = 0;
+    for ( int instruction = 0; instruction < INSTRUCTIONS; ++instruction ) {
+        if ( instruction % 8 == 0 ) {
+            labels.push_back( writer.NewLabel() );
+            writer.Bind( labels.back() );
+        }
+        if ( instruction % 8 == 7 ) {
+            const size_t back = ( static_cast<uint32_t>( instruction ) * 2654435761u ) % std::min<size_t>( labels.size(), 40 );
+            writer.EmitBranch( OpCode::GOTO, labels[labels.size() - 1 - back] );
+            ++branches;
+        } else {
+            writer.Emit( OpCode::ICONST );
+            writer.Emit( static_cast<int32_t>( instruction ) );
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    writer.Finish();
+    const double elapsed = Milliseconds( start );
+    size = writer.bytecode.size();
+    return elapsed;
+}
+
+}
+
+/*
+ Checks that relaxed branches still run correctly as a loop body grows past
+ the 8-bit reach, then times bulk emission and Finish on 5M instructions,
+ best of three.
+ */
+int main() {
+    for ( const int padding : { 0, 10, 50, 51, 52, 100, 1000 } ) {
+        size_t size = 0;
+        const int32_t sum = PaddedLoop( padding, size );
+        LOG_INFO( std::format( "padding {}: {} bytes, returns {}", padding, size, sum ) )
+        if ( sum != 5050 ) {
+            LOG_ERROR( std::format( "The loop padded with {} instructions returns {} instead of 5050", padding, sum ) )
+            return 1;
+        }
+    }
+
+    double emit = 1e9;
+    double emitReserved = 1e9;
+    double finish = 1e9;
+    size_t size = 0;
+    size_t branches = 0;
+    for ( int run = 0; run < RUNS; ++run ) {
+        emit = std::min( emit, EmitConstants( false ) );
+        emitReserved = std::min( emitReserved, EmitConstants( true ) );
+        finish = std::min( finish, FinishBranches( size, branches ) );
+    }
+    LOG_INFO( std::format( "emit {} ICONSTs: {} ms, {} ms with Reserve", INSTRUCTIONS, emit, emitReserved ) )
+    LOG_INFO( std::format( "Finish on {} instructions with {} branches, {} bytes: {} ms", INSTRUCTIONS, branches, size, finish ) )
+    return 0;
+}
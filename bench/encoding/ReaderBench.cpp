@@ -0,0 +1,160 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <BytecodeReader.hpp>
+#include <BytecodeWriter.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::Bytecode;
+
+std::string GetLoggerName() {
+    return "reader-bench";
+}
+
+namespace {
+
+constexpr uint32_t MAX_LOCALS = 300;
+constexpr size_t METHOD_SIZE = 2048;
+// Branches are written by Finish, they make up the rest of a method
+constexpr size_t METHOD_BYTES_BEFORE_BRANCHES = METHOD_SIZE * 4 / 5;
+constexpr int RUNS = 3;
+
+// One method: constants of every width, loads and stores of short and long
+// locals, adds and backward branches to one of its last 16 labels
+void EmitMethod( BytecodeWriter& writer, std::mt19937& random ) {
+    std::vector<Label> labels;
+    const size_t start = writer.bytecode.size();
+    for ( int instruction = 0; writer.bytecode.size() - start < METHOD_BYTES_BEFORE_BRANCHES || instruction < 8; ++instruction ) {
+        const uint32_t kind = random() % 10;
+        if ( kind < 3 ) {
+            writer.EmitIConst( static_cast<int32_t>( random() % 70000 ) - 35000 );
+        } else if ( kind < 6 ) {
+            writer.EmitILoad( static_cast<uint16_t>( random() % 8 ) );
+        } else if ( kind < 8 ) {
+            writer.EmitIStore( static_cast<uint16_t>( random() % MAX_LOCALS ) );
+        } else if ( kind < 9 ) {
+            writer.Emit( OpCode::IADD );
+        } else {
+            if ( labels.size() % 4 == 0 ) {
+                labels.push_back( writer.NewLabel() );
+                writer.Bind( labels.back() );
+            }
+            writer.EmitBranch( OpCode::IFNE, labels[labels.size() - 1 - random() % std::min<size_t>( labels.size(), 16 )] );
+        }
+    }
+}
+
+// Methods of about 2 KB once their branches are placed, each one is
+// finished before the next so its branches stay inside it
+std::vector<unsigned char> Body( const size_t bytes, std::vector<std::pair<size_t, size_t>>& methods ) {
+    std::mt19937 random( 1 );
+    std::vector<unsigned char> code;
+    code.reserve( bytes + METHOD_SIZE * 2 );
+    while ( code.size() < bytes ) {
+        BytecodeWriter writer;
+        EmitMethod( writer, random );
+        writer.Finish();
+        methods.emplace_back( code.size(), writer.bytecode.size() );
+        code.insert( code.end(), writer.bytecode.begin(), writer.bytecode.end() );
+    }
+    return code;
+}
+
+// Steps over the body with the operand size table alone, the floor for
+// decoding it. Every opcode in the body has a fixed operand size.
+size_t Walk( const std::span<const unsigned char> code ) {
+    size_t instructions = 0;
+    for ( size_t pc = 0; pc < code.size(); pc += 1 + static_cast<size_t>( OperandSize( static_cast<OpCode>( code[pc] ) ) ) ) {
+        ++instructions;
+    }
+    return instructions;
+}
+
+double Seconds( const std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+}
+
+/*
+ Decodes and validates a large generated body, best of three, next to a
+ bare walk over its operand sizes, then validates the methods it is made
+ of one by one, which is what the runtime does when it links them. The
+ body size in MiB defaults to 48, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const size_t mebibytes = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 48;
+    std::vector<std::pair<size_t, size_t>> methods;
+    const std::vector<unsigned char> code = Body( mebibytes << 20, methods );
+    const std::span<const unsigned char> all( code );
+    const double size = static_cast<double>( code.size() ) / 1e6;
+    const ValidationLimits limits { MAX_LOCALS, 0, {} };
+
+    const BytecodeReader reader( all );
+    size_t instructions = 0;
+
+    double walk = 1e9;
+    double decode = 1e9;
+    double validate = 1e9;
+    double validateMethods = 1e9;
+    for ( int run = 0; run < RUNS; ++run ) {
+        auto start = std::chrono::steady_clock::now();
+        const size_t walked = Walk( all );
+        walk = std::min( walk, Seconds( start ) );
+
+        start = std::chrono::steady_clock::now();
+        size_t operandBytes = 0;
+        instructions = 0;
+        for ( const Instruction& instruction : reader ) {
+            operandBytes += instruction.operand.size();
+            ++instructions;
+        }
+        decode = std::min( decode, Seconds( start ) );
+        if ( operandBytes == 0 || walked != instructions ) {
+            LOG_ERROR( "Decoded no operands, or not the instructions the walk stepped over" )
+            return 1;
+        }
+
+        start = std::chrono::steady_clock::now();
+        reader.Validate( limits );
+        validate = std::min( validate, Seconds( start ) );
+
+        start = std::chrono::steady_clock::now();
+        for ( const auto& [offset, length] : methods ) {
+            BytecodeReader( all.subspan( offset, length ) ).Validate( limits );
+        }
+        validateMethods = std::min( validateMethods, Seconds( start ) );
+    }
+
+    LOG_INFO( std::format( "{:.1f} MB, {} instructions", size, instructions ) )
+    LOG_INFO( std::format( "operand size walk: {} MB/s", size / walk ) )
+    LOG_INFO( std::format( "decode: {} MB/s, {} M instructions/s", size / decode,
+        static_cast<double>( instructions ) / decode / 1e6 ) )
+    LOG_INFO( std::format( "Validate: {} MB/s", size / validate ) )
+    LOG_INFO( std::format( "Validate on {} methods of {} bytes on average: {} MB/s", methods.size(),
+        code.size() / methods.size(), size / validateMethods ) )
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <BytecodeWriter.hpp>
+#include <LuminFile.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+using Bytecode::BytecodeWriter;
+
+std::string GetLoggerName() {
+    return "short-form-bench";
+}
+
+namespace {
+
+constexpr uint16_t LOCALS = 320;
+
+// Writes every instruction in its long form, ICONST with an int32 and
+// locals through WIDE, or lets the writer pick the smallest
+class Encoder {
+public:
+    explicit Encoder( const bool longForms ) : longForms( longForms ) {}
+
+    void IConst( const int32_t value ) {
+        if ( longForms ) {
+            writer.Emit( OpCode::ICONST );
+            writer.Emit( value );
+        } else {
+            writer.EmitIConst( value );
+        }
+    }
+
+    void Local( const OpCode opcode, const uint16_t index ) {
+        if ( longForms ) {
+            writer.Emit( OpCode::WIDE );
+            writer.Emit( opcode );
+            writer.Emit( index );
+        } else if ( opcode == OpCode::ILOAD ) {
+            writer.EmitILoad( index );
+        } else {
+            writer.EmitIStore( index );
+        }
+    }
+
+    BytecodeWriter writer;
+
+private:
+    bool longForms;
+};
+
+/*
+ Alternating `a = constant` and `z = x + y` statements. 55% of the constants
+ are in -1..5 and 80% of the locals are in slots 0 to 3, the rest needs a
+ byte, a short or WIDE. Returns local 0, which model computes the same way.
+ */
+std::vector<unsigned char> Corpus( const bool longForms, const uint32_t statements, int32_t& model ) {
+    std::mt19937 random( 42 );
+    const auto constant = [&] {
+        const uint32_t kind = random() % 100;
+        if ( kind < 55 ) return static_cast<int32_t>( random() % 7 ) - 1;
+        if ( kind < 85 ) return static_cast<int32_t>( random() % 200 ) - 100;
+        if ( kind < 97 ) return static_cast<int32_t>( random() % 20000 ) - 10000;
+        return static_cast<int32_t>( random() );
+    };
+    const auto local = [&] {
+        const uint32_t kind = random() % 100;
+        if ( kind < 80 ) return static_cast<uint16_t>( random() % 4 );
+        if ( kind < 99 ) return static_cast<uint16_t>( 4 + random() % 12 );
+        return static_cast<uint16_t>( 300 + random() % 10 );
+    };
+
+    Encoder encoder( longForms );
+    std::vector<int32_t> values( LOCALS, 0 );
+    for ( uint16_t index = 0; index < LOCALS; ++index ) {
+        encoder.IConst( 0 );
+        encoder.Local( OpCode::ISTORE, index );
+    }
+    for ( uint32_t statement = 0; statement < statements; ++statement ) {
+        const uint16_t a = local();
+        const int32_t value = constant();
+        encoder.IConst( value );
+        encoder.Local( OpCode::ISTORE, a );
+        values[a] = value;
+
+        const uint16_t x = local();
+        const uint16_t y = local();
+        const uint16_t z = local();
+        encoder.Local( OpCode::ILOAD, x );
+        encoder.Local( OpCode::ILOAD, y );
+        encoder.writer.Emit( OpCode::IADD );
+        encoder.Local( OpCode::ISTORE, z );
+        values[z] = static_cast<int32_t>( static_cast<uint32_t>( values[x] ) + static_cast<uint32_t>( values[y] ) );
+    }
+    encoder.Local( OpCode::ILOAD, 0 );
+    encoder.writer.Emit( OpCode::RETURN );
+    encoder.writer.Finish();
+
+    model = values[0];
+    return std::move( encoder.writer.bytecode );
+}
+
+void Measure( const bool longForms, const uint32_t statements ) {
+    int32_t model = 0;
+    LuminFile file {};
+    file.magicNumber = LUMIN_MAGIC_NUMBER;
+    file.versionMajor = LUMIN_VERSION_MAJOR;
+    file.entryMethod = 0;
+    file.bytecode = Corpus( longForms, statements, model );
+    file.methods.push_back( { FLAG_PUBLIC, 0, 0, 16, LOCALS, 0, 0, static_cast<uint32_t>( file.bytecode.size() ) } );
+
+    const auto runtime = std::make_shared<VM::LuminRuntime>( file );
+    runtime->ResolveAll();
+    const auto start = std::chrono::steady_clock::now();
+    VM::LuminVirtualMachine vm( runtime );
+    vm.Run();
+    const auto end = std::chrono::steady_clock::now();
+
+    const bool matches = !vm.stack.Empty() && vm.stack.Top() == NumericValue { model };
+    LOG_INFO( std::format( "{}: {:.1f} MB, run in {} ms, {}", longForms ? "long forms " : "short forms",
+        static_cast<double>( file.bytecode.size() ) / 1e6, std::chrono::duration<double, std::milli>( end - start ).count(),
+        matches ? "matches the model" : "DIFFERS FROM THE MODEL" ) )
+}
+
+}
+
+/*
+ Runs the same straight-line corpus in short and long encodings and reports
+ the code size and run time, linking is left out. The statement count
+ defaults to 2000000, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const uint32_t statements = argc > 1 ? static_cast<uint32_t>( std::strtoul( argv[1], nullptr, 10 ) ) : 2000000;
+    Measure( false, statements );
+    Measure( true, statements );
+    return 0;
+}
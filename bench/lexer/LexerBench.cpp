@@ -0,0 +1,134 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+#include <Lexer.hpp>
+#include <Parser.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::Compiler;
+
+std::string GetLoggerName() {
+    return "lexer-bench";
+}
+
+namespace {
+
+// Groups of small functions with random expressions, the same bytes for a given size
+class SourceGenerator {
+public:
+    std::string Generate( const size_t bytes ) {
+        for ( int group = 1; source.size() < bytes; ++group ) {
+            Group( group );
+        }
+        return source;
+    }
+
+private:
+    uint32_t Below( const uint32_t bound ) {
+        return static_cast<uint32_t>( random() % bound );
+    }
+
+    std::string Pick( const std::vector<std::string>& choices ) {
+        return choices[Below( static_cast<uint32_t>( choices.size() ) )];
+    }
+
+    void Line( const std::string& line ) {
+        source += line;
+        source += '\n';
+    }
+
+    std::string Expression( const std::vector<std::string>& names, const int depth ) {
+        if ( depth > 3 || Below( 100 ) < 30 ) {
+            return Below( 100 ) < 60 ? Pick( names ) : std::to_string( Below( 20 ) );
+        }
+        return std::format( "({} {} {})", Expression( names, depth + 1 ),
+            Pick( { "+", "-", "*", "/", "<", ">", "==", "!=", "<=", ">=" } ), Expression( names, depth + 1 ) );
+    }
+
+    void Group( const int group ) {
+        Line( std::format( "fun f0_{}(a: int, b: int)", group ) + " {" );
+        Line( "    if (a > b) { return a - b; }" );
+        Line( "    return b * 2 - a;" );
+        Line( "}" );
+        Line( std::format( "fun f1_{}(a: int, b: int)", group ) + " {" );
+        Line( "    return a * 3 + b;" );
+        Line( "}" );
+        Line( std::format( "{}fun g_{}(p: int, q: int)", Pick( { "", "inline ", "noinline " } ), group ) + " {" );
+        std::vector<std::string> names { "p", "q" };
+        Line( std::format( "    var x = {};", Expression( names, 1 ) ) );
+        names.emplace_back( "x" );
+        Line( std::format( "    var y = {};", Expression( names, 1 ) ) );
+        names.emplace_back( "y" );
+        Line( "    var z = 0;" );
+        Line( "    var w = 0.5;" );
+        names.emplace_back( "z" );
+        for ( uint32_t statement = Below( 4 ); statement > 0; --statement ) {
+            Line( std::format( "    {} = {};", Pick( names ), Expression( names, 1 ) ) );
+        }
+        Line( "    if (w > 100.0) { return x + y * 7 + z * 13 + 1; }" );
+        Line( "    return x + y * 7 + z * 13;" );
+        Line( "}" );
+        Line( std::format( "fun main_{}()", group ) + " {" );
+        Line( std::format( "    return g_{}({}, {}) + g_{}({}, {}) * 3;", group, Below( 19 ), Below( 19 ), group,
+            Below( 19 ), Below( 19 ) ) );
+        Line( "}" );
+    }
+
+    std::mt19937 random { 1 };
+    std::string source;
+};
+
+}
+
+/*
+ Lexes, then lexes and parses, a generated source and reports the best of
+ five runs in MB/s. The size in MB defaults to 8, the first argument
+ overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const size_t megabytes = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 8;
+    const std::string source = SourceGenerator().Generate( megabytes * 1000 * 1000 );
+    const double size = static_cast<double>( source.size() ) / 1e6;
+
+    double lexBest = 1e9;
+    double parseBest = 1e9;
+    size_t tokens = 0;
+    for ( int run = 0; run < 5; ++run ) {
+        const auto start = std::chrono::steady_clock::now();
+        Lexer lexer( source );
+        TokenStream lexed = lexer.Tokenize();
+        tokens = lexed.tokens.size();
+        const auto lexEnd = std::chrono::steady_clock::now();
+        Parser parser( source, std::move( lexed ) );
+        const auto statements = parser.Parse();
+        const auto parseEnd = std::chrono::steady_clock::now();
+
+        lexBest = std::min( lexBest, std::chrono::duration<double>( lexEnd - start ).count() );
+        parseBest = std::min( parseBest, std::chrono::duration<double>( parseEnd - start ).count() );
+    }
+
+    LOG_INFO( std::format( "{:.1f} MB, {} tokens of {} bytes", size, tokens, sizeof( Token ) ) )
+    LOG_INFO( std::format( "lex: {:.1f} MB/s, lex and parse: {:.1f} MB/s", size / lexBest, size / parseBest ) )
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <ConstantPoolBuilder.hpp>
+#include <LuminFile.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "load-bench";
+}
+
+namespace {
+
+constexpr int STRING_CONSTANTS = 50000;
+
+// Current, not peak, resident size: writing the program already peaked
+long ResidentMegabytes() {
+    long pages = 0;
+    long resident = 0;
+    std::ifstream( "/proc/self/statm" ) >> pages >> resident;
+    return resident * sysconf( _SC_PAGESIZE ) / ( 1024 * 1024 );
+}
+
+// A program with many string constants and a large code section, it is only
+// loaded, never run
+void WriteProgram( const std::string& path, const size_t codeBytes ) {
+    Utils::ConstantPoolBuilder pool;
+    for ( int i = 0; i < STRING_CONSTANTS; ++i ) {
+        pool.AddString( std::format( "constant_{}", i ) );
+    }
+
+    LuminFile file {};
+    file.magicNumber = LUMIN_MAGIC_NUMBER;
+    file.versionMajor = LUMIN_VERSION_MAJOR;
+    file.constantPool = pool.Release();
+    file.bytecode.assign( codeBytes, static_cast<unsigned char>( OpCode::HALT ) );
+    if ( !Utils::WriteLuminFile( path, file ) ) {
+        throw std::runtime_error( "Could not write " + path );
+    }
+}
+
+}
+
+/*
+ Loads a generated program through the mapping, then the way lumin did
+ before it mapped files: read into a LuminFile and copied into the runtime.
+ Resident memory is taken while the VM holds the program. The code size in MiB
+ defaults to 256, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const size_t mebibytes = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 256;
+    const std::string path = ( std::filesystem::temp_directory_path() / "lumin-load-bench.lmn" ).string();
+    WriteProgram( path, mebibytes << 20 );
+
+    const long baseline = ResidentMegabytes();
+    {
+        const auto start = std::chrono::steady_clock::now();
+        VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( Utils::MapLuminFile( path ) ) );
+        const auto end = std::chrono::steady_clock::now();
+        LOG_INFO( std::format( "map:  {} ms, {} MB resident over the baseline",
+            std::chrono::duration<double, std::milli>( end - start ).count(), ResidentMegabytes() - baseline ) )
+    }
+    {
+        const auto start = std::chrono::steady_clock::now();
+        VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( Utils::ReadLuminFile( path ) ) );
+        const auto end = std::chrono::steady_clock::now();
+        LOG_INFO( std::format( "read: {} ms, {} MB resident over the baseline",
+            std::chrono::duration<double, std::milli>( end - start ).count(), ResidentMegabytes() - baseline ) )
+    }
+
+    std::filesystem::remove( path );
+    return 0;
+}
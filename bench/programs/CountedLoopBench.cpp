@@ -0,0 +1,96 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <string>
+#include <Compiler.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "counted-loop-bench";
+}
+
+namespace {
+
+// ITERATIONS is replaced by the iteration count
+const std::string FOR_RANGE = R"(
+fun main() {
+    var s = 0;
+    for i in 0..ITERATIONS { s = s + i; }
+    return s;
+}
+)";
+
+// The same loop shape as for-in-range, so it takes the fast path too
+const std::string WHILE_LESS = R"(
+fun main() {
+    var s = 0;
+    var i = 0;
+    while ( i < ITERATIONS ) { s = s + i; i = i + 1; }
+    return s;
+}
+)";
+
+// <= keeps the generic load, compare, branch, add and store sequence
+const std::string WHILE_LESS_EQUAL = R"(
+fun main() {
+    var s = 0;
+    var i = 0;
+    var n = ITERATIONS;
+    while ( i <= n - 1 ) { s = s + i; i = i + 1; }
+    return s;
+}
+)";
+
+void Measure( const std::string& name, const std::string& program, const int iterations ) {
+    std::string source = program;
+    source.replace( source.find( "ITERATIONS" ), 10, std::to_string( iterations ) );
+
+    Compiler::CompilerOptions options;
+    options.optimizationLevel = 2;
+    Compiler::Compiler compiler( options );
+    const auto runtime = std::make_shared<VM::LuminRuntime>( compiler.Compile( source ) );
+
+    const auto start = std::chrono::steady_clock::now();
+    VM::LuminVirtualMachine vm( runtime );
+    vm.Run();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double elapsed = std::chrono::duration<double, std::milli>( end - start ).count();
+    LOG_INFO( std::format( "{}: {} ms, {} ns per iteration, returns {}", name, elapsed, elapsed * 1e6 / iterations,
+        vm.stack.Empty() ? 0 : std::get<int32_t>( vm.stack.Top() ) ) )
+}
+
+}
+
+/*
+ Times `s = s + i` in a for-in-range loop, in the equivalent while loop and
+ in a while loop written with <=, at -O2. The iteration count defaults to
+ 100000000, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const int iterations = argc > 1 ? std::atoi( argv[1] ) : 100000000;
+    Measure( "for i in 0..N       ", FOR_RANGE, iterations );
+    Measure( "while ( i < N )     ", WHILE_LESS, iterations );
+    Measure( "while ( i <= N - 1 )", WHILE_LESS_EQUAL, iterations );
+    return 0;
+}
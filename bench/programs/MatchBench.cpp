@@ -0,0 +1,105 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <string>
+#include <Compiler.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "match-bench";
+}
+
+namespace {
+
+// Dense keys are 0 to n - 1, sparse ones are far enough apart that the
+// emitter picks LOOKUPSWITCH
+int Key( const int arm, const bool dense ) {
+    return dense ? arm : arm * 1009 + 7;
+}
+
+std::string Pick( const int arms, const bool dense, const bool match ) {
+    std::string source = "fun pick( x: int ) {\n";
+    if ( match ) {
+        source += "    var r = 0;\n    match ( x ) {\n";
+        for ( int arm = 0; arm < arms; ++arm ) {
+            source += std::format( "        {} -> r = {};\n", Key( arm, dense ), arm * 3 + 1 );
+        }
+        source += "        _ -> r = 0;\n    }\n    return r;\n";
+    } else {
+        for ( int arm = 0; arm < arms; ++arm ) {
+            source += std::format( "    if ( x == {} )", Key( arm, dense ) ) + " { " + std::format( "return {};", arm * 3 + 1 ) + " }\n";
+        }
+        source += "    return 0;\n";
+    }
+    return source + "}\n";
+}
+
+// main calls pick with every key in turn, j is the call count modulo n
+std::string Program( const int arms, const bool dense, const bool match, const int calls ) {
+    std::string source = Pick( arms, dense, match );
+    source += "fun main() {\n    var s = 0;\n    var i = 0;\n";
+    source += std::format( "    while ( i < {} )", calls ) + " {\n";
+    source += std::format( "        var j = i - ( i / {} ) * {};\n", arms, arms );
+    source += dense ? "        s = s + pick( j );\n" : "        s = s + pick( j * 1009 + 7 );\n";
+    source += "        i = i + 1;\n    }\n    return s;\n}\n";
+    return source;
+}
+
+double Run( const std::string& source, int32_t& result ) {
+    Compiler::CompilerOptions options;
+    options.optimizationLevel = 2;
+    Compiler::Compiler compiler( options );
+    const auto runtime = std::make_shared<VM::LuminRuntime>( compiler.Compile( source ) );
+
+    const auto start = std::chrono::steady_clock::now();
+    VM::LuminVirtualMachine vm( runtime );
+    vm.Run();
+    const auto end = std::chrono::steady_clock::now();
+    result = vm.stack.Empty() ? 0 : std::get<int32_t>( vm.stack.Top() );
+    return std::chrono::duration<double, std::milli>( end - start ).count();
+}
+
+}
+
+/*
+ Times a match against the equivalent if chain over dense and sparse keys,
+ with 4, 32 and 256 arms, at -O2. The call count defaults to 3000000, the
+ first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const int calls = argc > 1 ? std::atoi( argv[1] ) : 3000000;
+    for ( const bool dense : { true, false } ) {
+        for ( const int arms : { 4, 32, 256 } ) {
+            int32_t matchResult = 0;
+            int32_t chainResult = 0;
+            const double match = Run( Program( arms, dense, true, calls ), matchResult );
+            const double chain = Run( Program( arms, dense, false, calls ), chainResult );
+            LOG_INFO( std::format( "{} n={}: match {} ms, if chain {} ms", dense ? "dense " : "sparse", arms, match, chain ) )
+            if ( matchResult != chainResult ) {
+                LOG_ERROR( std::format( "The match returns {} and the if chain {}", matchResult, chainResult ) )
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
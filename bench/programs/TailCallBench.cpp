@@ -0,0 +1,107 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <Compiler.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "tail-call-bench";
+}
+
+namespace {
+
+const std::string ACCUMULATOR = R"(
+fun sum( n: int, total: int ) {
+    if ( n == 0 ) { return total; }
+    return sum( n - 1, total + n );
+}
+fun main() {
+    return sum( DEPTH, 0 );
+}
+)";
+
+const std::string RECURSIVE = R"(
+fun sum( n: int ) {
+    if ( n == 0 ) { return 0; }
+    return n + sum( n - 1 );
+}
+fun main() {
+    return sum( DEPTH );
+}
+)";
+
+/*
+ Compiles and runs one program at -O2 in a child process, so each run gets
+ its own peak RSS.
+ */
+void Measure( const std::string& name, const std::string& program, const int depth, const bool tailCalls ) {
+    std::string source = program;
+    source.replace( source.find( "DEPTH" ), 5, std::to_string( depth ) );
+
+    std::fflush( stdout );
+    const pid_t child = fork();
+    if ( child != 0 ) {
+        int status = 0;
+        waitpid( child, &status, 0 );
+        return;
+    }
+
+    Compiler::CompilerOptions options;
+    options.optimizationLevel = 2;
+    options.emit.tailCalls = tailCalls;
+    Compiler::Compiler compiler( options );
+    const auto runtime = std::make_shared<VM::LuminRuntime>( compiler.Compile( source ) );
+
+    const auto start = std::chrono::steady_clock::now();
+    VM::LuminVirtualMachine vm( runtime );
+    vm.Run();
+    const auto end = std::chrono::steady_clock::now();
+
+    rusage usage {};
+    getrusage( RUSAGE_SELF, &usage );
+    LOG_INFO( std::format( "{}: {} ms, {} MB peak RSS, returns {}", name,
+        std::chrono::duration<double, std::milli>( end - start ).count(), usage.ru_maxrss / 1024,
+        vm.stack.Empty() ? 0 : std::get<int32_t>( vm.stack.Top() ) ) )
+    std::fflush( stdout );
+    _exit( 0 );
+}
+
+}
+
+/*
+ Recursive sums with the call in tail position, compiled with and without
+ TAILCALL, and with the addition after the call, where TAILCALL does not
+ apply. The depth defaults to 1000000, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const int depth = argc > 1 ? std::atoi( argv[1] ) : 1000000;
+    Measure( "accumulator, CALL    ", ACCUMULATOR, depth, false );
+    Measure( "accumulator, TAILCALL", ACCUMULATOR, depth, true );
+    Measure( "n + sum( n - 1 )     ", RECURSIVE, depth, true );
+    return 0;
+}
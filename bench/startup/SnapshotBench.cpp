@@ -0,0 +1,132 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Compiler.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <VMSnapshot.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "snapshot-bench";
+}
+
+namespace {
+
+constexpr int RUNS = 9;
+
+// Fills a table, the start-up work a snapshot skips, then answers from it.
+// LENGTH is replaced by the table length.
+const std::string PROGRAM = R"(
+fun main() {
+    var table = int[LENGTH];
+    for round in 0..8 {
+        for i in 0..LENGTH { table[i] = table[i] + i * round + 1; }
+    }
+    snapshot();
+    var s = 0;
+    for i in 0..1000 { s = s + table[i]; }
+    return s;
+}
+)";
+
+int32_t Result( const VM::LuminVirtualMachine& vm ) {
+    return vm.stack.Empty() ? 0 : std::get<int32_t>( vm.stack.Top() );
+}
+
+// From the file to the result, the fastest and the median of RUNS runs
+template < typename Start >
+void Measure( const std::string& name, Start start ) {
+    std::vector<double> times;
+    int32_t result = 0;
+    for ( int run = 0; run < RUNS; ++run ) {
+        const auto begin = std::chrono::steady_clock::now();
+        result = start();
+        const auto end = std::chrono::steady_clock::now();
+        times.push_back( std::chrono::duration<double, std::micro>( end - begin ).count() );
+    }
+    std::ranges::sort( times );
+
+    LOG_INFO( std::format( "{}: {} us median, {} us fastest, returns {}", name, times[RUNS / 2], times[0], result ) )
+}
+
+}
+
+/*
+ Startup latency of a program whose main spends most of its time filling a
+ table, run from the start and resumed from a snapshot taken after the
+ table is filled, both from the file to the result. The table length
+ defaults to 65536, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const int length = argc > 1 ? std::atoi( argv[1] ) : 65536;
+    if ( length < 1000 ) {
+        LOG_ERROR( "The table length has to be at least 1000" )
+        return 1;
+    }
+
+    std::string source = PROGRAM;
+    for ( size_t at = source.find( "LENGTH" ); at != std::string::npos; at = source.find( "LENGTH" ) ) {
+        source.replace( at, 6, std::to_string( length ) );
+    }
+    Compiler::CompilerOptions options;
+    options.optimizationLevel = 2;
+    const LuminFile program = Compiler::Compiler( options ).Compile( source );
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string programPath = ( directory / "lumin-snapshot-bench.lmn" ).string();
+    const std::string snapshotPath = ( directory / "lumin-snapshot-bench.snap" ).string();
+    if ( !Utils::WriteLuminFile( programPath, program ) ) {
+        throw std::runtime_error( "Could not write " + programPath );
+    }
+    {
+        VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( Utils::MapLuminFile( programPath ) ),
+            { .SnapshotPath = snapshotPath } );
+        vm.Run();
+    }
+    LOG_INFO( std::format( "{} byte program, {} byte snapshot", std::filesystem::file_size( programPath ),
+        std::filesystem::file_size( snapshotPath ) ) )
+
+    Measure( "from the start", [&programPath] {
+        VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( Utils::MapLuminFile( programPath ) ) );
+        vm.Run();
+        return Result( vm );
+    } );
+    Measure( "from a snapshot", [&snapshotPath] {
+        VM::VMSnapshot snapshot;
+        LuminFileView image;
+        if ( !VM::ReadSnapshotFile( snapshotPath, snapshot, image ) ) {
+            throw std::runtime_error( "Could not read " + snapshotPath );
+        }
+        VM::LuminVirtualMachine vm( std::move( snapshot ), std::make_shared<VM::LuminRuntime>( std::move( image ) ) );
+        vm.Run();
+        return Result( vm );
+    } );
+
+    std::filesystem::remove( programPath );
+    std::filesystem::remove( snapshotPath );
+    return 0;
+}
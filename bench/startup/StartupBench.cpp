@@ -0,0 +1,120 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <BytecodeWriter.hpp>
+#include <LuminFile.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+using Bytecode::BytecodeWriter;
+
+std::string GetLoggerName() {
+    return "startup-bench";
+}
+
+namespace {
+
+constexpr uint32_t CALLED_METHODS = 10;
+
+void AddMethod( LuminFile& file, BytecodeWriter& writer, const uint16_t parameters, const uint16_t locals ) {
+    writer.Finish();
+    file.methods.push_back( { FLAG_PUBLIC, 0, 0, 16, locals, parameters,
+        static_cast<uint32_t>( file.bytecode.size() ), static_cast<uint32_t>( writer.bytecode.size() ) } );
+    file.bytecode.insert( file.bytecode.end(), writer.bytecode.begin(), writer.bytecode.end() );
+}
+
+// main() calls the first few methods and sums their results, every other
+// method adds 50 constants to its argument and is never called
+void WriteProgram( const std::string& path, const uint32_t methods ) {
+    LuminFile file {};
+    file.magicNumber = LUMIN_MAGIC_NUMBER;
+    file.versionMajor = LUMIN_VERSION_MAJOR;
+    file.entryMethod = 0;
+
+    BytecodeWriter main;
+    for ( uint32_t method = 1; method <= CALLED_METHODS; ++method ) {
+        main.EmitIConst( static_cast<int32_t>( method ) );
+        main.Emit( OpCode::CALL );
+        main.Emit( static_cast<uint16_t>( method ) );
+    }
+    for ( uint32_t method = 1; method < CALLED_METHODS; ++method ) {
+        main.Emit( OpCode::IADD );
+    }
+    main.Emit( OpCode::RETURN );
+    AddMethod( file, main, 0, 0 );
+
+    for ( uint32_t method = 1; method < methods; ++method ) {
+        BytecodeWriter body;
+        body.EmitILoad( 0 );
+        for ( int32_t constant = 0; constant < 50; ++constant ) {
+            body.EmitIConst( constant );
+            body.Emit( OpCode::IADD );
+        }
+        body.Emit( OpCode::RETURN );
+        AddMethod( file, body, 1, 1 );
+    }
+
+    if ( !Utils::WriteLuminFile( path, file ) ) {
+        throw std::runtime_error( "Could not write " + path );
+    }
+}
+
+void Start( const std::string& path, const bool eager ) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto runtime = std::make_shared<VM::LuminRuntime>( Utils::MapLuminFile( path ) );
+    if ( eager ) {
+        runtime->ResolveAll();
+    }
+    VM::LuminVirtualMachine vm( runtime );
+    vm.Run();
+    const auto end = std::chrono::steady_clock::now();
+
+    LOG_INFO( std::format( "{}: {} ms to the result, {} of {} methods materialized", eager ? "eager" : "lazy",
+        std::chrono::duration<double, std::milli>( end - start ).count(), runtime->MaterializedCount(),
+        runtime->MethodCount() ) )
+}
+
+}
+
+/*
+ Loads and runs a program with many methods of which main calls a handful,
+ once linking on first call and once linking everything up front, like
+ lumin --eager. The method count defaults to 100000, the first argument
+ overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const uint32_t methods = argc > 1 ? static_cast<uint32_t>( std::strtoul( argv[1], nullptr, 10 ) ) : 100000;
+    if ( methods <= CALLED_METHODS ) {
+        LOG_ERROR( std::format( "The method count has to be above {}", CALLED_METHODS ) )
+        return 1;
+    }
+    const std::string path = ( std::filesystem::temp_directory_path() / "lumin-startup-bench.lmn" ).string();
+    WriteProgram( path, methods );
+
+    Start( path, false );
+    Start( path, true );
+
+    std::filesystem::remove( path );
+    return 0;
+}
@@ -0,0 +1,73 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef LUMIN_BYTEORDER_HPP
+#define LUMIN_BYTEORDER_HPP
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace Lumin::Utils {
+
+// Fixed-width little-endian loads and stores. Both go through memcpy, so the
+// address does not need to be aligned.
+template < typename T >
+concept LittleEndianStorable = std::integral<T> || std::floating_point<T>;
+
+template < LittleEndianStorable T >
+T LoadLE( const unsigned char* source ) {
+    if constexpr ( std::floating_point<T> ) {
+        using Bits = std::conditional_t<sizeof( T ) == 4, uint32_t, uint64_t>;
+        return std::bit_cast<T>( LoadLE<Bits>( source ) );
+    } else {
+        T value;
+        std::memcpy( &value, source, sizeof( T ) );
+        if constexpr ( std::endian::native == std::endian::big && sizeof( T ) > 1 ) {
+            value = std::byteswap( value );
+        }
+        return value;
+    }
+}
+
+template < LittleEndianStorable T >
+void StoreLE( unsigned char* destination, const T value ) {
+    if constexpr ( std::floating_point<T> ) {
+        using Bits = std::conditional_t<sizeof( T ) == 4, uint32_t, uint64_t>;
+        StoreLE( destination, std::bit_cast<Bits>( value ) );
+    } else {
+        T bits = value;
+        if constexpr ( std::endian::native == std::endian::big && sizeof( T ) > 1 ) {
+            bits = std::byteswap( bits );
+        }
+        std::memcpy( destination, &bits, sizeof( T ) );
+    }
+}
+
+template < LittleEndianStorable T >
+void AppendLE( std::vector<unsigned char>& out, const T value ) {
+    const size_t at = out.size();
+    out.resize( at + sizeof( T ) );
+    StoreLE( out.data() + at, value );
+}
+
+}
+
+#endif //LUMIN_BYTEORDER_HPP
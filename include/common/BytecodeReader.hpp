@@ -14,14 +14,229 @@
  See the License for the specific language governing permissions and
  limitations under the License.
  */
-
 #ifndef LUMIN_BYTECODEREADER_HPP
 #define LUMIN_BYTECODEREADER_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <OpCode.hpp>
+#include <ByteOrder.hpp>
+
 namespace Lumin::Bytecode {
 
-class BytecodeReader {};
+// OperandSize for every byte value, so decoding is a single table load
+inline constexpr auto OPERAND_SIZES = [] {
+    std::array<int8_t, 256> sizes {};
+    for ( size_t i = 0; i < sizes.size(); ++i ) {
+        sizes[i] = static_cast<int8_t>( OperandSize( static_cast<OpCode>( i ) ) );
+    }
+    return sizes;
+}();
+
+struct Instruction {
+    size_t offset; // From the start of the code
+    OpCode opcode; // For WIDE, the opcode it widens
+    bool wide;
+    std::span<const std::byte> operand; // Without the widened opcode byte
+
+    [[nodiscard]] size_t Size() const { return 1 + ( wide ? 1 : 0 ) + operand.size(); }
+    [[nodiscard]] size_t Next() const { return offset + Size(); }
+
+    [[nodiscard]] bool IsLocalAccess() const;
+    // Local slot of ILOAD/ISTORE in any of their forms
+    [[nodiscard]] uint32_t Local() const;
+    // Value pushed by ICONST and its short forms
+    [[nodiscard]] int32_t IntConstant() const;
+    [[nodiscard]] int32_t BranchOffset() const;
+    [[nodiscard]] size_t BranchTarget() const { return static_cast<size_t>( static_cast<int64_t>( Next() ) + BranchOffset() ); }
+    // 16-bit operand of CALL, TAILCALL, INVOKE, SCONST
+    [[nodiscard]] uint16_t Index() const { return Load<uint16_t>( 0 ); }
+
+    // Entries of TABLESWITCH and LOOKUPSWITCH, the default not counted
+    [[nodiscard]] uint32_t SwitchCount() const { return Load<uint32_t>( opcode == OpCode::TABLESWITCH ? 4 : 0 ); }
+    [[nodiscard]] int32_t SwitchKey( uint32_t entry ) const;
+    [[nodiscard]] size_t SwitchTarget( uint32_t entry ) const;
+    [[nodiscard]] size_t SwitchDefault() const;
+
+    // Operands of FOR_RANGE and LOOP_NEXT
+    [[nodiscard]] uint16_t LoopCounter() const { return Load<uint16_t>( 0 ); }
+    [[nodiscard]] uint16_t LoopLimit() const { return Load<uint16_t>( 2 ); }
+    [[nodiscard]] size_t LoopTarget() const { return static_cast<size_t>( static_cast<int64_t>( Next() ) + Load<int32_t>( 4 ) ); }
+
+    template < Utils::LittleEndianStorable T >
+    [[nodiscard]] T Load( const size_t at ) const {
+        return Utils::LoadLE<T>( reinterpret_cast<const unsigned char*>( operand.data() ) + at );
+    }
+};
+
+struct ValidationLimits {
+    uint32_t maxLocals = 0;
+    size_t methodCount = 0;
+    // Whether a constant pool index names a CONST_METHOD_REF, INVOKE is
+    // rejected when empty
+    std::function<bool( uint16_t )> isMethodRef;
+};
+
+// Decodes instructions from a method body. Operands are read with memcpy,
+// so the code does not need any alignment, and every decode is bounds
+// checked: a truncated or unknown instruction throws std::runtime_error.
+class BytecodeReader {
+public:
+    explicit BytecodeReader( const std::span<const std::byte> code ) : code( code ) {}
+    explicit BytecodeReader( const std::span<const unsigned char> code ) : code( std::as_bytes( code ) ) {}
+
+    [[nodiscard]] bool AtEnd() const { return position >= code.size(); }
+    [[nodiscard]] size_t Position() const { return position; }
+    [[nodiscard]] std::span<const std::byte> Code() const { return code; }
+    void Seek( const size_t offset ) { position = offset; }
+
+    [[nodiscard]] Instruction Decode( size_t offset ) const;
+    Instruction Next() {
+        const Instruction instruction = Decode( position );
+        position = instruction.Next();
+        return instruction;
+    }
+
+    // Checks the whole body in one linear pass: every instruction decodes,
+    // operands are in range and branches land on instruction boundaries.
+    void Validate( const ValidationLimits& limits ) const;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Instruction;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        Iterator( const BytecodeReader* reader, const size_t offset ) : reader( reader ), offset( offset ) {
+            Load();
+        }
+
+        const Instruction& operator*() const { return current; }
+        const Instruction* operator->() const { return &current; }
+        Iterator& operator++() {
+            offset = current.Next();
+            Load();
+            return *this;
+        }
+        void operator++( int ) { ++*this; }
+        bool operator==( std::default_sentinel_t ) const { return reader == nullptr || offset >= reader->code.size(); }
+
+    private:
+        // Forced inline: called from the constructor and from operator++,
+        // GCC otherwise keeps it out of line in larger loops and the
+        // Instruction goes through memory on every step
+        [[gnu::always_inline]] void Load() {
+            if ( reader != nullptr && offset < reader->code.size() ) {
+                current = reader->Decode( offset );
+            }
+        }
+
+        const BytecodeReader* reader = nullptr;
+        size_t offset = 0;
+        Instruction current {};
+    };
+
+    // Iterates from the start of the code, independent of Position
+    [[nodiscard]] Iterator begin() const { return { this, 0 }; }
+    [[nodiscard]] std::default_sentinel_t end() const { return {}; }
 
+private:
+    // Kept out of line so Decode stays small enough to inline
+    [[noreturn]] static void ThrowDecodeError( const char* message, size_t offset );
+    // WIDE and the switches, whose operand is not the size in OPERAND_SIZES
+    [[nodiscard]] Instruction DecodeVariable( size_t offset ) const;
+
+    std::span<const std::byte> code;
+    size_t position = 0;
+};
+
+inline bool Instruction::IsLocalAccess() const {
+    switch ( opcode ) {
+        case OpCode::ILOAD: case OpCode::ISTORE:
+        case OpCode::ILOAD_0: case OpCode::ILOAD_1: case OpCode::ILOAD_2: case OpCode::ILOAD_3:
+        case OpCode::ISTORE_0: case OpCode::ISTORE_1: case OpCode::ISTORE_2: case OpCode::ISTORE_3:
+            return true;
+        default:
+            return false;
+    }
+}
+
+inline uint32_t Instruction::Local() const {
+    switch ( opcode ) {
+        case OpCode::ILOAD:
+        case OpCode::ISTORE:
+            return wide ? Load<uint16_t>( 0 ) : Load<uint8_t>( 0 );
+        case OpCode::ILOAD_0: case OpCode::ILOAD_1: case OpCode::ILOAD_2: case OpCode::ILOAD_3:
+            return static_cast<uint32_t>( opcode ) - static_cast<uint32_t>( OpCode::ILOAD_0 );
+        case OpCode::ISTORE_0: case OpCode::ISTORE_1: case OpCode::ISTORE_2: case OpCode::ISTORE_3:
+            return static_cast<uint32_t>( opcode ) - static_cast<uint32_t>( OpCode::ISTORE_0 );
+        default:
+            throw std::logic_error( "Instruction has no local index" );
+    }
+}
+
+inline int32_t Instruction::IntConstant() const {
+    switch ( opcode ) {
+        case OpCode::ICONST:
+            return Load<int32_t>( 0 );
+        case OpCode::BIPUSH:
+            return Load<int8_t>( 0 );
+        case OpCode::SIPUSH:
+            return Load<int16_t>( 0 );
+        case OpCode::ICONST_M1: case OpCode::ICONST_0: case OpCode::ICONST_1: case OpCode::ICONST_2:
+        case OpCode::ICONST_3: case OpCode::ICONST_4: case OpCode::ICONST_5:
+            return static_cast<int32_t>( opcode ) - static_cast<int32_t>( OpCode::ICONST_0 );
+        default:
+            throw std::logic_error( "Instruction has no integer constant" );
+    }
+}
+
+inline int32_t Instruction::BranchOffset() const {
+    if ( !IsBranch( opcode ) ) {
+        throw std::logic_error( "Instruction is not a branch" );
+    }
+    return operand.size() == 1 ? Load<int8_t>( 0 ) : Load<int32_t>( 0 );
+}
+
+inline int32_t Instruction::SwitchKey( const uint32_t entry ) const {
+    if ( opcode == OpCode::TABLESWITCH ) {
+        return static_cast<int32_t>( static_cast<int64_t>( Load<int32_t>( 0 ) ) + entry );
+    }
+    return Load<int32_t>( 8 + 8 * static_cast<size_t>( entry ) );
+}
+
+inline size_t Instruction::SwitchTarget( const uint32_t entry ) const {
+    const size_t at = opcode == OpCode::TABLESWITCH ? 12 + 4 * static_cast<size_t>( entry ) : 12 + 8 * static_cast<size_t>( entry );
+    return static_cast<size_t>( static_cast<int64_t>( Next() ) + Load<int32_t>( at ) );
+}
+
+inline size_t Instruction::SwitchDefault() const {
+    return static_cast<size_t>( static_cast<int64_t>( Next() ) + Load<int32_t>( opcode == OpCode::TABLESWITCH ? 8 : 4 ) );
+}
+
+inline Instruction BytecodeReader::Decode( const size_t offset ) const {
+    if ( offset >= code.size() ) [[unlikely]] {
+        ThrowDecodeError( "Bytecode read out of bounds at ", offset );
+    }
+
+    const auto opcode = static_cast<OpCode>( code[offset] );
+    const int operandSize = OPERAND_SIZES[static_cast<uint8_t>( opcode )];
+    // -1 for an invalid opcode converts to the largest size_t
+    if ( static_cast<size_t>( operandSize ) > code.size() - offset - 1 ) [[unlikely]] {
+        ThrowDecodeError( operandSize < 0 ? "Invalid opcode at " : "Truncated operand at ", offset );
+    }
+    if ( opcode == OpCode::WIDE || IsSwitch( opcode ) ) [[unlikely]] {
+        return DecodeVariable( offset );
+    }
+
+    return { offset, opcode, false, { code.data() + offset + 1, static_cast<size_t>( operandSize ) } };
+}
 }
 
 #endif //LUMIN_BYTECODEREADER_HPP
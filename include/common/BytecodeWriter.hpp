@@ -18,21 +18,33 @@
 #ifndef LUMIN_BYTECODEWRITER_HPP
 #define LUMIN_BYTECODEWRITER_HPP
 
+#include <cstddef>
+#include <span>
 #include <vector>
-#include <Opcode.hpp>
+#include <OpCode.hpp>
 
 namespace Lumin::Bytecode {
 
+struct Label {
+    uint32_t id;
+};
+
+// Appends encoded instructions to bytecode. Branches to labels are kept
+// aside until Finish, which picks the 8-bit form wherever the target is in
+// reach and splices the branches in.
 class BytecodeWriter {
 public:
     std::vector<uint8_t> bytecode;
 
+    void Reserve(size_t bytes);
     void Emit(OpCode opcode);
+    void Emit(std::span<const uint8_t> bytes);
 
     void Emit(uint64_t value);
     void Emit(int64_t value);
     void Emit(uint32_t value);
     void Emit(int32_t value);
+    void Emit(uint16_t value);
     void Emit(int16_t value);
     void Emit(uint8_t value);
     void Emit(int8_t value);
@@ -40,6 +52,58 @@ public:
     void Emit(double value);
     void Emit(bool value);
 
+    // Pick the smallest encoding for the value or local index
+    void EmitIConst(int32_t value);
+    void EmitILoad(uint16_t index);
+    void EmitIStore(uint16_t index);
+
+    [[nodiscard]] Label NewLabel();
+    // Binds the label to the next instruction emitted
+    void Bind(Label label);
+    void EmitBranch(OpCode opcode, Label target);
+    // TABLESWITCH over the keys low up to low + targets.size() - 1
+    void EmitTableSwitch(int32_t low, std::span<const Label> targets, Label fallback);
+    // LOOKUPSWITCH, keys must be ascending and match targets one to one
+    void EmitLookupSwitch(std::span<const int32_t> keys, std::span<const Label> targets, Label fallback);
+    // FOR_RANGE or LOOP_NEXT over the counter and limit locals
+    void EmitCountedLoop(OpCode opcode, uint16_t counter, uint16_t limit, Label target);
+    // Resolves every branch, throws std::logic_error for an unbound label.
+    // bytecode is final afterwards, more code may still be appended.
+    void Finish();
+    // Final offset of a bound label, only valid after Finish
+    [[nodiscard]] size_t Offset(Label label) const;
+
+private:
+    static constexpr size_t UNBOUND = SIZE_MAX;
+
+    struct LabelSlot {
+        size_t position = UNBOUND; // In bytecode as emitted, without branches
+        size_t branchesBefore = 0;
+        size_t offset = 0; // Final offset, set by Finish
+    };
+
+    struct Branch {
+        size_t position; // In bytecode as emitted, the branch goes before it
+        OpCode opcode;
+        uint32_t target;
+        bool isLong = false;
+    };
+
+    // An offset of a switch or counted loop, patched in place since those
+    // have no short form to relax to
+    struct FixedOffset {
+        size_t position; // Of the offset in bytecode as emitted
+        size_t end; // Of the instruction, which offsets are from
+        size_t branchesBefore;
+        uint32_t target;
+    };
+
+    std::vector<LabelSlot> labels;
+    std::vector<Branch> branches;
+    std::vector<FixedOffset> fixedOffsets;
+
+    void EmitLocalAccess(OpCode opcode, OpCode shortForm0, uint16_t index);
+    void EmitFixedOffset(Label target, size_t end);
 };
 
 }
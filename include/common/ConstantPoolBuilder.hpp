@@ -0,0 +1,96 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef LUMIN_CONSTANTPOOLBUILDER_HPP
+#define LUMIN_CONSTANTPOOLBUILDER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <LuminFile.hpp>
+
+namespace Lumin::Utils {
+
+// Builds a constant pool in which every (tag, value) pair appears once.
+// Indices are handed out in insertion order and never change, so they can be
+// emitted into bytecode straight away.
+class ConstantPoolBuilder {
+public:
+    ConstantPoolBuilder() = default;
+    explicit ConstantPoolBuilder( const std::vector<ConstantPoolEntry>& existing );
+
+    uint16_t Add( const ConstantPoolEntry& entry );
+
+    uint16_t AddInteger( int32_t value );
+    uint16_t AddLong( int64_t value );
+    uint16_t AddFloat( float value );
+    uint16_t AddDouble( double value );
+    uint16_t AddUtf8( std::string_view value );
+    uint16_t AddString( std::string_view value );
+    // Class, method and field references name their target by a UTF8 entry
+    uint16_t AddClass( std::string_view name );
+    uint16_t AddMethodRef( std::string_view name );
+    uint16_t AddFieldRef( std::string_view name );
+
+    [[nodiscard]] size_t Size() const { return entries.size(); }
+    [[nodiscard]] const std::vector<ConstantPoolEntry>& Entries() const { return entries; }
+    std::vector<ConstantPoolEntry> Release();
+
+private:
+    // Numbers are keyed by their bit pattern, so 0.0 and -0.0 stay distinct
+    struct Key {
+        ConstantPoolTag tag;
+        uint64_t bits;
+        std::string text;
+    };
+
+    struct KeyView {
+        ConstantPoolTag tag;
+        uint64_t bits;
+        std::string_view text;
+    };
+
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()( const KeyView& key ) const;
+        size_t operator()( const Key& key ) const { return ( *this )( KeyView { key.tag, key.bits, key.text } ); }
+    };
+
+    struct KeyEqual {
+        using is_transparent = void;
+        static KeyView View( const Key& key ) { return { key.tag, key.bits, key.text }; }
+        static KeyView View( const KeyView& key ) { return key; }
+        template < typename A, typename B >
+        bool operator()( const A& a, const B& b ) const {
+            const KeyView x = View( a );
+            const KeyView y = View( b );
+            return x.tag == y.tag && x.bits == y.bits && x.text == y.text;
+        }
+    };
+
+    uint16_t Intern( const KeyView& key, ConstantPoolEntry&& entry );
+    uint16_t AddReference( ConstantPoolTag tag, std::string_view name );
+
+    std::vector<ConstantPoolEntry> entries;
+    std::unordered_map<Key, uint16_t, KeyHash, KeyEqual> index;
+};
+
+}
+
+#endif //LUMIN_CONSTANTPOOLBUILDER_HPP
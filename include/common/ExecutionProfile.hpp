@@ -0,0 +1,72 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef LUMIN_EXECUTIONPROFILE_HPP
+#define LUMIN_EXECUTIONPROFILE_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Lumin::Utils {
+
+// Times a branch of a method body went each way. GOTO is only ever taken.
+struct BranchCount {
+    uint32_t offset; // Of the branch opcode in the body
+    uint64_t taken;
+    uint64_t notTaken;
+};
+
+struct MethodProfile {
+    std::string name;
+    uint64_t codeHash = 0; // HashCode of the body the counts belong to
+    uint64_t calls = 0;
+    std::vector<BranchCount> branches; // Ascending offsets
+};
+
+struct CallCount {
+    uint32_t caller;
+    uint32_t callee;
+    uint64_t count;
+};
+
+// What `lumin --profile-out` saw a program do, for `luminc --profile-use`.
+// Offsets only mean something for the exact bodies that ran, a method whose
+// body hashes differently is recompiled without its counts.
+struct ExecutionProfile {
+    std::vector<MethodProfile> methods; // By method index
+    std::vector<CallCount> calls;
+};
+
+// FNV-1a of a method body
+[[nodiscard]] uint64_t HashCode( std::span<const unsigned char> code );
+
+/*
+ Text, one record a line, so a profile can be read and diffed:
+
+   lumin-profile 1
+   method <index> <calls> <code hash, hex> <name>
+   branch <offset> <taken> <not taken>      of the last method line
+   call <caller> <callee> <count>
+ */
+bool WriteProfileFile( const std::string& outputPath, const ExecutionProfile& profile );
+bool ReadProfileFile( const std::string& inputPath, ExecutionProfile& profile );
+
+}
+
+#endif //LUMIN_EXECUTIONPROFILE_HPP
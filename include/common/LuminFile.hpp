@@ -19,15 +19,20 @@
 #define LUMINFILE_HPP
 
 #include <cstdint>
+#include <span>
 #include <variant>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <MappedFile.hpp>
 
 constexpr uint8_t LUMIN_VERSION_MAJOR = 25;
 constexpr uint8_t LUMIN_VERSION_MINOR = 0;
 constexpr uint8_t LUMIN_VERSION_PATCH = 0;
 
 constexpr uint32_t LUMIN_MAGIC_NUMBER = 0xC0FFEE;
+constexpr uint16_t LUMIN_FORMAT_VERSION = 2;
+constexpr uint32_t LUMIN_NO_ENTRY_METHOD = 0xFFFFFFFF;
 
 constexpr uint8_t FLAG_PUBLIC = 0x01;
 constexpr uint8_t FLAG_PRIVATE = 0x02;
@@ -51,6 +56,9 @@ struct MethodInfo {
     uint16_t signatureIndex; // Index fin CP for return/parameter types
     uint16_t maxStack; // Max operand stack size needed
     uint16_t maxLocals; // Number of local variables (incl parameters)
+    uint16_t parameterCount; // Arguments popped into the first locals on call
+    uint32_t codeOffset; // Offset of the method body in the code section
+    uint32_t codeLength; // Size of the method body in bytes
 };
 
 struct ClassInfo {
@@ -92,8 +100,8 @@ struct ConstantPoolEntry {
         uint16_t
     > data;
 
-    void Serialize(std::ofstream &outFile) const;
-    static ConstantPoolEntry Deserialize(std::ifstream &inFile);
+    void Serialize(std::vector<unsigned char>& out) const;
+    static ConstantPoolEntry Deserialize(std::span<const unsigned char> bytes);
 };
 
 struct LuminFile {
@@ -101,14 +109,113 @@ struct LuminFile {
     uint8_t versionMajor;
     uint8_t versionMinor;
     uint16_t flags;
+    uint32_t entryMethod = LUMIN_NO_ENTRY_METHOD; // Index in methods, or run the code section from 0
     std::vector<ConstantPoolEntry> constantPool;
-    std::vector<unsigned char> bytecode;
+    std::vector<ClassInfo> classes;
+    std::vector<MethodInfo> methods; // Free functions, class methods live in their ClassInfo
+    std::vector<unsigned char> bytecode; // Code section, method bodies point into it
+};
+
+/*
+ Format v2 layout. All integers are fixed-width little-endian and every
+ section starts on an 8-byte boundary, so a loader can jump straight to the
+ part it needs.
+
+   LuminFileHeader
+   LuminSectionEntry[sectionCount]
+   sections, in any order
+
+ CONSTANT_POOL  uint32 offset per entry (from the section start), then the
+                entries, each 8-byte aligned: tag, 3 reserved bytes, a
+                uint32 payload (value, reference or string length), then
+                8 more bytes for 64-bit values or the string bytes.
+ CLASSES        LUMIN_CLASS_RECORD_SIZE bytes per class, with ranges into
+                FIELDS and METHODS.
+ FIELDS         LUMIN_FIELD_RECORD_SIZE bytes per field.
+ METHODS        LUMIN_METHOD_RECORD_SIZE bytes per method, free functions
+                first, then each class's methods.
+ CODE           Method bodies, addressed by MethodInfo::codeOffset.
+ */
+enum class LuminSection : uint32_t {
+    CONSTANT_POOL = 1,
+    CLASSES = 2,
+    FIELDS = 3,
+    METHODS = 4,
+    CODE = 5,
+};
+
+struct LuminFileHeader {
+    uint32_t magicNumber;
+    uint8_t versionMajor;
+    uint8_t versionMinor;
+    uint16_t flags;
+    uint16_t formatVersion;
+    uint16_t sectionCount;
+    uint32_t entryMethod;
+};
+
+struct LuminSectionEntry {
+    LuminSection kind;
+    uint32_t count; // Number of records, entries or bytes in the section
+    uint64_t offset;
+    uint64_t size;
+};
+
+constexpr size_t LUMIN_HEADER_SIZE = 16;
+constexpr size_t LUMIN_SECTION_ENTRY_SIZE = 24;
+constexpr size_t LUMIN_CLASS_RECORD_SIZE = 24;
+constexpr size_t LUMIN_FIELD_RECORD_SIZE = 16;
+constexpr size_t LUMIN_METHOD_RECORD_SIZE = 24;
+
+struct ConstantPoolEntryView {
+    ConstantPoolTag tag;
+    std::variant<
+        std::monostate,
+        int32_t,
+        float,
+        int64_t,
+        double,
+        std::string_view,
+        uint16_t
+    > data;
+};
+
+// LuminFile backed by a read-only mapping of the file. Strings and bytecode
+// point into the mapping and stay valid for as long as the view lives.
+// Section bounds are validated on load, records are decoded on access.
+struct LuminFileView {
+    uint32_t magicNumber;
+    uint8_t versionMajor;
+    uint8_t versionMinor;
+    uint16_t flags;
+    uint32_t entryMethod;
+    std::span<const unsigned char> constantPool; // Whole section, offset index first
+    std::span<const unsigned char> classTable;
+    std::span<const unsigned char> fieldTable;
+    std::span<const unsigned char> methodTable;
+    std::span<const unsigned char> bytecode;
+    uint32_t constantCount;
+    uint32_t classCount;
+    uint32_t fieldCount;
+    uint32_t methodCount;
+    std::span<const unsigned char> image; // The whole file
+    Lumin::Utils::MappedFile mapping; // Owns image when it was mapped from disk
+
+    [[nodiscard]] ConstantPoolEntryView Constant(size_t index) const;
+    [[nodiscard]] ClassInfo Class(size_t index) const;
+    [[nodiscard]] FieldInfo Field(size_t index) const;
+    [[nodiscard]] MethodInfo Method(size_t index) const;
+    [[nodiscard]] std::span<const unsigned char> Code(const MethodInfo& method) const;
 };
 
 namespace Lumin::Utils {
 
+std::vector<unsigned char> SerializeLuminFile(const LuminFile& luminFile);
 bool WriteLuminFile(const std::string& outputPath, const LuminFile& luminFile);
 LuminFile ReadLuminFile(const std::string& inputPath);
+LuminFileView MapLuminFile(const std::string& inputPath);
+// Validates an image already in memory, the view borrows the bytes
+LuminFileView ViewLuminFile(std::span<const unsigned char> image, const std::string& name);
 
 }
 
@@ -0,0 +1,57 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef LUMIN_MAPPEDFILE_HPP
+#define LUMIN_MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace Lumin::Utils {
+
+// Read-only memory mapping of a whole file. Processes mapping the same file
+// share its pages through the page cache, nothing is copied on open.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile( const std::string& path );
+    ~MappedFile();
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+    MappedFile( MappedFile&& other ) noexcept;
+    MappedFile& operator=( MappedFile&& other ) noexcept;
+
+    [[nodiscard]] bool IsOpen() const { return data != nullptr; }
+    [[nodiscard]] const unsigned char* Data() const { return data; }
+    [[nodiscard]] size_t Size() const { return size; }
+    [[nodiscard]] std::span<const unsigned char> Bytes() const { return { data, size }; }
+
+private:
+    void Close();
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    void* mapping = nullptr;
+#endif
+};
+
+}
+
+#endif //LUMIN_MAPPEDFILE_HPP
@@ -21,6 +21,14 @@
 #include <variant>
 #include <cstdint>
 
+// An array on the VM heap, held by index so values stay trivially copyable
+// and a snapshot can store them as they are
+struct ArrayRef {
+    uint32_t index;
+
+    bool operator==( const ArrayRef& ) const = default;
+};
+
 using NumericValue = std::variant<
     std::monostate,  // null
     bool,
@@ -28,7 +36,8 @@ using NumericValue = std::variant<
     int32_t,
     int64_t,
     float,
-    double
+    double,
+    ArrayRef
 >;
 
 #endif //NUMERICVALUE_HPP
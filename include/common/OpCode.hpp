@@ -18,6 +18,7 @@
 #ifndef LUMIN_OPCODE_HPP
 #define LUMIN_OPCODE_HPP
 
+#include <cstddef>
 #include <cstdint>
 
 namespace Lumin::Bytecode {
@@ -110,9 +111,260 @@ enum class OpCode : unsigned char {
     // Memory and array operations
     LOAD_ARRAY = 64,   // Load array element
     STORE_ARRAY = 65,  // Store to array element
-    ALLOC_ARRAY = 66   // Allocate new array
+    ALLOC_ARRAY = 66,  // Allocate new zeroed array of an ArrayElement type
+
+    // VM control
+    SNAPSHOT = 67,     // Snapshot VM state and stop, when snapshotting is enabled
+
+    // Constant pool references
+    INVOKE = 68,       // Call the method named by a CONST_METHOD_REF
+
+    // Short forms, the operand is implied by the opcode or narrower
+    ICONST_M1 = 69,    // Push -1
+    ICONST_0 = 70,     // Push 0
+    ICONST_1 = 71,     // Push 1
+    ICONST_2 = 72,     // Push 2
+    ICONST_3 = 73,     // Push 3
+    ICONST_4 = 74,     // Push 4
+    ICONST_5 = 75,     // Push 5
+    BIPUSH = 76,       // Push sign-extended 8-bit integer
+    SIPUSH = 77,       // Push sign-extended 16-bit integer
+    ILOAD_0 = 78,      // Load integer from local 0
+    ILOAD_1 = 79,      // Load integer from local 1
+    ILOAD_2 = 80,      // Load integer from local 2
+    ILOAD_3 = 81,      // Load integer from local 3
+    ISTORE_0 = 82,     // Store integer to local 0
+    ISTORE_1 = 83,     // Store integer to local 1
+    ISTORE_2 = 84,     // Store integer to local 2
+    ISTORE_3 = 85,     // Store integer to local 3
+    WIDE = 86,         // Next ILOAD/ISTORE takes a 16-bit local index
+
+    // Branches with a signed 8-bit offset
+    IFEQ_S = 87,
+    GOTO_S = 88,
+    IFNE_S = 89,
+    IFLT_S = 90,
+    IFGT_S = 91,
+    IFLE_S = 92,
+    IFGE_S = 93,
+
+    FCMP = 94,         // Compare top two float stack values, like ICMP
+    ACONST_NULL = 95,  // Push a null reference
+
+    // Element-wise array arithmetic over a range of indices, see VectorMode
+    VADD = 96,
+    VSUB = 97,
+    VMUL = 98,
+    VDIV = 99,         // Float arrays only
+
+    ALLOC_LOCAL_ARRAY = 100, // ALLOC_ARRAY of an array that does not outlive the method's frame
+    TAILCALL = 101,          // CALL and RETURN in one, the callee takes over the caller's frame
+
+    // Multiway branches on the int popped from the stack, see SwitchEntrySize
+    TABLESWITCH = 102,       // Jump table indexed by the key minus the lowest key
+    LOOKUPSWITCH = 103,      // Binary search over sorted keys
+
+    // Counted loops over an int local, see IsCountedLoop
+    FOR_RANGE = 104,         // Pops the limit into its local, jumps unless counter < limit
+    LOOP_NEXT = 105,         // Increments the counter, jumps back while counter < limit
+
+    // Null references, see IsNonNullAccess
+    ISNULL = 106,              // Pops a reference, pushes 1 if it is null, else 0
+    LOAD_ARRAY_NONNULL = 107,  // LOAD_ARRAY of an array the compiler proved is not null
+    STORE_ARRAY_NONNULL = 108  // STORE_ARRAY of an array the compiler proved is not null
 };
 
+// Operand of ALLOC_ARRAY and ALLOC_LOCAL_ARRAY
+enum class ArrayElement : uint8_t { INT = 0, FLOAT = 1 };
+
+/*
+ Operand of the vector opcodes. They pop the end and begin of an index range,
+ the right and left operands and the destination array, then compute
+ dst[i] = left[i] op right[i] for the longest prefix of the range whose
+ length is a multiple of VECTOR_LANES, and push the first index they left
+ for the scalar loop that follows. An operand marked scalar is a number used
+ for every element instead of an array.
+
+ Nothing is done, and begin is pushed back, when an array is null or the
+ prefix is out of its bounds: the scalar loop then fails at the same element
+ it would have without the vector instruction. VECTOR_CHECK only pushes the
+ index without writing anything, so a loop with several vector statements
+ can find the range all of them accept before the first one runs.
+ */
+enum VectorMode : uint8_t {
+    VECTOR_LEFT_SCALAR = 1,
+    VECTOR_RIGHT_SCALAR = 2,
+    VECTOR_CHECK = 4
+};
+
+constexpr int32_t VECTOR_LANES = 4;
+
+// Bytes of inline operand following an opcode, -1 if the byte is not an opcode.
+// Branches carry a signed 32-bit offset from the end of the branch instruction,
+// their _S forms a signed 8-bit one,
+// CALL and TAILCALL a 16-bit index into the method table, INVOKE a 16-bit
+// constant pool index.
+// ILOAD/ISTORE take an 8-bit local index, WIDE is followed by the widened
+// opcode and a 16-bit index. ALLOC_ARRAY and ALLOC_LOCAL_ARRAY take an 8-bit
+// ArrayElement, the vector opcodes an 8-bit VectorMode. FOR_RANGE and
+// LOOP_NEXT take a 16-bit counter local, a 16-bit limit local and a branch
+// offset.
+// The switches are variable length, their size is that of the fixed part.
+constexpr int OperandSize( const OpCode opcode ) {
+    switch ( opcode ) {
+        case OpCode::CCONST:
+        case OpCode::ILOAD:
+        case OpCode::ISTORE:
+        case OpCode::BIPUSH:
+        case OpCode::ALLOC_ARRAY: case OpCode::ALLOC_LOCAL_ARRAY:
+        case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VDIV:
+        case OpCode::IFEQ_S: case OpCode::GOTO_S: case OpCode::IFNE_S: case OpCode::IFLT_S:
+        case OpCode::IFGT_S: case OpCode::IFLE_S: case OpCode::IFGE_S:
+            return 1;
+        case OpCode::SCONST:
+        case OpCode::CALL:
+        case OpCode::TAILCALL:
+        case OpCode::INVOKE:
+        case OpCode::SIPUSH:
+            return 2;
+        case OpCode::WIDE:
+            return 3;
+        case OpCode::ICONST:
+        case OpCode::FCONST:
+        case OpCode::IFEQ:
+        case OpCode::GOTO:
+        case OpCode::IFNE:
+        case OpCode::IFLT:
+        case OpCode::IFGT:
+        case OpCode::IFLE:
+        case OpCode::IFGE:
+            return 4;
+        case OpCode::DCONST:
+        case OpCode::LCONST:
+        case OpCode::LOOKUPSWITCH:
+        case OpCode::FOR_RANGE:
+        case OpCode::LOOP_NEXT:
+            return 8;
+        case OpCode::TABLESWITCH:
+            return 12;
+        case OpCode::IADD: case OpCode::ISUB: case OpCode::IMUL: case OpCode::IDIV:
+        case OpCode::IPRINT: case OpCode::ICMP: case OpCode::FCMP: case OpCode::HALT:
+        case OpCode::SWAP: case OpCode::DUP: case OpCode::POP:
+        case OpCode::I2F: case OpCode::F2I: case OpCode::I2D: case OpCode::D2I:
+        case OpCode::I2L: case OpCode::L2I: case OpCode::I2C: case OpCode::C2I:
+        case OpCode::I2S: case OpCode::S2I:
+        case OpCode::FADD: case OpCode::FSUB: case OpCode::FMUL: case OpCode::FDIV:
+        case OpCode::FNEG: case OpCode::FPRINT:
+        case OpCode::DADD: case OpCode::DSUB: case OpCode::DMUL: case OpCode::DDIV:
+        case OpCode::DNEG: case OpCode::DPRINT:
+        case OpCode::LADD: case OpCode::LSUB: case OpCode::LMUL: case OpCode::LDIV:
+        case OpCode::LNEG: case OpCode::LPRINT:
+        case OpCode::CPRINT: case OpCode::SPRINT:
+        case OpCode::RETURN:
+        case OpCode::IAND: case OpCode::IOR: case OpCode::IXOR: case OpCode::INEG:
+        case OpCode::LAND: case OpCode::LOR: case OpCode::LXOR:
+        case OpCode::LOAD_ARRAY: case OpCode::STORE_ARRAY: case OpCode::ACONST_NULL:
+        case OpCode::ISNULL: case OpCode::LOAD_ARRAY_NONNULL: case OpCode::STORE_ARRAY_NONNULL:
+        case OpCode::SNAPSHOT:
+        case OpCode::ICONST_M1: case OpCode::ICONST_0: case OpCode::ICONST_1: case OpCode::ICONST_2:
+        case OpCode::ICONST_3: case OpCode::ICONST_4: case OpCode::ICONST_5:
+        case OpCode::ILOAD_0: case OpCode::ILOAD_1: case OpCode::ILOAD_2: case OpCode::ILOAD_3:
+        case OpCode::ISTORE_0: case OpCode::ISTORE_1: case OpCode::ISTORE_2: case OpCode::ISTORE_3:
+            return 0;
+    }
+    return -1;
+}
+
+/*
+ TABLESWITCH is followed by the int32 lowest key, a uint32 entry count and
+ the int32 default offset, then an int32 offset per key from the lowest one
+ up. LOOKUPSWITCH is followed by a uint32 entry count and the int32 default
+ offset, then an int32 key and offset pair per entry, keys ascending. Like
+ branch offsets, all are from the end of the instruction, entries included.
+ */
+constexpr bool IsSwitch( const OpCode opcode ) {
+    return opcode == OpCode::TABLESWITCH || opcode == OpCode::LOOKUPSWITCH;
+}
+
+// Bytes per entry after the fixed operand of a switch
+constexpr size_t SwitchEntrySize( const OpCode opcode ) {
+    return opcode == OpCode::TABLESWITCH ? 4 : 8;
+}
+
+/*
+ FOR_RANGE and LOOP_NEXT keep a loop's int counter and limit in locals and
+ have no short form. FOR_RANGE runs once on entry: it stores the limit it
+ pops and jumps to its target, past the loop, unless counter < limit.
+ LOOP_NEXT closes the loop: it adds 1 to the counter and jumps back to its
+ target while counter < limit. The counter cannot overflow, it only grows
+ while it is below an int limit.
+ */
+constexpr bool IsCountedLoop( const OpCode opcode ) {
+    return opcode == OpCode::FOR_RANGE || opcode == OpCode::LOOP_NEXT;
+}
+
+/*
+ The _NONNULL array accesses skip the null test of LOAD_ARRAY and
+ STORE_ARRAY: the compiler only emits them where its dataflow analysis
+ proved the array was allocated, compared unequal to null or already
+ accessed. Bounds are still checked. Nothing verifies the proof, so the VM
+ still rejects a null it is handed, as a malformed program rather than as a
+ null access.
+ */
+constexpr bool IsNonNullAccess( const OpCode opcode ) {
+    return opcode == OpCode::LOAD_ARRAY_NONNULL || opcode == OpCode::STORE_ARRAY_NONNULL;
+}
+
+constexpr bool IsBranch( const OpCode opcode ) {
+    switch ( opcode ) {
+        case OpCode::IFEQ:
+        case OpCode::GOTO:
+        case OpCode::IFNE:
+        case OpCode::IFLT:
+        case OpCode::IFGT:
+        case OpCode::IFLE:
+        case OpCode::IFGE:
+        case OpCode::IFEQ_S:
+        case OpCode::GOTO_S:
+        case OpCode::IFNE_S:
+        case OpCode::IFLT_S:
+        case OpCode::IFGT_S:
+        case OpCode::IFLE_S:
+        case OpCode::IFGE_S:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The 8-bit offset form of a branch, the opcode itself if it has none
+constexpr OpCode ShortBranch( const OpCode opcode ) {
+    switch ( opcode ) {
+        case OpCode::IFEQ: return OpCode::IFEQ_S;
+        case OpCode::GOTO: return OpCode::GOTO_S;
+        case OpCode::IFNE: return OpCode::IFNE_S;
+        case OpCode::IFLT: return OpCode::IFLT_S;
+        case OpCode::IFGT: return OpCode::IFGT_S;
+        case OpCode::IFLE: return OpCode::IFLE_S;
+        case OpCode::IFGE: return OpCode::IFGE_S;
+        default: return opcode;
+    }
+}
+
+// The 32-bit offset form of a branch, the opcode itself if it already is
+constexpr OpCode LongBranch( const OpCode opcode ) {
+    switch ( opcode ) {
+        case OpCode::IFEQ_S: return OpCode::IFEQ;
+        case OpCode::GOTO_S: return OpCode::GOTO;
+        case OpCode::IFNE_S: return OpCode::IFNE;
+        case OpCode::IFLT_S: return OpCode::IFLT;
+        case OpCode::IFGT_S: return OpCode::IFGT;
+        case OpCode::IFLE_S: return OpCode::IFLE;
+        case OpCode::IFGE_S: return OpCode::IFGE;
+        default: return opcode;
+    }
+}
+
 }
 
 #endif //LUMIN_OPCODE_HPP
@@ -0,0 +1,58 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_AOTCOMPILER_HPP
+#define LUMIN_AOTCOMPILER_HPP
+
+#include <string>
+#include <vector>
+#include <LuminFile.hpp>
+
+namespace Lumin::Compiler {
+
+struct AotOptions {
+    // C compiler, one word. When empty, $CC split into words as make does,
+    // then cc.
+    std::string compiler;
+    std::vector<std::string> compilerFlags { "-O2" };
+    bool sharedObject = false; // Build a shared object exporting lumin_run instead of an executable
+    bool keepSource = false; // Keep the generated C next to the output
+};
+
+/*
+ Translates every method reachable from the entry into a C function.
+ A whole-program pass infers the type of each local and operand stack
+ slot; slots that only ever hold an int, a float or an array of one type
+ become plain C variables, everything else is a tagged lm_value handled by
+ the small runtime emitted at the top of the file. Array accesses keep the
+ interpreter's null and bounds checks, and the vector opcodes run as plain
+ loops over the same prefix of their range.
+
+ The generated lumin_run() leaves the entry method's results in an array,
+ main() prints them the same way for every build.
+
+ Throws std::runtime_error for bytecode the translator does not support:
+ opcodes the interpreter has no handler for, stack depths that differ
+ between paths, or methods that return more than one value.
+ */
+std::string TranslateToC( const LuminFile& program );
+
+// Writes the C translation next to outputPath and runs the C compiler on it
+bool CompileNative( const LuminFile& program, const std::string& outputPath, const AotOptions& options = {} );
+
+}
+
+#endif //LUMIN_AOTCOMPILER_HPP
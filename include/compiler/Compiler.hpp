@@ -14,8 +14,70 @@
  See the License for the specific language governing permissions and
  limitations under the License.
  */
-
 #ifndef LUMIN_COMPILER_HPP
 #define LUMIN_COMPILER_HPP
 
+#include <string>
+#include <string_view>
+#include <ExecutionProfile.hpp>
+#include <LuminFile.hpp>
+#include <ir/BytecodeEmitter.hpp>
+#include <ir/Passes.hpp>
+
+namespace Lumin::Compiler {
+
+struct CompilerOptions {
+    int optimizationLevel = 1; // 0 to 2, see IR::Optimize
+    bool dumpIR = false; // Keep a dump of the optimized IR
+    IR::LoopOptions loops;
+    IR::AllocationOptions allocations;
+    IR::EmitOptions emit;
+    // Lays out blocks and methods by a run of the program compiled the same
+    // way without a profile, not owned
+    const Utils::ExecutionProfile* profile = nullptr;
+};
+
+// What the profile changed, for the -V report
+struct LayoutCounts {
+    uint32_t methods = 0;    // Laid out by their counts
+    uint32_t stale = 0;      // Ran, but the profile was taken on different code
+    uint32_t coldBlocks = 0; // Moved to the end of their method
+};
+
+// Frame sizes of all methods, for the -V report
+struct FrameCounts {
+    uint32_t locals = 0;
+    uint32_t valueLocals = 0; // With a local for every stored value
+};
+
+// Source to program: lex, parse, lower to SSA, optimize and emit bytecode
+class Compiler {
+public:
+    explicit Compiler( CompilerOptions options = {} ) : options( options ) {}
+
+    // Throws std::runtime_error for syntax errors and programs the code
+    // generator cannot handle
+    LuminFile Compile( std::string_view source );
+
+    [[nodiscard]] const std::string& IRDump() const { return irDump; }
+    // Counted as lowered and as emitted, for the -V report
+    [[nodiscard]] const IR::NullCheckCounts& LoweredNullChecks() const { return loweredNullChecks; }
+    [[nodiscard]] const IR::NullCheckCounts& EmittedNullChecks() const { return emittedNullChecks; }
+    [[nodiscard]] const LayoutCounts& Layout() const { return layout; }
+    [[nodiscard]] const FrameCounts& Frames() const { return frames; }
+
+private:
+    // Emits the function, once more in the profile's block order when it has counts for it
+    IR::EmittedMethod Emit( IR::Module& module, uint32_t function );
+
+    CompilerOptions options;
+    std::string irDump;
+    IR::NullCheckCounts loweredNullChecks;
+    IR::NullCheckCounts emittedNullChecks;
+    LayoutCounts layout;
+    FrameCounts frames;
+};
+
+}
+
 #endif //LUMIN_COMPILER_HPP
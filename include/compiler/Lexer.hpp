@@ -26,10 +26,12 @@ namespace Lumin::Compiler {
 
 class Lexer {
 public:
+    // Throws std::runtime_error for sources of 4 GiB and more, tokens keep 32-bit offsets
     explicit Lexer( std::string_view source );
 
-    std::vector<Token> Tokenize();
+    TokenStream Tokenize();
 private:
+    void SkipWhitespace();
     Token ScanToken();
     Token IdentifierToken();
     Token NumberToken();
@@ -41,11 +43,11 @@ private:
     char Advance();
     Token MakeToken( TokenType type ) const;
     bool IsAtEnd() const;
-    static std::string_view Trim( const std::string_view& source );
 
     std::string_view source;
     size_t start = 0;
     size_t current = 0;
+    TokenStream lexed;
 };
 
 }
@@ -19,45 +19,71 @@
 #define LUMIN_PARSER_HPP
 
 #include <memory>
+#include <string_view>
 #include <vector>
 #include <TokenType.hpp>
 #include <statements/VariableStatement.hpp>
 #include <statements/FunctionStatement.hpp>
 #include <statements/ReturnStatement.hpp>
 #include <statements/ExpressionStatement.hpp>
+#include <statements/BlockStatement.hpp>
+#include <statements/IfStatement.hpp>
+#include <statements/WhileStatement.hpp>
+#include <statements/ForStatement.hpp>
+#include <statements/MatchStatement.hpp>
 #include <expressions/GetVariableExpression.hpp>
 #include <expressions/AssignmentExpression.hpp>
 #include <expressions/BinaryExpression.hpp>
 #include <expressions/UnaryExpression.hpp>
 #include <expressions/LiteralExpression.hpp>
 #include <expressions/CallExpression.hpp>
+#include <expressions/NewArrayExpression.hpp>
+#include <expressions/IndexExpression.hpp>
+#include <expressions/IndexAssignmentExpression.hpp>
 
 namespace Lumin::Compiler {
 
 class Parser {
 public:
-    explicit Parser(std::vector<Token> tokens);
+    // Tokens of source, which has to outlive the parser
+    Parser( std::string_view source, TokenStream lexed );
     std::vector<std::unique_ptr<Statement>> Parse();
+    // Whether a declaration failed to parse and was skipped
+    [[nodiscard]] bool HadError() const { return hadError; }
 private:
     // Declaration parsing methods
     std::unique_ptr<Statement> ParseDeclaration();
-    std::unique_ptr<Statement> ParseFunctionDeclaration(AccessModifier access, InlineSpecifier inlineSpec);
-    std::unique_ptr<Statement> ParseVariableDeclaration(AccessModifier access);
+    std::unique_ptr<Statement> ParseFunctionDeclaration(AccessModifier access, InlineSpecifier inlineSpec, bool isConstexpr);
+    std::unique_ptr<Statement> ParseVariableDeclaration(AccessModifier access, bool isConstexpr);
 
     // Statement parsing methods
     std::unique_ptr<Statement> ParseStatement();
     std::unique_ptr<Statement> ParseReturnStatement();
+    std::unique_ptr<Statement> ParseIfStatement();
+    std::unique_ptr<Statement> ParseWhileStatement();
+    std::unique_ptr<Statement> ParseForStatement();
+    std::unique_ptr<Statement> ParseMatchStatement();
+    int32_t ParseMatchKey();
     std::unique_ptr<Statement> ParseExpressionStatement();
     std::vector<std::unique_ptr<Statement>> ParseBlock();
+    // A type keyword or a type parameter in scope, optionally followed by []
+    TypeAnnotation ParseTypeAnnotation( const std::string& message );
     // Expression parsing methods
     std::unique_ptr<Expression> ParseExpression();
     std::unique_ptr<Expression> ParseAssignment();
     std::unique_ptr<Expression> ParseEquality();
     std::unique_ptr<Expression> ParseComparison();
+    std::unique_ptr<Expression> ParseElvis();
     std::unique_ptr<Expression> ParseAdditive();
     std::unique_ptr<Expression> ParseMultiplicative();
     std::unique_ptr<Expression> ParseUnary();
+    std::unique_ptr<Expression> ParseIndex();
     std::unique_ptr<Expression> ParsePrimary();
+    std::unique_ptr<Expression> ParseNewArray( TypeAnnotation elementType );
+    // Whether `<` after a function name opens type arguments rather than a
+    // comparison, decided by the token after it: no expression starts
+    // with a type
+    bool CheckTypeArguments() const;
 
     // Modifier/Specifiers parsing methods
     AccessModifier ParseAccessModifier();
@@ -66,15 +92,23 @@ private:
     // Helper
     bool Match(std::initializer_list<TokenType> types);
     bool Check(TokenType type) const;
+    bool IsTypeParameter( const Token& token ) const;
     Token Consume(TokenType type, const std::string& message);
     Token Advance();
     bool IsAtEnd() const;
     Token& Previous();
+    [[nodiscard]] std::string_view Lexeme( const Token& token ) const;
+    // Value of the number literal at a token index
+    [[nodiscard]] const NumberValue& Number( size_t index ) const;
     void Synchronize();
 
 
+    std::string_view source;
     std::vector<Token> tokens;
+    std::vector<NumberValue> numbers;
     size_t current;
+    bool hadError = false;
+    std::vector<std::string> typeParameters; // Of the generic function being parsed
 };
 
 }
@@ -18,7 +18,8 @@
 #ifndef TOKENTYPE_HPP
 #define TOKENTYPE_HPP
 
-#include <string>
+#include <cstdint>
+#include <vector>
 
 namespace Lumin::Compiler {
 
@@ -100,12 +101,29 @@ enum class TokenType {
     SPECIAL_END, SPECIAL_ERROR
 };
 
+// Where a token is in the source it was lexed from, its lexeme is a view
+// of that
 struct Token {
     TokenType type;
-    std::string lexeme;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// Value of a number literal, parsed while lexing: ints and longs into
+// integer, floats and doubles into real. Kept beside the tokens, so every
+// token stays 12 bytes.
+struct NumberValue {
+    uint32_t token; // Index of the literal's token
+    union {
+        int64_t integer = 0;
+        double real;
+    };
+};
 
-    size_t line = 0;
-    size_t column = 0;
+// What the lexer produces, the tokens end with SPECIAL_END
+struct TokenStream {
+    std::vector<Token> tokens;
+    std::vector<NumberValue> numbers; // Ascending token indices
 };
 
 }
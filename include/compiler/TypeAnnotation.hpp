@@ -0,0 +1,34 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef TYPEANNOTATION_HPP
+#define TYPEANNOTATION_HPP
+
+#include <string>
+#include "TokenType.hpp"
+
+using namespace Lumin::Compiler;
+
+// A written type, such as `int` or `float[]`, by its keyword. A type
+// parameter of a generic function is a LITERAL_IDENTIFIER with its name.
+struct TypeAnnotation {
+    TokenType type;
+    bool isArray = false;
+    std::string name;
+};
+
+#endif //TYPEANNOTATION_HPP
@@ -22,18 +22,21 @@
 #include <vector>
 #include <string>
 #include "Expression.hpp"
+#include "TypeAnnotation.hpp"
 
 class CallExpression : public Expression {
 public:
     std::string name;
     std::vector<std::unique_ptr<Expression>> arguments;
+    std::vector<TypeAnnotation> typeArguments; // `sum<int>( ... )`, for a generic function
 
     void accept( ExpressionVisitor<void> &visitor ) override {
         visitor.visit( *this );
     }
 
-    CallExpression( std::string& name, std::vector<std::unique_ptr<Expression>> arguments )
-        : name( std::move( name ) ), arguments( std::move( arguments ) ) {}
+    CallExpression( std::string& name, std::vector<std::unique_ptr<Expression>> arguments,
+                    std::vector<TypeAnnotation> typeArguments = {} )
+        : name( std::move( name ) ), arguments( std::move( arguments ) ), typeArguments( std::move( typeArguments ) ) {}
 };
 
 #endif //CALLEXPRESSION_HPP
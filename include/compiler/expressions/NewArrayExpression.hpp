@@ -0,0 +1,42 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef NEWARRAYEXPRESSION_HPP
+#define NEWARRAYEXPRESSION_HPP
+
+#include <memory>
+#include "Expression.hpp"
+#include "TypeAnnotation.hpp"
+
+using namespace Lumin::Compiler;
+
+// `int[length]`, a new array with every element zero. The element type is
+// a scalar keyword or a type parameter.
+class NewArrayExpression final : public Expression {
+public:
+    TypeAnnotation elementType;
+    std::unique_ptr<Expression> length;
+
+    void accept( ExpressionVisitor<void> &visitor ) override {
+        visitor.visit( *this );
+    }
+
+    NewArrayExpression( TypeAnnotation elementType, std::unique_ptr<Expression> length )
+        : elementType( std::move( elementType ) ), length( std::move( length ) ) {}
+};
+
+#endif //NEWARRAYEXPRESSION_HPP
@@ -0,0 +1,71 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_BYTECODEEMITTER_HPP
+#define LUMIN_IR_BYTECODEEMITTER_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <ir/IR.hpp>
+
+namespace Lumin::Compiler::IR {
+
+// A conditional branch of the emitted code and the edges of the function
+// it stands for, which maps profile counts back onto the blocks. A counted
+// loop's LOOP_NEXT stands for its header's edges, like FOR_RANGE.
+struct BranchSite {
+    uint32_t offset;
+    BlockId from;
+    BlockId taken;
+    BlockId notTaken;
+};
+
+struct EmittedMethod {
+    std::vector<uint8_t> code;
+    uint16_t maxLocals = 0;
+    uint16_t maxStack = 0;
+    uint32_t valueLocals = 0; // maxLocals if every stored value had a local of its own
+    std::vector<BranchSite> branches; // Ascending offsets
+};
+
+struct EmitOptions {
+    // Values of one type that are never live at the same time share a local
+    bool shareLocals = true;
+    // A call whose result the block returns right away becomes TAILCALL
+    bool tailCalls = true;
+};
+
+/*
+ Emits one function of the module as a method body. Parameters stay in the
+ first locals. Constants and pure values used once in the block that
+ computes them are rebuilt as expression trees where they are used, every
+ other value is stored in a local, which values of one type that are never
+ live at the same time share. Phis become parallel copies at the end of
+ each predecessor, so critical edges into phi blocks are split first, which
+ is why the function is modified.
+
+ Blocks are laid out in reverse post order, or in the order given, which
+ has to start with the entry and hold every reachable block once.
+
+ Throws std::runtime_error when a function without a return value is used
+ as one or the method needs more than 65535 locals.
+ */
+EmittedMethod EmitBytecode( Module& module, uint32_t function, const EmitOptions& options = {}, std::span<const BlockId> layout = {} );
+
+}
+
+#endif //LUMIN_IR_BYTECODEEMITTER_HPP
@@ -0,0 +1,54 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_CODELAYOUT_HPP
+#define LUMIN_IR_CODELAYOUT_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <ExecutionProfile.hpp>
+#include <ir/BytecodeEmitter.hpp>
+
+namespace Lumin::Compiler::IR {
+
+struct BlockLayout {
+    std::vector<BlockId> order;
+    uint32_t coldBlocks = 0; // Never reached in the profiled run, at the end
+};
+
+/*
+ Block order of a function for a profiled run of it, after Pettis and
+ Hansen: edges are taken hottest first and join chains of blocks that fall
+ through to each other, so the likely way out of a branch is the next block.
+ The entry's chain comes first, then the other chains that ran in reverse
+ post order and last the blocks that never ran.
+
+ sites are the branches of the method as emitted in reverse post order,
+ counts what the profile saw of them and calls how often it was entered.
+ Counts of blocks that end in a jump follow from their predecessors, a
+ switch is not profiled and every target is counted as often as it ran.
+ */
+BlockLayout ProfiledBlockOrder( const Function& function, std::span<const BranchSite> sites,
+    std::span<const Utils::BranchCount> counts, uint64_t calls );
+
+// Order of the method bodies in the code section: callers and callees that
+// call each other most are chained next to each other, chains go by their
+// most called method and methods that never ran come last, in index order
+std::vector<uint32_t> ProfiledMethodOrder( const Utils::ExecutionProfile& profile, size_t methodCount );
+
+}
+
+#endif //LUMIN_IR_CODELAYOUT_HPP
@@ -0,0 +1,55 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_CONSTANT_HPP
+#define LUMIN_IR_CONSTANT_HPP
+
+#include <optional>
+#include <ir/IR.hpp>
+
+namespace Lumin::Compiler::IR {
+
+// A value known at compile time, an int or a float like on the VM's stack
+struct Constant {
+    bool isFloat = false;
+    int32_t intValue = 0;
+    float floatValue = 0.0f;
+
+    [[nodiscard]] static Constant Int( int32_t value );
+    [[nodiscard]] static Constant Float( float value );
+    [[nodiscard]] static Constant Of( const Instruction& instruction ); // CONST_INT or CONST_FLOAT
+
+    [[nodiscard]] float AsFloat() const {
+        return isFloat ? floatValue : static_cast<float>( intValue );
+    }
+    // The CONST_INT or CONST_FLOAT instruction producing this value
+    [[nodiscard]] Instruction ToInstruction() const;
+
+    // Compares bit patterns, so NaN equals itself and -0.0 is not 0.0
+    bool operator==( const Constant& other ) const;
+};
+
+// Evaluates a binary operation the way the VM would at runtime: integer
+// arithmetic wraps and int with float gives float. Empty where the VM
+// fails or the result is not settled, an integer division by zero or
+// overflow and comparisons with NaN.
+[[nodiscard]] std::optional<Constant> Fold( Op op, const Constant& left, const Constant& right );
+[[nodiscard]] Constant Negate( const Constant& value );
+[[nodiscard]] Constant ToFloat( const Constant& value );
+
+}
+
+#endif //LUMIN_IR_CONSTANT_HPP
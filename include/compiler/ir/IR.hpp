@@ -0,0 +1,246 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_HPP
+#define LUMIN_IR_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Lumin::Compiler::IR {
+
+using ValueId = uint32_t;
+using BlockId = uint32_t;
+
+constexpr uint32_t NO_ID = UINT32_MAX;
+
+// Static type of a value, the VM's stack holds 32-bit ints and floats and
+// references to heap arrays of either
+enum class Type : uint8_t { INT, FLOAT, INT_ARRAY, FLOAT_ARRAY };
+
+[[nodiscard]] constexpr bool IsArray( const Type type ) {
+    return type == Type::INT_ARRAY || type == Type::FLOAT_ARRAY;
+}
+
+[[nodiscard]] constexpr Type ElementOf( const Type array ) {
+    return array == Type::FLOAT_ARRAY ? Type::FLOAT : Type::INT;
+}
+
+[[nodiscard]] constexpr Type ArrayOf( const Type element ) {
+    return element == Type::FLOAT ? Type::FLOAT_ARRAY : Type::INT_ARRAY;
+}
+
+[[nodiscard]] const char* TypeName( Type type );
+
+enum class Op : uint8_t {
+    CONST_INT,   // intValue
+    CONST_FLOAT, // floatValue
+    PARAM,       // index: parameter number
+    ADD, SUB, MUL, DIV, NEG, // Operands have the instruction's type
+    TO_FLOAT,    // Int operand widened to float
+    CONST_NULL,  // Null array reference, of the instruction's array type
+    IS_NULL,     // 1 when the array operand is null, else 0
+    CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE, // 1 or 0, both operands of one type
+    CALL,        // index: callee function, operands: arguments
+    PHI,         // One operand per predecessor, in predecessor order
+    COPY,        // Same value as its operand, left behind by rewrites until copy propagation
+    NEW_ARRAY,   // Zeroed array of the instruction's type, operand: length, index 1 when it does not escape the function
+    // index 1 on LOAD and STORE when the array is known not to be null,
+    // see EliminateNullChecks
+    LOAD,        // Operands: array, index
+    STORE,       // Operands: array, index, value, has no result
+    // Operands: dst, left, right, begin, end. Applies intValue, one of ADD,
+    // SUB, MUL or DIV, to the elements of a prefix of [begin, end) whose
+    // length is a multiple of the vector width and gives the next index,
+    // see VADD. Left and right are arrays or scalars of the element type.
+    // index 1 only checks the operands, see VECTOR_CHECK.
+    VECTOR,
+    SNAPSHOT,    // Stops the VM for a snapshot when it writes one, has no result
+    // Terminators, always the last instruction of a block
+    JUMP,        // targets[0]
+    BRANCH,      // operand != 0 ? targets[0] : targets[1]
+    SWITCH,      // Int operand, index: its SwitchTable in the function
+    RETURN,      // Optional operand
+    NOP          // Deleted
+};
+
+[[nodiscard]] bool IsTerminator( Op op );
+// No side effects and only depends on its operands, so it can be moved,
+// merged with an equal instruction or dropped when unused
+[[nodiscard]] bool IsPure( Op op );
+[[nodiscard]] const char* OpName( Op op );
+
+// Instructions live in one array per function and refer to each other by
+// index. Operands are ranges of a shared pool, so building and copying a
+// function allocates per function, not per instruction.
+struct Instruction {
+    Op op = Op::NOP;
+    Type type = Type::INT;
+    BlockId block = NO_ID;
+    uint32_t operandBegin = 0;
+    uint32_t operandCount = 0;
+    int32_t intValue = 0;
+    float floatValue = 0.0f;
+    uint32_t index = 0;
+    std::array<BlockId, 2> targets { NO_ID, NO_ID };
+};
+
+[[nodiscard]] inline Instruction MakeInstruction( const Op op, const Type type = Type::INT ) {
+    Instruction instruction;
+    instruction.op = op;
+    instruction.type = op == Op::CONST_FLOAT || op == Op::TO_FLOAT ? Type::FLOAT : type;
+    return instruction;
+}
+
+// The value a variable has before it is assigned: 0, 0.0 or null
+[[nodiscard]] inline Instruction MakeZero( const Type type ) {
+    return MakeInstruction( type == Type::FLOAT ? Op::CONST_FLOAT : IsArray( type ) ? Op::CONST_NULL : Op::CONST_INT, type );
+}
+
+struct Block {
+    std::vector<ValueId> instructions; // Phis first, terminator last
+    std::vector<BlockId> predecessors;
+    bool sealed = false; // All predecessors are known, used while building SSA
+    bool removed = false;
+};
+
+// Targets of a SWITCH by key. Every target is a distinct block, so a block
+// is a successor at most once like with the other terminators.
+struct SwitchTable {
+    std::vector<int32_t> keys; // Ascending
+    std::vector<BlockId> targets; // One per key, then the one taken for any other key
+
+    [[nodiscard]] BlockId Target( int32_t key ) const;
+};
+
+// From the `inline` and `noinline` specifiers of the declaration
+enum class InlineHint : uint8_t { NONE, ALWAYS, NEVER };
+
+// A `constexpr` variable, its initializer must be known at compile time
+struct ConstantInitializer {
+    ValueId value;
+    std::string variable;
+};
+
+struct Function {
+    std::string name;
+    uint32_t parameterCount = 0;
+    std::vector<Type> parameterTypes;
+    Type returnType = Type::INT;
+    uint16_t flags = 0; // MethodInfo flags
+    bool returnsValue = false;
+    InlineHint inlineHint = InlineHint::NONE;
+    bool isConstexpr = false;
+    std::vector<ConstantInitializer> constantInitializers; // Checked, then cleared, by EvaluateConstants
+    std::vector<Block> blocks;
+    std::vector<Instruction> values;
+    std::vector<ValueId> operandPool;
+    std::vector<SwitchTable> switches;
+
+    BlockId AddBlock();
+    // Appends to the block, phis are kept in front of the other instructions
+    // and the terminator stays last
+    ValueId Append( BlockId block, Instruction instruction, std::span<const ValueId> operands = {} );
+
+    [[nodiscard]] std::span<ValueId> Operands( const ValueId value ) {
+        const Instruction& instruction = values[value];
+        return { operandPool.data() + instruction.operandBegin, instruction.operandCount };
+    }
+    [[nodiscard]] std::span<const ValueId> Operands( const ValueId value ) const {
+        const Instruction& instruction = values[value];
+        return { operandPool.data() + instruction.operandBegin, instruction.operandCount };
+    }
+    void SetOperands( ValueId value, std::span<const ValueId> operands );
+
+    [[nodiscard]] ValueId Terminator( BlockId block ) const;
+    [[nodiscard]] std::span<const BlockId> Successors( BlockId block ) const;
+    // Successors of a terminator, for passes that retarget its edges
+    [[nodiscard]] std::span<BlockId> Targets( ValueId terminator );
+    // Follows COPY chains to the value that is actually computed
+    [[nodiscard]] ValueId Resolve( ValueId value ) const;
+    // Turns the instruction into a COPY of another value in place
+    void ReplaceWith( ValueId value, ValueId replacement );
+    // Turns the instruction into a constant in place, of the value's own type
+    void ReplaceWithConstant( ValueId value, const Instruction& constant );
+    // Drops the edge from -> to, with the matching phi operands in to
+    void RemoveEdge( BlockId from, BlockId to );
+
+private:
+    void LeavePhiGroup( ValueId value );
+};
+
+struct Module {
+    std::vector<Function> functions;
+    uint32_t entry = NO_ID;
+};
+
+// Reachable blocks from the entry, in reverse post order
+[[nodiscard]] std::vector<BlockId> ReversePostOrder( const Function& function );
+
+struct DominatorTree {
+    std::vector<BlockId> order; // Reverse post order
+    std::vector<BlockId> idom; // NO_ID for the entry and unreachable blocks
+    std::vector<std::vector<BlockId>> children;
+
+    [[nodiscard]] bool Dominates( BlockId a, BlockId b ) const;
+};
+
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse post order
+[[nodiscard]] DominatorTree ComputeDominators( const Function& function );
+
+// A natural loop: the header and every block that reaches a back edge to it
+// without passing through it
+struct Loop {
+    BlockId header = NO_ID;
+    std::vector<BlockId> blocks;  // Reverse post order, so the header is first
+    std::vector<BlockId> latches; // Sources of the back edges
+    uint32_t parent = NO_ID;      // Innermost loop around this one
+    bool hasInnerLoops = false;
+};
+
+struct LoopForest {
+    std::vector<Loop> loops;         // Inner loops before the loops around them
+    std::vector<uint32_t> innermost; // Per block, NO_ID outside every loop
+
+    [[nodiscard]] bool Contains( uint32_t loop, BlockId block ) const;
+};
+
+// Loops of the back edges, edges to a block that dominates their source.
+// Back edges to one header make one loop. Irreducible cycles have no back
+// edge and are not loops here.
+[[nodiscard]] LoopForest FindLoops( const Function& function, const DominatorTree& dominators );
+
+// Marks blocks the entry cannot reach as removed and unlinks them
+void RemoveUnreachableBlocks( Function& function );
+// Drops NOP instructions from the block lists, passes delete instructions
+// by turning them into NOPs and compact once at the end
+void CompactBlocks( Function& function );
+// Folds a block into its predecessor when a jump from that predecessor is
+// its only way in, so straight-line code is one block again
+void MergeBlocks( Function& function );
+// Puts an empty block on every edge from a block with several successors
+// to a block with several predecessors, so phi copies have a place to go
+void SplitCriticalEdges( Function& function );
+
+[[nodiscard]] std::string Dump( const Function& function );
+[[nodiscard]] std::string Dump( const Module& module );
+
+}
+
+#endif //LUMIN_IR_HPP
@@ -0,0 +1,50 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_LOWERING_HPP
+#define LUMIN_IR_LOWERING_HPP
+
+#include <memory>
+#include <vector>
+#include <ir/IR.hpp>
+#include <statements/Statement.hpp>
+
+namespace Lumin::Compiler::IR {
+
+/*
+ Lowers the parsed top-level functions into SSA form in one pass over the
+ AST, with Braun et al.'s on-the-fly construction: variables are looked up
+ per block and phis are only placed where a read actually merges paths,
+ so there is no separate dominance frontier or renaming phase.
+
+ The function named main becomes the module entry. Generic functions are
+ lowered once per instantiation, see Monomorphize. A variable declared
+ without an initializer starts as 0, or as the zero of its annotated type.
+
+ Every value is typed, see InferSignatures. Ints are widened to float
+ where they meet one, through an explicit TO_FLOAT.
+
+ Throws std::runtime_error for statements outside functions, undefined or
+ redeclared names, calls with the wrong number of arguments and type
+ errors: a float assigned to an int variable or passed for an int
+ parameter, an if on a float, arithmetic on an array and an array where a
+ number goes or the other way around.
+ */
+Module Lower( const std::vector<std::unique_ptr<Statement>>& program );
+
+}
+
+#endif //LUMIN_IR_LOWERING_HPP
@@ -0,0 +1,75 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_MONOMORPHIZATION_HPP
+#define LUMIN_IR_MONOMORPHIZATION_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ir/IR.hpp>
+#include <expressions/CallExpression.hpp>
+#include <statements/FunctionStatement.hpp>
+
+namespace Lumin::Compiler::IR {
+
+// A function to generate code for: a declaration, with the types its type
+// parameters stand for when it is generic
+struct Instance {
+    const FunctionStatement* declaration = nullptr;
+    std::vector<Type> typeArguments; // One per type parameter
+    std::string name; // `sum<int>` for an instantiation
+    // The instance each call in the body goes to, calls to undefined
+    // functions are left out for lowering to report
+    std::unordered_map<const CallExpression*, uint32_t> callees;
+};
+
+// Code, in AST nodes, the instantiations of one generic function may add up
+// to before further type arguments share a version
+constexpr size_t INSTANTIATION_BUDGET = 4096;
+
+// The type an annotation stands for in the instance, what names the
+// annotated thing for the error when the code generator has no such type
+[[nodiscard]] Type AnnotatedType( const TypeAnnotation& annotation, const Instance& instance, const std::string& what );
+
+/*
+ Specializes generic functions at compile time. Every function that is not
+ generic is an instance, in declaration order, and each distinct list of
+ type arguments a generic function is called with becomes one more,
+ found by walking the bodies of the instances until no call adds a new
+ one. A generic function nothing calls generates no code and is not type
+ checked.
+
+ Type arguments are scalars and are cached by the type the VM keeps them
+ as, so sum<int> and sum<bool> are one instance with int opcodes and
+ sum<float> another with float ones. Instantiations are private to the
+ module, another module instantiates its own.
+
+ Once the instantiations of a function would pass INSTANTIATION_BUDGET, new
+ type arguments share the version with every type parameter float, which
+ int arguments widen to like for any float parameter, so its results are
+ floats. A function with arrays of a type parameter cannot share it since
+ arrays do not convert, and is rejected instead.
+
+ Throws std::runtime_error for a generic main, a call to a generic
+ function without type arguments or with the wrong number of them, type
+ arguments to a function that is not generic and array type arguments.
+ */
+[[nodiscard]] std::vector<Instance> Monomorphize( const std::vector<const FunctionStatement*>& declarations );
+
+}
+
+#endif //LUMIN_IR_MONOMORPHIZATION_HPP
@@ -0,0 +1,135 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_PASSES_HPP
+#define LUMIN_IR_PASSES_HPP
+
+#include <ir/IR.hpp>
+
+namespace Lumin::Compiler::IR {
+
+// Sparse conditional constant propagation (Wegman and Zadeck). Folds values
+// that are constant on every executable path, turns branches on constants
+// into jumps and drops the blocks that become unreachable. Folding follows
+// the VM: integer arithmetic wraps, int with float gives float and a
+// division by zero is never folded.
+bool PropagateConstants( Function& function );
+
+// Dominator-based global value numbering: a pure instruction equal to one
+// in a dominating block is replaced by it
+bool NumberValues( Function& function );
+
+// Points every operand past COPY chains, removes phis whose operands are
+// all the same value and deletes the COPYs
+bool PropagateCopies( Function& function );
+
+// Deletes instructions whose results are never used and have no effect
+bool EliminateDeadCode( Function& function );
+
+// Bounds on compile-time evaluation, so a runaway `constexpr` call cannot
+// hang the compiler
+struct EvaluationLimits {
+    uint64_t maxSteps = 1'000'000; // Instructions run for one call, nested calls included
+    uint32_t maxDepth = 256;       // Nested calls
+};
+
+// Runs `constexpr` functions at compile time: a call to one whose arguments
+// are all constants becomes the result. What they call is run as well,
+// functions have no side effects. A call that hits a limit, or would fail
+// at runtime, is left to the VM. The initializer of a `constexpr` variable
+// has to evaluate or compilation fails. Returns the number of values replaced.
+uint32_t EvaluateConstants( Module& module, const EvaluationLimits& limits = {} );
+
+// Limits of the inlining cost model, sizes count the instructions a body
+// turns into, without the phis, copies and jumps that emit nothing
+struct InlineOptions {
+    uint32_t smallSize = 6;              // No bigger than the call it replaces, inlined at every site
+    uint32_t singleCallSiteSize = 120;   // Callees with one call site in the module
+    uint32_t maxSize = 40;               // Anything else ...
+    uint32_t growthBudget = 160;         // ... as long as size times call sites stays under this
+    uint32_t constantArgumentBonus = 3;  // Size a constant argument is expected to fold away
+    uint32_t callerLimit = 4000;         // Callers this big only take `inline` callees
+};
+
+// Replaces calls with the callee's body. `inline` callees are always
+// inlined and `noinline` ones never, the rest go by the cost model. The call
+// graph is walked bottom-up so callees are inlined into first, and calls
+// within a recursive cycle stay calls. Returns the number of inlined calls.
+uint32_t InlineCalls( Module& module, const InlineOptions& options = {} );
+
+// Which loop transformations run, and how far unrolling may grow a loop.
+// Sizes count instructions like the inliner's. Strength reduction is off by
+// default: in the VM a multiply is one instruction, while the extra
+// induction variable costs a phi copy on every back edge.
+struct LoopOptions {
+    bool hoistInvariants = true;
+    bool simplifyInductionVariables = true;
+    bool unroll = true;
+    bool reduceStrength = false;
+    bool vectorize = true;
+    uint32_t maxUnrollTrips = 8;
+    uint32_t maxUnrolledSize = 64; // Loop size times trips
+};
+
+// Loop-invariant code motion into a preheader, exit values of induction
+// variables with a known trip count and removal of loops left without
+// effect, vectorization of element-wise array loops, full unrolling of small
+// constant-count loops and strength reduction of induction variable
+// multiplies. Returns the number of changes.
+uint32_t OptimizeLoops( Function& function, const LoopOptions& options = {} );
+
+// What escape analysis may do with an array that never leaves the function
+// that allocates it: one that is not passed, returned or merged by a phi
+struct AllocationOptions {
+    bool scalarReplace = true;
+    bool allocateInFrame = true;
+    uint32_t maxScalarElements = 8; // Longest array split into one value per element
+};
+
+// Escape analysis of NEW_ARRAY. A short array that does not escape and is
+// only indexed by constants becomes one SSA value per element, its loads
+// the stored values. Other arrays that do not escape are allocated with
+// ALLOC_LOCAL_ARRAY and released when the function returns. Returns the
+// number of allocations changed.
+uint32_t OptimizeAllocations( Function& function, const AllocationOptions& options = {} );
+
+// Flow-sensitive null check elimination. An array is known not to be null
+// when it was allocated, returned by a function that only returns such
+// arrays, merged from such arrays, compared unequal to null on the way or
+// already indexed, as a failed LOAD or STORE does not continue. Accesses
+// to known arrays are marked to emit LOAD_ARRAY_NONNULL and
+// STORE_ARRAY_NONNULL, tests of them and of null become constants. Returns
+// the number of accesses and tests changed.
+uint32_t EliminateNullChecks( Module& module );
+
+// Array accesses and null tests of a module, for reports
+struct NullCheckCounts {
+    uint32_t accesses = 0;  // LOADs and STOREs
+    uint32_t unchecked = 0; // Of those, the ones on arrays known not to be null
+    uint32_t tests = 0;     // IS_NULLs
+};
+
+[[nodiscard]] NullCheckCounts CountNullChecks( const Module& module );
+
+// 0 only evaluates `constexpr`, 1 adds constant propagation, copy
+// propagation, dead code elimination, inlining, loop optimization and escape
+// analysis and null check elimination, 2 adds value numbering and iterates
+// once more
+void Optimize( Module& module, int level, const LoopOptions& loops = {}, const AllocationOptions& allocations = {} );
+
+}
+
+#endif //LUMIN_IR_PASSES_HPP
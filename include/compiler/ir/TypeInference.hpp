@@ -0,0 +1,47 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_IR_TYPEINFERENCE_HPP
+#define LUMIN_IR_TYPEINFERENCE_HPP
+
+#include <vector>
+#include <ir/IR.hpp>
+#include <ir/Monomorphization.hpp>
+
+namespace Lumin::Compiler::IR {
+
+struct Signature {
+    std::vector<Type> parameters;
+    Type result = Type::INT;
+};
+
+/*
+ Infers the signature of every instance. Parameters have the type they
+ are annotated with, variables the type of their annotation or else of
+ their initializer and the result is the widest type any return produces, int widening to float.
+ Arrays do not convert, a function returning an array and a number in
+ different places is rejected by lowering.
+
+ Results depend on each other through calls, so they are solved together:
+ each function starts out returning nothing known and is walked again
+ whenever a function it calls gets a wider result. A function that never
+ produces a known value, such as one that only recurses, returns int.
+ */
+[[nodiscard]] std::vector<Signature> InferSignatures( const std::vector<Instance>& instances );
+
+}
+
+#endif //LUMIN_IR_TYPEINFERENCE_HPP
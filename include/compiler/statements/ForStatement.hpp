@@ -0,0 +1,43 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef FORSTATEMENT_HPP
+#define FORSTATEMENT_HPP
+
+#include <memory>
+#include <string>
+#include "Statement.hpp"
+#include "expressions/Expression.hpp"
+
+// for variable in begin..end, over the ints from begin up to but not
+// including end. Both bounds are evaluated once, before the first iteration.
+class ForStatement final : public Statement {
+public:
+    std::string variable;
+    std::unique_ptr<Expression> begin;
+    std::unique_ptr<Expression> end;
+    std::unique_ptr<Statement> body;
+
+    void accept( StatementVisitor<void> &visitor ) override {
+        visitor.visit( *this );
+    }
+
+    ForStatement( std::string variable, std::unique_ptr<Expression> begin, std::unique_ptr<Expression> end, std::unique_ptr<Statement> body )
+        : variable( std::move( variable ) ), begin( std::move( begin ) ), end( std::move( end ) ), body( std::move( body ) ) {}
+};
+
+#endif //FORSTATEMENT_HPP
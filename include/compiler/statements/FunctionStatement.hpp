@@ -24,7 +24,7 @@
 #include "AccessModifier.hpp"
 #include "InlineSpecifier.hpp"
 #include "BlockStatement.hpp"
-#include "TokenType.hpp"
+#include "TypeAnnotation.hpp"
 
 using namespace Lumin::Compiler;
 
@@ -33,7 +33,9 @@ public:
     std::string name;
     AccessModifier access;
     InlineSpecifier inlineSpec;
-    std::vector<std::pair<std::string, TokenType>> parameters;
+    bool isConstexpr; // Calls with constant arguments are evaluated by the compiler
+    std::vector<std::string> typeParameters; // Empty unless generic, see Monomorphize
+    std::vector<std::pair<std::string, TypeAnnotation>> parameters;
     std::vector<std::unique_ptr<Statement>> body;
 
     void accept( StatementVisitor<void> &visitor ) override {
@@ -44,12 +46,16 @@ public:
         std::string& name,
         const AccessModifier access,
         const InlineSpecifier inlineSpec,
-        std::vector<std::pair<std::string, TokenType>> params,
+        const bool isConstexpr,
+        std::vector<std::string> typeParams,
+        std::vector<std::pair<std::string, TypeAnnotation>> params,
         std::vector<std::unique_ptr<Statement>> body
     )
         : name( std::move( name ) )
         ,access( access )
         , inlineSpec( inlineSpec )
+        , isConstexpr( isConstexpr )
+        , typeParameters( std::move( typeParams ) )
         , parameters( std::move( params ) )
         , body( std::move( body ) ) {}
 };
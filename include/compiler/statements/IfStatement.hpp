@@ -0,0 +1,39 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef IFSTATEMENT_HPP
+#define IFSTATEMENT_HPP
+
+#include <memory>
+#include "Statement.hpp"
+#include "expressions/Expression.hpp"
+
+class IfStatement final : public Statement {
+public:
+    std::unique_ptr<Expression> condition;
+    std::unique_ptr<Statement> thenBranch;
+    std::unique_ptr<Statement> elseBranch; // Null without an else
+
+    void accept( StatementVisitor<void> &visitor ) override {
+        visitor.visit( *this );
+    }
+
+    IfStatement( std::unique_ptr<Expression> condition, std::unique_ptr<Statement> thenBranch, std::unique_ptr<Statement> elseBranch )
+        : condition( std::move( condition ) ), thenBranch( std::move( thenBranch ) ), elseBranch( std::move( elseBranch ) ) {}
+};
+
+#endif //IFSTATEMENT_HPP
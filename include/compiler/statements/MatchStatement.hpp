@@ -0,0 +1,47 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef MATCHSTATEMENT_HPP
+#define MATCHSTATEMENT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Statement.hpp"
+#include "expressions/Expression.hpp"
+
+// An arm is taken when the subject equals one of its keys, the '_' arm has
+// none and is taken when no other arm is
+struct MatchArm {
+    std::vector<int32_t> keys;
+    std::unique_ptr<Statement> body;
+};
+
+class MatchStatement final : public Statement {
+public:
+    std::unique_ptr<Expression> subject;
+    std::vector<MatchArm> arms; // Keys are unique across arms, at most one '_' arm
+
+    void accept( StatementVisitor<void> &visitor ) override {
+        visitor.visit( *this );
+    }
+
+    MatchStatement( std::unique_ptr<Expression> subject, std::vector<MatchArm> arms )
+        : subject( std::move( subject ) ), arms( std::move( arms ) ) {}
+};
+
+#endif //MATCHSTATEMENT_HPP
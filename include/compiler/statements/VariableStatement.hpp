@@ -20,23 +20,29 @@
 
 #include <string>
 #include <memory>
+#include <optional>
 #include <utility>
 #include "Statement.hpp"
 #include "expressions/Expression.hpp"
 #include "AccessModifier.hpp"
+#include "TypeAnnotation.hpp"
 
 class VariableStatement final : public Statement {
 public:
     std::string name;
     AccessModifier access;
     std::unique_ptr<Expression> initializer;
+    bool isConstexpr; // The initializer must be evaluated at compile time
+    std::optional<TypeAnnotation> annotation; // `var total: T = 0`, the initializer is converted to it
 
     void accept( StatementVisitor<void> &visitor ) override  {
         visitor.visit( *this );
     }
 
-    VariableStatement( std::string& name, const AccessModifier access, std::unique_ptr<Expression> initializer )
-        : name( std::move( name ) ), access( access ), initializer( std::move( initializer ) ) {}
+    VariableStatement( std::string& name, const AccessModifier access, std::unique_ptr<Expression> initializer, const bool isConstexpr = false,
+                       std::optional<TypeAnnotation> annotation = std::nullopt )
+        : name( std::move( name ) ), access( access ), initializer( std::move( initializer ) ), isConstexpr( isConstexpr ),
+          annotation( std::move( annotation ) ) {}
 };
 
 #endif //VARIABLESTATEMENT_HPP
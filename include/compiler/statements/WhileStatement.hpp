@@ -0,0 +1,38 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef WHILESTATEMENT_HPP
+#define WHILESTATEMENT_HPP
+
+#include <memory>
+#include "Statement.hpp"
+#include "expressions/Expression.hpp"
+
+class WhileStatement final : public Statement {
+public:
+    std::unique_ptr<Expression> condition;
+    std::unique_ptr<Statement> body;
+
+    void accept( StatementVisitor<void> &visitor ) override {
+        visitor.visit( *this );
+    }
+
+    WhileStatement( std::unique_ptr<Expression> condition, std::unique_ptr<Statement> body )
+        : condition( std::move( condition ) ), body( std::move( body ) ) {}
+};
+
+#endif //WHILESTATEMENT_HPP
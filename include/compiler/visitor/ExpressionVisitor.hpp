@@ -25,6 +25,9 @@ class CallExpression;
 class LiteralExpression;
 class UnaryExpression;
 class GetVariableExpression;
+class NewArrayExpression;
+class IndexExpression;
+class IndexAssignmentExpression;
 
 template<typename R>
 class ExpressionVisitor {
@@ -37,5 +40,8 @@ public:
     virtual R visit(const UnaryExpression& expression) = 0;
     virtual R visit(const GetVariableExpression& expression) = 0;
     virtual R visit(const CallExpression& expression) = 0;
+    virtual R visit(const NewArrayExpression& expression) = 0;
+    virtual R visit(const IndexExpression& expression) = 0;
+    virtual R visit(const IndexAssignmentExpression& expression) = 0;
 };
 #endif //EXPRESSIONVISITOR_HPP
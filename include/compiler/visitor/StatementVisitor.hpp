@@ -20,6 +20,9 @@
 
 // Forward declarations
 class IfStatement;
+class WhileStatement;
+class ForStatement;
+class MatchStatement;
 class ExpressionStatement;
 class FunctionStatement;
 class ReturnStatement;
@@ -33,6 +36,9 @@ public:
     virtual ~StatementVisitor() = default;
 
     virtual R visit(const IfStatement& statement) = 0;
+    virtual R visit(const WhileStatement& statement) = 0;
+    virtual R visit(const ForStatement& statement) = 0;
+    virtual R visit(const MatchStatement& statement) = 0;
     virtual R visit(const ExpressionStatement& statement) = 0;
     virtual R visit(const FunctionStatement& statement) = 0;
     virtual R visit(const ReturnStatement& statement) = 0;
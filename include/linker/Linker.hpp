@@ -0,0 +1,63 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#ifndef LUMIN_LINKER_HPP
+#define LUMIN_LINKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <LuminFile.hpp>
+
+namespace Lumin::Linker {
+
+struct LinkOptions {
+    // Drop methods and classes that cannot be reached from the entry method
+    bool eliminateDeadCode = true;
+    // Inline small straight-line functions called from another module
+    bool inlineCrossModule = false;
+    uint32_t inlineBudget = 32; // Largest callee body inlined, in bytes
+    // Name of the entry method, the first module that has one when empty
+    std::string entryName;
+};
+
+struct LinkStats {
+    size_t methodsIn = 0;
+    size_t methodsOut = 0;
+    size_t classesIn = 0;
+    size_t classesOut = 0;
+    size_t constantsIn = 0;
+    size_t constantsOut = 0;
+    size_t resolvedReferences = 0;
+    size_t inlinedCalls = 0;
+};
+
+/*
+ Merges modules into one image. Method indices are global afterwards:
+ CALL operands are renumbered and every INVOKE through a CONST_METHOD_REF
+ is resolved by name and rewritten to a direct CALL. The constant pools
+ are merged through a ConstantPoolBuilder, so only entries still referenced
+ survive, each once.
+
+ Throws std::runtime_error for duplicate or unresolved symbols and for
+ bytecode that does not validate.
+ */
+LuminFile Link( const std::vector<LuminFile>& modules, const LinkOptions& options = {}, LinkStats* stats = nullptr );
+
+}
+
+#endif //LUMIN_LINKER_HPP
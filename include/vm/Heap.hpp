@@ -0,0 +1,172 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef HEAP_HPP
+#define HEAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+#include <NumericValue.hpp>
+#include <OpCode.hpp>
+
+namespace Lumin::VM {
+
+// Elements of an array, of the type it was allocated with
+using ArrayStorage = std::variant<std::vector<int32_t>, std::vector<float>>;
+
+// Counts since the VM started, `lumin -V` reports them
+struct HeapStatistics {
+    uint64_t allocated = 0;      // Arrays, frame-local ones included
+    uint64_t localAllocated = 0; // By ALLOC_LOCAL_ARRAY
+    uint64_t released = 0;       // Frame-local arrays released
+    uint64_t peakLive = 0;       // Most arrays alive at once
+};
+
+// Arrays allocated by one VM. There is no collector yet, an array lives as
+// long as the VM does, unless the compiler proved it does not outlive the
+// method that allocated it. Those are released early and their slots reused.
+class Heap {
+public:
+    struct LocalArray {
+        size_t depth; // Frame count at allocation
+        size_t site;  // Offset of the allocating instruction
+        ArrayRef array;
+    };
+
+    ArrayRef Allocate( const Bytecode::ArrayElement element, const size_t length ) {
+        ArrayStorage storage = Storage( element, length );
+        ++statistics.allocated;
+        ArrayRef array;
+        if ( !freeSlots.empty() ) {
+            array.index = freeSlots.back();
+            freeSlots.pop_back();
+            arrays[array.index] = std::move( storage );
+        } else {
+            if ( arrays.size() >= UINT32_MAX ) {
+                throw std::runtime_error( "Out of array references" );
+            }
+            arrays.push_back( std::move( storage ) );
+            array.index = static_cast<uint32_t>( arrays.size() - 1 );
+        }
+        statistics.peakLive = std::max<uint64_t>( statistics.peakLive, arrays.size() - freeSlots.size() );
+        return array;
+    }
+
+    // Released by ReleaseFrames once the frame count drops below depth, or
+    // when the same instruction, at site, allocates again in that frame. The
+    // compiler only emits ALLOC_LOCAL_ARRAY for arrays no phi merges, so
+    // the array of the previous pass through a loop is no longer used.
+    ArrayRef AllocateLocal( const Bytecode::ArrayElement element, const size_t length, const size_t depth, const size_t site ) {
+        for ( auto local = localArrays.rbegin(); local != localArrays.rend() && local->depth == depth; ++local ) {
+            if ( local->site == site ) {
+                // Released and allocated again in place
+                arrays[local->array.index] = Storage( element, length );
+                ++statistics.released;
+                ++statistics.allocated;
+                ++statistics.localAllocated;
+                return local->array;
+            }
+        }
+
+        const ArrayRef array = Allocate( element, length );
+        ++statistics.localAllocated;
+        localArrays.push_back( { depth, site, array } );
+        return array;
+    }
+
+    // Called after a return, with the frames that are left
+    void ReleaseFrames( const size_t depth ) {
+        while ( !localArrays.empty() && localArrays.back().depth > depth ) {
+            Release( localArrays.back().array.index );
+            localArrays.pop_back();
+        }
+    }
+
+    // References come from snapshots too, so they are checked
+    ArrayStorage& Get( const ArrayRef array ) {
+        if ( array.index >= arrays.size() ) {
+            throw std::runtime_error( std::format( "Invalid array reference {}", array.index ) );
+        }
+        return arrays[array.index];
+    }
+
+    [[nodiscard]] const std::vector<ArrayStorage>& Arrays() const { return arrays; }
+    [[nodiscard]] const std::vector<uint32_t>& FreeSlots() const { return freeSlots; }
+    [[nodiscard]] const std::vector<LocalArray>& LocalArrays() const { return localArrays; }
+    [[nodiscard]] const HeapStatistics& Statistics() const { return statistics; }
+
+    // The state of a snapshot, frame-local arrays stay tied to their frames
+    // and are released when those return. The statistics carry on from the
+    // run that took the snapshot.
+    void Restore(
+        std::vector<ArrayStorage> restoredArrays,
+        std::vector<uint32_t> restoredFreeSlots,
+        std::vector<LocalArray> restoredLocals,
+        const HeapStatistics& restoredStatistics
+    ) {
+        for ( const uint32_t slot : restoredFreeSlots ) {
+            if ( slot >= restoredArrays.size() ) {
+                throw std::runtime_error( std::format( "Invalid free array slot {}", slot ) );
+            }
+        }
+        for ( size_t i = 0; i < restoredLocals.size(); ++i ) {
+            if ( restoredLocals[i].array.index >= restoredArrays.size()
+                 || ( i > 0 && restoredLocals[i].depth < restoredLocals[i - 1].depth ) ) {
+                throw std::runtime_error( std::format( "Invalid frame-local array {}", restoredLocals[i].array.index ) );
+            }
+        }
+
+        Clear();
+        arrays = std::move( restoredArrays );
+        freeSlots = std::move( restoredFreeSlots );
+        localArrays = std::move( restoredLocals );
+        statistics = restoredStatistics;
+        statistics.peakLive = std::max<uint64_t>( statistics.peakLive, arrays.size() - freeSlots.size() );
+    }
+    void Clear() {
+        arrays.clear();
+        freeSlots.clear();
+        localArrays.clear();
+    }
+
+private:
+    std::vector<ArrayStorage> arrays;
+    std::vector<uint32_t> freeSlots;
+    std::vector<LocalArray> localArrays; // Innermost frame last
+    HeapStatistics statistics;
+
+    static ArrayStorage Storage( const Bytecode::ArrayElement element, const size_t length ) {
+        if ( element == Bytecode::ArrayElement::FLOAT ) {
+            return std::vector<float>( length );
+        }
+        return std::vector<int32_t>( length );
+    }
+
+    void Release( const uint32_t index ) {
+        std::visit( []( auto& elements ) { std::decay_t<decltype( elements )>().swap( elements ); }, arrays[index] );
+        freeSlots.push_back( index );
+        ++statistics.released;
+    }
+};
+
+}
+
+#endif //HEAP_HPP
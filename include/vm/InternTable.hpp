@@ -0,0 +1,49 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef INTERNTABLE_HPP
+#define INTERNTABLE_HPP
+
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace Lumin::VM {
+
+// Process wide string table. Equal strings from any loaded module intern to
+// the same pointer, so names compare by address once resolved.
+class InternTable {
+public:
+    static InternTable& Global();
+
+    const std::string* Intern( std::string_view value );
+    [[nodiscard]] size_t Size() const;
+
+private:
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()( const std::string_view value ) const { return std::hash<std::string_view> {}( value ); }
+    };
+
+    mutable std::shared_mutex lock;
+    std::unordered_set<std::string, Hash, std::equal_to<>> strings;
+};
+
+}
+
+#endif //INTERNTABLE_HPP
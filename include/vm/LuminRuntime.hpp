@@ -18,5 +18,113 @@
 #ifndef LUMINRUNTIME_HPP
 #define LUMINRUNTIME_HPP
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <LuminFile.hpp>
+
+namespace Lumin::VM {
+
+struct LinkedMethod {
+    uint32_t index;
+    MethodInfo info;
+    std::span<const unsigned char> code;
+};
+
+struct RuntimeClass {
+    const std::string* name; // Interned
+    ClassInfo info;
+};
+
+// A resolved constant pool entry. target is the method index a
+// CONST_METHOD_REF was bound to, and unused for other entries.
+struct ResolvedConstant {
+    uint32_t index;
+    uint32_t target;
+};
+
+// What a runtime has linked and resolved so far, a snapshot carries it to
+// the runtime that resumes it
+struct RuntimeCaches {
+    std::vector<uint32_t> linkedMethods;
+    std::vector<ResolvedConstant> constants;
+};
+
+// A loaded program, shared by every VM (isolate) running it. Methods are
+// registered as stubs from their MethodInfo only; the first call through
+// Resolve verifies and links the body, later calls take the fast path.
+// Constant pool entries are resolved the same way, once per runtime, and the
+// result is cached by pool index.
+class LuminRuntime {
+public:
+    explicit LuminRuntime( LuminFileView file );
+    // Serializes the program and runs from the in-memory image. Runs the code
+    // section from offset 0 when the entry method is LUMIN_NO_ENTRY_METHOD.
+    explicit LuminRuntime( const LuminFile& program );
+
+    LuminRuntime( const LuminRuntime& ) = delete;
+    LuminRuntime& operator=( const LuminRuntime& ) = delete;
+
+    const LinkedMethod& Resolve( uint32_t index );
+    void ResolveAll();
+
+    [[nodiscard]] RuntimeCaches Caches() const;
+    // Links the methods of a snapshot up front and binds the method references
+    // to the same methods without a lookup. The bodies are verified again, a
+    // snapshot is file input like any program.
+    void RestoreCaches( const RuntimeCaches& caches );
+
+    // CONST_UTF8 or CONST_STRING, the text is interned process wide
+    const std::string* ResolveString( uint32_t index );
+    const RuntimeClass& ResolveClass( uint32_t index );
+    const LinkedMethod& ResolveMethodRef( uint32_t index );
+
+    [[nodiscard]] std::span<const unsigned char> Code() const { return file.bytecode; }
+    // The serialized program, snapshots embed it as is
+    [[nodiscard]] std::span<const unsigned char> Image() const { return file.image; }
+    [[nodiscard]] uint32_t EntryMethod() const { return file.entryMethod; }
+    [[nodiscard]] size_t MethodCount() const { return methodCount; }
+    [[nodiscard]] size_t ConstantCount() const { return file.constantCount; }
+    [[nodiscard]] size_t MaterializedCount() const { return materialized.load( std::memory_order_relaxed ); }
+    [[nodiscard]] const MethodInfo& Method( uint32_t index ) const;
+    [[nodiscard]] ConstantPoolEntryView Constant( uint32_t index ) const;
+
+private:
+    struct MethodSlot {
+        MethodInfo info {};
+        std::atomic<const LinkedMethod*> linked { nullptr };
+        std::unique_ptr<LinkedMethod> storage;
+    };
+
+    // Linking is rare, a few striped locks are enough and keep stubs small
+    static constexpr size_t LINK_LOCK_STRIPES = 64;
+
+    void RegisterStubs();
+    const LinkedMethod& Link( uint32_t index );
+    void Verify( const MethodInfo& info, std::span<const unsigned char> body ) const;
+    [[nodiscard]] ConstantPoolEntryView CheckedConstant( uint32_t index, ConstantPoolTag tag ) const;
+    void BuildNameTables();
+
+    std::vector<unsigned char> ownedImage;
+    LuminFileView file {};
+    std::unique_ptr<MethodSlot[]> slots;
+    size_t methodCount = 0;
+    std::atomic<size_t> materialized { 0 };
+    std::array<std::mutex, LINK_LOCK_STRIPES> linkLocks;
+
+    // Resolved constants by pool index: an interned string, a RuntimeClass or
+    // a LinkedMethod depending on the tag
+    std::unique_ptr<std::atomic<const void*>[]> resolvedConstants;
+    std::once_flag nameTablesOnce;
+    std::unordered_map<const std::string*, uint32_t> methodsByName;
+    std::unordered_map<const std::string*, RuntimeClass> classesByName;
+};
+
+}
 
 #endif //LUMINRUNTIME_HPP
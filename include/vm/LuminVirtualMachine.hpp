@@ -19,11 +19,18 @@
 #define LUMINVIRTUALMACHINE_HPP
 
 
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 #include <unordered_map>
-#include <Opcode.hpp>
+#include <OpCode.hpp>
+#include <Heap.hpp>
 #include <StackFrame.hpp>
 #include <VMStack.hpp>
+#include <VMSnapshot.hpp>
+#include <LuminRuntime.hpp>
+#include <Profiler.hpp>
 
 using namespace Lumin::Bytecode;
 
@@ -33,40 +40,69 @@ typedef unsigned char byte;
 
 struct LuminVirtualMachineConfig {
     bool DebugMode = false;
+    // Where SNAPSHOT writes the VM state, the marker is ignored when empty
+    std::string SnapshotPath;
+    // Count calls and branches for CollectProfile, see Profiler
+    bool Profile = false;
 };
 
 class LuminVirtualMachine {
 public:
-    explicit LuminVirtualMachine(const std::vector<byte>& bytecode);
+    explicit LuminVirtualMachine(const std::vector<byte>& bytecode, LuminVirtualMachineConfig config = {});
+    // Starts at the runtime's entry method, several VMs may share one runtime
+    explicit LuminVirtualMachine(std::shared_ptr<LuminRuntime> runtime, LuminVirtualMachineConfig config = {});
+    // Resumes a snapshot of a VM that was running the same program
+    LuminVirtualMachine(VMSnapshot snapshot, std::shared_ptr<LuminRuntime> runtime, LuminVirtualMachineConfig config = {});
     // TODO: remove
     bool freezeExecution = false;
     void Step();
     void Run();
     void Reset();
+    [[nodiscard]] VMSnapshot CaptureSnapshot() const;
+    [[nodiscard]] const LuminRuntime& Runtime() const { return *runtime; }
+    // What the program did so far, only when the config asked for a profile
+    [[nodiscard]] Utils::ExecutionProfile CollectProfile() const;
     //
     VMStack<NumericValue> stack;
     std::vector<NumericValue> locals;
     std::vector<StackFrame> frames;
+    Heap heap;
 private:
     using OpcodeHandler = void (LuminVirtualMachine::*)();
     std::unordered_map<OpCode, OpcodeHandler> opcode_handlers;
-    std::vector<byte> bytecode;
+    LuminVirtualMachineConfig config;
+    std::shared_ptr<LuminRuntime> runtime;
+    std::unique_ptr<Profiler> profiler;
+    std::span<const byte> bytecode; // Body of the executing method
     size_t ip;
     size_t base_pointer;
+    size_t instruction_end = 0; // Operands of the executing instruction end here
 
     void Init();
+    void Start();
+    // Decodes the instruction at ip with the shared reader, which checks the
+    // opcode and that its operand is in bounds, and steps ip past the opcode
+    OpCode Decode();
     void Process(OpCode opcode);
+    void Invoke(const LinkedMethod& method);
+    std::vector<NumericValue>& CurrentLocals();
+    void LoadLocal(size_t index);
+    void StoreLocal(size_t index);
+    // A local that has to hold an int, for the counted loop opcodes
+    int32_t& IntLocal(size_t index, const char* opcode);
+    void Jump(OpCode opcode);
+    // Moves ip by a branch offset relative to end, the end of the instruction
+    void JumpFrom(size_t end, int32_t offset);
+    // Records the branch at offset of the executing method when profiling
+    void CountBranch(size_t offset, bool taken);
 
     template < typename T >
     T Read();
     template< typename T >
     T PopCheckedValue();
-    template < typename Op >
-    NumericValue PerformNumericOperation(
-        const NumericValue &a,
-        const NumericValue &b,
-        Op operation
-    );
+    template < typename T >
+    T PopOperand(const char* opcode);
+    ArrayStorage& PopArray(const char* opcode);
 
     // Integer
     void HandleICONST();
@@ -77,7 +113,16 @@ private:
     void HandleIADD();
     void HandleISUB();
     void HandleINEG();
+    void HandleICMP();
+    void HandlePOP();
     void HandleI2F();
+    // Short forms
+    void HandleICONST_N();
+    void HandleBIPUSH();
+    void HandleSIPUSH();
+    void HandleILOAD_N();
+    void HandleISTORE_N();
+    void HandleWIDE();
     // Floats
     void HandleFCONST();
     void HandleFDIV();
@@ -85,8 +130,29 @@ private:
     void HandleFADD();
     void HandleFSUB();
     void HandleFNEG();
+    void HandleFCMP();
     void HandleFLOAD();
     void HandleFSTORE();
+    // Arrays
+    void HandleACONST_NULL();
+    void HandleALLOC_ARRAY();
+    void HandleLOAD_ARRAY();
+    void HandleSTORE_ARRAY();
+    void HandleISNULL();
+    void HandleVECTOR();
+    // Control flow
+    void HandleCALL();
+    void HandleINVOKE();
+    void HandleTAILCALL();
+    void HandleRETURN();
+    void HandleGOTO();
+    void HandleIF();
+    void HandleTABLESWITCH();
+    void HandleLOOKUPSWITCH();
+    void HandleFOR_RANGE();
+    void HandleLOOP_NEXT();
+    // VM
+    void HandleSNAPSHOT();
     //
 };
 
@@ -0,0 +1,52 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <ExecutionProfile.hpp>
+#include <LuminRuntime.hpp>
+
+namespace Lumin::VM {
+
+constexpr uint32_t NO_CALLER = UINT32_MAX;
+
+// Counts method entries, calls between methods and which way each branch
+// goes. Branch counters are kept per byte of a body, allocated on the first
+// branch of the method, so recording one is an index and an increment.
+class Profiler {
+public:
+    explicit Profiler( const LuminRuntime& runtime );
+
+    void Call( uint32_t caller, uint32_t callee );
+    void Branch( uint32_t method, size_t offset, bool taken );
+
+    [[nodiscard]] Utils::ExecutionProfile Collect( LuminRuntime& runtime ) const;
+
+private:
+    std::vector<uint64_t> calls;
+    std::vector<std::vector<std::array<uint64_t, 2>>> branches; // Per method and offset, not taken then taken
+    std::unordered_map<uint64_t, uint64_t> callEdges; // Caller in the high half, callee in the low one
+};
+
+}
+
+#endif //PROFILER_HPP
@@ -18,18 +18,20 @@
 #ifndef STACKFRAME_HPP
 #define STACKFRAME_HPP
 
+#include <cstdint>
 #include <vector>
 #include <NumericValue.hpp>
 
 namespace Lumin::VM {
 
 struct StackFrame {
-    size_t return_address;
-    size_t base_pointer;
+    uint32_t method_index; // Method executing in this frame
+    size_t return_address; // Caller ip
+    size_t base_pointer; // Caller base pointer
     std::vector<NumericValue> local_variables;
 
-    StackFrame( const size_t ret_addr, const size_t base_ptr, const size_t local_count )
-        : return_address( ret_addr ), base_pointer( base_ptr ),
+    StackFrame( const uint32_t method, const size_t ret_addr, const size_t base_ptr, const size_t local_count )
+        : method_index( method ), return_address( ret_addr ), base_pointer( base_ptr ),
         local_variables( local_count ) {}
 };
 
@@ -0,0 +1,143 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef VMSNAPSHOT_HPP
+#define VMSNAPSHOT_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <NumericValue.hpp>
+#include <LuminFile.hpp>
+#include <Heap.hpp>
+#include <LuminRuntime.hpp>
+
+namespace Lumin::VM {
+
+constexpr uint32_t LUMIN_SNAPSHOT_MAGIC = 0xC0FFEE5A;
+constexpr uint16_t LUMIN_SNAPSHOT_VERSION = 7;
+
+/*
+ On-disk layout, every section 8-byte aligned and addressed by its offset from
+ the start of the file. Nothing in the image is a pointer, so a mapped snapshot
+ is used in place without relocation. Every field is little-endian and written
+ with the ByteOrder.hpp helpers, the structs below are not copied as they are.
+
+   header              magic (u32), version (u16), flags (u16), then the
+                       SnapshotHeader fields from ip on, a u64 each
+   program             the serialized LuminFile, programSize bytes
+   value[]             operand stack, bottom first
+   value[]             locals
+   frame[]             call frames, outermost first
+   value[]             frame locals, referenced by SnapshotFrame::localsIndex
+   heap                per array its element type (u8, 7 bytes padding), its
+                       length (u64) and its elements (i32 or f32), padded
+                       to 8 bytes, in ArrayRef order
+   u32[]               released array slots, padded to 8 bytes
+   local array[]       frame-local arrays, innermost frame last
+   u32[]               indices of the linked methods, padded to 8 bytes
+   constant[]          resolved constant pool entries: index, target (u32 each)
+
+ A value is the NumericValue alternative index (u8, 7 bytes padding) and its
+ payload zero extended to a u64, floats by their bits. A frame and a local
+ array are their SnapshotFrame and SnapshotLocalArray fields, a u64 each.
+
+ The ip is relative to the body of the method in the innermost frame, or to
+ the start of the program's code section when there is no frame.
+ */
+struct SnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t ip;
+    uint64_t basePointer;
+    uint64_t programOffset;
+    uint64_t programSize;
+    uint64_t stackOffset;
+    uint64_t stackCount;
+    uint64_t localsOffset;
+    uint64_t localsCount;
+    uint64_t framesOffset;
+    uint64_t frameCount;
+    uint64_t frameLocalsOffset;
+    uint64_t frameLocalsCount;
+    uint64_t heapOffset;
+    uint64_t arrayCount;
+    uint64_t freeSlotsOffset;
+    uint64_t freeSlotCount;
+    uint64_t localArraysOffset;
+    uint64_t localArrayCount;
+    uint64_t linkedMethodsOffset;
+    uint64_t linkedMethodCount;
+    uint64_t constantsOffset;
+    uint64_t constantCount;
+    // HeapStatistics, so `lumin -V` counts from the start of the run
+    uint64_t allocated;
+    uint64_t localAllocated;
+    uint64_t released;
+    uint64_t peakLive;
+};
+
+struct SnapshotLocalArray {
+    uint64_t depth;
+    uint64_t site;
+    uint64_t array; // ArrayRef index
+};
+
+struct SnapshotFrame {
+    uint64_t methodIndex;
+    uint64_t returnAddress;
+    uint64_t basePointer;
+    uint64_t localsIndex; // First value in the frame locals section
+    uint64_t localsCount;
+};
+
+constexpr size_t SNAPSHOT_VALUE_SIZE = 16;
+constexpr size_t SNAPSHOT_ARRAY_HEADER_SIZE = 16;
+constexpr size_t SNAPSHOT_FRAME_SIZE = 40;
+constexpr size_t SNAPSHOT_LOCAL_ARRAY_SIZE = 24;
+constexpr size_t SNAPSHOT_CONSTANT_SIZE = 8;
+
+struct VMSnapshotFrame {
+    uint32_t methodIndex;
+    size_t returnAddress;
+    size_t basePointer;
+    std::vector<NumericValue> locals;
+};
+
+// Execution state of a LuminVirtualMachine, the program is stored next to it
+struct VMSnapshot {
+    size_t ip = 0;
+    size_t basePointer = 0;
+    std::vector<NumericValue> stack;
+    std::vector<NumericValue> locals;
+    std::vector<VMSnapshotFrame> frames;
+    std::vector<ArrayStorage> arrays;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Heap::LocalArray> localArrays;
+    HeapStatistics statistics;
+    RuntimeCaches runtime;
+};
+
+bool WriteSnapshotFile( const std::string& outputPath, const VMSnapshot& snapshot, std::span<const unsigned char> program );
+// The program is viewed in place, it keeps the snapshot mapped
+bool ReadSnapshotFile( const std::string& inputPath, VMSnapshot& snapshot, LuminFileView& program );
+
+}
+
+#endif //VMSNAPSHOT_HPP
@@ -0,0 +1,48 @@
+
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef VECTORKERNELS_HPP
+#define VECTORKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Lumin::VM {
+
+enum class VectorOp : uint8_t { ADD, SUB, MUL, DIV };
+
+// One side of a vector operation, the array or, when elements is null, the
+// scalar used for every element
+template < typename T >
+struct VectorOperand {
+    const T* elements;
+    T scalar;
+};
+
+// dst[i] = left[i] op right[i] for every i below count, a multiple of
+// VECTOR_LANES. dst may be one of the operands, each element is read before
+// it is written.
+// Integer arithmetic wraps like IADD and IMUL, integers have no DIV kernel.
+void RunVectorKernel( VectorOp op, int32_t* dst, const VectorOperand<int32_t>& left, const VectorOperand<int32_t>& right, size_t count );
+void RunVectorKernel( VectorOp op, float* dst, const VectorOperand<float>& left, const VectorOperand<float>& right, size_t count );
+
+// The instruction set the kernels run with, picked from the CPU on first use
+const char* VectorInstructionSet();
+
+}
+
+#endif //VECTORKERNELS_HPP
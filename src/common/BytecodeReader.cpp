@@ -13,5 +13,171 @@
  See the License for the specific language governing permissions and
  limitations under the License.
  */
+#include <array>
+#include <format>
+#include <string>
+#include <vector>
+#include <BytecodeReader.hpp>
 
+using namespace Lumin::Bytecode;
 
+namespace {
+
+// Opcodes whose operand Validate checks past decoding, other than the
+// locals and branches it tests first
+constexpr bool HasCheckedOperand( const OpCode opcode ) {
+    switch ( opcode ) {
+        case OpCode::CALL: case OpCode::TAILCALL: case OpCode::INVOKE:
+        case OpCode::ALLOC_ARRAY: case OpCode::ALLOC_LOCAL_ARRAY:
+        case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VDIV:
+        case OpCode::TABLESWITCH: case OpCode::LOOKUPSWITCH:
+        case OpCode::FOR_RANGE: case OpCode::LOOP_NEXT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+constexpr auto CHECKED_OPERANDS = [] {
+    std::array<bool, 256> checked {};
+    for ( size_t i = 0; i < checked.size(); ++i ) {
+        checked[i] = HasCheckedOperand( static_cast<OpCode>( i ) );
+    }
+    return checked;
+}();
+
+}
+
+void BytecodeReader::ThrowDecodeError( const char* message, const size_t offset ) {
+    throw std::runtime_error( message + std::to_string( offset ) );
+}
+
+Instruction BytecodeReader::DecodeVariable( const size_t offset ) const {
+    const auto opcode = static_cast<OpCode>( code[offset] );
+    const auto operandSize = static_cast<size_t>( OPERAND_SIZES[static_cast<uint8_t>( opcode )] );
+    if ( opcode == OpCode::WIDE ) {
+        return { offset, static_cast<OpCode>( code[offset + 1] ), true, { code.data() + offset + 2, 2 } };
+    }
+
+    const auto count = Utils::LoadLE<uint32_t>( reinterpret_cast<const unsigned char*>( code.data() ) + offset + 1
+        + ( opcode == OpCode::TABLESWITCH ? 4 : 0 ) );
+    const size_t entries = count * SwitchEntrySize( opcode );
+    if ( entries > code.size() - offset - 1 - operandSize ) {
+        ThrowDecodeError( "Truncated switch table at ", offset );
+    }
+    return { offset, opcode, false, { code.data() + offset + 1, operandSize + entries } };
+}
+
+void BytecodeReader::Validate( const ValidationLimits& limits ) const {
+    // Copied, so the stores into boundaries do not force reloads
+    const uint32_t maxLocals = limits.maxLocals;
+    const size_t methodCount = limits.methodCount;
+    // The short forms name locals 0 to 3, all in range from 4 locals on
+    const bool shortLocalsFit = maxLocals >= 4;
+
+    std::vector<bool> boundaries( code.size() + 1, false );
+    std::vector<size_t> branchTargets;
+
+    size_t pc = 0;
+    while ( pc < code.size() ) {
+        const Instruction instruction = Decode( pc );
+        boundaries[pc] = true;
+        pc = instruction.Next();
+
+        // Locals and branches are most of any body and are tested first. A
+        // switch over every opcode compiles to a jump table whose indirect
+        // jump mispredicts on nearly every instruction of a mixed body, so
+        // only the opcodes with a checked operand reach the switch below.
+        if ( instruction.opcode == OpCode::ILOAD || instruction.opcode == OpCode::ISTORE ) {
+            if ( ( instruction.wide ? instruction.Load<uint16_t>( 0 ) : instruction.Load<uint8_t>( 0 ) ) >= maxLocals ) {
+                throw std::runtime_error( std::format( "Local index out of range at {}", instruction.offset ) );
+            }
+            continue;
+        }
+        // Only ILOAD and ISTORE can be widened
+        if ( instruction.wide ) {
+            throw std::runtime_error( std::format( "WIDE applied to opcode {} at {}",
+                static_cast<int>( instruction.opcode ), instruction.offset ) );
+        }
+        if ( IsBranch( instruction.opcode ) ) {
+            const auto target = static_cast<int64_t>( pc ) + instruction.BranchOffset();
+            if ( target < 0 || target > static_cast<int64_t>( code.size() ) ) {
+                throw std::runtime_error( std::format( "Branch target out of range at {}", instruction.offset ) );
+            }
+            branchTargets.push_back( static_cast<size_t>( target ) );
+            continue;
+        }
+        if ( !shortLocalsFit && instruction.IsLocalAccess() && instruction.Local() >= maxLocals ) {
+            throw std::runtime_error( std::format( "Local index out of range at {}", instruction.offset ) );
+        }
+        if ( !CHECKED_OPERANDS[static_cast<uint8_t>( instruction.opcode )] ) {
+            continue;
+        }
+
+        switch ( instruction.opcode ) {
+            case OpCode::CALL: case OpCode::TAILCALL:
+                if ( instruction.Index() >= methodCount ) {
+                    throw std::runtime_error( std::format( "Call to unknown method at {}", instruction.offset ) );
+                }
+                break;
+            case OpCode::INVOKE:
+                if ( !limits.isMethodRef || !limits.isMethodRef( instruction.Index() ) ) {
+                    throw std::runtime_error( std::format( "INVOKE operand is not a method reference at {}", instruction.offset ) );
+                }
+                break;
+            case OpCode::ALLOC_ARRAY: case OpCode::ALLOC_LOCAL_ARRAY:
+                if ( instruction.Load<uint8_t>( 0 ) > static_cast<uint8_t>( ArrayElement::FLOAT ) ) {
+                    throw std::runtime_error( std::format( "Unknown array element type at {}", instruction.offset ) );
+                }
+                break;
+            case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VDIV:
+                // At least one operand is an array, or there is nothing to vectorize
+                if ( const uint8_t mode = instruction.Load<uint8_t>( 0 );
+                     mode > ( VECTOR_LEFT_SCALAR | VECTOR_RIGHT_SCALAR | VECTOR_CHECK )
+                     || ( mode & ( VECTOR_LEFT_SCALAR | VECTOR_RIGHT_SCALAR ) ) == ( VECTOR_LEFT_SCALAR | VECTOR_RIGHT_SCALAR ) ) {
+                    throw std::runtime_error( std::format( "Invalid vector mode at {}", instruction.offset ) );
+                }
+                break;
+            case OpCode::TABLESWITCH: case OpCode::LOOKUPSWITCH: {
+                const uint32_t count = instruction.SwitchCount();
+                if ( instruction.opcode == OpCode::TABLESWITCH && count > 0
+                     && static_cast<int64_t>( instruction.Load<int32_t>( 0 ) ) + count - 1 > INT32_MAX ) {
+                    throw std::runtime_error( std::format( "Switch keys overflow at {}", instruction.offset ) );
+                }
+                for ( uint32_t entry = 0; entry <= count; ++entry ) {
+                    if ( instruction.opcode == OpCode::LOOKUPSWITCH && entry > 0 && entry < count
+                         && instruction.SwitchKey( entry ) <= instruction.SwitchKey( entry - 1 ) ) {
+                        throw std::runtime_error( std::format( "Switch keys out of order at {}", instruction.offset ) );
+                    }
+                    // Offsets are signed, a target before the start wraps around past the end
+                    const size_t target = entry < count ? instruction.SwitchTarget( entry ) : instruction.SwitchDefault();
+                    if ( target > code.size() ) {
+                        throw std::runtime_error( std::format( "Switch target out of range at {}", instruction.offset ) );
+                    }
+                    branchTargets.push_back( target );
+                }
+                break;
+            }
+            case OpCode::FOR_RANGE: case OpCode::LOOP_NEXT: {
+                if ( instruction.LoopCounter() >= maxLocals || instruction.LoopLimit() >= maxLocals ) {
+                    throw std::runtime_error( std::format( "Local index out of range at {}", instruction.offset ) );
+                }
+                const size_t target = instruction.LoopTarget();
+                if ( target > code.size() ) {
+                    throw std::runtime_error( std::format( "Branch target out of range at {}", instruction.offset ) );
+                }
+                branchTargets.push_back( target );
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    boundaries[code.size()] = true;
+
+    for ( const size_t target : branchTargets ) {
+        if ( !boundaries[target] ) {
+            throw std::runtime_error( std::format( "Branch into the middle of an instruction ( target {} )", target ) );
+        }
+    }
+}
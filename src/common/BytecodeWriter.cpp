@@ -14,56 +14,52 @@
  limitations under the License.
  */
 
-#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 #include <BytecodeWriter.hpp>
+#include <ByteOrder.hpp>
 
 using namespace Lumin::Bytecode;
 
-void BytecodeWriter::Emit( const uint64_t value ) {
-    bytecode.push_back( value & 0xFF );
-    bytecode.push_back( (value >> 8) & 0xFF );
-    bytecode.push_back( (value >> 16) & 0xFF );
-    bytecode.push_back( (value >> 24) & 0xFF );
-    bytecode.push_back( (value >> 32) & 0xFF );
-    bytecode.push_back( (value >> 40) & 0xFF );
-    bytecode.push_back( (value >> 48) & 0xFF );
-    bytecode.push_back( (value >> 56) & 0xFF );
+void BytecodeWriter::Reserve( const size_t bytes ) {
+    bytecode.reserve( bytecode.size() + bytes );
 }
 
+void BytecodeWriter::Emit( const std::span<const uint8_t> bytes ) {
+    bytecode.insert( bytecode.end(), bytes.begin(), bytes.end() );
+}
+
+void BytecodeWriter::Emit( const uint64_t value ) {
+    Utils::AppendLE( bytecode, value );
+}
 
 void BytecodeWriter::Emit( const int64_t value ) {
-    Emit( static_cast<uint64_t>( value ) );
+    Utils::AppendLE( bytecode, value );
 }
 
 void BytecodeWriter::Emit( const double value ) {
-    uint64_t bits;
-    std::memcpy(&bits, &value, sizeof(double));
-
-    Emit( bits );
+    Utils::AppendLE( bytecode, value );
 }
 
 void BytecodeWriter::Emit( const uint32_t value ) {
-    bytecode.push_back( value & 0xFF );          // Least significant byte
-    bytecode.push_back( (value >> 8) & 0xFF );   // Second byte
-    bytecode.push_back( (value >> 16) & 0xFF );  // Third byte
-    bytecode.push_back( (value >> 24) & 0xFF );  // Most significant byte
+    Utils::AppendLE( bytecode, value );
 }
 
 void BytecodeWriter::Emit( const int32_t value ) {
-    Emit( static_cast<uint32_t>( value ) );
+    Utils::AppendLE( bytecode, value );
 }
 
 void BytecodeWriter::Emit( const float value ) {
-    uint32_t bits;
-    std::memcpy( &bits, &value, sizeof( float ) );
-
-    Emit( bits );
+    Utils::AppendLE( bytecode, value );
 }
 
+void BytecodeWriter::Emit( const uint16_t value ) {
+    Utils::AppendLE( bytecode, value );
+}
 
 void BytecodeWriter::Emit( const int16_t value ) {
-    bytecode.push_back( value & 0xFF );
-    bytecode.push_back( (value >> 8) & 0xFF );
+    Utils::AppendLE( bytecode, value );
 }
 
 void BytecodeWriter::Emit( const bool value ) {
@@ -81,3 +77,208 @@ void BytecodeWriter::Emit( const int8_t value ) {
 void BytecodeWriter::Emit( const OpCode opcode ) {
     bytecode.push_back( static_cast<uint8_t>( opcode ) );
 }
+
+void BytecodeWriter::EmitIConst( const int32_t value ) {
+    if ( value >= -1 && value <= 5 ) {
+        Emit( static_cast<OpCode>( static_cast<int32_t>( OpCode::ICONST_0 ) + value ) );
+    } else if ( value >= INT8_MIN && value <= INT8_MAX ) {
+        Emit( OpCode::BIPUSH );
+        Emit( static_cast<int8_t>( value ) );
+    } else if ( value >= INT16_MIN && value <= INT16_MAX ) {
+        Emit( OpCode::SIPUSH );
+        Emit( static_cast<int16_t>( value ) );
+    } else {
+        Emit( OpCode::ICONST );
+        Emit( value );
+    }
+}
+
+void BytecodeWriter::EmitILoad( const uint16_t index ) {
+    EmitLocalAccess( OpCode::ILOAD, OpCode::ILOAD_0, index );
+}
+
+void BytecodeWriter::EmitIStore( const uint16_t index ) {
+    EmitLocalAccess( OpCode::ISTORE, OpCode::ISTORE_0, index );
+}
+
+void BytecodeWriter::EmitLocalAccess( const OpCode opcode, const OpCode shortForm0, const uint16_t index ) {
+    if ( index <= 3 ) {
+        Emit( static_cast<OpCode>( static_cast<uint8_t>( shortForm0 ) + index ) );
+    } else if ( index <= UINT8_MAX ) {
+        Emit( opcode );
+        Emit( static_cast<uint8_t>( index ) );
+    } else {
+        Emit( OpCode::WIDE );
+        Emit( opcode );
+        Emit( index );
+    }
+}
+
+Label BytecodeWriter::NewLabel() {
+    labels.emplace_back();
+    return { static_cast<uint32_t>( labels.size() - 1 ) };
+}
+
+void BytecodeWriter::Bind( const Label label ) {
+    LabelSlot& slot = labels.at( label.id );
+    if ( slot.position != UNBOUND ) {
+        throw std::logic_error( "Label bound twice" );
+    }
+
+    slot.position = bytecode.size();
+    slot.branchesBefore = branches.size();
+}
+
+void BytecodeWriter::EmitBranch( const OpCode opcode, const Label target ) {
+    if ( !IsBranch( opcode ) ) {
+        throw std::logic_error( "EmitBranch needs a branch opcode" );
+    }
+    if ( target.id >= labels.size() ) {
+        throw std::logic_error( "Branch to an unknown label" );
+    }
+
+    branches.push_back( { bytecode.size(), LongBranch( opcode ), target.id } );
+}
+
+void BytecodeWriter::EmitTableSwitch( const int32_t low, const std::span<const Label> targets, const Label fallback ) {
+    if ( !targets.empty() && static_cast<int64_t>( low ) + static_cast<int64_t>( targets.size() ) - 1 > INT32_MAX ) {
+        throw std::logic_error( "TABLESWITCH keys overflow" );
+    }
+
+    const size_t end = bytecode.size() + 13 + 4 * targets.size();
+    Emit( OpCode::TABLESWITCH );
+    Emit( low );
+    Emit( static_cast<uint32_t>( targets.size() ) );
+    EmitFixedOffset( fallback, end );
+    for ( const Label target : targets ) {
+        EmitFixedOffset( target, end );
+    }
+}
+
+void BytecodeWriter::EmitLookupSwitch( const std::span<const int32_t> keys, const std::span<const Label> targets, const Label fallback ) {
+    if ( keys.size() != targets.size() || std::ranges::adjacent_find( keys, std::greater_equal<>() ) != keys.end() ) {
+        throw std::logic_error( "LOOKUPSWITCH needs ascending keys, one per target" );
+    }
+
+    const size_t end = bytecode.size() + 9 + 8 * targets.size();
+    Emit( OpCode::LOOKUPSWITCH );
+    Emit( static_cast<uint32_t>( keys.size() ) );
+    EmitFixedOffset( fallback, end );
+    for ( size_t i = 0; i < keys.size(); ++i ) {
+        Emit( keys[i] );
+        EmitFixedOffset( targets[i], end );
+    }
+}
+
+void BytecodeWriter::EmitCountedLoop( const OpCode opcode, const uint16_t counter, const uint16_t limit, const Label target ) {
+    if ( !IsCountedLoop( opcode ) ) {
+        throw std::logic_error( "EmitCountedLoop needs FOR_RANGE or LOOP_NEXT" );
+    }
+
+    const size_t end = bytecode.size() + 9;
+    Emit( opcode );
+    Emit( counter );
+    Emit( limit );
+    EmitFixedOffset( target, end );
+}
+
+void BytecodeWriter::EmitFixedOffset( const Label target, const size_t end ) {
+    if ( target.id >= labels.size() ) {
+        throw std::logic_error( "Branch to an unknown label" );
+    }
+
+    fixedOffsets.push_back( { bytecode.size(), end, branches.size(), target.id } );
+    Emit( static_cast<int32_t>( 0 ) );
+}
+
+void BytecodeWriter::Finish() {
+    for ( const Branch& branch : branches ) {
+        if ( labels[branch.target].position == UNBOUND ) {
+            throw std::logic_error( "Branch to a label that was never bound" );
+        }
+    }
+    for ( const FixedOffset& offset : fixedOffsets ) {
+        if ( labels[offset.target].position == UNBOUND ) {
+            throw std::logic_error( "Branch to a label that was never bound" );
+        }
+    }
+
+    // Every branch starts out short and is lengthened when its target is out
+    // of reach. Lengthening only moves code apart, so a branch never has to
+    // shrink again and the loop settles after at most one pass per branch.
+    std::vector<size_t> growth( branches.size() + 1, 0 );
+    const auto labelOffset = [this, &growth]( const LabelSlot& slot ) {
+        return slot.position + growth[slot.branchesBefore];
+    };
+
+    bool changed = true;
+    while ( changed ) {
+        changed = false;
+        for ( size_t i = 0; i < branches.size(); ++i ) {
+            const int size = branches[i].isLong ? 5 : 2;
+            growth[i + 1] = growth[i] + static_cast<size_t>( size );
+        }
+
+        for ( size_t i = 0; i < branches.size(); ++i ) {
+            Branch& branch = branches[i];
+            if ( branch.isLong ) {
+                continue;
+            }
+
+            const size_t end = branch.position + growth[i] + 2;
+            const auto displacement = static_cast<int64_t>( labelOffset( labels[branch.target] ) ) - static_cast<int64_t>( end );
+            if ( displacement < INT8_MIN || displacement > INT8_MAX ) {
+                branch.isLong = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve( bytecode.size() + growth.back() );
+
+    size_t copied = 0;
+    for ( size_t i = 0; i < branches.size(); ++i ) {
+        const Branch& branch = branches[i];
+        out.insert( out.end(), bytecode.begin() + copied, bytecode.begin() + branch.position );
+        copied = branch.position;
+
+        const size_t end = out.size() + ( branch.isLong ? 5 : 2 );
+        const auto displacement = static_cast<int64_t>( labelOffset( labels[branch.target] ) ) - static_cast<int64_t>( end );
+        if ( branch.isLong ) {
+            out.push_back( static_cast<uint8_t>( branch.opcode ) );
+            Utils::AppendLE( out, static_cast<int32_t>( displacement ) );
+        } else {
+            out.push_back( static_cast<uint8_t>( ShortBranch( branch.opcode ) ) );
+            out.push_back( static_cast<uint8_t>( static_cast<int8_t>( displacement ) ) );
+        }
+    }
+    out.insert( out.end(), bytecode.begin() + copied, bytecode.end() );
+
+    // A switch or counted loop has no branches inside it, so all of it moves
+    // by the growth of the branches before
+    for ( const FixedOffset& offset : fixedOffsets ) {
+        const size_t moved = growth[offset.branchesBefore];
+        const auto displacement = static_cast<int64_t>( labelOffset( labels[offset.target] ) )
+            - static_cast<int64_t>( offset.end + moved );
+        Utils::StoreLE( out.data() + offset.position + moved, static_cast<int32_t>( displacement ) );
+    }
+
+    // Bound labels now point into the final code, code appended later may
+    // still branch back to them
+    for ( LabelSlot& slot : labels ) {
+        if ( slot.position != UNBOUND ) {
+            slot.offset = labelOffset( slot );
+            slot.position = slot.offset;
+            slot.branchesBefore = 0;
+        }
+    }
+
+    bytecode = std::move( out );
+    branches.clear();
+    fixedOffsets.clear();
+}
+
+size_t BytecodeWriter::Offset( const Label label ) const {
+    return labels.at( label.id ).offset;
+}
@@ -0,0 +1,141 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <bit>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <ConstantPoolBuilder.hpp>
+
+using namespace Lumin::Utils;
+
+size_t ConstantPoolBuilder::KeyHash::operator()( const KeyView& key ) const {
+    size_t hash = std::hash<std::string_view> {}( key.text );
+    hash ^= std::hash<uint64_t> {}( key.bits ) + 0x9E3779B97F4A7C15ULL + ( hash << 6 ) + ( hash >> 2 );
+    hash ^= static_cast<size_t>( key.tag ) * 0x100000001B3ULL;
+    return hash;
+}
+
+ConstantPoolBuilder::ConstantPoolBuilder( const std::vector<ConstantPoolEntry>& existing ) {
+    entries.reserve( existing.size() );
+    for ( const auto& entry : existing ) {
+        Add( entry );
+    }
+}
+
+uint16_t ConstantPoolBuilder::Intern( const KeyView& key, ConstantPoolEntry&& entry ) {
+    if ( const auto it = index.find( key ); it != index.end() ) {
+        return it->second;
+    }
+
+    if ( entries.size() > std::numeric_limits<uint16_t>::max() ) {
+        throw std::length_error( "Constant pool is full" );
+    }
+
+    const auto position = static_cast<uint16_t>( entries.size() );
+    entries.push_back( std::move( entry ) );
+    index.emplace( Key { key.tag, key.bits, std::string( key.text ) }, position );
+
+    return position;
+}
+
+uint16_t ConstantPoolBuilder::Add( const ConstantPoolEntry& entry ) {
+    switch ( entry.tag ) {
+        case ConstantPoolTag::CONSTANT_INTEGER:
+            return AddInteger( std::get<int32_t>( entry.data ) );
+        case ConstantPoolTag::CONSTANT_FLOAT:
+            return AddFloat( std::get<float>( entry.data ) );
+        case ConstantPoolTag::CONSTANT_LONG:
+            return AddLong( std::get<int64_t>( entry.data ) );
+        case ConstantPoolTag::CONSTANT_DOUBLE:
+            return AddDouble( std::get<double>( entry.data ) );
+        case ConstantPoolTag::CONST_UTF8:
+        case ConstantPoolTag::CONST_STRING: {
+            const std::string& text = std::get<std::string>( entry.data );
+            return Intern( { entry.tag, 0, text }, ConstantPoolEntry( entry ) );
+        }
+        default: {
+            const uint16_t target = std::get<uint16_t>( entry.data );
+            return Intern( { entry.tag, target, {} }, ConstantPoolEntry( entry ) );
+        }
+    }
+}
+
+uint16_t ConstantPoolBuilder::AddInteger( const int32_t value ) {
+    return Intern(
+        { ConstantPoolTag::CONSTANT_INTEGER, static_cast<uint32_t>( value ), {} },
+        { ConstantPoolTag::CONSTANT_INTEGER, value }
+    );
+}
+
+uint16_t ConstantPoolBuilder::AddLong( const int64_t value ) {
+    return Intern(
+        { ConstantPoolTag::CONSTANT_LONG, static_cast<uint64_t>( value ), {} },
+        { ConstantPoolTag::CONSTANT_LONG, value }
+    );
+}
+
+uint16_t ConstantPoolBuilder::AddFloat( const float value ) {
+    return Intern(
+        { ConstantPoolTag::CONSTANT_FLOAT, std::bit_cast<uint32_t>( value ), {} },
+        { ConstantPoolTag::CONSTANT_FLOAT, value }
+    );
+}
+
+uint16_t ConstantPoolBuilder::AddDouble( const double value ) {
+    return Intern(
+        { ConstantPoolTag::CONSTANT_DOUBLE, std::bit_cast<uint64_t>( value ), {} },
+        { ConstantPoolTag::CONSTANT_DOUBLE, value }
+    );
+}
+
+uint16_t ConstantPoolBuilder::AddUtf8( const std::string_view value ) {
+    const KeyView key { ConstantPoolTag::CONST_UTF8, 0, value };
+    if ( const auto it = index.find( key ); it != index.end() ) {
+        return it->second;
+    }
+    return Intern( key, { ConstantPoolTag::CONST_UTF8, std::string( value ) } );
+}
+
+uint16_t ConstantPoolBuilder::AddString( const std::string_view value ) {
+    const KeyView key { ConstantPoolTag::CONST_STRING, 0, value };
+    if ( const auto it = index.find( key ); it != index.end() ) {
+        return it->second;
+    }
+    return Intern( key, { ConstantPoolTag::CONST_STRING, std::string( value ) } );
+}
+
+uint16_t ConstantPoolBuilder::AddReference( const ConstantPoolTag tag, const std::string_view name ) {
+    const uint16_t nameIndex = AddUtf8( name );
+    return Intern( { tag, nameIndex, {} }, { tag, nameIndex } );
+}
+
+uint16_t ConstantPoolBuilder::AddClass( const std::string_view name ) {
+    return AddReference( ConstantPoolTag::CONST_CLASS, name );
+}
+
+uint16_t ConstantPoolBuilder::AddMethodRef( const std::string_view name ) {
+    return AddReference( ConstantPoolTag::CONST_METHOD_REF, name );
+}
+
+uint16_t ConstantPoolBuilder::AddFieldRef( const std::string_view name ) {
+    return AddReference( ConstantPoolTag::CONST_FIELD_REF, name );
+}
+
+std::vector<ConstantPoolEntry> ConstantPoolBuilder::Release() {
+    index.clear();
+    return std::move( entries );
+}
@@ -0,0 +1,114 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <ExecutionProfile.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::Utils;
+
+namespace {
+
+constexpr auto PROFILE_HEADER = "lumin-profile 1";
+
+}
+
+uint64_t Lumin::Utils::HashCode( const std::span<const unsigned char> code ) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for ( const unsigned char byte : code ) {
+        hash = ( hash ^ byte ) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+bool Lumin::Utils::WriteProfileFile( const std::string& outputPath, const ExecutionProfile& profile ) {
+    std::ofstream file( outputPath );
+    if ( !file ) {
+        LOG_ERROR( "Failed to open file for writing: " + outputPath )
+        return false;
+    }
+
+    file << PROFILE_HEADER << '\n';
+    for ( size_t i = 0; i < profile.methods.size(); ++i ) {
+        const MethodProfile& method = profile.methods[i];
+        file << std::format( "method {} {} {:016x} {}\n", i, method.calls, method.codeHash, method.name );
+        for ( const auto& [offset, taken, notTaken] : method.branches ) {
+            file << std::format( "branch {} {} {}\n", offset, taken, notTaken );
+        }
+    }
+    for ( const auto& [caller, callee, count] : profile.calls ) {
+        file << std::format( "call {} {} {}\n", caller, callee, count );
+    }
+    file.close();
+
+    return static_cast<bool>( file );
+}
+
+bool Lumin::Utils::ReadProfileFile( const std::string& inputPath, ExecutionProfile& profile ) {
+    std::ifstream file( inputPath );
+    if ( !file ) {
+        LOG_ERROR( "Failed to open profile: " + inputPath )
+        return false;
+    }
+
+    std::string line;
+    if ( !std::getline( file, line ) || line != PROFILE_HEADER ) {
+        LOG_ERROR( "Not a Lumin profile: " + inputPath )
+        return false;
+    }
+
+    profile = {};
+    size_t number = 1;
+    while ( std::getline( file, line ) ) {
+        ++number;
+        std::istringstream fields( line );
+        std::string kind;
+        fields >> kind;
+
+        bool valid = false;
+        if ( kind == "method" ) {
+            size_t index = 0;
+            MethodProfile method;
+            valid = static_cast<bool>( fields >> index >> method.calls >> std::hex >> method.codeHash >> std::dec )
+                && index == profile.methods.size();
+            fields >> std::ws;
+            std::getline( fields, method.name );
+            profile.methods.push_back( std::move( method ) );
+        } else if ( kind == "branch" ) {
+            BranchCount branch {};
+            valid = static_cast<bool>( fields >> branch.offset >> branch.taken >> branch.notTaken ) && !profile.methods.empty()
+                && ( profile.methods.back().branches.empty() || profile.methods.back().branches.back().offset < branch.offset );
+            if ( valid ) {
+                profile.methods.back().branches.push_back( branch );
+            }
+        } else if ( kind == "call" ) {
+            CallCount call {};
+            valid = static_cast<bool>( fields >> call.caller >> call.callee >> call.count );
+            profile.calls.push_back( call );
+        } else {
+            valid = kind.empty();
+        }
+
+        if ( !valid ) {
+            LOG_ERROR( std::format( "{}:{}: malformed profile record", inputPath, number ) )
+            return false;
+        }
+    }
+
+    return true;
+}
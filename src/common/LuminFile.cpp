@@ -14,34 +14,57 @@
  limitations under the License.
  */
 
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 #include <LuminFile.hpp>
+#include <ByteOrder.hpp>
 #include <Logging.hpp>
 
 using namespace Lumin::Utils;
 
-void ConstantPoolEntry::Serialize( std::ofstream& outFile ) const {
-    outFile.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+namespace {
 
-    switch (tag) {
+constexpr size_t SECTION_ALIGNMENT = 8;
+
+size_t Align( const size_t offset ) {
+    return ( offset + SECTION_ALIGNMENT - 1 ) & ~( SECTION_ALIGNMENT - 1 );
+}
+
+void PadToAlignment( std::vector<unsigned char>& out ) {
+    out.resize( Align( out.size() ) );
+}
+
+std::span<const unsigned char> Slice( const std::span<const unsigned char> bytes, const size_t offset, const size_t count ) {
+    if ( offset > bytes.size() || count > bytes.size() - offset ) {
+        throw std::runtime_error( "Record out of bounds" );
+    }
+    return bytes.subspan( offset, count );
+}
+
+ConstantPoolEntryView DecodeEntry( const std::span<const unsigned char> bytes ) {
+    const auto head = Slice( bytes, 0, 8 );
+    ConstantPoolEntryView entry;
+    entry.tag = static_cast<ConstantPoolTag>( head[0] );
+    const auto payload = LoadLE<uint32_t>( head.data() + 4 );
+
+    switch ( entry.tag ) {
         case ConstantPoolTag::CONSTANT_INTEGER:
-            outFile.write(reinterpret_cast<const char*>(&std::get<int32_t>(data)), sizeof(int32_t));
-        break;
+            entry.data = static_cast<int32_t>( payload );
+            break;
         case ConstantPoolTag::CONSTANT_FLOAT:
-            outFile.write(reinterpret_cast<const char*>(&std::get<float>(data)), sizeof(float));
-        break;
+            entry.data = LoadLE<float>( head.data() + 4 );
+            break;
         case ConstantPoolTag::CONSTANT_LONG:
-            outFile.write(reinterpret_cast<const char*>(&std::get<int64_t>(data)), sizeof(int64_t));
-        break;
+            entry.data = LoadLE<int64_t>( Slice( bytes, 8, 8 ).data() );
+            break;
         case ConstantPoolTag::CONSTANT_DOUBLE:
-            outFile.write(reinterpret_cast<const char*>(&std::get<double>(data)), sizeof(double));
-        break;
+            entry.data = LoadLE<double>( Slice( bytes, 8, 8 ).data() );
+            break;
         case ConstantPoolTag::CONST_UTF8:
         case ConstantPoolTag::CONST_STRING: {
-            const std::string& str = std::get<std::string>(data);
-            const size_t len = str.size();
-            outFile.write(reinterpret_cast<const char*>(&len), sizeof(len));
-            outFile.write(str.c_str(), len);
+            const auto str = Slice( bytes, 8, payload );
+            entry.data = std::string_view( reinterpret_cast<const char*>( str.data() ), str.size() );
             break;
         }
         case ConstantPoolTag::CONST_CLASS:
@@ -49,68 +72,260 @@ void ConstantPoolEntry::Serialize( std::ofstream& outFile ) const {
         case ConstantPoolTag::CONST_FIELD_REF:
         case ConstantPoolTag::CONST_METHOD_REF:
         case ConstantPoolTag::CONST_SIGNATURE:
-            outFile.write(reinterpret_cast<const char*>(&std::get<uint16_t>(data)), sizeof(uint16_t));
-        break;
-        default:
+            entry.data = static_cast<uint16_t>( payload );
             break;
+        default:
+            throw std::runtime_error( "Unknown constant pool tag" );
     }
+
+    return entry;
 }
 
-ConstantPoolEntry ConstantPoolEntry::Deserialize( std::ifstream& inFile ) {
-    ConstantPoolEntry entry;
-    inFile.read( reinterpret_cast<char*>( &entry.tag ), sizeof( entry.tag ) );
+void EncodeField( std::vector<unsigned char>& out, const FieldInfo& field ) {
+    AppendLE( out, field.flags );
+    AppendLE( out, field.nameIndex );
+    AppendLE( out, field.typeIndex );
+    AppendLE( out, uint16_t { 0 } );
+    AppendLE( out, field.defaultValueIndex );
+    AppendLE( out, uint32_t { 0 } );
+}
 
-    switch (entry.tag) {
-        case ConstantPoolTag::CONSTANT_INTEGER: {
-            int32_t value;
-            inFile.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
-            entry.data = value;
+void EncodeMethod( std::vector<unsigned char>& out, const MethodInfo& method ) {
+    AppendLE( out, method.flags );
+    AppendLE( out, method.nameIndex );
+    AppendLE( out, method.signatureIndex );
+    AppendLE( out, method.maxStack );
+    AppendLE( out, method.maxLocals );
+    AppendLE( out, method.parameterCount );
+    AppendLE( out, method.codeOffset );
+    AppendLE( out, method.codeLength );
+    AppendLE( out, uint32_t { 0 } );
+}
+
+struct SectionData {
+    LuminSection kind;
+    uint32_t count;
+    std::vector<unsigned char> bytes;
+};
+
+}
+
+void ConstantPoolEntry::Serialize( std::vector<unsigned char>& out ) const {
+    PadToAlignment( out );
+    out.push_back( static_cast<unsigned char>( tag ) );
+    out.insert( out.end(), 3, 0 );
+
+    switch ( tag ) {
+        case ConstantPoolTag::CONSTANT_INTEGER:
+            AppendLE( out, std::get<int32_t>( data ) );
             break;
-        }
-        case ConstantPoolTag::CONSTANT_FLOAT: {
-            float value;
-            inFile.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
-            entry.data = value;
+        case ConstantPoolTag::CONSTANT_FLOAT:
+            AppendLE( out, std::get<float>( data ) );
             break;
-        }
-        case ConstantPoolTag::CONSTANT_LONG: {
-            int64_t value;
-            inFile.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
-            entry.data = value;
+        case ConstantPoolTag::CONSTANT_LONG:
+            AppendLE( out, uint32_t { 0 } );
+            AppendLE( out, std::get<int64_t>( data ) );
             break;
-        }
-        case ConstantPoolTag::CONSTANT_DOUBLE: {
-            double value;
-            inFile.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
-            entry.data = value;
+        case ConstantPoolTag::CONSTANT_DOUBLE:
+            AppendLE( out, uint32_t { 0 } );
+            AppendLE( out, std::get<double>( data ) );
             break;
-        }
         case ConstantPoolTag::CONST_UTF8:
         case ConstantPoolTag::CONST_STRING: {
-            size_t len;
-            inFile.read( reinterpret_cast<char*>( &len ), sizeof( len ) );
-            std::string str( len, '\0' );
-            inFile.read( &str[0], len );
-            entry.data = str;
+            const std::string& str = std::get<std::string>( data );
+            AppendLE( out, static_cast<uint32_t>( str.size() ) );
+            out.insert( out.end(), str.begin(), str.end() );
             break;
         }
         case ConstantPoolTag::CONST_CLASS:
         case ConstantPoolTag::CONST_INTERFACE:
         case ConstantPoolTag::CONST_FIELD_REF:
         case ConstantPoolTag::CONST_METHOD_REF:
-        case ConstantPoolTag::CONST_SIGNATURE: {
-            uint16_t ref;
-            inFile.read( reinterpret_cast<char*>( &ref ), sizeof( ref ) );
-            entry.data = ref;
+        case ConstantPoolTag::CONST_SIGNATURE:
+            AppendLE( out, static_cast<uint32_t>( std::get<uint16_t>( data ) ) );
             break;
-        }
         default:
+            AppendLE( out, uint32_t { 0 } );
             break;
     }
 
+    PadToAlignment( out );
+}
+
+ConstantPoolEntry ConstantPoolEntry::Deserialize( const std::span<const unsigned char> bytes ) {
+    const auto view = DecodeEntry( bytes );
+
+    ConstantPoolEntry entry;
+    entry.tag = view.tag;
+    std::visit( [&entry]( const auto& value ) {
+        using T = std::decay_t<decltype( value )>;
+        if constexpr ( std::is_same_v<T, std::string_view> ) {
+            entry.data = std::string( value );
+        } else {
+            entry.data = value;
+        }
+    }, view.data );
+
     return entry;
 }
 
+ConstantPoolEntryView LuminFileView::Constant( const size_t index ) const {
+    if ( index >= constantCount ) {
+        throw std::out_of_range( "Constant pool index out of range" );
+    }
+
+    const auto offset = LoadLE<uint32_t>( constantPool.data() + index * sizeof( uint32_t ) );
+    return DecodeEntry( constantPool.subspan( offset ) );
+}
+
+FieldInfo LuminFileView::Field( const size_t index ) const {
+    if ( index >= fieldCount ) {
+        throw std::out_of_range( "Field index out of range" );
+    }
+
+    const unsigned char* record = fieldTable.data() + index * LUMIN_FIELD_RECORD_SIZE;
+    return {
+        LoadLE<uint16_t>( record ),
+        LoadLE<uint16_t>( record + 2 ),
+        LoadLE<uint16_t>( record + 4 ),
+        LoadLE<uint32_t>( record + 8 )
+    };
+}
+
+MethodInfo LuminFileView::Method( const size_t index ) const {
+    if ( index >= methodCount ) {
+        throw std::out_of_range( "Method index out of range" );
+    }
+
+    const unsigned char* record = methodTable.data() + index * LUMIN_METHOD_RECORD_SIZE;
+    return {
+        LoadLE<uint16_t>( record ),
+        LoadLE<uint16_t>( record + 2 ),
+        LoadLE<uint16_t>( record + 4 ),
+        LoadLE<uint16_t>( record + 6 ),
+        LoadLE<uint16_t>( record + 8 ),
+        LoadLE<uint16_t>( record + 10 ),
+        LoadLE<uint32_t>( record + 12 ),
+        LoadLE<uint32_t>( record + 16 )
+    };
+}
+
+ClassInfo LuminFileView::Class( const size_t index ) const {
+    if ( index >= classCount ) {
+        throw std::out_of_range( "Class index out of range" );
+    }
+
+    const unsigned char* record = classTable.data() + index * LUMIN_CLASS_RECORD_SIZE;
+    ClassInfo classInfo {
+        LoadLE<uint16_t>( record ),
+        LoadLE<uint16_t>( record + 2 ),
+        LoadLE<uint16_t>( record + 4 ),
+        {},
+        {}
+    };
+
+    const auto firstField = LoadLE<uint32_t>( record + 8 );
+    const auto fieldTotal = LoadLE<uint32_t>( record + 12 );
+    const auto firstMethod = LoadLE<uint32_t>( record + 16 );
+    const auto methodTotal = LoadLE<uint32_t>( record + 20 );
+
+    classInfo.fields.reserve( fieldTotal );
+    for ( uint32_t i = 0; i < fieldTotal; ++i ) {
+        classInfo.fields.push_back( Field( static_cast<size_t>( firstField ) + i ) );
+    }
+
+    classInfo.methods.reserve( methodTotal );
+    for ( uint32_t i = 0; i < methodTotal; ++i ) {
+        classInfo.methods.push_back( Method( static_cast<size_t>( firstMethod ) + i ) );
+    }
+
+    return classInfo;
+}
+
+std::span<const unsigned char> LuminFileView::Code( const MethodInfo& method ) const {
+    return Slice( bytecode, method.codeOffset, method.codeLength );
+}
+
+std::vector<unsigned char> Lumin::Utils::SerializeLuminFile( const LuminFile& luminFile ) {
+    std::vector<SectionData> sections;
+
+    // Constant pool, offset index first so any entry is one lookup away
+    {
+        const size_t indexSize = Align( luminFile.constantPool.size() * sizeof( uint32_t ) );
+        std::vector<unsigned char> pool( indexSize );
+        for ( size_t i = 0; i < luminFile.constantPool.size(); ++i ) {
+            StoreLE( pool.data() + i * sizeof( uint32_t ), static_cast<uint32_t>( pool.size() ) );
+            luminFile.constantPool[i].Serialize( pool );
+        }
+        sections.push_back( {
+            LuminSection::CONSTANT_POOL,
+            static_cast<uint32_t>( luminFile.constantPool.size() ),
+            std::move( pool )
+        } );
+    }
+
+    // Free functions take the first method slots, class members follow
+    std::vector<unsigned char> methods;
+    std::vector<unsigned char> fields;
+    std::vector<unsigned char> classes;
+    uint32_t methodCount = 0;
+    uint32_t fieldCount = 0;
+
+    for ( const auto& method : luminFile.methods ) {
+        EncodeMethod( methods, method );
+        ++methodCount;
+    }
+
+    for ( const auto& classInfo : luminFile.classes ) {
+        AppendLE( classes, classInfo.flags );
+        AppendLE( classes, classInfo.nameIndex );
+        AppendLE( classes, classInfo.superClassIndex );
+        AppendLE( classes, uint16_t { 0 } );
+        AppendLE( classes, fieldCount );
+        AppendLE( classes, static_cast<uint32_t>( classInfo.fields.size() ) );
+        AppendLE( classes, methodCount );
+        AppendLE( classes, static_cast<uint32_t>( classInfo.methods.size() ) );
+
+        for ( const auto& field : classInfo.fields ) {
+            EncodeField( fields, field );
+            ++fieldCount;
+        }
+        for ( const auto& method : classInfo.methods ) {
+            EncodeMethod( methods, method );
+            ++methodCount;
+        }
+    }
+
+    sections.push_back( { LuminSection::CLASSES, static_cast<uint32_t>( luminFile.classes.size() ), std::move( classes ) } );
+    sections.push_back( { LuminSection::FIELDS, fieldCount, std::move( fields ) } );
+    sections.push_back( { LuminSection::METHODS, methodCount, std::move( methods ) } );
+    sections.push_back( { LuminSection::CODE, static_cast<uint32_t>( luminFile.bytecode.size() ), luminFile.bytecode } );
+
+    std::vector<unsigned char> image;
+    AppendLE( image, luminFile.magicNumber );
+    AppendLE( image, luminFile.versionMajor );
+    AppendLE( image, luminFile.versionMinor );
+    AppendLE( image, luminFile.flags );
+    AppendLE( image, LUMIN_FORMAT_VERSION );
+    AppendLE( image, static_cast<uint16_t>( sections.size() ) );
+    AppendLE( image, luminFile.entryMethod );
+
+    size_t offset = Align( LUMIN_HEADER_SIZE + sections.size() * LUMIN_SECTION_ENTRY_SIZE );
+    for ( const auto& [kind, count, bytes] : sections ) {
+        AppendLE( image, static_cast<uint32_t>( kind ) );
+        AppendLE( image, count );
+        AppendLE( image, static_cast<uint64_t>( offset ) );
+        AppendLE( image, static_cast<uint64_t>( bytes.size() ) );
+        offset = Align( offset + bytes.size() );
+    }
+
+    for ( const auto& section : sections ) {
+        PadToAlignment( image );
+        image.insert( image.end(), section.bytes.begin(), section.bytes.end() );
+    }
+
+    return image;
+}
 
 bool Lumin::Utils::WriteLuminFile( const std::string& outputPath, const LuminFile& luminFile ) {
     std::ofstream file( outputPath, std::ios::binary );
@@ -119,60 +334,176 @@ bool Lumin::Utils::WriteLuminFile( const std::string& outputPath, const LuminFil
         return false;
     }
 
-    const auto& [
-        magicNumber,
-        versionMajor,
-        versionMinor,
-        flags,
-        constantPool,
-        bytecode
-    ] = luminFile;
+    const std::vector<unsigned char> image = SerializeLuminFile( luminFile );
+    file.write( reinterpret_cast<const char*>( image.data() ), static_cast<std::streamsize>( image.size() ) );
+    file.close();
+
+    return static_cast<bool>( file );
+}
+
+LuminFileView Lumin::Utils::ViewLuminFile( const std::span<const unsigned char> bytes, const std::string& inputPath ) {
+    LuminFileView luminFile {};
+    luminFile.magicNumber = -1;
 
-    file.write( reinterpret_cast<const char*>( &magicNumber ), sizeof( magicNumber ) );
-    file.write( reinterpret_cast<const char*>( &versionMajor ), sizeof( versionMajor ) );
-    file.write( reinterpret_cast<const char*>( &versionMinor ), sizeof( versionMinor ) );
-    file.write( reinterpret_cast<const char*>( &flags ), sizeof( flags ));
+    try {
+        const auto header = Slice( bytes, 0, LUMIN_HEADER_SIZE );
+        const auto magicNumber = LoadLE<uint32_t>( header.data() );
+        const auto versionMajor = header[4];
+        const auto formatVersion = LoadLE<uint16_t>( header.data() + 8 );
+        const auto sectionCount = LoadLE<uint16_t>( header.data() + 10 );
+
+        if ( magicNumber != LUMIN_MAGIC_NUMBER ) {
+            LOG_ERROR( "Not a Lumin file: " + inputPath )
+            return luminFile;
+        }
 
-    const size_t poolSize = constantPool.size();
-    file.write( reinterpret_cast<const char*>( &poolSize ), sizeof( poolSize ) );
-    for ( const auto& entry : constantPool ) {
-        entry.Serialize( file );
+        if ( versionMajor != LUMIN_VERSION_MAJOR || formatVersion != LUMIN_FORMAT_VERSION ) {
+            LOG_ERROR( "Unsupported Lumin file version " + std::to_string( versionMajor )
+                + " (format " + std::to_string( formatVersion ) + "): " + inputPath )
+            return luminFile;
+        }
+
+        const auto table = Slice( bytes, LUMIN_HEADER_SIZE, sectionCount * LUMIN_SECTION_ENTRY_SIZE );
+        bool hasCode = false;
+        for ( size_t i = 0; i < sectionCount; ++i ) {
+            const unsigned char* entry = table.data() + i * LUMIN_SECTION_ENTRY_SIZE;
+            const auto kind = static_cast<LuminSection>( LoadLE<uint32_t>( entry ) );
+            const auto count = LoadLE<uint32_t>( entry + 4 );
+            const auto offset = LoadLE<uint64_t>( entry + 8 );
+            const auto size = LoadLE<uint64_t>( entry + 16 );
+
+            if ( offset % SECTION_ALIGNMENT != 0 ) {
+                throw std::runtime_error( "Misaligned section" );
+            }
+            const auto section = Slice( bytes, offset, size );
+
+            switch ( kind ) {
+                case LuminSection::CONSTANT_POOL:
+                    if ( count > size / sizeof( uint32_t ) ) {
+                        throw std::runtime_error( "Constant pool index out of bounds" );
+                    }
+                    for ( size_t j = 0; j < count; ++j ) {
+                        if ( LoadLE<uint32_t>( section.data() + j * sizeof( uint32_t ) ) >= size ) {
+                            throw std::runtime_error( "Constant pool offset out of bounds" );
+                        }
+                    }
+                    luminFile.constantPool = section;
+                    luminFile.constantCount = count;
+                    break;
+                case LuminSection::CLASSES:
+                    if ( size != static_cast<uint64_t>( count ) * LUMIN_CLASS_RECORD_SIZE ) {
+                        throw std::runtime_error( "Class table size mismatch" );
+                    }
+                    luminFile.classTable = section;
+                    luminFile.classCount = count;
+                    break;
+                case LuminSection::FIELDS:
+                    if ( size != static_cast<uint64_t>( count ) * LUMIN_FIELD_RECORD_SIZE ) {
+                        throw std::runtime_error( "Field table size mismatch" );
+                    }
+                    luminFile.fieldTable = section;
+                    luminFile.fieldCount = count;
+                    break;
+                case LuminSection::METHODS:
+                    if ( size != static_cast<uint64_t>( count ) * LUMIN_METHOD_RECORD_SIZE ) {
+                        throw std::runtime_error( "Method table size mismatch" );
+                    }
+                    luminFile.methodTable = section;
+                    luminFile.methodCount = count;
+                    break;
+                case LuminSection::CODE:
+                    luminFile.bytecode = section;
+                    hasCode = true;
+                    break;
+                default:
+                    // Sections from newer minor versions are skipped
+                    break;
+            }
+        }
+
+        if ( !hasCode ) {
+            throw std::runtime_error( "Missing code section" );
+        }
+
+        for ( size_t i = 0; i < luminFile.methodCount; ++i ) {
+            const auto method = luminFile.Method( i );
+            Slice( luminFile.bytecode, method.codeOffset, method.codeLength );
+        }
+
+        luminFile.entryMethod = LoadLE<uint32_t>( header.data() + 12 );
+        if ( luminFile.entryMethod != LUMIN_NO_ENTRY_METHOD && luminFile.entryMethod >= luminFile.methodCount ) {
+            throw std::runtime_error( "Entry method out of range" );
+        }
+
+        luminFile.versionMajor = versionMajor;
+        luminFile.versionMinor = header[5];
+        luminFile.flags = LoadLE<uint16_t>( header.data() + 6 );
+        luminFile.image = bytes;
+        luminFile.magicNumber = magicNumber;
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( "Malformed Lumin file " + inputPath + ": " + exception.what() )
+        luminFile = {};
+        luminFile.magicNumber = -1;
     }
 
-    const size_t bytecodeSize = bytecode.size();
-    file.write( reinterpret_cast<const char*>( bytecode.data() ), bytecodeSize * sizeof( unsigned char ) );
+    return luminFile;
+}
 
-    file.close();
+LuminFileView Lumin::Utils::MapLuminFile( const std::string& inputPath ) {
+    MappedFile mapping( inputPath );
+    if ( !mapping.IsOpen() ) {
+        LuminFileView luminFile {};
+        luminFile.magicNumber = -1;
+        return luminFile;
+    }
 
-    return true;
+    LuminFileView luminFile = ViewLuminFile( mapping.Bytes(), inputPath );
+    if ( luminFile.magicNumber == LUMIN_MAGIC_NUMBER ) {
+        luminFile.mapping = std::move( mapping );
+    }
+    return luminFile;
 }
 
 LuminFile Lumin::Utils::ReadLuminFile( const std::string& inputPath ) {
-    LuminFile luminFile;
-    std::ifstream file( inputPath, std::ios::binary );
-    if ( !file ) {
-        LOG_ERROR( "Failed to open file for reading: " + inputPath )
+    LuminFile luminFile {};
+    const LuminFileView view = MapLuminFile( inputPath );
+    if ( view.magicNumber != LUMIN_MAGIC_NUMBER ) {
         luminFile.magicNumber = -1;
         return luminFile;
     }
 
-    file.read( reinterpret_cast<char*>( &luminFile.magicNumber ), sizeof( luminFile.magicNumber ) );
-    file.read( reinterpret_cast<char*>( &luminFile.versionMajor ), sizeof( luminFile.versionMajor ) );
-    file.read( reinterpret_cast<char*>( &luminFile.versionMinor ), sizeof( luminFile.versionMinor ) );
-    file.read( reinterpret_cast<char*>( &luminFile.flags ), sizeof( luminFile.flags ) );
+    luminFile.magicNumber = view.magicNumber;
+    luminFile.versionMajor = view.versionMajor;
+    luminFile.versionMinor = view.versionMinor;
+    luminFile.flags = view.flags;
+    luminFile.entryMethod = view.entryMethod;
 
-    size_t poolSize;
-    file.read( reinterpret_cast<char*>( &poolSize ), sizeof( poolSize ) );
-    luminFile.constantPool.resize( poolSize );
-    for ( auto& entry : luminFile.constantPool ) {
-        entry = ConstantPoolEntry::Deserialize( file );
-    }
+    try {
+        luminFile.constantPool.reserve( view.constantCount );
+        for ( size_t i = 0; i < view.constantCount; ++i ) {
+            const auto offset = LoadLE<uint32_t>( view.constantPool.data() + i * sizeof( uint32_t ) );
+            luminFile.constantPool.push_back( ConstantPoolEntry::Deserialize( view.constantPool.subspan( offset ) ) );
+        }
 
-    size_t bytecodeSize;
-    file.read( reinterpret_cast<char*>( &bytecodeSize ), sizeof( bytecodeSize ) );
-    luminFile.bytecode.resize( bytecodeSize);
-    file.read( reinterpret_cast<char*>( luminFile.bytecode.data() ), bytecodeSize );
+        size_t classMethods = 0;
+        luminFile.classes.reserve( view.classCount );
+        for ( size_t i = 0; i < view.classCount; ++i ) {
+            luminFile.classes.push_back( view.Class( i ) );
+            classMethods += luminFile.classes.back().methods.size();
+        }
 
-    file.close();
+        const size_t freeMethods = view.methodCount - std::min<size_t>( classMethods, view.methodCount );
+        luminFile.methods.reserve( freeMethods );
+        for ( size_t i = 0; i < freeMethods; ++i ) {
+            luminFile.methods.push_back( view.Method( i ) );
+        }
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( "Malformed Lumin file " + inputPath + ": " + exception.what() )
+        luminFile = {};
+        luminFile.magicNumber = -1;
+        return luminFile;
+    }
+
+    luminFile.bytecode.assign( view.bytecode.begin(), view.bytecode.end() );
     return luminFile;
 }
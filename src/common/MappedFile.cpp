@@ -0,0 +1,139 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <utility>
+#include <MappedFile.hpp>
+#include <Logging.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Lumin::Utils;
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile( const std::string& path ) {
+    const HANDLE file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( file == INVALID_HANDLE_VALUE ) {
+        LOG_ERROR( "Failed to open file for mapping: " + path )
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 ) {
+        LOG_ERROR( "Cannot map empty or unreadable file: " + path )
+        CloseHandle( file );
+        return;
+    }
+
+    mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    CloseHandle( file );
+    if ( !mapping ) {
+        LOG_ERROR( "Failed to map file: " + path )
+        return;
+    }
+
+    data = static_cast<const unsigned char*>( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+    if ( !data ) {
+        LOG_ERROR( "Failed to map file: " + path )
+        CloseHandle( mapping );
+        mapping = nullptr;
+        return;
+    }
+
+    size = static_cast<size_t>( fileSize.QuadPart );
+}
+
+void MappedFile::Close() {
+    if ( data ) {
+        UnmapViewOfFile( data );
+    }
+    if ( mapping ) {
+        CloseHandle( mapping );
+    }
+    data = nullptr;
+    mapping = nullptr;
+    size = 0;
+}
+
+#else
+
+MappedFile::MappedFile( const std::string& path ) {
+    const int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        LOG_ERROR( "Failed to open file for mapping: " + path )
+        return;
+    }
+
+    struct stat info {};
+    if ( fstat( fd, &info ) != 0 || info.st_size == 0 ) {
+        LOG_ERROR( "Cannot map empty or unreadable file: " + path )
+        close( fd );
+        return;
+    }
+
+    void* address = mmap( nullptr, static_cast<size_t>( info.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( address == MAP_FAILED ) {
+        LOG_ERROR( "Failed to map file: " + path )
+        return;
+    }
+
+    data = static_cast<const unsigned char*>( address );
+    size = static_cast<size_t>( info.st_size );
+}
+
+void MappedFile::Close() {
+    if ( data ) {
+        munmap( const_cast<unsigned char*>( data ), size );
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile( MappedFile&& other ) noexcept
+    : data( std::exchange( other.data, nullptr ) ),
+    size( std::exchange( other.size, 0 ) ) {
+#if defined(_WIN32)
+    mapping = std::exchange( other.mapping, nullptr );
+#endif
+}
+
+MappedFile& MappedFile::operator=( MappedFile&& other ) noexcept {
+    if ( this != &other ) {
+        Close();
+        data = std::exchange( other.data, nullptr );
+        size = std::exchange( other.size, 0 );
+#if defined(_WIN32)
+        mapping = std::exchange( other.mapping, nullptr );
+#endif
+    }
+    return *this;
+}
@@ -0,0 +1,1157 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <AotCompiler.hpp>
+#include <BytecodeReader.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::Compiler;
+using namespace Lumin::Bytecode;
+
+namespace {
+
+// Mirrors the interpreter's value semantics: an int and a float promote to
+// a float, int arithmetic wraps, and anything else aborts like the
+// interpreter's "Incompatible types" error would. Arrays are never
+// collected, like on the interpreter's heap, except the frame-local ones a
+// method frees when it returns.
+constexpr auto RUNTIME_PRELUDE = R"(#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct lm_array {
+    int32_t element; /* 0 int, 1 float, as ArrayElement */
+    int32_t length;
+    union { int32_t* i; float* f; } as;
+} lm_array;
+
+typedef struct {
+    int32_t tag; /* 0 null, 1 int, 2 float, 3 array */
+    union { int32_t i; float f; lm_array* a; } as;
+} lm_value;
+
+static lm_value lm_null( void ) { lm_value v; v.tag = 0; v.as.i = 0; return v; }
+static lm_value lm_int( int32_t i ) { lm_value v; v.tag = 1; v.as.i = i; return v; }
+static lm_value lm_float( float f ) { lm_value v; v.tag = 2; v.as.f = f; return v; }
+static lm_value lm_ref( lm_array* a ) { lm_value v; v.tag = 3; v.as.a = a; return v; }
+
+static void lm_fail( const char* format, ... ) {
+    va_list arguments;
+    va_start( arguments, format );
+    fprintf( stderr, "LuminVM Error " );
+    vfprintf( stderr, format, arguments );
+    fprintf( stderr, "\n" );
+    va_end( arguments );
+    exit( 1 );
+}
+
+static int32_t lm_as_int( lm_value v ) {
+    if ( v.tag != 1 ) lm_fail( "Expected an int" );
+    return v.as.i;
+}
+
+static float lm_as_float( lm_value v ) {
+    if ( v.tag != 1 && v.tag != 2 ) lm_fail( "Incompatible types for operation" );
+    return v.tag == 1 ? (float) v.as.i : v.as.f;
+}
+
+static int32_t lm_idiv( int32_t a, int32_t b ) {
+    if ( b == 0 ) lm_fail( "Division by zero" );
+    /* INT32_MIN / -1 overflows, it wraps back to INT32_MIN */
+    return b == -1 ? (int32_t) ( 0u - (uint32_t) a ) : a / b;
+}
+
+static lm_value lm_arith( char op, lm_value a, lm_value b ) {
+    if ( a.tag == 1 && b.tag == 1 ) {
+        uint32_t x = (uint32_t) a.as.i, y = (uint32_t) b.as.i;
+        switch ( op ) {
+            case '+': return lm_int( (int32_t) ( x + y ) );
+            case '-': return lm_int( (int32_t) ( x - y ) );
+            case '*': return lm_int( (int32_t) ( x * y ) );
+            default: return lm_int( lm_idiv( a.as.i, b.as.i ) );
+        }
+    }
+    float x = lm_as_float( a ), y = lm_as_float( b );
+    switch ( op ) {
+        case '+': return lm_float( x + y );
+        case '-': return lm_float( x - y );
+        case '*': return lm_float( x * y );
+        default: return lm_float( x / y );
+    }
+}
+
+static int32_t lm_cmp( lm_value a, lm_value b ) {
+    if ( a.tag == 1 && b.tag == 1 ) return ( a.as.i > b.as.i ) - ( a.as.i < b.as.i );
+    float x = lm_as_float( a ), y = lm_as_float( b );
+    return ( x > y ) - ( x < y );
+}
+
+static lm_value lm_neg( lm_value v ) {
+    if ( v.tag == 1 ) return lm_int( (int32_t) ( 0u - (uint32_t) v.as.i ) );
+    return lm_float( -lm_as_float( v ) );
+}
+
+static lm_array* lm_alloc( int32_t element, int32_t length ) {
+    if ( length < 0 ) lm_fail( "Negative array length %d", length );
+    lm_array* a = calloc( 1, sizeof( lm_array ) + (size_t) length * sizeof( int32_t ) );
+    if ( !a ) lm_fail( "Out of memory for an array of length %d", length );
+    a->element = element;
+    a->length = length;
+    if ( element == 1 ) a->as.f = (float*) ( a + 1 );
+    else a->as.i = (int32_t*) ( a + 1 );
+    return a;
+}
+
+/* The array a site allocated on the previous pass is dead, like the
+   interpreter reuses its slot */
+static lm_array* lm_alloc_local( lm_array* previous, int32_t element, int32_t length ) {
+    free( previous );
+    return lm_alloc( element, length );
+}
+
+static lm_array* lm_as_array( lm_value v, const char* opcode ) {
+    if ( v.tag == 0 ) lm_fail( "%s on a null array", opcode );
+    if ( v.tag != 3 ) lm_fail( "%s expects an array", opcode );
+    return v.as.a;
+}
+
+static int32_t lm_isnull( lm_value v ) {
+    if ( v.tag == 1 || v.tag == 2 ) lm_fail( "ISNULL expects an array" );
+    return v.tag == 0;
+}
+
+static int32_t lm_index( const lm_array* a, int32_t index ) {
+    if ( index < 0 || index >= a->length ) lm_fail( "Array index %d out of bounds for length %d", index, a->length );
+    return index;
+}
+
+static lm_value lm_load( const lm_array* a, int32_t index ) {
+    index = lm_index( a, index );
+    return a->element == 1 ? lm_float( a->as.f[index] ) : lm_int( a->as.i[index] );
+}
+
+static void lm_store( lm_array* a, int32_t index, lm_value v ) {
+    if ( v.tag != ( a->element == 1 ? 2 : 1 ) ) lm_fail( "STORE_ARRAY expects %s elements", a->element == 1 ? "float" : "int" );
+    index = lm_index( a, index );
+    if ( a->element == 1 ) a->as.f[index] = v.as.f;
+    else a->as.i[index] = v.as.i;
+}
+
+/* An array operand of a vector instruction, 0 when the scalar loop has to
+   run instead, see VectorMode */
+static int lm_vector_operand( const lm_array* dst, lm_value v, int scalar, int32_t end ) {
+    if ( scalar ) {
+        if ( v.tag != ( dst->element == 1 ? 2 : 1 ) ) lm_fail( "Vector operand does not match the array type" );
+        return 1;
+    }
+    if ( v.tag != 3 ) return 0;
+    if ( v.as.a->element != dst->element ) lm_fail( "Vector operand does not match the array type" );
+    return end <= v.as.a->length;
+}
+
+/* VADD, VSUB, VMUL and VDIV as a plain loop over the prefix of the range
+   the interpreter's kernels would take, left to the C compiler to
+   vectorize. Returns the first index left for the scalar loop. */
+static int32_t lm_vector( char op, int32_t mode, lm_value dst, lm_value left, lm_value right, int32_t begin, int32_t end ) {
+    int64_t available = (int64_t) end - begin;
+    if ( available < 0 ) available = 0;
+    int32_t count = (int32_t) ( available - available % 4 );
+    if ( count == 0 || begin < 0 || dst.tag != 3 ) return begin;
+
+    lm_array* d = dst.as.a;
+    int32_t stop = begin + count;
+    if ( stop > d->length
+         || !lm_vector_operand( d, left, mode & 1, stop )
+         || !lm_vector_operand( d, right, mode & 2, stop ) ) {
+        return begin;
+    }
+    if ( op == '/' && d->element != 1 ) lm_fail( "VDIV expects float arrays" );
+    if ( mode & 4 ) return stop;
+
+    for ( int32_t i = begin; i < stop; ++i ) {
+        if ( d->element == 1 ) {
+            float x = ( mode & 1 ) ? left.as.f : left.as.a->as.f[i];
+            float y = ( mode & 2 ) ? right.as.f : right.as.a->as.f[i];
+            d->as.f[i] = op == '+' ? x + y : op == '-' ? x - y : op == '*' ? x * y : x / y;
+        } else {
+            uint32_t x = (uint32_t) ( ( mode & 1 ) ? left.as.i : left.as.a->as.i[i] );
+            uint32_t y = (uint32_t) ( ( mode & 2 ) ? right.as.i : right.as.a->as.i[i] );
+            d->as.i[i] = (int32_t) ( op == '+' ? x + y : op == '-' ? x - y : x * y );
+        }
+    }
+    return stop;
+}
+
+static void lm_print( lm_value v ) {
+    if ( v.tag == 1 ) printf( "%d\n", v.as.i );
+    else if ( v.tag == 2 ) printf( "%.9g\n", (double) v.as.f );
+    else if ( v.tag == 3 ) printf( "%s[%d]\n", v.as.a->element == 1 ? "float" : "int", v.as.a->length );
+    else printf( "null\n" );
+}
+
+)";
+
+// NONE is "no value seen yet", DYNAMIC is "more than one type". An array
+// type is never null, a value that may be is DYNAMIC.
+enum class ValueType : uint8_t { NONE, NUL, INT, FLOAT, INT_ARRAY, FLOAT_ARRAY, DYNAMIC };
+
+ValueType Join( const ValueType a, const ValueType b ) {
+    if ( a == ValueType::NONE ) return b;
+    if ( b == ValueType::NONE ) return a;
+    return a == b ? a : ValueType::DYNAMIC;
+}
+
+bool JoinInto( std::vector<ValueType>& into, const std::span<const ValueType> from ) {
+    bool changed = false;
+    for ( size_t i = 0; i < from.size(); ++i ) {
+        const ValueType joined = Join( into[i], from[i] );
+        changed |= joined != into[i];
+        into[i] = joined;
+    }
+    return changed;
+}
+
+// Result of the interpreter's arithmetic on two statically known operands
+ValueType ArithmeticType( const ValueType a, const ValueType b ) {
+    const auto numeric = []( const ValueType type ) { return type == ValueType::INT || type == ValueType::FLOAT; };
+    if ( a == ValueType::INT && b == ValueType::INT ) return ValueType::INT;
+    if ( numeric( a ) && numeric( b ) ) return ValueType::FLOAT;
+    return ValueType::DYNAMIC;
+}
+
+bool IsArray( const ValueType type ) {
+    return type == ValueType::INT_ARRAY || type == ValueType::FLOAT_ARRAY;
+}
+
+// Element read from an array of a type
+ValueType ElementType( const ValueType array ) {
+    switch ( array ) {
+        case ValueType::INT_ARRAY: return ValueType::INT;
+        case ValueType::FLOAT_ARRAY: return ValueType::FLOAT;
+        default: return ValueType::DYNAMIC;
+    }
+}
+
+// How a value of a type is held in C, everything not plainly typed is boxed
+enum class Storage : uint8_t { INT, FLOAT, ARRAY, BOXED };
+
+Storage StorageOf( const ValueType type ) {
+    switch ( type ) {
+        case ValueType::INT: return Storage::INT;
+        case ValueType::FLOAT: return Storage::FLOAT;
+        case ValueType::INT_ARRAY: case ValueType::FLOAT_ARRAY: return Storage::ARRAY;
+        default: return Storage::BOXED;
+    }
+}
+
+const char* CType( const Storage storage ) {
+    switch ( storage ) {
+        case Storage::INT: return "int32_t";
+        case Storage::FLOAT: return "float";
+        case Storage::ARRAY: return "lm_array*";
+        default: return "lm_value";
+    }
+}
+
+// Moves a value between storages. The target storage always covers the
+// value's static type, so unboxing never needs a check.
+std::string Convert( const std::string& expression, const Storage from, const Storage to, const ValueType type ) {
+    if ( from == to ) {
+        return expression;
+    }
+    if ( to == Storage::BOXED ) {
+        switch ( type ) {
+            case ValueType::INT: return std::format( "lm_int( {} )", expression );
+            case ValueType::FLOAT: return std::format( "lm_float( {} )", expression );
+            case ValueType::INT_ARRAY: case ValueType::FLOAT_ARRAY: return std::format( "lm_ref( {} )", expression );
+            default: return "lm_null()";
+        }
+    }
+    return expression + ( to == Storage::INT ? ".as.i" : to == Storage::FLOAT ? ".as.f" : ".as.a" );
+}
+
+// Type of the array ALLOC_ARRAY or ALLOC_LOCAL_ARRAY pushes
+ValueType AllocatedType( const Instruction& instruction ) {
+    return instruction.Load<uint8_t>( 0 ) == static_cast<uint8_t>( ArrayElement::FLOAT ) ? ValueType::FLOAT_ARRAY : ValueType::INT_ARRAY;
+}
+
+// Hex float literal, exact for every value
+std::string FloatLiteral( const float value ) {
+    if ( std::isnan( value ) ) {
+        return "( 0.0f / 0.0f )";
+    }
+    if ( std::isinf( value ) ) {
+        return value < 0 ? "( -1.0f / 0.0f )" : "( 1.0f / 0.0f )";
+    }
+    char literal[32];
+    std::snprintf( literal, sizeof( literal ), "%af", static_cast<double>( value ) );
+    return literal;
+}
+
+struct FrameState {
+    std::vector<ValueType> stack;
+    std::vector<ValueType> locals;
+};
+
+struct MethodPlan {
+    const MethodInfo* info = nullptr;
+    std::string name;
+    std::span<const unsigned char> code;
+    std::vector<Instruction> instructions;
+    std::unordered_map<size_t, size_t> instructionAt; // Offset to index in instructions
+    std::vector<size_t> localArraySites; // Offsets of ALLOC_LOCAL_ARRAY, each keeps its array in a C local
+
+    bool reached = false;
+    std::vector<ValueType> parameters; // Joined over every call site
+    std::optional<size_t> results; // Values left on the stack by a return, unknown until one is seen
+    std::vector<ValueType> resultTypes;
+
+    // Filled on every analysis, valid once the whole program is stable
+    std::vector<std::optional<FrameState>> states; // Per instruction, empty when unreachable
+    std::optional<FrameState> endState; // Reaching the end of the body returns
+    std::vector<ValueType> stackTypes;
+    std::vector<ValueType> localTypes;
+};
+
+class CTranslator {
+public:
+    explicit CTranslator( const LuminFile& program );
+
+    std::string Translate();
+
+private:
+    uint32_t CallTarget( const MethodPlan& method, const Instruction& instruction ) const;
+    bool Analyze( MethodPlan& method );
+    bool Transfer( MethodPlan& method, const Instruction& instruction, FrameState& state, std::vector<size_t>& successors );
+    bool RecordReturn( MethodPlan& method, const FrameState& state );
+
+    std::string Slot( const MethodPlan& method, size_t depth ) const;
+    Storage SlotStorage( const MethodPlan& method, size_t depth ) const;
+    Storage LocalStorage( const MethodPlan& method, size_t local ) const;
+    Storage ResultStorage( const MethodPlan& method ) const;
+    std::string Signature( uint32_t index ) const;
+    std::string Label( const MethodPlan& method, size_t target ) const;
+    void EmitMethod( uint32_t index, std::ostringstream& out ) const;
+    void EmitInstruction( const MethodPlan& method, const Instruction& instruction, const FrameState& state, std::ostringstream& out ) const;
+    void EmitRelease( const MethodPlan& method, std::ostringstream& out ) const;
+    void EmitReturn( const MethodPlan& method, const FrameState& state, std::ostringstream& out ) const;
+
+    const LuminFile& program;
+    std::vector<MethodPlan> methods;
+    std::unordered_map<std::string, uint32_t> methodsByName;
+};
+
+CTranslator::CTranslator( const LuminFile& program ) : program( program ) {
+    // Same method table the runtime builds: free functions, then classes
+    std::vector<const MethodInfo*> table;
+    for ( const auto& method : program.methods ) {
+        table.push_back( &method );
+    }
+    for ( const auto& classInfo : program.classes ) {
+        for ( const auto& method : classInfo.methods ) {
+            table.push_back( &method );
+        }
+    }
+
+    methods.resize( table.size() );
+    for ( size_t i = 0; i < table.size(); ++i ) {
+        MethodPlan& method = methods[i];
+        method.info = table[i];
+        if ( static_cast<uint64_t>( method.info->codeOffset ) + method.info->codeLength > program.bytecode.size() ) {
+            throw std::runtime_error( std::format( "Method {} body out of bounds", i ) );
+        }
+        method.code = std::span( program.bytecode ).subspan( method.info->codeOffset, method.info->codeLength );
+        method.parameters.assign( method.info->parameterCount, ValueType::NONE );
+
+        const uint16_t nameIndex = method.info->nameIndex;
+        if ( nameIndex < program.constantPool.size() ) {
+            if ( const auto* name = std::get_if<std::string>( &program.constantPool[nameIndex].data ) ) {
+                method.name = *name;
+                methodsByName.try_emplace( *name, static_cast<uint32_t>( i ) );
+            }
+        }
+    }
+}
+
+uint32_t CTranslator::CallTarget( const MethodPlan& method, const Instruction& instruction ) const {
+    if ( instruction.opcode == OpCode::CALL || instruction.opcode == OpCode::TAILCALL ) {
+        return instruction.Index();
+    }
+
+    // INVOKE is bound by name at translation time, as the linker would
+    const auto& reference = program.constantPool[instruction.Index()];
+    const uint16_t nameIndex = std::get<uint16_t>( reference.data );
+    const auto* name = nameIndex < program.constantPool.size()
+        ? std::get_if<std::string>( &program.constantPool[nameIndex].data )
+        : nullptr;
+    const auto target = name ? methodsByName.find( *name ) : methodsByName.end();
+    if ( target == methodsByName.end() ) {
+        throw std::runtime_error( std::format( "Unresolved method '{}' referenced from '{}'", name ? *name : "?", method.name ) );
+    }
+    return target->second;
+}
+
+bool CTranslator::RecordReturn( MethodPlan& method, const FrameState& state ) {
+    if ( !method.results ) {
+        method.results = state.stack.size();
+        method.resultTypes = state.stack;
+        return true;
+    }
+    if ( *method.results != state.stack.size() ) {
+        throw std::runtime_error( std::format( "Method '{}' returns {} and {} values on different paths",
+            method.name, *method.results, state.stack.size() ) );
+    }
+    return JoinInto( method.resultTypes, state.stack );
+}
+
+// Applies one instruction to the abstract frame. Returns whether a summary
+// of this or another method changed.
+bool CTranslator::Transfer( MethodPlan& method, const Instruction& instruction, FrameState& state, std::vector<size_t>& successors ) {
+    auto& stack = state.stack;
+    const auto pop = [&] {
+        if ( stack.empty() ) {
+            throw std::runtime_error( std::format( "Method '{}' pops below its frame at {}", method.name, instruction.offset ) );
+        }
+        const ValueType type = stack.back();
+        stack.pop_back();
+        return type;
+    };
+
+    bool changed = false;
+    bool fallsThrough = true;
+    switch ( instruction.opcode ) {
+        case OpCode::ICONST: case OpCode::BIPUSH: case OpCode::SIPUSH:
+        case OpCode::ICONST_M1: case OpCode::ICONST_0: case OpCode::ICONST_1: case OpCode::ICONST_2:
+        case OpCode::ICONST_3: case OpCode::ICONST_4: case OpCode::ICONST_5:
+            stack.push_back( ValueType::INT );
+            break;
+        case OpCode::FCONST:
+            stack.push_back( ValueType::FLOAT );
+            break;
+        case OpCode::ILOAD: case OpCode::ILOAD_0: case OpCode::ILOAD_1: case OpCode::ILOAD_2: case OpCode::ILOAD_3:
+            stack.push_back( state.locals[instruction.Local()] );
+            method.localTypes[instruction.Local()] = Join( method.localTypes[instruction.Local()], stack.back() );
+            break;
+        case OpCode::ISTORE: case OpCode::ISTORE_0: case OpCode::ISTORE_1: case OpCode::ISTORE_2: case OpCode::ISTORE_3:
+            state.locals[instruction.Local()] = pop();
+            method.localTypes[instruction.Local()] = Join( method.localTypes[instruction.Local()], state.locals[instruction.Local()] );
+            break;
+        case OpCode::IADD: case OpCode::ISUB: case OpCode::IMUL: case OpCode::IDIV:
+        case OpCode::FADD: case OpCode::FSUB: case OpCode::FMUL: case OpCode::FDIV: {
+            const ValueType a = pop();
+            const ValueType b = pop();
+            stack.push_back( ArithmeticType( a, b ) );
+            break;
+        }
+        case OpCode::INEG: case OpCode::FNEG: {
+            const ValueType a = pop();
+            stack.push_back( a == ValueType::INT || a == ValueType::FLOAT ? a : ValueType::DYNAMIC );
+            break;
+        }
+        case OpCode::ICMP: case OpCode::FCMP:
+            pop();
+            pop();
+            stack.push_back( ValueType::INT );
+            break;
+        case OpCode::POP:
+            pop();
+            break;
+        case OpCode::I2F:
+            pop();
+            stack.push_back( ValueType::FLOAT );
+            break;
+        case OpCode::ACONST_NULL:
+            stack.push_back( ValueType::NUL );
+            break;
+        case OpCode::ISNULL:
+            pop();
+            stack.push_back( ValueType::INT );
+            break;
+        case OpCode::ALLOC_ARRAY: case OpCode::ALLOC_LOCAL_ARRAY:
+            pop();
+            stack.push_back( AllocatedType( instruction ) );
+            break;
+        case OpCode::LOAD_ARRAY: case OpCode::LOAD_ARRAY_NONNULL:
+            pop();
+            stack.push_back( ElementType( pop() ) );
+            break;
+        case OpCode::STORE_ARRAY: case OpCode::STORE_ARRAY_NONNULL:
+            pop();
+            pop();
+            pop();
+            break;
+        case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VDIV:
+            // Destination, left, right, begin and end, the next index is left
+            for ( int operand = 0; operand < 5; ++operand ) {
+                pop();
+            }
+            stack.push_back( ValueType::INT );
+            break;
+        case OpCode::CALL:
+        case OpCode::TAILCALL:
+        case OpCode::INVOKE: {
+            MethodPlan& callee = methods[CallTarget( method, instruction )];
+            const size_t parameterCount = callee.info->parameterCount;
+            if ( stack.size() < parameterCount ) {
+                throw std::runtime_error( std::format( "Method '{}' pops below its frame at {}", method.name, instruction.offset ) );
+            }
+
+            changed |= !callee.reached;
+            callee.reached = true;
+            changed |= JoinInto( callee.parameters, std::span( stack ).last( parameterCount ) );
+            stack.resize( stack.size() - parameterCount );
+
+            // Until the callee is seen to return, nothing after the call is reachable
+            if ( !callee.results ) {
+                fallsThrough = false;
+                break;
+            }
+            stack.insert( stack.end(), callee.resultTypes.begin(), callee.resultTypes.end() );
+            if ( instruction.opcode == OpCode::TAILCALL ) {
+                changed |= RecordReturn( method, state );
+                fallsThrough = false;
+            }
+            break;
+        }
+        case OpCode::RETURN:
+            changed |= RecordReturn( method, state );
+            fallsThrough = false;
+            break;
+        case OpCode::SNAPSHOT:
+            // The native program has no interpreter state to snapshot
+            break;
+        case OpCode::FOR_RANGE: case OpCode::LOOP_NEXT: {
+            const uint16_t counter = instruction.LoopCounter();
+            const uint16_t limit = instruction.LoopLimit();
+            if ( instruction.opcode == OpCode::FOR_RANGE ) {
+                state.locals[limit] = pop();
+            } else {
+                state.locals[counter] = ArithmeticType( state.locals[counter], ValueType::INT );
+            }
+            for ( const uint16_t local : { counter, limit } ) {
+                method.localTypes[local] = Join( method.localTypes[local], state.locals[local] );
+            }
+            successors.push_back( instruction.LoopTarget() );
+            break;
+        }
+        case OpCode::TABLESWITCH: case OpCode::LOOKUPSWITCH:
+            pop();
+            for ( uint32_t entry = 0; entry < instruction.SwitchCount(); ++entry ) {
+                successors.push_back( instruction.SwitchTarget( entry ) );
+            }
+            successors.push_back( instruction.SwitchDefault() );
+            fallsThrough = false;
+            break;
+        default:
+            if ( IsBranch( instruction.opcode ) ) {
+                if ( LongBranch( instruction.opcode ) != OpCode::GOTO ) {
+                    pop();
+                } else {
+                    fallsThrough = false;
+                }
+                successors.push_back( instruction.BranchTarget() );
+                break;
+            }
+            throw std::runtime_error( std::format( "Opcode {} at {} in '{}' is not supported ahead of time",
+                static_cast<int>( instruction.opcode ), instruction.offset, method.name ) );
+    }
+
+    if ( fallsThrough ) {
+        successors.push_back( instruction.Next() );
+    }
+    return changed;
+}
+
+// Abstract interpretation of one method under the current summaries. The
+// states, and from them the storage of every slot, are rebuilt each time.
+bool CTranslator::Analyze( MethodPlan& method ) {
+    const uint16_t maxLocals = method.info->maxLocals;
+    if ( method.instructions.empty() && !method.code.empty() ) {
+        const BytecodeReader reader( method.code );
+        reader.Validate( { maxLocals, methods.size(), [this]( const uint16_t index ) {
+            return index < program.constantPool.size() && program.constantPool[index].tag == ConstantPoolTag::CONST_METHOD_REF;
+        } } );
+        for ( const auto& instruction : reader ) {
+            method.instructionAt.emplace( instruction.offset, method.instructions.size() );
+            method.instructions.push_back( instruction );
+            if ( instruction.opcode == OpCode::ALLOC_LOCAL_ARRAY ) {
+                method.localArraySites.push_back( instruction.offset );
+            }
+        }
+    }
+
+    method.states.assign( method.instructions.size(), std::nullopt );
+    method.endState.reset();
+    method.stackTypes.clear();
+    method.localTypes.assign( maxLocals, ValueType::NONE );
+    std::ranges::copy( method.parameters, method.localTypes.begin() );
+
+    FrameState entry;
+    entry.locals.assign( maxLocals, ValueType::NUL );
+    std::ranges::copy( method.parameters, entry.locals.begin() );
+
+    bool changed = false;
+    std::vector<std::pair<size_t, FrameState>> worklist { { 0, std::move( entry ) } };
+    while ( !worklist.empty() ) {
+        auto [offset, incoming] = std::move( worklist.back() );
+        worklist.pop_back();
+
+        auto& slot = offset >= method.code.size() ? method.endState : method.states[method.instructionAt.at( offset )];
+        if ( !slot ) {
+            slot = std::move( incoming );
+        } else {
+            if ( slot->stack.size() != incoming.stack.size() ) {
+                throw std::runtime_error( std::format( "Method '{}' reaches {} with different stack depths", method.name, offset ) );
+            }
+            const bool grew = JoinInto( slot->stack, incoming.stack ) | JoinInto( slot->locals, incoming.locals );
+            if ( !grew ) {
+                continue;
+            }
+        }
+
+        if ( offset >= method.code.size() ) {
+            changed |= RecordReturn( method, *slot );
+            continue;
+        }
+
+        FrameState state = *slot;
+        std::vector<size_t> successors;
+        changed |= Transfer( method, method.instructions[method.instructionAt.at( offset )], state, successors );
+        for ( const size_t successor : successors ) {
+            worklist.emplace_back( successor, state );
+        }
+    }
+
+    for ( const auto& state : method.states ) {
+        if ( state ) {
+            method.stackTypes.resize( std::max( method.stackTypes.size(), state->stack.size() ), ValueType::NONE );
+            JoinInto( method.stackTypes, state->stack );
+        }
+    }
+    if ( method.endState ) {
+        method.stackTypes.resize( std::max( method.stackTypes.size(), method.endState->stack.size() ), ValueType::NONE );
+        JoinInto( method.stackTypes, method.endState->stack );
+    }
+
+    return changed;
+}
+
+std::string CTranslator::Slot( const MethodPlan&, const size_t depth ) const {
+    return std::format( "s{}", depth );
+}
+
+Storage CTranslator::SlotStorage( const MethodPlan& method, const size_t depth ) const {
+    return StorageOf( method.stackTypes[depth] );
+}
+
+Storage CTranslator::LocalStorage( const MethodPlan& method, const size_t local ) const {
+    return StorageOf( method.localTypes[local] );
+}
+
+Storage CTranslator::ResultStorage( const MethodPlan& method ) const {
+    return StorageOf( method.resultTypes.front() );
+}
+
+std::string CTranslator::Signature( const uint32_t index ) const {
+    const MethodPlan& method = methods[index];
+    std::string parameters;
+    for ( uint16_t i = 0; i < method.info->parameterCount; ++i ) {
+        parameters += std::format( "{}{} l{}", i ? ", " : "", CType( LocalStorage( method, i ) ), i );
+    }
+
+    return std::format( "static {} lumin_m{}( {} )",
+        method.results == 1 ? CType( ResultStorage( method ) ) : "void", index, parameters.empty() ? "void" : parameters );
+}
+
+std::string CTranslator::Label( const MethodPlan& method, const size_t target ) const {
+    return target >= method.code.size() ? "L_end" : std::format( "L{}", target );
+}
+
+// Frees the frame-local arrays before the method returns, none of them is
+// part of its results
+void CTranslator::EmitRelease( const MethodPlan& method, std::ostringstream& out ) const {
+    for ( const size_t site : method.localArraySites ) {
+        out << std::format( "    free( a{} );\n", site );
+    }
+}
+
+void CTranslator::EmitReturn( const MethodPlan& method, const FrameState& state, std::ostringstream& out ) const {
+    EmitRelease( method, out );
+    if ( state.stack.empty() ) {
+        out << "    return;\n";
+        return;
+    }
+
+    const size_t top = state.stack.size() - 1;
+    out << std::format( "    return {};\n", Convert( Slot( method, top ), SlotStorage( method, top ), ResultStorage( method ), state.stack[top] ) );
+}
+
+void CTranslator::EmitInstruction( const MethodPlan& method, const Instruction& instruction, const FrameState& state, std::ostringstream& out ) const {
+    const size_t depth = state.stack.size();
+    // Operand at depth, unboxed to its static type where that is known
+    const auto typed = [&]( const size_t at ) {
+        const ValueType type = state.stack[at];
+        return Convert( Slot( method, at ), SlotStorage( method, at ), StorageOf( type ), type );
+    };
+    const auto boxed = [&]( const size_t at ) {
+        return Convert( Slot( method, at ), SlotStorage( method, at ), Storage::BOXED, state.stack[at] );
+    };
+    const auto assign = [&]( const size_t at, const std::string& expression, const ValueType type ) {
+        out << std::format( "    {} = {};\n", Slot( method, at ), Convert( expression, StorageOf( type ), SlotStorage( method, at ), type ) );
+    };
+    const auto integer = [&]( const size_t at ) {
+        return state.stack[at] == ValueType::INT ? typed( at ) : std::format( "lm_as_int( {} )", boxed( at ) );
+    };
+    // Array operand of an access, the _NONNULL forms take it unchecked
+    const auto array = [&]( const size_t at, const char* opcode ) {
+        if ( IsArray( state.stack[at] ) ) {
+            return typed( at );
+        }
+        if ( IsNonNullAccess( instruction.opcode ) ) {
+            return boxed( at ) + ".as.a";
+        }
+        return std::format( "lm_as_array( {}, \"{}\" )", boxed( at ), opcode );
+    };
+
+    switch ( instruction.opcode ) {
+        case OpCode::ICONST: case OpCode::BIPUSH: case OpCode::SIPUSH:
+        case OpCode::ICONST_M1: case OpCode::ICONST_0: case OpCode::ICONST_1: case OpCode::ICONST_2:
+        case OpCode::ICONST_3: case OpCode::ICONST_4: case OpCode::ICONST_5: {
+            const int32_t value = instruction.IntConstant();
+            // INT32_MIN has no literal of type int in C
+            assign( depth, value == INT32_MIN ? "INT32_MIN" : std::to_string( value ), ValueType::INT );
+            break;
+        }
+        case OpCode::FCONST:
+            assign( depth, FloatLiteral( instruction.Load<float>( 0 ) ), ValueType::FLOAT );
+            break;
+        case OpCode::ILOAD: case OpCode::ILOAD_0: case OpCode::ILOAD_1: case OpCode::ILOAD_2: case OpCode::ILOAD_3: {
+            const uint32_t local = instruction.Local();
+            const ValueType type = state.locals[local];
+            assign( depth, Convert( std::format( "l{}", local ), LocalStorage( method, local ), StorageOf( type ), type ), type );
+            break;
+        }
+        case OpCode::ISTORE: case OpCode::ISTORE_0: case OpCode::ISTORE_1: case OpCode::ISTORE_2: case OpCode::ISTORE_3: {
+            const uint32_t local = instruction.Local();
+            out << std::format( "    l{} = {};\n", local,
+                Convert( Slot( method, depth - 1 ), SlotStorage( method, depth - 1 ), LocalStorage( method, local ), state.stack[depth - 1] ) );
+            break;
+        }
+        case OpCode::IADD: case OpCode::ISUB: case OpCode::IMUL: case OpCode::IDIV:
+        case OpCode::FADD: case OpCode::FSUB: case OpCode::FMUL: case OpCode::FDIV: {
+            // The interpreter pops a, then b, and computes a op b
+            const size_t a = depth - 1;
+            const size_t b = depth - 2;
+            const OpCode opcode = instruction.opcode;
+            const std::string op = opcode == OpCode::ISUB || opcode == OpCode::FSUB ? "-"
+                : opcode == OpCode::IMUL || opcode == OpCode::FMUL ? "*"
+                : opcode == OpCode::IDIV || opcode == OpCode::FDIV ? "/" : "+";
+            const ValueType result = ArithmeticType( state.stack[a], state.stack[b] );
+            if ( result == ValueType::INT ) {
+                assign( b, op == "/"
+                    ? std::format( "lm_idiv( {}, {} )", typed( a ), typed( b ) )
+                    : std::format( "(int32_t) ( (uint32_t) {} {} (uint32_t) {} )", typed( a ), op, typed( b ) ), result );
+            } else if ( result == ValueType::FLOAT ) {
+                assign( b, std::format( "(float) {} {} (float) {}", typed( a ), op, typed( b ) ), result );
+            } else {
+                assign( b, std::format( "lm_arith( '{}', {}, {} )", op, boxed( a ), boxed( b ) ), result );
+            }
+            break;
+        }
+        case OpCode::INEG: case OpCode::FNEG: {
+            const size_t a = depth - 1;
+            switch ( state.stack[a] ) {
+                case ValueType::INT:
+                    assign( a, std::format( "(int32_t) ( 0u - (uint32_t) {} )", typed( a ) ), ValueType::INT );
+                    break;
+                case ValueType::FLOAT:
+                    assign( a, std::format( "-{}", typed( a ) ), ValueType::FLOAT );
+                    break;
+                default:
+                    assign( a, std::format( "lm_neg( {} )", boxed( a ) ), ValueType::DYNAMIC );
+                    break;
+            }
+            break;
+        }
+        case OpCode::ICMP: case OpCode::FCMP: {
+            const size_t a = depth - 1;
+            const size_t b = depth - 2;
+            const ValueType operands = ArithmeticType( state.stack[a], state.stack[b] );
+            if ( operands == ValueType::INT || operands == ValueType::FLOAT ) {
+                const std::string x = operands == ValueType::INT ? typed( a ) : "(float) " + typed( a );
+                const std::string y = operands == ValueType::INT ? typed( b ) : "(float) " + typed( b );
+                assign( b, std::format( "( {} > {} ) - ( {} < {} )", x, y, x, y ), ValueType::INT );
+            } else {
+                assign( b, std::format( "lm_cmp( {}, {} )", boxed( a ), boxed( b ) ), ValueType::INT );
+            }
+            break;
+        }
+        case OpCode::POP:
+            break;
+        case OpCode::I2F:
+            assign( depth - 1, std::format( "(float) {}", integer( depth - 1 ) ), ValueType::FLOAT );
+            break;
+        case OpCode::ACONST_NULL:
+            assign( depth, "lm_null()", ValueType::NUL );
+            break;
+        case OpCode::ISNULL: {
+            // A tag test, unless the type already tells
+            const size_t a = depth - 1;
+            const ValueType type = state.stack[a];
+            assign( a, type == ValueType::NUL ? "1" : IsArray( type ) ? "0" : std::format( "lm_isnull( {} )", boxed( a ) ), ValueType::INT );
+            break;
+        }
+        case OpCode::ALLOC_ARRAY: case OpCode::ALLOC_LOCAL_ARRAY: {
+            const size_t a = depth - 1;
+            const int element = instruction.Load<uint8_t>( 0 );
+            if ( instruction.opcode == OpCode::ALLOC_LOCAL_ARRAY ) {
+                const std::string local = std::format( "a{}", instruction.offset );
+                out << std::format( "    {} = lm_alloc_local( {}, {}, {} );\n", local, local, element, integer( a ) );
+                assign( a, local, AllocatedType( instruction ) );
+            } else {
+                assign( a, std::format( "lm_alloc( {}, {} )", element, integer( a ) ), AllocatedType( instruction ) );
+            }
+            break;
+        }
+        case OpCode::LOAD_ARRAY: case OpCode::LOAD_ARRAY_NONNULL: {
+            const size_t a = depth - 2;
+            const std::string reference = array( a, "LOAD_ARRAY" );
+            const ValueType element = ElementType( state.stack[a] );
+            if ( element == ValueType::DYNAMIC ) {
+                assign( a, std::format( "lm_load( {}, {} )", reference, integer( depth - 1 ) ), element );
+            } else {
+                assign( a, std::format( "{}->as.{}[lm_index( {}, {} )]", reference, element == ValueType::INT ? "i" : "f",
+                    reference, integer( depth - 1 ) ), element );
+            }
+            break;
+        }
+        case OpCode::STORE_ARRAY: case OpCode::STORE_ARRAY_NONNULL: {
+            const size_t a = depth - 3;
+            const size_t value = depth - 1;
+            const std::string reference = array( a, "STORE_ARRAY" );
+            const ValueType element = ElementType( state.stack[a] );
+            if ( element != ValueType::DYNAMIC && element == state.stack[value] ) {
+                out << std::format( "    {}->as.{}[lm_index( {}, {} )] = {};\n", reference, element == ValueType::INT ? "i" : "f",
+                    reference, integer( depth - 2 ), typed( value ) );
+            } else {
+                out << std::format( "    lm_store( {}, {}, {} );\n", reference, integer( depth - 2 ), boxed( value ) );
+            }
+            break;
+        }
+        case OpCode::VADD: case OpCode::VSUB: case OpCode::VMUL: case OpCode::VDIV: {
+            const size_t destination = depth - 5;
+            const std::string op = instruction.opcode == OpCode::VSUB ? "-"
+                : instruction.opcode == OpCode::VMUL ? "*"
+                : instruction.opcode == OpCode::VDIV ? "/" : "+";
+            assign( destination, std::format( "lm_vector( '{}', {}, {}, {}, {}, {}, {} )", op, static_cast<int>( instruction.Load<uint8_t>( 0 ) ),
+                boxed( destination ), boxed( depth - 4 ), boxed( depth - 3 ), integer( depth - 2 ), integer( depth - 1 ) ), ValueType::INT );
+            break;
+        }
+        case OpCode::CALL:
+        case OpCode::TAILCALL:
+        case OpCode::INVOKE: {
+            const uint32_t target = CallTarget( method, instruction );
+            const MethodPlan& callee = methods[target];
+            const size_t first = depth - callee.info->parameterCount;
+
+            std::string arguments;
+            for ( size_t i = 0; i < callee.info->parameterCount; ++i ) {
+                arguments += std::format( "{}{}", i ? ", " : "",
+                    Convert( Slot( method, first + i ), SlotStorage( method, first + i ), LocalStorage( callee, i ), state.stack[first + i] ) );
+            }
+
+            const std::string call = std::format( "lumin_m{}( {} )", target, arguments );
+            if ( instruction.opcode == OpCode::TAILCALL ) {
+                // Left to the C compiler's sibling call optimization. The
+                // arguments never refer to the frame's own arrays.
+                EmitRelease( method, out );
+                if ( callee.results == 1 ) {
+                    out << std::format( "    return {};\n", Convert( call, ResultStorage( callee ), ResultStorage( method ), callee.resultTypes.front() ) );
+                } else {
+                    out << std::format( "    {};\n    return;\n", call );
+                }
+            } else if ( callee.results == 1 ) {
+                out << std::format( "    {} = {};\n", Slot( method, first ),
+                    Convert( call, ResultStorage( callee ), SlotStorage( method, first ), callee.resultTypes.front() ) );
+            } else {
+                out << std::format( "    {};\n", call );
+            }
+            break;
+        }
+        case OpCode::RETURN:
+            EmitReturn( method, state, out );
+            break;
+        case OpCode::SNAPSHOT:
+            break;
+        case OpCode::FOR_RANGE: case OpCode::LOOP_NEXT: {
+            const uint16_t counter = instruction.LoopCounter();
+            const uint16_t limit = instruction.LoopLimit();
+            const auto local = [&]( const uint16_t index, const ValueType type ) {
+                const std::string name = std::format( "l{}", index );
+                return type == ValueType::INT ? Convert( name, LocalStorage( method, index ), Storage::INT, type )
+                    : std::format( "lm_as_int( {} )", Convert( name, LocalStorage( method, index ), Storage::BOXED, type ) );
+            };
+            if ( instruction.opcode == OpCode::FOR_RANGE ) {
+                out << std::format( "    l{} = {};\n", limit,
+                    Convert( Slot( method, depth - 1 ), SlotStorage( method, depth - 1 ), LocalStorage( method, limit ), state.stack[depth - 1] ) );
+                out << std::format( "    if ( {} >= {} ) goto {};\n", local( counter, state.locals[counter] ),
+                    local( limit, state.stack[depth - 1] ), Label( method, instruction.LoopTarget() ) );
+            } else {
+                const std::string next = std::format( "(int32_t) ( (uint32_t) {} + 1u )", local( counter, state.locals[counter] ) );
+                out << std::format( "    l{} = {};\n", counter, Convert( next, Storage::INT, LocalStorage( method, counter ), ValueType::INT ) );
+                out << std::format( "    if ( {} < {} ) goto {};\n", local( counter, ValueType::INT ),
+                    local( limit, state.locals[limit] ), Label( method, instruction.LoopTarget() ) );
+            }
+            break;
+        }
+        case OpCode::TABLESWITCH: case OpCode::LOOKUPSWITCH: {
+            // Left to the C compiler to pick a jump table or a search
+            const size_t a = depth - 1;
+            out << "    switch ( " << integer( a ) << " ) {\n";
+            for ( uint32_t entry = 0; entry < instruction.SwitchCount(); ++entry ) {
+                out << std::format( "        case {}: goto {};\n", instruction.SwitchKey( entry ),
+                    Label( method, instruction.SwitchTarget( entry ) ) );
+            }
+            out << std::format( "        default: goto {};\n", Label( method, instruction.SwitchDefault() ) ) << "    }\n";
+            break;
+        }
+        default: {
+            const std::string label = Label( method, instruction.BranchTarget() );
+            if ( LongBranch( instruction.opcode ) == OpCode::GOTO ) {
+                out << std::format( "    goto {};\n", label );
+                break;
+            }
+
+            const std::string value = integer( depth - 1 );
+            const char* comparison = "";
+            switch ( LongBranch( instruction.opcode ) ) {
+                case OpCode::IFEQ: comparison = "=="; break;
+                case OpCode::IFNE: comparison = "!="; break;
+                case OpCode::IFLT: comparison = "<"; break;
+                case OpCode::IFGT: comparison = ">"; break;
+                case OpCode::IFLE: comparison = "<="; break;
+                default: comparison = ">="; break;
+            }
+            out << std::format( "    if ( {} {} 0 ) goto {};\n", value, comparison, label );
+            break;
+        }
+    }
+}
+
+void CTranslator::EmitMethod( const uint32_t index, std::ostringstream& out ) const {
+    const MethodPlan& method = methods[index];
+    out << "/* " << ( method.name.empty() ? "method " + std::to_string( index ) : method.name ) << " */\n";
+    out << Signature( index ) << " {\n";
+
+    for ( size_t local = method.info->parameterCount; local < method.localTypes.size(); ++local ) {
+        if ( method.localTypes[local] != ValueType::NONE ) {
+            const Storage storage = LocalStorage( method, local );
+            out << std::format( "    {} l{} = {};\n", CType( storage ), local,
+                storage == Storage::BOXED ? "lm_null()" : storage == Storage::INT ? "0" : storage == Storage::FLOAT ? "0.0f" : "NULL" );
+        }
+    }
+    for ( const size_t site : method.localArraySites ) {
+        out << std::format( "    lm_array* a{} = NULL;\n", site );
+    }
+    for ( size_t depth = 0; depth < method.stackTypes.size(); ++depth ) {
+        out << std::format( "    {} s{};\n", CType( SlotStorage( method, depth ) ), depth );
+    }
+
+    std::vector<bool> targets( method.code.size() + 1, false );
+    for ( size_t i = 0; i < method.instructions.size(); ++i ) {
+        if ( !method.states[i] ) {
+            continue;
+        }
+        const Instruction& instruction = method.instructions[i];
+        if ( IsBranch( instruction.opcode ) ) {
+            targets[std::min( instruction.BranchTarget(), method.code.size() )] = true;
+        } else if ( IsCountedLoop( instruction.opcode ) ) {
+            targets[std::min( instruction.LoopTarget(), method.code.size() )] = true;
+        } else if ( IsSwitch( instruction.opcode ) ) {
+            for ( uint32_t entry = 0; entry < instruction.SwitchCount(); ++entry ) {
+                targets[std::min( instruction.SwitchTarget( entry ), method.code.size() )] = true;
+            }
+            targets[std::min( instruction.SwitchDefault(), method.code.size() )] = true;
+        }
+    }
+
+    for ( size_t i = 0; i < method.instructions.size(); ++i ) {
+        const Instruction& instruction = method.instructions[i];
+        if ( targets[instruction.offset] ) {
+            out << std::format( "L{}:;\n", instruction.offset );
+        }
+        if ( method.states[i] ) {
+            EmitInstruction( method, instruction, *method.states[i], out );
+        }
+    }
+
+    if ( method.endState ) {
+        out << "L_end:;\n";
+        EmitReturn( method, *method.endState, out );
+    }
+    out << "}\n\n";
+}
+
+std::string CTranslator::Translate() {
+    const uint32_t entry = program.entryMethod;
+    if ( entry == LUMIN_NO_ENTRY_METHOD || entry >= methods.size() ) {
+        throw std::runtime_error( "Ahead-of-time compilation needs an entry method" );
+    }
+    if ( methods[entry].info->parameterCount != 0 ) {
+        throw std::runtime_error( "The entry method cannot take parameters" );
+    }
+
+    // Whole-program fixpoint: parameter types flow from call sites, result
+    // types from returns, until no summary changes
+    methods[entry].reached = true;
+    bool changed = true;
+    while ( changed ) {
+        changed = false;
+        for ( auto& method : methods ) {
+            if ( method.reached ) {
+                changed |= Analyze( method );
+            }
+        }
+    }
+
+    std::ostringstream out;
+    out << RUNTIME_PRELUDE;
+    for ( uint32_t i = 0; i < methods.size(); ++i ) {
+        if ( !methods[i].reached ) {
+            continue;
+        }
+        if ( methods[i].results.value_or( 0 ) > 1 ) {
+            throw std::runtime_error( std::format( "Method '{}' returns {} values, only one is supported",
+                methods[i].name, *methods[i].results ) );
+        }
+        out << Signature( i ) << ";\n";
+    }
+    out << "\n";
+
+    for ( uint32_t i = 0; i < methods.size(); ++i ) {
+        if ( methods[i].reached ) {
+            EmitMethod( i, out );
+        }
+    }
+
+    const MethodPlan& main = methods[entry];
+    out << "/* Runs the entry method, its results are what the interpreter leaves on the stack */\n";
+    out << "size_t lumin_run( lm_value* results, size_t capacity ) {\n";
+    if ( main.results == 1 ) {
+        out << std::format( "    lm_value result = {};\n", Convert( std::format( "lumin_m{}()", entry ),
+            ResultStorage( main ), Storage::BOXED, main.resultTypes.front() ) );
+        out << "    if ( capacity > 0 ) results[0] = result;\n    return 1;\n";
+    } else {
+        out << std::format( "    lumin_m{}();\n    (void) results;\n    (void) capacity;\n    return 0;\n", entry );
+    }
+    out << "}\n\n";
+
+    out << "#ifndef LUMIN_AOT_SHARED\n";
+    out << "int main( void ) {\n";
+    out << "    lm_value results[1];\n";
+    out << "    size_t count = lumin_run( results, 1 );\n";
+    out << "    for ( size_t i = 0; i < count; ++i ) lm_print( results[i] );\n";
+    out << "    return 0;\n";
+    out << "}\n";
+    out << "#endif\n";
+    return out.str();
+}
+
+std::string ShellQuote( const std::string& argument ) {
+    std::string quoted = "'";
+    for ( const char c : argument ) {
+        if ( c == '\'' ) {
+            quoted.append( "'\\''" );
+        } else {
+            quoted.push_back( c );
+        }
+    }
+    quoted.push_back( '\'' );
+    return quoted;
+}
+
+// An explicit compiler is one word, $CC may carry flags and is split on
+// whitespace like make splits it
+std::string CompilerCommand( const std::string& compiler ) {
+    if ( !compiler.empty() ) {
+        return ShellQuote( compiler );
+    }
+
+    const char* environmentCompiler = std::getenv( "CC" );
+    std::istringstream words( environmentCompiler ? environmentCompiler : "" );
+    std::string command;
+    for ( std::string word; words >> word; ) {
+        command.append( command.empty() ? "" : " " ).append( ShellQuote( word ) );
+    }
+    return command.empty() ? "cc" : command;
+}
+
+}
+
+std::string Lumin::Compiler::TranslateToC( const LuminFile& program ) {
+    return CTranslator( program ).Translate();
+}
+
+bool Lumin::Compiler::CompileNative( const LuminFile& program, const std::string& outputPath, const AotOptions& options ) {
+    const std::string sourcePath = outputPath + ".c";
+    {
+        std::ofstream source( sourcePath );
+        if ( !source ) {
+            LOG_ERROR( "Failed to open file for writing: " + sourcePath )
+            return false;
+        }
+        source << TranslateToC( program );
+        if ( !source ) {
+            LOG_ERROR( "Failed to write " + sourcePath )
+            return false;
+        }
+    }
+
+    // Appended piece by piece, chains of operator+ on temporaries trip
+    // GCC 12's -Wrestrict at -O3
+    std::string command = CompilerCommand( options.compiler );
+    for ( const auto& flag : options.compilerFlags ) {
+        command.append( " " ).append( ShellQuote( flag ) );
+    }
+    if ( options.sharedObject ) {
+        command.append( " -shared -fPIC -DLUMIN_AOT_SHARED" );
+    }
+    command.append( " -o " ).append( ShellQuote( outputPath ) ).append( " " ).append( ShellQuote( sourcePath ) );
+
+    LOG_DEBUG( "Running " + command )
+    const int status = std::system( command.c_str() );
+    if ( !options.keepSource ) {
+        std::error_code ignored;
+        std::filesystem::remove( sourcePath, ignored );
+    }
+
+    if ( status != 0 ) {
+        LOG_ERROR( std::format( "C compiler failed ({}): {}", status, command ) )
+        return false;
+    }
+    return true;
+}
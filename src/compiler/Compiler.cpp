@@ -0,0 +1,111 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <stdexcept>
+#include <Compiler.hpp>
+#include <ConstantPoolBuilder.hpp>
+#include <Lexer.hpp>
+#include <Parser.hpp>
+#include <ir/CodeLayout.hpp>
+#include <ir/Lowering.hpp>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler;
+
+LuminFile Lumin::Compiler::Compiler::Compile( const std::string_view source ) {
+    Lexer lexer( source );
+    Parser parser( source, lexer.Tokenize() );
+    const auto statements = parser.Parse();
+    if ( parser.HadError() ) {
+        throw std::runtime_error( "Syntax errors, see above" );
+    }
+
+    IR::Module module = IR::Lower( statements );
+    loweredNullChecks = IR::CountNullChecks( module );
+    IR::Optimize( module, options.optimizationLevel, options.loops, options.allocations );
+    emittedNullChecks = IR::CountNullChecks( module );
+
+    LuminFile program {};
+    program.magicNumber = LUMIN_MAGIC_NUMBER;
+    program.versionMajor = LUMIN_VERSION_MAJOR;
+    program.versionMinor = LUMIN_VERSION_MINOR;
+    program.entryMethod = module.entry == IR::NO_ID ? LUMIN_NO_ENTRY_METHOD : module.entry;
+
+    Utils::ConstantPoolBuilder constants;
+    std::vector<IR::EmittedMethod> bodies;
+    layout = {};
+    frames = {};
+    program.methods.reserve( module.functions.size() );
+    for ( uint32_t i = 0; i < module.functions.size(); ++i ) {
+        const IR::EmittedMethod& emitted = bodies.emplace_back( Emit( module, i ) );
+        const IR::Function& function = module.functions[i];
+
+        MethodInfo method {};
+        method.flags = function.flags;
+        method.nameIndex = constants.AddUtf8( function.name );
+        method.maxStack = emitted.maxStack;
+        method.maxLocals = emitted.maxLocals;
+        method.parameterCount = static_cast<uint16_t>( function.parameterCount );
+        method.codeLength = static_cast<uint32_t>( emitted.code.size() );
+        program.methods.push_back( method );
+        frames.locals += emitted.maxLocals;
+        frames.valueLocals += emitted.valueLocals;
+    }
+
+    // Method indices stay, only the bodies move. Without an entry method
+    // the code section runs from offset 0, so its order is kept.
+    std::vector<uint32_t> placement( module.functions.size() );
+    for ( uint32_t i = 0; i < placement.size(); ++i ) {
+        placement[i] = i;
+    }
+    if ( options.profile && options.profile->methods.size() == module.functions.size() && module.entry != IR::NO_ID ) {
+        placement = IR::ProfiledMethodOrder( *options.profile, module.functions.size() );
+    }
+    for ( const uint32_t i : placement ) {
+        program.methods[i].codeOffset = static_cast<uint32_t>( program.bytecode.size() );
+        program.bytecode.insert( program.bytecode.end(), bodies[i].code.begin(), bodies[i].code.end() );
+    }
+
+    // Dumped after emission, so split edges show up
+    if ( options.dumpIR ) {
+        irDump = IR::Dump( module );
+    }
+
+    program.constantPool = constants.Release();
+    return program;
+}
+
+IR::EmittedMethod Lumin::Compiler::Compiler::Emit( IR::Module& module, const uint32_t function ) {
+    IR::EmittedMethod emitted = IR::EmitBytecode( module, function, options.emit );
+    if ( !options.profile || function >= options.profile->methods.size() ) {
+        return emitted;
+    }
+
+    // A method that never ran has nothing to go by, it only moves to the end
+    const Utils::MethodProfile& profiled = options.profile->methods[function];
+    if ( profiled.calls == 0 ) {
+        return emitted;
+    }
+    if ( profiled.name != module.functions[function].name || profiled.codeHash != Utils::HashCode( emitted.code ) ) {
+        ++layout.stale;
+        return emitted;
+    }
+
+    const IR::BlockLayout blocks = IR::ProfiledBlockOrder( module.functions[function], emitted.branches,
+        profiled.branches, profiled.calls );
+    ++layout.methods;
+    layout.coldBlocks += blocks.coldBlocks;
+    return IR::EmitBytecode( module, function, options.emit, blocks.order );
+}
@@ -15,29 +15,79 @@
  limitations under the License.
  */
 
-#include <typeinfo>
-#include <Lexer.hpp>
-#include <Parser.hpp>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <AotCompiler.hpp>
+#include <Compiler.hpp>
 #include "Utils.hpp"
 
 std::string GetLoggerName() {
     return "luminc";
 }
 
+// Switch of an optimization -d and -f turn off and on, nullptr for unknown names
+static bool* OptimizationSwitch( Lumin::Compiler::CompilerOptions& options, const std::string_view name ) {
+    if ( name == "licm" ) {
+        return &options.loops.hoistInvariants;
+    }
+    if ( name == "induction-variables" ) {
+        return &options.loops.simplifyInductionVariables;
+    }
+    if ( name == "unroll" ) {
+        return &options.loops.unroll;
+    }
+    if ( name == "strength-reduction" ) {
+        return &options.loops.reduceStrength;
+    }
+    if ( name == "vectorize" ) {
+        return &options.loops.vectorize;
+    }
+    if ( name == "scalar-replacement" ) {
+        return &options.allocations.scalarReplace;
+    }
+    if ( name == "frame-allocation" ) {
+        return &options.allocations.allocateInFrame;
+    }
+    if ( name == "local-sharing" ) {
+        return &options.emit.shareLocals;
+    }
+    if ( name == "tail-calls" ) {
+        return &options.emit.tailCalls;
+    }
+    return nullptr;
+}
+
 int main( const int argc, char** argv ) {
     int opt;
     /*
      o/output - output file
-     d/disable - disable feature
+     d/disable - disable an optimization: licm, induction-variables, vectorize, unroll, strength-reduction,
+       scalar-replacement, frame-allocation, local-sharing or tail-calls
      h/help - help
      V/verbose - verbose
      v/version - version
      g/debug - debug
      w/warning - warning level
      n/nowarn - disable warnings
-     f/feature - enable feature
+     f/feature - enable an optimization, strength-reduction is off by default
+     a/aot - compile a .lmn program to a native executable through C
+     aot-shared - like aot, but build a shared object exporting lumin_run
+     cc - C compiler used by aot, otherwise $CC when set, otherwise cc
+     emit-c - keep the generated C source next to the output
+     O - optimization level, -O0 to -O2
+     dump-ir - print the optimized IR of each function
+     profile-use - lay out blocks and methods by a profile from lumin --profile-out
      */
-    constexpr auto options = "o:|output|:d:|disable:|h|help|V|verbose|v|version|g|debug|w:|warning|:n:|nowarn|:f:|feature|:";
+    constexpr auto options = "o:|output|:d:|disable|:h|help|V|verbose|v|version|g|debug|w:|warning|:n:|nowarn|:f:|feature|:a|aot||aot-shared||cc|:|emit-c|O:|dump-ir||profile-use|:";
+    bool aot = false;
+    bool verbose = false;
+    std::string outputPath;
+    Lumin::Compiler::AotOptions aotOptions;
+    Lumin::Compiler::CompilerOptions compilerOptions;
+    Lumin::Utils::ExecutionProfile profile;
     while ( (opt = lumin::utils::getopt( argc, argv, options ) ) != -1 ) {
         switch ( opt ) {
             case 'v':
@@ -56,15 +106,47 @@ int main( const int argc, char** argv ) {
                 break;
             case 'o':
                 LOG_INFO( "Output file: " + std::string( optarg ) )
+                outputPath = optarg;
+                break;
+            case 'a':
+                aot = true;
+                aotOptions.sharedObject = current_option == "aot-shared";
+                break;
+            case 'c':
+                aotOptions.compiler = optarg;
+                break;
+            case 'e':
+                aotOptions.keepSource = true;
                 break;
             case 'd':
-                LOG_INFO("Feature disabled")
+                if ( current_option == "dump-ir" ) {
+                    compilerOptions.dumpIR = true;
+                } else if ( bool* enabled = OptimizationSwitch( compilerOptions, optarg ) ) {
+                    *enabled = false;
+                } else {
+                    LOG_ERROR( "Unknown optimization: " + std::string( optarg ) )
+                    return 1;
+                }
+                break;
+            case 'O':
+                if ( std::string_view( optarg ) != "0" && std::string_view( optarg ) != "1" && std::string_view( optarg ) != "2" ) {
+                    LOG_ERROR( "Unknown optimization level: " + std::string( optarg ) )
+                    return 1;
+                }
+                compilerOptions.optimizationLevel = optarg[0] - '0';
+                break;
+            case 'p':
+                if ( !Lumin::Utils::ReadProfileFile( optarg, profile ) ) {
+                    return 1;
+                }
+                compilerOptions.profile = &profile;
                 break;
             case 'h':
                 LOG_INFO("Help information displayed here")
                 break;
             case 'V':
                 LOG_INFO("Verbose mode enabled")
+                verbose = true;
                 break;
             case 'g':
                 LOG_INFO("Debug mode enabled")
@@ -76,40 +158,96 @@ int main( const int argc, char** argv ) {
                 LOG_INFO("Warnings disabled: " + std::string(optarg))
                 break;
             case 'f':
-                LOG_INFO("Feature enabled")
+                if ( bool* enabled = OptimizationSwitch( compilerOptions, optarg ) ) {
+                    *enabled = true;
+                } else {
+                    LOG_ERROR( "Unknown optimization: " + std::string( optarg ) )
+                    return 1;
+                }
                 break;
             default:
                 break;
         }
     }
 
-    for (int i = optind; i < argc; i++) {
-        LOG_INFO("Non-option argument: " + std::string(argv[i]))
+    if ( aot ) {
+        if ( optind >= argc ) {
+            LOG_ERROR( "No input program for --aot" )
+            return 1;
+        }
+
+        const std::string inputPath = argv[optind];
+        const LuminFile program = Lumin::Utils::ReadLuminFile( inputPath );
+        if ( program.magicNumber != LUMIN_MAGIC_NUMBER ) {
+            LOG_ERROR( "Not a Lumin program: " + inputPath )
+            return 1;
+        }
+        if ( outputPath.empty() ) {
+            outputPath = std::filesystem::path( inputPath ).replace_extension( aotOptions.sharedObject ? ".so" : "" ).string();
+        }
+
+        try {
+            return Lumin::Compiler::CompileNative( program, outputPath, aotOptions ) ? 0 : 1;
+        } catch ( const std::exception& exception ) {
+            LOG_ERROR( std::format( "Ahead-of-time compilation failed: {}", exception.what() ) )
+            return 1;
+        }
     }
 
-    std::stringstream ss;
-    ss << "private inline fun mul(a: int, b: int) {";
-    ss << "     return a * b;";
-    ss << "}";
-    ss << "";
-    ss << "fun main() {";
-    ss << "     var x = 10 + 10;";
-    ss << "     mul(10, 10);";
-    ss << "}";
-
-    Lexer lexer(ss.view());
-    std::cout << "Tokenizing" << std::endl;
-    Parser parser(lexer.Tokenize());
-    std::cout << "Parsing" << std::endl;
-    auto statements = parser.Parse();
-    std::cout << "Printing statements" << std::endl;
-    int i = 0;
-    for ( const auto& statement : statements ) {
-        std::cout << i << ": " << typeid(*statement).name() << "\n";
-        i++;
+    if ( optind >= argc ) {
+        LOG_ERROR( "No input files" )
+        return 1;
+    }
+    if ( !outputPath.empty() && argc - optind > 1 ) {
+        LOG_ERROR( "-o needs a single input file" )
+        return 1;
     }
 
+    for ( int i = optind; i < argc; ++i ) {
+        const std::string inputPath = argv[i];
+        std::ifstream input( inputPath, std::ios::binary );
+        if ( !input ) {
+            LOG_ERROR( "Failed to open " + inputPath )
+            return 1;
+        }
+        std::stringstream source;
+        source << input.rdbuf();
+
+        Lumin::Compiler::Compiler compiler( compilerOptions );
+        LuminFile program;
+        try {
+            program = compiler.Compile( source.view() );
+        } catch ( const std::exception& exception ) {
+            LOG_ERROR( std::format( "{}: {}", inputPath, exception.what() ) )
+            return 1;
+        }
 
+        if ( compilerOptions.dumpIR ) {
+            std::cout << compiler.IRDump();
+        }
+        if ( verbose ) {
+            const auto& lowered = compiler.LoweredNullChecks();
+            const auto& emitted = compiler.EmittedNullChecks();
+            LOG_INFO( std::format( "{}: {} of {} array accesses without a null check, {} of {} null tests folded",
+                inputPath, emitted.unchecked, emitted.accesses, lowered.tests - std::min( lowered.tests, emitted.tests ), lowered.tests ) )
+            const auto& frames = compiler.Frames();
+            LOG_INFO( std::format( "{}: {} locals in all frames, {} with one for every stored value",
+                inputPath, frames.locals, frames.valueLocals ) )
+            if ( compilerOptions.profile ) {
+                const auto& layout = compiler.Layout();
+                LOG_INFO( std::format( "{}: {} methods laid out by the profile, {} cold blocks moved last, {} methods changed since profiling",
+                    inputPath, layout.methods, layout.coldBlocks, layout.stale ) )
+            }
+        }
+
+        const std::string programPath = outputPath.empty()
+            ? std::filesystem::path( inputPath ).replace_extension( ".lmn" ).string()
+            : outputPath;
+        if ( !Lumin::Utils::WriteLuminFile( programPath, program ) ) {
+            LOG_ERROR( "Failed to write " + programPath )
+            return 1;
+        }
+    }
 
     return 0;
-}
\ No newline at end of file
+}
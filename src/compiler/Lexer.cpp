@@ -14,26 +14,141 @@
  limitations under the License.
  */
 
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <format>
 #include <Lexer.hpp>
 #include <stdexcept>
-#include <unordered_map>
 
 using namespace Lumin::Compiler;
 
-Lexer::Lexer( const std::string_view source ) : source( source ) {}
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr std::array KEYWORDS = {
+    Keyword { "constexpr", TokenType::MODIFIER_CONSTEXPR },
+    Keyword { "inline", TokenType::MODIFIER_INLINE },
+    Keyword { "noinline", TokenType::MODIFIER_NOINLINE },
+    Keyword { "private", TokenType::MODIFIER_PRIVATE },
+    Keyword { "fun", TokenType::KEYWORD_FUN },
+    Keyword { "native", TokenType::KEYWORD_NATIVE },
+    Keyword { "async", TokenType::KEYWORD_ASYNC },
+    Keyword { "var", TokenType::KEYWORD_VAR },
+    Keyword { "val", TokenType::KEYWORD_VAL },
+    Keyword { "if", TokenType::KEYWORD_IF },
+    Keyword { "then", TokenType::KEYWORD_THEN },
+    Keyword { "else", TokenType::KEYWORD_ELSE },
+    Keyword { "for", TokenType::KEYWORD_FOR },
+    Keyword { "in", TokenType::KEYWORD_IN },
+    Keyword { "while", TokenType::KEYWORD_WHILE },
+    Keyword { "return", TokenType::KEYWORD_RETURN },
+    Keyword { "try", TokenType::KEYWORD_TRY },
+    Keyword { "catch", TokenType::KEYWORD_CATCH },
+    Keyword { "int", TokenType::KEYWORD_INT },
+    Keyword { "double", TokenType::KEYWORD_DOUBLE },
+    Keyword { "float", TokenType::KEYWORD_FLOAT },
+    Keyword { "long", TokenType::KEYWORD_LONG },
+    Keyword { "bool", TokenType::KEYWORD_BOOL },
+    Keyword { "void", TokenType::KEYWORD_VOID },
+    Keyword { "char", TokenType::KEYWORD_CHAR },
+    Keyword { "string", TokenType::KEYWORD_STRING },
+    Keyword { "class", TokenType::KEYWORD_CLASS },
+    Keyword { "interface", TokenType::KEYWORD_INTERFACE },
+    Keyword { "enum", TokenType::KEYWORD_ENUM },
+    Keyword { "extends", TokenType::KEYWORD_EXTENDS },
+    Keyword { "implements", TokenType::KEYWORD_IMPLEMENTS },
+    Keyword { "typealias", TokenType::KEYWORD_TYPEALIAS },
+    Keyword { "import", TokenType::KEYWORD_IMPORT },
+    Keyword { "namespace", TokenType::KEYWORD_NAMESPACE },
+    Keyword { "this", TokenType::KEYWORD_THIS },
+    Keyword { "is", TokenType::KEYWORD_IS },
+    Keyword { "as", TokenType::KEYWORD_AS },
+    Keyword { "match", TokenType::KEYWORD_MATCH },
+    Keyword { "break", TokenType::KEYWORD_BREAK },
+    Keyword { "continue", TokenType::KEYWORD_CONTINUE },
+    Keyword { "throw", TokenType::KEYWORD_THROW },
+    Keyword { "true", TokenType::LITERAL_BOOL },
+    Keyword { "false", TokenType::LITERAL_BOOL },
+    Keyword { "null", TokenType::LITERAL_NULL }
+};
+
+constexpr size_t SHORTEST_KEYWORD = std::ranges::min( KEYWORDS, {}, []( const Keyword& keyword ) { return keyword.text.size(); } ).text.size();
+constexpr size_t LONGEST_KEYWORD = std::ranges::max( KEYWORDS, {}, []( const Keyword& keyword ) { return keyword.text.size(); } ).text.size();
+constexpr uint32_t KEYWORD_SLOTS = 256;
+constexpr uint8_t NO_KEYWORD = UINT8_MAX;
+static_assert( SHORTEST_KEYWORD >= 2 && KEYWORDS.size() < NO_KEYWORD );
+
+// Multiplicative hash of the length and the first two and the last
+// character, which tell the keywords apart, into a slot of the table
+constexpr uint32_t KeywordHash( const std::string_view text, const uint32_t seed ) {
+    const uint32_t key = static_cast<uint8_t>( text[0] ) | static_cast<uint32_t>( static_cast<uint8_t>( text[1] ) ) << 8
+        | static_cast<uint32_t>( static_cast<uint8_t>( text.back() ) ) << 16 | static_cast<uint32_t>( text.size() ) << 24;
+    return key * seed >> 24;
+}
 
-std::vector<Token> Lexer::Tokenize() {
-    std::vector<Token> tokens;
+// The first seed the keywords hash to different slots with, found while
+// compiling. Small seeds leave the top byte to the length, the search starts
+// at the golden ratio instead.
+constexpr uint32_t KEYWORD_SEED = [] {
+    for ( uint32_t seed = 0x9E3779B1; seed < 0x9E3779B1 + 20'000; seed += 2 ) {
+        std::array<bool, KEYWORD_SLOTS> used {};
+        bool collides = false;
+        for ( const Keyword& keyword : KEYWORDS ) {
+            const uint32_t slot = KeywordHash( keyword.text, seed );
+            collides = collides || used[slot];
+            used[slot] = true;
+        }
+        if ( !collides ) {
+            return seed;
+        }
+    }
+    throw std::logic_error( "No seed hashes the keywords without collisions" );
+}();
+
+constexpr std::array<uint8_t, KEYWORD_SLOTS> KEYWORD_TABLE = [] {
+    std::array<uint8_t, KEYWORD_SLOTS> table {};
+    table.fill( NO_KEYWORD );
+    for ( size_t i = 0; i < KEYWORDS.size(); ++i ) {
+        table[KeywordHash( KEYWORDS[i].text, KEYWORD_SEED )] = static_cast<uint8_t>( i );
+    }
+    return table;
+}();
 
-    while ( !IsAtEnd() ) {
+// One hash and one comparison, identifiers that are no keyword mostly fail on the empty slot
+TokenType IdentifierType( const std::string_view text ) {
+    if ( text.size() < SHORTEST_KEYWORD || text.size() > LONGEST_KEYWORD ) {
+        return TokenType::LITERAL_IDENTIFIER;
+    }
+    const uint8_t index = KEYWORD_TABLE[KeywordHash( text, KEYWORD_SEED )];
+    return index != NO_KEYWORD && KEYWORDS[index].text == text ? KEYWORDS[index].type : TokenType::LITERAL_IDENTIFIER;
+}
+
+}
+
+Lexer::Lexer( const std::string_view source ) : source( source ) {
+    if ( source.size() > UINT32_MAX ) {
+        throw std::runtime_error( std::format( "Source of {} bytes is too large, at most 4 GiB are supported", source.size() ) );
+    }
+}
+
+TokenStream Lexer::Tokenize() {
+    lexed = {};
+
+    // Whitespace and comments are skipped here, so a file may end in them
+    // and lexemes never start with them
+    while ( SkipWhitespace(), !IsAtEnd() ) {
         start = current;
-        tokens.push_back( ScanToken() );
+        lexed.tokens.push_back( ScanToken() );
     }
 
-    tokens.push_back( { TokenType::SPECIAL_END, "" } );
+    lexed.tokens.push_back( { TokenType::SPECIAL_END, static_cast<uint32_t>( source.size() ), 0 } );
 
-    return tokens;
+    return std::move( lexed );
 }
 
 Token Lexer::ScanToken() {
@@ -48,31 +163,14 @@ Token Lexer::ScanToken() {
             if ( Match( '-' ) ) return MakeToken( TokenType::OPERATOR_DECREMENT );
             return MakeToken( TokenType::OPERATOR_MINUS );
         case '*': return MakeToken( Match( '=' ) ? TokenType::OPERATOR_MULTIPLY_EQ : TokenType::OPERATOR_MULTIPLY );
-        case '/':
-            if ( Match( '/' ) ) {
-                while ( !IsAtEnd() && Peek() != '\n' ) Advance();
-                return ScanToken();
-            }
-            if ( Match( '*' ) ) {
-                while ( !IsAtEnd() && !( Peek() == '*' && PeekNext() == '/' ) ) {
-                    Advance();
-                }
-
-                if ( IsAtEnd() ) {
-                    throw std::runtime_error( "Unterminated multi-line comment" );
-                }
-
-                Advance();
-                Advance();
-
-                return ScanToken();
-            }
-            return MakeToken(Match('=') ? TokenType::OPERATOR_DIVIDE_EQ : TokenType::OPERATOR_DIVIDE);
+        case '/': return MakeToken(Match('=') ? TokenType::OPERATOR_DIVIDE_EQ : TokenType::OPERATOR_DIVIDE);
         case '%': return MakeToken( Match( '=' ) ? TokenType::OPERATOR_MODULO_EQ : TokenType::OPERATOR_MODULO );
         case '(': return MakeToken( TokenType::PUNCTUATION_LPAREN );
         case ')': return MakeToken( TokenType::PUNCTUATION_RPAREN );
         case '{': return MakeToken( TokenType::PUNCTUATION_LBRACE );
         case '}': return MakeToken( TokenType::PUNCTUATION_RBRACE );
+        case '[': return MakeToken( TokenType::PUNCTUATION_LBRACKET );
+        case ']': return MakeToken( TokenType::PUNCTUATION_RBRACKET );
         case ':':
                 return MakeToken( Match( ':' ) ? TokenType::OPERATOR_ACCESS : TokenType::PUNCTUATION_COLON );
         case ';': return MakeToken( TokenType::PUNCTUATION_SEMICOLON );
@@ -102,13 +200,11 @@ Token Lexer::ScanToken() {
             return MakeToken( TokenType::OPERATOR_BITWISE_INC_OR );
         case '^': return MakeToken( TokenType::OPERATOR_BITWISE_EXC_OR );
         case '~': return MakeToken( TokenType::OPERATOR_BITWISE_NEGATE );
+        case '?':
+            return MakeToken( Match( ':' ) ? TokenType::OPERATOR_ELSENULL : TokenType::OPERATOR_NULLABILITY );
         case '$': return MakeToken( TokenType::PUNCTUATION_DOLLAR );
         case '_': return MakeToken( TokenType::PUNCTUATION_UNDERSCORE );
-        case ' ':
-        case '\r':
-        case '\t':
-        case '\n':
-            return ScanToken();
+        case '\'': return CharacterToken();
         default:
             if ( std::isalpha( c ) ) return IdentifierToken();
         if ( std::isdigit( c ) ) return NumberToken();
@@ -116,6 +212,42 @@ Token Lexer::ScanToken() {
     }
 }
 
+void Lexer::SkipWhitespace() {
+    while ( !IsAtEnd() ) {
+        switch ( Peek() ) {
+            case ' ':
+            case '\r':
+            case '\t':
+            case '\n':
+                Advance();
+                break;
+            case '/':
+                if ( PeekNext() == '/' ) {
+                    while ( !IsAtEnd() && Peek() != '\n' ) Advance();
+                    break;
+                }
+                if ( PeekNext() == '*' ) {
+                    Advance();
+                    Advance();
+                    while ( !IsAtEnd() && !( Peek() == '*' && PeekNext() == '/' ) ) {
+                        Advance();
+                    }
+
+                    if ( IsAtEnd() ) {
+                        throw std::runtime_error( "Unterminated multi-line comment" );
+                    }
+
+                    Advance();
+                    Advance();
+                    break;
+                }
+                return;
+            default:
+                return;
+        }
+    }
+}
+
 bool Lexer::Match( const char expected ) {
     if ( IsAtEnd() || source[current] != expected ) return false;
     current++;
@@ -123,9 +255,7 @@ bool Lexer::Match( const char expected ) {
 }
 
 Token Lexer::MakeToken( const TokenType type ) const {
-    const auto lexeme = std::string( source.substr( start, current - start ) );
-    Token token = { type, lexeme };
-    return token;
+    return { type, static_cast<uint32_t>( start ), static_cast<uint32_t>( current - start ) };
 }
 
 Token Lexer::IdentifierToken() {
@@ -133,54 +263,7 @@ Token Lexer::IdentifierToken() {
         Advance();
     }
 
-    const auto text = source.substr(start, current - start);
-    static const std::unordered_map<std::string_view, TokenType> keywords = {
-        { "inline", TokenType::MODIFIER_INLINE },
-        { "noinline", TokenType::MODIFIER_NOINLINE },
-        { "private", TokenType::MODIFIER_PRIVATE },
-        { "fun", TokenType::KEYWORD_FUN },
-        { "native", TokenType::KEYWORD_NATIVE },
-        { "async", TokenType::KEYWORD_ASYNC },
-        { "var", TokenType::KEYWORD_VAR },
-        { "val", TokenType::KEYWORD_VAL },
-        { "if", TokenType::KEYWORD_IF },
-        { "then", TokenType::KEYWORD_THEN },
-        { "else", TokenType::KEYWORD_ELSE },
-        { "for", TokenType::KEYWORD_FOR },
-        { "in", TokenType::KEYWORD_IN },
-        { "return", TokenType::KEYWORD_RETURN },
-        { "try", TokenType::KEYWORD_TRY },
-        { "catch", TokenType::KEYWORD_CATCH },
-        { "int", TokenType::KEYWORD_INT },
-        { "double", TokenType::KEYWORD_DOUBLE },
-        { "float", TokenType::KEYWORD_FLOAT },
-        { "long", TokenType::KEYWORD_LONG },
-        { "bool", TokenType::KEYWORD_BOOL },
-        { "void", TokenType::KEYWORD_VOID },
-        { "char", TokenType::KEYWORD_CHAR },
-        { "string", TokenType::KEYWORD_STRING },
-        { "class", TokenType::KEYWORD_CLASS },
-        { "interface", TokenType::KEYWORD_INTERFACE },
-        { "enum", TokenType::KEYWORD_ENUM },
-        { "extends", TokenType::KEYWORD_EXTENDS },
-        { "implements", TokenType::KEYWORD_IMPLEMENTS },
-        { "typealias", TokenType::KEYWORD_TYPEALIAS },
-        { "import", TokenType::KEYWORD_IMPORT },
-        { "namespace", TokenType::KEYWORD_NAMESPACE },
-        { "this", TokenType::KEYWORD_THIS },
-        { "is", TokenType::KEYWORD_IS },
-        { "as", TokenType::KEYWORD_AS },
-        { "match", TokenType::KEYWORD_MATCH },
-        { "break", TokenType::KEYWORD_BREAK },
-        { "continue", TokenType::KEYWORD_CONTINUE },
-        { "throw", TokenType::KEYWORD_THROW },
-        { "true", TokenType::LITERAL_BOOL },
-        { "false", TokenType::LITERAL_BOOL }
-    };
-
-    const auto it = keywords.find( Trim( text ) );
-
-    return { it != keywords.end() ? it->second : TokenType::LITERAL_IDENTIFIER, std::string( text ) };
+    return MakeToken( IdentifierType( source.substr( start, current - start ) ) );
 }
 
 Token Lexer::StringToken() {
@@ -235,7 +318,7 @@ Token Lexer::NumberToken() {
     }
 
     // handle decimal
-    if ( !IsAtEnd() && Peek() == '.' && std::isdigit( Peek() ) ) {
+    if ( !IsAtEnd() && Peek() == '.' && std::isdigit( PeekNext() ) ) {
         isFloat = true;
         Advance(); // consume '.'
 
@@ -263,27 +346,41 @@ Token Lexer::NumberToken() {
     }
 
     // type suffixes
-    if (!IsAtEnd()) {
-        const char c = Peek();
-
-        if ( c == 'f' || c == 'F' ) {
-            Advance();
-            return MakeToken( TokenType::LITERAL_FLOAT );
-        }
-
-        if ( c == 'd' || c == 'D' ) {
-            Advance();
-            return MakeToken( TokenType::LITERAL_DOUBLE );
-        }
-
-        if ( c == 'l' || c == 'L' ) {
-            Advance();
-            return MakeToken( TokenType::LITERAL_LONG );
+    const size_t digitsEnd = current;
+    TokenType type = isFloat ? TokenType::LITERAL_FLOAT : TokenType::LITERAL_INT;
+    if ( !IsAtEnd() ) {
+        switch ( Peek() ) {
+            case 'f': case 'F': type = TokenType::LITERAL_FLOAT; Advance(); break;
+            case 'd': case 'D': type = TokenType::LITERAL_DOUBLE; Advance(); break;
+            case 'l': case 'L': type = TokenType::LITERAL_LONG; Advance(); break;
+            default: break;
         }
+    }
 
+    NumberValue& number = lexed.numbers.emplace_back();
+    number.token = static_cast<uint32_t>( lexed.tokens.size() );
+    const char* first = source.data() + start;
+    const char* last = source.data() + digitsEnd;
+    std::from_chars_result result {};
+    if ( type == TokenType::LITERAL_FLOAT ) {
+        // Rounded to float once, not to double first
+        float value = 0.0f;
+        result = std::from_chars( first, last, value );
+        number.real = value;
+    } else if ( type == TokenType::LITERAL_DOUBLE ) {
+        result = std::from_chars( first, last, number.real );
+    } else {
+        result = std::from_chars( first, last, number.integer );
     }
 
-    return MakeToken( isFloat ? TokenType::LITERAL_FLOAT : TokenType::LITERAL_INT );
+    const auto lexeme = source.substr( start, current - start );
+    if ( result.ec == std::errc::result_out_of_range ) {
+        throw std::runtime_error( std::format( "Number literal {} is out of range", lexeme ) );
+    }
+    if ( result.ec != std::errc {} || result.ptr != last ) {
+        throw std::runtime_error( std::format( "Invalid number literal {}", lexeme ) );
+    }
+    return MakeToken( type );
 }
 
 char Lexer::Peek() const {
@@ -303,11 +400,3 @@ char Lexer::Advance() {
 bool Lexer::IsAtEnd() const {
     return current >= source.length();
 }
-
-std::string_view Lexer::Trim(const std::string_view &source) {
-    const auto start = source.find_first_not_of(" \t\n\r");
-    const auto end = source.find_last_not_of(" \t\n\r");
-    return ( start == std::string_view::npos || end == std::string_view::npos )
-        ? std::string_view{}
-    : source.substr( start, end - start + 1 );
-}
\ No newline at end of file
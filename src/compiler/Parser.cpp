@@ -15,14 +15,37 @@
  */
 
 #include <algorithm>
+#include <format>
 #include <iostream>
+#include <unordered_set>
 #include <Parser.hpp>
 #include <Logging.hpp>
 
 using namespace Lumin::Compiler;
 
-Parser::Parser( std::vector<Token> tokens) :
-    tokens( std::move( tokens ) ),
+namespace {
+
+// Code of a character literal, the lexeme keeps its quotes and escape
+int32_t CharacterValue( const std::string_view lexeme ) {
+    if ( lexeme[1] != '\\' ) {
+        return static_cast<unsigned char>( lexeme[1] );
+    }
+    switch ( lexeme[2] ) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return '\0';
+        case '\\': case '\'': case '"': return lexeme[2];
+        default: throw std::runtime_error( std::format( "Unknown escape sequence in character literal {}", lexeme ) );
+    }
+}
+
+}
+
+Parser::Parser( const std::string_view source, TokenStream lexed ) :
+    source( source ),
+    tokens( std::move( lexed.tokens ) ),
+    numbers( std::move( lexed.numbers ) ),
     current( 0 ) {}
 
 std::vector<std::unique_ptr<Statement>> Parser::Parse() {
@@ -42,28 +65,33 @@ std::vector<std::unique_ptr<Statement>> Parser::Parse() {
 std::unique_ptr<Statement> Parser::ParseDeclaration() {
     try {
         const AccessModifier accessModifier = ParseAccessModifier();
+        const bool isConstexpr = Match( { TokenType::MODIFIER_CONSTEXPR } );
         const InlineSpecifier inlineSpec = ParseInlineSpecifier();
 
         if ( Match( { TokenType::KEYWORD_FUN } ) ) {
-            return ParseFunctionDeclaration( accessModifier, inlineSpec );
+            return ParseFunctionDeclaration( accessModifier, inlineSpec, isConstexpr );
         }
 
         if ( Match( { TokenType::KEYWORD_VAR } ) ) {
-            return ParseVariableDeclaration( accessModifier );
+            return ParseVariableDeclaration( accessModifier, isConstexpr );
         }
 
         if( Match( { TokenType::KEYWORD_VAL } ) ) {
-            return ParseVariableDeclaration( accessModifier ); // todo: make this pass a mutability parameter?
+            return ParseVariableDeclaration( accessModifier, isConstexpr ); // todo: make this pass a mutability parameter?
         }
 
         if ( accessModifier != AccessModifier::NONE ) {
             throw std::runtime_error( "Expected declaration after access modifier" );
         }
+        if ( isConstexpr ) {
+            throw std::runtime_error( "Expected declaration after 'constexpr'" );
+        }
 
         return ParseStatement();
 
     } catch ( const std::exception& e ) {
         std::cerr << "ParseDecl error: " << e.what() << " @ " << current << std::endl;
+        hadError = true;
 
         Synchronize();
         return nullptr;
@@ -73,11 +101,98 @@ std::unique_ptr<Statement> Parser::ParseDeclaration() {
 }
 
 std::unique_ptr<Statement> Parser::ParseStatement() {
-    //if ( Match( { TokenType::KEYWORD_IF } ) ) return parseIfStatement();
+    if ( Match( { TokenType::KEYWORD_IF } ) ) return ParseIfStatement();
+    if ( Match( { TokenType::KEYWORD_WHILE } ) ) return ParseWhileStatement();
+    if ( Match( { TokenType::KEYWORD_FOR } ) ) return ParseForStatement();
+    if ( Match( { TokenType::KEYWORD_MATCH } ) ) return ParseMatchStatement();
     if ( Match( { TokenType::KEYWORD_RETURN} ) ) return ParseReturnStatement();
+    if ( Match( { TokenType::PUNCTUATION_LBRACE } ) ) return std::make_unique<BlockStatement>( ParseBlock() );
     return ParseExpressionStatement();
 }
 
+std::unique_ptr<Statement> Parser::ParseIfStatement() {
+    Consume( TokenType::PUNCTUATION_LPAREN, "Expect '(' after 'if'" );
+    auto condition = ParseExpression();
+    Consume( TokenType::PUNCTUATION_RPAREN, "Expect ')' after if condition" );
+
+    auto thenBranch = ParseStatement();
+    std::unique_ptr<Statement> elseBranch;
+    if ( Match( { TokenType::KEYWORD_ELSE } ) ) {
+        elseBranch = ParseStatement();
+    }
+
+    return std::make_unique<IfStatement>( std::move( condition ), std::move( thenBranch ), std::move( elseBranch ) );
+}
+
+std::unique_ptr<Statement> Parser::ParseWhileStatement() {
+    Consume( TokenType::PUNCTUATION_LPAREN, "Expect '(' after 'while'" );
+    auto condition = ParseExpression();
+    Consume( TokenType::PUNCTUATION_RPAREN, "Expect ')' after while condition" );
+
+    return std::make_unique<WhileStatement>( std::move( condition ), ParseStatement() );
+}
+
+std::unique_ptr<Statement> Parser::ParseForStatement() {
+    std::string variable( Lexeme( Consume( TokenType::LITERAL_IDENTIFIER, "Expect loop variable after 'for'" ) ) );
+    Consume( TokenType::KEYWORD_IN, "Expect 'in' after loop variable" );
+    auto begin = ParseExpression();
+    Consume( TokenType::OPERATOR_RANGE, "Expect '..' between range bounds" );
+    auto end = ParseExpression();
+
+    return std::make_unique<ForStatement>( std::move( variable ), std::move( begin ), std::move( end ), ParseStatement() );
+}
+
+std::unique_ptr<Statement> Parser::ParseMatchStatement() {
+    Consume( TokenType::PUNCTUATION_LPAREN, "Expect '(' after 'match'" );
+    auto subject = ParseExpression();
+    Consume( TokenType::PUNCTUATION_RPAREN, "Expect ')' after match subject" );
+    Consume( TokenType::PUNCTUATION_LBRACE, "Expect '{' before match arms" );
+
+    std::vector<MatchArm> arms;
+    std::unordered_set<int32_t> keys;
+    bool hasDefault = false;
+    while ( !Check( TokenType::PUNCTUATION_RBRACE ) && !IsAtEnd() ) {
+        MatchArm arm;
+        if ( Match( { TokenType::PUNCTUATION_UNDERSCORE } ) ) {
+            if ( hasDefault ) {
+                throw std::runtime_error( "Match has more than one '_' arm" );
+            }
+            hasDefault = true;
+        } else {
+            do {
+                const int32_t key = ParseMatchKey();
+                if ( !keys.insert( key ).second ) {
+                    throw std::runtime_error( std::format( "Duplicate match key {}", key ) );
+                }
+                arm.keys.push_back( key );
+            } while ( Match( { TokenType::PUNCTUATION_COMMA } ) );
+        }
+
+        Consume( TokenType::OPERATOR_ARROW, "Expect '->' after match keys" );
+        arm.body = ParseStatement();
+        arms.push_back( std::move( arm ) );
+    }
+
+    Consume( TokenType::PUNCTUATION_RBRACE, "Expect '}' after match arms" );
+    return std::make_unique<MatchStatement>( std::move( subject ), std::move( arms ) );
+}
+
+// An int or character literal, ints may be negated
+int32_t Parser::ParseMatchKey() {
+    if ( Match( { TokenType::LITERAL_CHAR } ) ) {
+        return CharacterValue( Lexeme( Previous() ) );
+    }
+
+    const bool negative = Match( { TokenType::OPERATOR_MINUS } );
+    const Token key = Consume( TokenType::LITERAL_INT, "Expect an int or character literal as match key" );
+    const int64_t literal = Number( current - 1 ).integer;
+    const int64_t value = negative ? -literal : literal;
+    if ( value < INT32_MIN || value > INT32_MAX ) {
+        throw std::runtime_error( std::format( "Match key {}{} is out of the int range", negative ? "-" : "", Lexeme( key ) ) );
+    }
+    return static_cast<int32_t>( value );
+}
+
 std::unique_ptr<Statement> Parser::ParseExpressionStatement() {
     auto expr = ParseExpression();
     Consume( TokenType::PUNCTUATION_SEMICOLON, "Expect ';' after expression" );
@@ -96,11 +211,16 @@ std::unique_ptr<Statement> Parser::ParseReturnStatement() {
 }
 
 
-std::unique_ptr<Statement> Parser::ParseVariableDeclaration( AccessModifier access ) {
-    std::string name = Consume(
+std::unique_ptr<Statement> Parser::ParseVariableDeclaration( AccessModifier access, const bool isConstexpr ) {
+    std::string name( Lexeme( Consume(
         TokenType::LITERAL_IDENTIFIER,
         "Expected variable name"
-    ).lexeme;
+    ) ) );
+
+    std::optional<TypeAnnotation> annotation;
+    if ( Match( { TokenType::PUNCTUATION_COLON } ) ) {
+        annotation = ParseTypeAnnotation( "Expected type after ':'" );
+    }
 
     std::unique_ptr<Expression> initializer;
     if ( Match( { TokenType::OPERATOR_ASSIGN } ) ) {
@@ -109,38 +229,38 @@ std::unique_ptr<Statement> Parser::ParseVariableDeclaration( AccessModifier acce
 
     Consume( TokenType::PUNCTUATION_SEMICOLON, "Expect ';' after variable declaration" );
 
-    return std::make_unique<VariableStatement>( name, access, std::move(initializer) );
+    if ( isConstexpr && !initializer ) {
+        throw std::runtime_error( std::format( "constexpr variable '{}' needs an initializer", name ) );
+    }
+
+    return std::make_unique<VariableStatement>( name, access, std::move(initializer), isConstexpr, std::move( annotation ) );
 
 }
 
-std::unique_ptr<Statement> Parser::ParseFunctionDeclaration( AccessModifier access, InlineSpecifier inlineSpec ) {
-    std::string name = Consume( TokenType::LITERAL_IDENTIFIER, "Expect function name" ).lexeme;
+std::unique_ptr<Statement> Parser::ParseFunctionDeclaration( AccessModifier access, InlineSpecifier inlineSpec, const bool isConstexpr ) {
+    std::string name( Lexeme( Consume( TokenType::LITERAL_IDENTIFIER, "Expect function name" ) ) );
+
+    // `fun sum<T>( ... )`, the type parameters name types in the signature and body
+    typeParameters.clear();
+    if ( Match( { TokenType::OPERATOR_LESS_THAN } ) ) {
+        do {
+            std::string typeParameter( Lexeme( Consume( TokenType::LITERAL_IDENTIFIER, "Expect type parameter name" ) ) );
+            if ( std::ranges::find( typeParameters, typeParameter ) != typeParameters.end() ) {
+                throw std::runtime_error( std::format( "Duplicate type parameter '{}' in '{}'", typeParameter, name ) );
+            }
+            typeParameters.push_back( std::move( typeParameter ) );
+        } while ( Match( { TokenType::PUNCTUATION_COMMA } ) );
+        Consume( TokenType::OPERATOR_GREATER_THAN, "Expect '>' after type parameters" );
+    }
 
     Consume( TokenType::PUNCTUATION_LPAREN, "Expect '(' after function name" );
-    std::vector<std::pair<std::string, TokenType>> parameters;
+    std::vector<std::pair<std::string, TypeAnnotation>> parameters;
 
     if ( !Check( TokenType::PUNCTUATION_RPAREN ) ) {
         do {
-            std::string paramName = Consume( TokenType::LITERAL_IDENTIFIER, "Expect parameter name" ).lexeme;
+            std::string paramName( Lexeme( Consume( TokenType::LITERAL_IDENTIFIER, "Expect parameter name" ) ) );
             Consume( TokenType::PUNCTUATION_COLON, "Expect ':' after parameter name" );
-
-            auto paramType = TokenType::SPECIAL_ERROR;
-            if (Match({
-                TokenType::KEYWORD_BOOL,
-                TokenType::KEYWORD_INT,
-                TokenType::KEYWORD_LONG,
-                TokenType::KEYWORD_FLOAT,
-                TokenType::KEYWORD_DOUBLE,
-                TokenType::KEYWORD_STRING,
-                TokenType::KEYWORD_CHAR,
-                TokenType::KEYWORD_VOID
-            })) {
-                paramType = Previous().type;
-            } else {
-                throw std::runtime_error( "Expected type after ':'" );
-            }
-
-            parameters.emplace_back( paramName, paramType );
+            parameters.emplace_back( paramName, ParseTypeAnnotation( "Expected type after ':'" ) );
         } while ( Match( { TokenType::PUNCTUATION_COMMA } ) );
     }
 
@@ -149,7 +269,40 @@ std::unique_ptr<Statement> Parser::ParseFunctionDeclaration( AccessModifier acce
 
     auto body = ParseBlock();
 
-    return std::make_unique<FunctionStatement>(name, access, inlineSpec, std::move(parameters), std::move(body));
+    auto declaration = std::make_unique<FunctionStatement>( name, access, inlineSpec, isConstexpr, std::move( typeParameters ),
+        std::move( parameters ), std::move( body ) );
+    typeParameters.clear();
+    return declaration;
+}
+
+TypeAnnotation Parser::ParseTypeAnnotation( const std::string& message ) {
+    TypeAnnotation annotation { TokenType::SPECIAL_ERROR, false, {} };
+    if (Match({
+        TokenType::KEYWORD_BOOL,
+        TokenType::KEYWORD_INT,
+        TokenType::KEYWORD_LONG,
+        TokenType::KEYWORD_FLOAT,
+        TokenType::KEYWORD_DOUBLE,
+        TokenType::KEYWORD_STRING,
+        TokenType::KEYWORD_CHAR,
+        TokenType::KEYWORD_VOID
+    })) {
+        annotation.type = Previous().type;
+    } else if ( !IsAtEnd() && IsTypeParameter( tokens[current] ) ) {
+        annotation.type = TokenType::LITERAL_IDENTIFIER;
+        annotation.name = Lexeme( Advance() );
+    } else {
+        throw std::runtime_error( message );
+    }
+    if ( Match( { TokenType::PUNCTUATION_LBRACKET } ) ) {
+        Consume( TokenType::PUNCTUATION_RBRACKET, "Expect ']' after '[' in an array type" );
+        annotation.isArray = true;
+    }
+    // Every array can be null, `int[]?` only says so
+    if ( Match( { TokenType::OPERATOR_NULLABILITY } ) && !annotation.isArray ) {
+        throw std::runtime_error( "Only array types can be null" );
+    }
+    return annotation;
 }
 
 std::vector<std::unique_ptr<Statement>> Parser::ParseBlock() {
@@ -170,11 +323,14 @@ std::unique_ptr<Expression> Parser::ParseExpression() {
 std::unique_ptr<Expression> Parser::ParseAssignment() {
     auto expr = ParseEquality();
 
-    if ( Match( { TokenType::OPERATOR_EQUALS } ) ) {
+    if ( Match( { TokenType::OPERATOR_ASSIGN } ) ) {
         auto value = ParseAssignment();
         if ( auto* variable = dynamic_cast<GetVariableExpression*>( expr.get() ) ) {
             return std::make_unique<AssignmentExpression>( variable->name, std::move( value ) );
         }
+        if ( auto* element = dynamic_cast<IndexExpression*>( expr.get() ) ) {
+            return std::make_unique<IndexAssignmentExpression>( std::move( element->array ), std::move( element->index ), std::move( value ) );
+        }
         throw std::runtime_error("Invalid assignment target");
     }
 
@@ -194,18 +350,30 @@ std::unique_ptr<Expression> Parser::ParseEquality() {
 }
 
 std::unique_ptr<Expression> Parser::ParseComparison() {
-    auto expr = ParseAdditive();
+    auto expr = ParseElvis();
 
     while ( Match( { TokenType::OPERATOR_GREATER_THAN, TokenType::OPERATOR_GREATER_EQUALS,
                   TokenType::OPERATOR_LESS_THAN, TokenType::OPERATOR_LESS_EQUALS } ) ) {
         TokenType op = Previous().type;
-        auto right = ParseAdditive();
+        auto right = ParseElvis();
         expr = std::make_unique<BinaryExpression>( std::move( expr ), op, std::move( right ) );
     }
 
     return expr;
 }
 
+// Right associative, `a ?: b ?: c` is the first of them that is not null
+std::unique_ptr<Expression> Parser::ParseElvis() {
+    auto expr = ParseAdditive();
+
+    if ( Match( { TokenType::OPERATOR_ELSENULL } ) ) {
+        auto right = ParseElvis();
+        return std::make_unique<BinaryExpression>( std::move( expr ), TokenType::OPERATOR_ELSENULL, std::move( right ) );
+    }
+
+    return expr;
+}
+
 std::unique_ptr<Expression> Parser::ParseAdditive() {
     auto expr = ParseMultiplicative();
 
@@ -237,41 +405,77 @@ std::unique_ptr<Expression> Parser::ParseUnary() {
         return std::make_unique<UnaryExpression>( op, std::move( right ) );
     }
 
-    return ParsePrimary();
+    return ParseIndex();
+}
+
+std::unique_ptr<Expression> Parser::ParseIndex() {
+    auto expr = ParsePrimary();
+
+    while ( Match( { TokenType::PUNCTUATION_LBRACKET } ) ) {
+        auto index = ParseExpression();
+        Consume( TokenType::PUNCTUATION_RBRACKET, "Expect ']' after index" );
+        expr = std::make_unique<IndexExpression>( std::move( expr ), std::move( index ) );
+    }
+
+    return expr;
 }
 
 std::unique_ptr<Expression> Parser::ParsePrimary() {
 
     if ( Match( { TokenType::LITERAL_DOUBLE } ) ) {
-        return std::make_unique<LiteralExpression>( std::stod( Previous().lexeme ) );
+        return std::make_unique<LiteralExpression>( Number( current - 1 ).real );
     }
 
     if ( Match( { TokenType::LITERAL_FLOAT } ) ) {
-        return std::make_unique<LiteralExpression>( std::stof( Previous().lexeme ) );
+        return std::make_unique<LiteralExpression>( static_cast<float>( Number( current - 1 ).real ) );
     }
 
     if ( Match( { TokenType::LITERAL_INT } ) ) {
-        return std::make_unique<LiteralExpression>( std::stoi( Previous().lexeme ) );
+        const int64_t value = Number( current - 1 ).integer;
+        if ( value > INT32_MAX ) {
+            throw std::runtime_error( std::format( "Int literal {} is out of range", Lexeme( Previous() ) ) );
+        }
+        return std::make_unique<LiteralExpression>( static_cast<int>( value ) );
+    }
+
+    if ( Match( { TokenType::LITERAL_CHAR } ) ) {
+        return std::make_unique<LiteralExpression>( CharacterValue( Lexeme( Previous() ) ) );
     }
 
     if ( Match( { TokenType::LITERAL_LONG } ) ) {
-        return std::make_unique<LiteralExpression>( std::stoll( Previous().lexeme ) );
+        return std::make_unique<LiteralExpression>( static_cast<long long>( Number( current - 1 ).integer ) );
     }
 
     if ( Match ( { TokenType::LITERAL_BOOL } ) ) {
-        const std::string value = Previous().lexeme;
-        if ( value == "true" ) {
-            return std::make_unique<LiteralExpression>( true );
-        }
+        return std::make_unique<LiteralExpression>( Lexeme( Previous() ) == "true" );
+    }
 
-        return std::make_unique<LiteralExpression>( false );
+    if ( Match( { TokenType::LITERAL_NULL } ) ) {
+        return std::make_unique<LiteralExpression>( std::monostate {} );
     }
 
 
+    // An element type followed by a length allocates an array, in a generic
+    // function the element type can be one of its type parameters
+    if ( Match( { TokenType::KEYWORD_INT, TokenType::KEYWORD_BOOL, TokenType::KEYWORD_FLOAT, TokenType::KEYWORD_DOUBLE } ) ) {
+        return ParseNewArray( TypeAnnotation { Previous().type, false, {} } );
+    }
+    if ( !IsAtEnd() && IsTypeParameter( tokens[current] ) ) {
+        return ParseNewArray( TypeAnnotation { TokenType::LITERAL_IDENTIFIER, false, std::string( Lexeme( Advance() ) ) } );
+    }
+
     if ( Match( { TokenType::LITERAL_IDENTIFIER } ) ) {
         // Check if this is a function call
-        if ( Check( TokenType::PUNCTUATION_LPAREN ) ) {
-            std::string functionName = Previous().lexeme;
+        if ( Check( TokenType::PUNCTUATION_LPAREN ) || CheckTypeArguments() ) {
+            std::string functionName( Lexeme( Previous() ) );
+
+            std::vector<TypeAnnotation> typeArguments;
+            if ( Match( { TokenType::OPERATOR_LESS_THAN } ) ) {
+                do {
+                    typeArguments.push_back( ParseTypeAnnotation( "Expect type argument" ) );
+                } while ( Match( { TokenType::PUNCTUATION_COMMA } ) );
+                Consume( TokenType::OPERATOR_GREATER_THAN, "Expect '>' after type arguments" );
+            }
 
             Consume( TokenType::PUNCTUATION_LPAREN, "Expect '(' after function name" );
 
@@ -284,10 +488,11 @@ std::unique_ptr<Expression> Parser::ParsePrimary() {
 
             Consume( TokenType::PUNCTUATION_RPAREN, "Expect ')' after arguments" );
 
-            return std::make_unique<CallExpression>( functionName, std::move( arguments ) );
+            return std::make_unique<CallExpression>( functionName, std::move( arguments ), std::move( typeArguments ) );
         }
 
-        return std::make_unique<GetVariableExpression>( Previous().lexeme );
+        std::string name( Lexeme( Previous() ) );
+        return std::make_unique<GetVariableExpression>( name );
     }
 
     if ( Match( { TokenType::PUNCTUATION_LPAREN } ) ) {
@@ -299,6 +504,13 @@ std::unique_ptr<Expression> Parser::ParsePrimary() {
     throw std::runtime_error("Expect expression");
 }
 
+std::unique_ptr<Expression> Parser::ParseNewArray( TypeAnnotation elementType ) {
+    Consume( TokenType::PUNCTUATION_LBRACKET, "Expect '[' after the element type of a new array" );
+    auto length = ParseExpression();
+    Consume( TokenType::PUNCTUATION_RBRACKET, "Expect ']' after array length" );
+    return std::make_unique<NewArrayExpression>( std::move( elementType ), std::move( length ) );
+}
+
 AccessModifier Parser::ParseAccessModifier() {
     if( Match( { TokenType::MODIFIER_PRIVATE } ) ) return AccessModifier::PRIVATE;
     if( Match( { TokenType::MODIFIER_INTERNAL } ) ) return AccessModifier::INTERNAL;
@@ -317,6 +529,24 @@ bool Parser::Check( const TokenType type ) const {
     return tokens[current].type == type;
 }
 
+bool Parser::IsTypeParameter( const Token& token ) const {
+    return token.type == TokenType::LITERAL_IDENTIFIER && std::ranges::find( typeParameters, Lexeme( token ) ) != typeParameters.end();
+}
+
+bool Parser::CheckTypeArguments() const {
+    if ( !Check( TokenType::OPERATOR_LESS_THAN ) || current + 1 >= tokens.size() ) {
+        return false;
+    }
+    switch ( const Token& next = tokens[current + 1]; next.type ) {
+        case TokenType::KEYWORD_BOOL: case TokenType::KEYWORD_INT: case TokenType::KEYWORD_LONG:
+        case TokenType::KEYWORD_FLOAT: case TokenType::KEYWORD_DOUBLE: case TokenType::KEYWORD_STRING:
+        case TokenType::KEYWORD_CHAR: case TokenType::KEYWORD_VOID:
+            return true;
+        default:
+            return IsTypeParameter( next );
+    }
+}
+
 Token Parser::Consume( const TokenType type, const std::string& message ) {
     if ( Check( type ) ) return Advance();
     throw std::runtime_error( message );
@@ -339,6 +569,18 @@ Token& Parser::Previous() {
     return tokens[current - 1];
 }
 
+std::string_view Parser::Lexeme( const Token& token ) const {
+    return source.substr( token.offset, token.length );
+}
+
+const NumberValue& Parser::Number( const size_t index ) const {
+    const auto number = std::ranges::lower_bound( numbers, index, {}, &NumberValue::token );
+    if ( number == numbers.end() || number->token != index ) {
+        throw std::runtime_error( std::format( "No value for number literal {}", Lexeme( tokens[index] ) ) );
+    }
+    return *number;
+}
+
 bool Parser::IsAtEnd() const {
     return tokens[current].type == TokenType::SPECIAL_END;
 }
@@ -0,0 +1,938 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <stdexcept>
+#include <BytecodeWriter.hpp>
+#include <ir/BytecodeEmitter.hpp>
+
+using namespace Lumin::Compiler::IR;
+using Lumin::Bytecode::BytecodeWriter;
+using Lumin::Bytecode::Label;
+using Lumin::Bytecode::OpCode;
+using Lumin::Bytecode::ArrayElement;
+using Lumin::Bytecode::VECTOR_CHECK;
+using Lumin::Bytecode::VECTOR_LEFT_SCALAR;
+using Lumin::Bytecode::VECTOR_RIGHT_SCALAR;
+
+namespace {
+
+constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+// Branch taken when the comparison holds, for ICMP's -1/0/1 of left - right
+OpCode BranchIfTrue( const Op op ) {
+    switch ( op ) {
+        case Op::CMP_EQ: return OpCode::IFEQ;
+        case Op::CMP_NE: return OpCode::IFNE;
+        case Op::CMP_LT: return OpCode::IFLT;
+        case Op::CMP_LE: return OpCode::IFLE;
+        case Op::CMP_GT: return OpCode::IFGT;
+        default: return OpCode::IFGE;
+    }
+}
+
+OpCode Invert( const OpCode branch ) {
+    switch ( branch ) {
+        case OpCode::IFEQ: return OpCode::IFNE;
+        case OpCode::IFNE: return OpCode::IFEQ;
+        case OpCode::IFLT: return OpCode::IFGE;
+        case OpCode::IFGE: return OpCode::IFLT;
+        case OpCode::IFGT: return OpCode::IFLE;
+        default: return OpCode::IFGT;
+    }
+}
+
+bool IsComparison( const Op op ) {
+    return op >= Op::CMP_EQ && op <= Op::CMP_GE;
+}
+
+// ICMP or FCMP, by the type both operands of the comparison have
+OpCode CompareOpcode( const Function& function, const ValueId comparison ) {
+    return function.values[function.Operands( comparison )[0]].type == Type::FLOAT ? OpCode::FCMP : OpCode::ICMP;
+}
+
+class Emitter {
+public:
+    Emitter( Module& module, Function& function, const EmitOptions& options )
+        : module( module ), function( function ), options( options ) {}
+
+    EmittedMethod Run( std::span<const BlockId> layout );
+
+private:
+    // A loop whose header only checks counter < limit, against a limit from
+    // outside the loop, and whose single latch adds 1 to the counter. The
+    // header becomes FOR_RANGE and the latch's jump back LOOP_NEXT.
+    struct CountedLoop {
+        BlockId header;
+        BlockId latch;
+        BlockId body;
+        BlockId exit;
+        ValueId counter; // Phi in the header
+        ValueId limit;
+        uint32_t limitSlot; // Known once slots are shared
+    };
+
+    void AssignSlots();
+    void FindCountedLoops();
+    // Gives values that are never live at the same time the same local
+    void ShareSlots();
+    // Marks the stored values that pushing value reads, by their local before sharing
+    void AddUses( ValueId value, std::vector<uint64_t>& live ) const;
+    [[nodiscard]] ValueId TailCall( BlockId block ) const;
+    void EmitBlock( BlockId block, BlockId next );
+    // Copies for the phis of to, except skip
+    void EmitPhiCopies( BlockId from, BlockId to, ValueId skip = NO_ID );
+    void EmitJump( BlockId target, BlockId next );
+    void EmitBranch( ValueId branch, BlockId next );
+    void EmitSwitch( ValueId value );
+    // The block a switch jumps to for the target, past a block that only jumps on
+    [[nodiscard]] BlockId SwitchTarget( BlockId target ) const;
+    // Pushes the value, rebuilding it when it has no slot
+    void Push( ValueId value );
+    // Pushes what the instruction computes
+    void Compute( ValueId value );
+    void EmitCall( ValueId value );
+    void EmitVector( ValueId value );
+    void Adjust( int delta );
+    // Marks where the branch about to be emitted goes, see BranchSite
+    void AddSite( BlockId from, BlockId taken, BlockId notTaken );
+
+    Module& module;
+    Function& function;
+    const EmitOptions& options;
+    BytecodeWriter writer;
+    std::vector<Label> labels;
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> useCounts;
+    std::vector<bool> rebuilt; // Pushed where it is used instead of stored
+    std::vector<ValueId> tailCalls; // Per block, the CALL emitted as TAILCALL in place of its RETURN
+    std::vector<CountedLoop> countedLoops;
+    std::vector<uint32_t> countedLoopOf; // Per block, the counted loop it is the header or latch of
+    std::vector<std::pair<Label, BranchSite>> sites; // Offsets are known after Finish
+    uint32_t localCount = 0;
+    uint32_t valueLocals = 0; // Locals with one for every stored value, before ShareSlots
+    int depth = 0;
+    int maxDepth = 0;
+};
+
+void Emitter::Adjust( const int delta ) {
+    depth += delta;
+    maxDepth = std::max( maxDepth, depth );
+}
+
+void Emitter::AddSite( const BlockId from, const BlockId taken, const BlockId notTaken ) {
+    const Label at = writer.NewLabel();
+    writer.Bind( at );
+    sites.emplace_back( at, BranchSite { 0, from, taken, notTaken } );
+}
+
+void Emitter::AssignSlots() {
+    const size_t count = function.values.size();
+    slots.assign( count, NO_SLOT );
+    useCounts.assign( count, 0 );
+    rebuilt.assign( count, false );
+    // Block of the only use, NO_ID once there is more than one
+    std::vector<BlockId> useBlock( count, NO_ID );
+    std::vector<bool> usedByPhi( count, false );
+
+    for ( const Block& block : function.blocks ) {
+        for ( const ValueId user : block.instructions ) {
+            const Instruction& instruction = function.values[user];
+            if ( instruction.op == Op::COPY ) {
+                continue;
+            }
+
+            const auto operands = function.Operands( user );
+            for ( size_t i = 0; i < operands.size(); ++i ) {
+                const ValueId operand = function.Resolve( operands[i] );
+                // A phi operand is read at the end of its predecessor
+                const BlockId where = instruction.op == Op::PHI ? block.predecessors[i] : instruction.block;
+                useBlock[operand] = useCounts[operand]++ == 0 ? where : NO_ID;
+                usedByPhi[operand] = usedByPhi[operand] || instruction.op == Op::PHI;
+            }
+        }
+    }
+
+    tailCalls.assign( function.blocks.size(), NO_ID );
+    for ( BlockId block = 0; block < function.blocks.size() && options.tailCalls; ++block ) {
+        tailCalls[block] = TailCall( block );
+    }
+
+    localCount = function.parameterCount;
+    for ( const Block& block : function.blocks ) {
+        for ( const ValueId value : block.instructions ) {
+            const Instruction& instruction = function.values[value];
+            if ( value == tailCalls[instruction.block] ) {
+                continue;
+            }
+            switch ( instruction.op ) {
+                case Op::CONST_INT: case Op::CONST_FLOAT: case Op::CONST_NULL: case Op::PARAM:
+                    rebuilt[value] = true;
+                    continue;
+                case Op::COPY: case Op::NOP:
+                case Op::JUMP: case Op::BRANCH: case Op::SWITCH: case Op::RETURN:
+                    continue;
+                case Op::PHI:
+                    break;
+                default:
+                    if ( IsPure( instruction.op ) && useCounts[value] == 1 && useBlock[value] == instruction.block ) {
+                        // A comparison read by a phi would be rebuilt into a
+                        // 0/1 diamond in the middle of the parallel copy
+                        if ( !( IsComparison( instruction.op ) && usedByPhi[value] ) ) {
+                            rebuilt[value] = true;
+                            continue;
+                        }
+                    }
+                    if ( useCounts[value] == 0 ) {
+                        continue;
+                    }
+                    break;
+            }
+            slots[value] = localCount++;
+        }
+    }
+
+    FindCountedLoops();
+    valueLocals = localCount;
+    if ( options.shareLocals ) {
+        ShareSlots();
+    }
+
+    // FOR_RANGE stores the limit it pops, into the slot it already has if any
+    for ( CountedLoop& loop : countedLoops ) {
+        const Instruction& bound = function.values[loop.limit];
+        loop.limitSlot = slots[loop.limit] != NO_SLOT ? slots[loop.limit] : bound.op == Op::PARAM ? bound.index : NO_SLOT;
+        if ( loop.limitSlot == NO_SLOT ) {
+            loop.limitSlot = localCount++;
+            ++valueLocals;
+        }
+    }
+
+    if ( localCount > UINT16_MAX ) {
+        throw std::runtime_error( std::format( "'{}' needs {} locals, at most 65535 are supported", function.name, localCount ) );
+    }
+}
+
+void Emitter::FindCountedLoops() {
+    countedLoops.clear();
+    countedLoopOf.assign( function.blocks.size(), NO_ID );
+    const DominatorTree dominators = ComputeDominators( function );
+    const LoopForest forest = FindLoops( function, dominators );
+
+    const auto isOne = [this]( const ValueId value ) {
+        const Instruction& instruction = function.values[function.Resolve( value )];
+        return instruction.op == Op::CONST_INT && instruction.intValue == 1;
+    };
+
+    for ( uint32_t index = 0; index < forest.loops.size(); ++index ) {
+        const Loop& loop = forest.loops[index];
+        const Block& header = function.blocks[loop.header];
+        if ( loop.latches.size() != 1 || header.predecessors.size() != 2 ) {
+            continue;
+        }
+        const BlockId latch = loop.latches.front();
+        const ValueId branch = function.Terminator( loop.header );
+        const ValueId jump = function.Terminator( latch );
+        if ( branch == NO_ID || function.values[branch].op != Op::BRANCH || jump == NO_ID || function.values[jump].op != Op::JUMP ) {
+            continue;
+        }
+        const auto& targets = function.values[branch].targets;
+        if ( !forest.Contains( index, targets[0] ) || forest.Contains( index, targets[1] ) ) {
+            continue;
+        }
+
+        // Rebuilt, so the branch is its only use
+        const ValueId condition = function.Resolve( function.Operands( branch )[0] );
+        if ( function.values[condition].op != Op::CMP_LT || !rebuilt[condition] ) {
+            continue;
+        }
+        const ValueId counter = function.Resolve( function.Operands( condition )[0] );
+        const ValueId limit = function.Resolve( function.Operands( condition )[1] );
+        const Instruction& phi = function.values[counter];
+        const Instruction& bound = function.values[limit];
+        if ( phi.op != Op::PHI || phi.block != loop.header || phi.type != Type::INT || slots[counter] == NO_SLOT ) {
+            continue;
+        }
+        const bool invariant = bound.op == Op::CONST_INT || bound.op == Op::PARAM || !forest.Contains( index, bound.block );
+        if ( bound.type != Type::INT || !invariant ) {
+            continue;
+        }
+
+        // Nothing else is emitted in the header, FOR_RANGE only runs on entry
+        const bool onlyCondition = std::ranges::all_of( header.instructions, [&]( const ValueId value ) {
+            const Op op = function.values[value].op;
+            return op == Op::PHI || op == Op::COPY || op == Op::NOP || rebuilt[value] || value == branch;
+        } );
+        if ( !onlyCondition ) {
+            continue;
+        }
+
+        // The sum is rebuilt, the phi copy is its only use and LOOP_NEXT does it
+        const size_t edge = header.predecessors[0] == latch ? 0 : 1;
+        const ValueId next = function.Resolve( function.Operands( counter )[edge] );
+        const Instruction& add = function.values[next];
+        if ( add.op != Op::ADD || add.type != Type::INT || !rebuilt[next] ) {
+            continue;
+        }
+        const auto addends = function.Operands( next );
+        const bool step = ( function.Resolve( addends[0] ) == counter && isOne( addends[1] ) )
+            || ( function.Resolve( addends[1] ) == counter && isOne( addends[0] ) );
+        if ( !step ) {
+            continue;
+        }
+
+        countedLoopOf[loop.header] = countedLoopOf[latch] = static_cast<uint32_t>( countedLoops.size() );
+        countedLoops.push_back( { loop.header, latch, targets[0], targets[1], counter, limit, NO_SLOT } );
+    }
+}
+
+/*
+ Liveness is that of the emitted code. A rebuilt value reads its operands
+ where it is used. A phi is written on the way into its block, so its
+ operand is read at the end of the predecessor, after anything else there.
+ LOOP_NEXT reads the limit at the latch, which keeps it live around the loop.
+
+ Values interfere when one is written while the other is live. Only values
+ of one type share a local, so the typed locals of the C translation stay
+ as narrow as they were. Locals are picked in reverse post order, and a phi
+ and the values it gets prefer each other's, which turns their copy into
+ nothing.
+ */
+void Emitter::ShareSlots() {
+    const uint32_t first = function.parameterCount;
+    const size_t valueCount = localCount - first;
+    if ( valueCount == 0 ) {
+        return;
+    }
+    std::vector<ValueId> valueOf( valueCount );
+    for ( ValueId value = 0; value < slots.size(); ++value ) {
+        if ( slots[value] != NO_SLOT ) {
+            valueOf[slots[value] - first] = value;
+        }
+    }
+
+    using Set = std::vector<uint64_t>;
+    const size_t words = ( valueCount + 63 ) / 64;
+    const std::vector<BlockId> order = ReversePostOrder( function );
+    std::vector<Set> liveIn( function.blocks.size(), Set( words, 0 ) );
+    const auto liveOut = [&]( const BlockId block ) {
+        Set live( words, 0 );
+        for ( const BlockId successor : function.Successors( block ) ) {
+            for ( size_t i = 0; i < words; ++i ) {
+                live[i] |= liveIn[successor][i];
+            }
+            const Block& target = function.blocks[successor];
+            const auto edge = static_cast<size_t>( std::ranges::find( target.predecessors, block ) - target.predecessors.begin() );
+            for ( const ValueId phi : target.instructions ) {
+                if ( function.values[phi].op != Op::PHI ) {
+                    break;
+                }
+                AddUses( function.Operands( phi )[edge], live );
+            }
+        }
+        return live;
+    };
+
+    std::vector<std::vector<uint32_t>> neighbors( valueCount );
+    const auto interfere = [&]( const uint32_t index, const Set& live ) {
+        const Type type = function.values[valueOf[index]].type;
+        for ( size_t i = 0; i < words; ++i ) {
+            for ( uint64_t bits = live[i]; bits != 0; bits &= bits - 1 ) {
+                const auto other = static_cast<uint32_t>( i * 64 + std::countr_zero( bits ) );
+                if ( other != index && function.values[valueOf[other]].type == type ) {
+                    neighbors[index].push_back( other );
+                    neighbors[other].push_back( index );
+                }
+            }
+        }
+    };
+
+    // Turns what is live out of the block into what is live into it
+    const auto scan = [&]( const BlockId block, Set& live, const bool record ) {
+        const auto& instructions = function.blocks[block].instructions;
+        const uint32_t counted = countedLoopOf[block];
+        for ( auto position = instructions.rbegin(); position != instructions.rend(); ++position ) {
+            const ValueId value = *position;
+            const Instruction& instruction = function.values[value];
+            switch ( instruction.op ) {
+                case Op::PHI: case Op::COPY: case Op::NOP:
+                    continue;
+                case Op::JUMP:
+                    if ( counted != NO_ID ) {
+                        AddUses( countedLoops[counted].limit, live );
+                    }
+                    continue;
+                case Op::BRANCH:
+                    if ( counted != NO_ID ) {
+                        AddUses( countedLoops[counted].limit, live );
+                        AddUses( countedLoops[counted].counter, live );
+                    } else {
+                        AddUses( function.Operands( value )[0], live );
+                    }
+                    continue;
+                case Op::SWITCH:
+                    AddUses( function.Operands( value )[0], live );
+                    continue;
+                case Op::RETURN:
+                    if ( tailCalls[block] == NO_ID && instruction.operandCount != 0 ) {
+                        AddUses( function.Operands( value )[0], live );
+                    }
+                    continue;
+                default:
+                    break;
+            }
+            if ( rebuilt[value] || ( slots[value] == NO_SLOT && IsPure( instruction.op ) ) ) {
+                continue;
+            }
+
+            if ( slots[value] != NO_SLOT ) {
+                const uint32_t index = slots[value] - first;
+                live[index / 64] &= ~( uint64_t { 1 } << index % 64 );
+                if ( record ) {
+                    interfere( index, live );
+                }
+            }
+            for ( const ValueId operand : function.Operands( value ) ) {
+                AddUses( operand, live );
+            }
+        }
+
+        // Phis are written together, each while the others and all that is
+        // live into the block are kept
+        for ( const ValueId phi : instructions ) {
+            if ( function.values[phi].op != Op::PHI ) {
+                break;
+            }
+            if ( record ) {
+                interfere( slots[phi] - first, live );
+            }
+        }
+        for ( const ValueId phi : instructions ) {
+            if ( function.values[phi].op != Op::PHI ) {
+                break;
+            }
+            const uint32_t index = slots[phi] - first;
+            live[index / 64] &= ~( uint64_t { 1 } << index % 64 );
+        }
+    };
+
+    for ( bool changed = true; changed; ) {
+        changed = false;
+        for ( auto block = order.rbegin(); block != order.rend(); ++block ) {
+            Set live = liveOut( *block );
+            scan( *block, live, false );
+            if ( live != liveIn[*block] ) {
+                liveIn[*block] = std::move( live );
+                changed = true;
+            }
+        }
+    }
+    for ( const BlockId block : order ) {
+        Set live = liveOut( block );
+        scan( block, live, true );
+    }
+
+    std::vector<std::vector<uint32_t>> related( valueCount );
+    for ( uint32_t index = 0; index < valueCount; ++index ) {
+        const ValueId phi = valueOf[index];
+        if ( function.values[phi].op != Op::PHI ) {
+            continue;
+        }
+        for ( const ValueId operand : function.Operands( phi ) ) {
+            const ValueId incoming = function.Resolve( operand );
+            if ( incoming != phi && slots[incoming] != NO_SLOT && function.values[incoming].type == function.values[phi].type ) {
+                related[index].push_back( slots[incoming] - first );
+                related[slots[incoming] - first].push_back( index );
+            }
+        }
+    }
+
+    std::vector<uint32_t> shared( valueCount, NO_SLOT );
+    std::vector<Type> sharedTypes; // Of each local handed out
+    std::vector<bool> taken;
+    for ( const BlockId block : order ) {
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            if ( slots[value] == NO_SLOT ) {
+                continue;
+            }
+            const uint32_t index = slots[value] - first;
+            const Type type = function.values[value].type;
+            taken.assign( sharedTypes.size(), false );
+            for ( const uint32_t other : neighbors[index] ) {
+                if ( shared[other] != NO_SLOT ) {
+                    taken[shared[other]] = true;
+                }
+            }
+
+            uint32_t local = NO_SLOT;
+            for ( const uint32_t other : related[index] ) {
+                if ( shared[other] != NO_SLOT && !taken[shared[other]] ) {
+                    local = shared[other];
+                    break;
+                }
+            }
+            for ( uint32_t i = 0; local == NO_SLOT && i < sharedTypes.size(); ++i ) {
+                if ( !taken[i] && sharedTypes[i] == type ) {
+                    local = i;
+                }
+            }
+            if ( local == NO_SLOT ) {
+                local = static_cast<uint32_t>( sharedTypes.size() );
+                sharedTypes.push_back( type );
+            }
+            shared[index] = local;
+        }
+    }
+
+    for ( uint32_t& slot : slots ) {
+        if ( slot != NO_SLOT ) {
+            slot = first + shared[slot - first];
+        }
+    }
+    localCount = first + static_cast<uint32_t>( sharedTypes.size() );
+}
+
+void Emitter::AddUses( const ValueId value, std::vector<uint64_t>& live ) const {
+    const ValueId resolved = function.Resolve( value );
+    if ( slots[resolved] != NO_SLOT ) {
+        const uint32_t index = slots[resolved] - function.parameterCount;
+        live[index / 64] |= uint64_t { 1 } << index % 64;
+    } else if ( rebuilt[resolved] ) {
+        for ( const ValueId operand : function.Operands( resolved ) ) {
+            AddUses( operand, live );
+        }
+    }
+}
+
+void Emitter::Push( ValueId value ) {
+    value = function.Resolve( value );
+    if ( slots[value] != NO_SLOT ) {
+        writer.EmitILoad( static_cast<uint16_t>( slots[value] ) );
+        Adjust( 1 );
+        return;
+    }
+    if ( !rebuilt[value] ) {
+        throw std::logic_error( std::format( "v{} in '{}' has neither a slot nor an expression", value, function.name ) );
+    }
+    Compute( value );
+}
+
+void Emitter::Compute( const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    const auto operands = function.Operands( value );
+
+    switch ( instruction.op ) {
+        case Op::CONST_INT:
+            writer.EmitIConst( instruction.intValue );
+            Adjust( 1 );
+            return;
+        case Op::CONST_FLOAT:
+            writer.Emit( OpCode::FCONST );
+            writer.Emit( instruction.floatValue );
+            Adjust( 1 );
+            return;
+        case Op::CONST_NULL:
+            writer.Emit( OpCode::ACONST_NULL );
+            Adjust( 1 );
+            return;
+        case Op::PARAM:
+            writer.EmitILoad( static_cast<uint16_t>( instruction.index ) );
+            Adjust( 1 );
+            return;
+        case Op::NEG:
+            Push( operands[0] );
+            writer.Emit( instruction.type == Type::FLOAT ? OpCode::FNEG : OpCode::INEG );
+            return;
+        case Op::TO_FLOAT:
+            Push( operands[0] );
+            writer.Emit( OpCode::I2F );
+            return;
+        case Op::IS_NULL:
+            Push( operands[0] );
+            writer.Emit( OpCode::ISNULL );
+            return;
+        case Op::CALL:
+            EmitCall( value );
+            return;
+        case Op::SNAPSHOT:
+            if ( useCounts[value] != 0 ) {
+                throw std::runtime_error( std::format( "snapshot() does not return a value, but '{}' uses its result", function.name ) );
+            }
+            writer.Emit( OpCode::SNAPSHOT );
+            return;
+        case Op::NEW_ARRAY:
+            Push( operands[0] );
+            writer.Emit( instruction.index != 0 ? OpCode::ALLOC_LOCAL_ARRAY : OpCode::ALLOC_ARRAY );
+            writer.Emit( static_cast<uint8_t>( instruction.type == Type::FLOAT_ARRAY ? ArrayElement::FLOAT : ArrayElement::INT ) );
+            return;
+        case Op::LOAD:
+            Push( operands[0] );
+            Push( operands[1] );
+            writer.Emit( instruction.index != 0 ? OpCode::LOAD_ARRAY_NONNULL : OpCode::LOAD_ARRAY );
+            Adjust( -1 );
+            return;
+        case Op::STORE:
+            Push( operands[0] );
+            Push( operands[1] );
+            Push( operands[2] );
+            writer.Emit( instruction.index != 0 ? OpCode::STORE_ARRAY_NONNULL : OpCode::STORE_ARRAY );
+            Adjust( -3 );
+            return;
+        case Op::VECTOR:
+            EmitVector( value );
+            return;
+        default:
+            break;
+    }
+
+    // The VM pops the left operand first, so it goes on top
+    Push( operands[1] );
+    Push( operands[0] );
+    Adjust( -1 );
+
+    const bool isFloat = instruction.type == Type::FLOAT;
+    switch ( instruction.op ) {
+        case Op::ADD: writer.Emit( isFloat ? OpCode::FADD : OpCode::IADD ); return;
+        case Op::SUB: writer.Emit( isFloat ? OpCode::FSUB : OpCode::ISUB ); return;
+        case Op::MUL: writer.Emit( isFloat ? OpCode::FMUL : OpCode::IMUL ); return;
+        case Op::DIV: writer.Emit( isFloat ? OpCode::FDIV : OpCode::IDIV ); return;
+        default: break;
+    }
+
+    // Comparisons used as values become 0 or 1
+    const Label isFalse = writer.NewLabel();
+    const Label done = writer.NewLabel();
+    writer.Emit( CompareOpcode( function, value ) );
+    writer.EmitBranch( Invert( BranchIfTrue( instruction.op ) ), isFalse );
+    writer.EmitIConst( 1 );
+    writer.EmitBranch( OpCode::GOTO, done );
+    writer.Bind( isFalse );
+    writer.EmitIConst( 0 );
+    writer.Bind( done );
+}
+
+// A call whose result, or lack of one, the block returns right away. Only
+// instructions that emit nothing where they stand may come in between.
+ValueId Emitter::TailCall( const BlockId block ) const {
+    const ValueId terminator = function.Terminator( block );
+    if ( function.blocks[block].removed || terminator == NO_ID || function.values[terminator].op != Op::RETURN ) {
+        return NO_ID;
+    }
+
+    const auto& instructions = function.blocks[block].instructions;
+    for ( auto position = instructions.rbegin() + 1; position != instructions.rend(); ++position ) {
+        const Instruction& instruction = function.values[*position];
+        switch ( instruction.op ) {
+            case Op::COPY: case Op::NOP:
+            case Op::CONST_INT: case Op::CONST_FLOAT: case Op::CONST_NULL: case Op::PARAM:
+                continue;
+            case Op::CALL: {
+                const bool returnsValue = module.functions[instruction.index].returnsValue;
+                const auto returned = function.Operands( terminator );
+                if ( returned.empty() ? returnsValue : !returnsValue || function.Resolve( returned[0] ) != *position || useCounts[*position] != 1 ) {
+                    return NO_ID;
+                }
+                return *position;
+            }
+            default:
+                return NO_ID;
+        }
+    }
+    return NO_ID;
+}
+
+void Emitter::EmitCall( const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    const auto operands = function.Operands( value );
+
+    // Arguments in order, the VM pops them into the callee's first locals
+    for ( const ValueId argument : operands ) {
+        Push( argument );
+    }
+    const bool tailCall = value == tailCalls[instruction.block];
+    writer.Emit( tailCall ? OpCode::TAILCALL : OpCode::CALL );
+    writer.Emit( static_cast<uint16_t>( instruction.index ) );
+
+    const bool returnsValue = module.functions[instruction.index].returnsValue;
+    if ( !returnsValue && useCounts[value] != 0 ) {
+        throw std::runtime_error( std::format( "'{}' does not return a value, but '{}' uses its result",
+            module.functions[instruction.index].name, function.name ) );
+    }
+    // A tail call's result is the caller's, it is not pushed in this frame
+    Adjust( ( returnsValue && !tailCall ? 1 : 0 ) - static_cast<int>( operands.size() ) );
+}
+
+// Operands in order, the mode byte says which of left and right are scalars
+void Emitter::EmitVector( const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    const auto operands = function.Operands( value );
+    uint8_t mode = instruction.index != 0 ? VECTOR_CHECK : 0;
+    if ( !IsArray( function.values[function.Resolve( operands[1] )].type ) ) {
+        mode |= VECTOR_LEFT_SCALAR;
+    }
+    if ( !IsArray( function.values[function.Resolve( operands[2] )].type ) ) {
+        mode |= VECTOR_RIGHT_SCALAR;
+    }
+
+    for ( const ValueId operand : operands ) {
+        Push( operand );
+    }
+    switch ( static_cast<Op>( instruction.intValue ) ) {
+        case Op::ADD: writer.Emit( OpCode::VADD ); break;
+        case Op::SUB: writer.Emit( OpCode::VSUB ); break;
+        case Op::MUL: writer.Emit( OpCode::VMUL ); break;
+        default: writer.Emit( OpCode::VDIV ); break;
+    }
+    writer.Emit( mode );
+    Adjust( 1 - static_cast<int>( operands.size() ) );
+}
+
+void Emitter::EmitPhiCopies( const BlockId from, const BlockId to, const ValueId skip ) {
+    const Block& target = function.blocks[to];
+    const auto edge = static_cast<size_t>( std::ranges::find( target.predecessors, from ) - target.predecessors.begin() );
+
+    std::vector<ValueId> stores;
+    for ( const ValueId phi : target.instructions ) {
+        if ( function.values[phi].op != Op::PHI ) {
+            break;
+        }
+        const ValueId incoming = function.Resolve( function.Operands( phi )[edge] );
+        // A phi sharing the local of what it gets needs no copy
+        if ( incoming == phi || phi == skip || slots[phi] == NO_SLOT || slots[incoming] == slots[phi] ) {
+            continue;
+        }
+        Push( incoming );
+        stores.push_back( phi );
+    }
+
+    // Everything is read before anything is written, so phis that feed each
+    // other swap correctly
+    for ( auto it = stores.rbegin(); it != stores.rend(); ++it ) {
+        writer.EmitIStore( static_cast<uint16_t>( slots[*it] ) );
+        Adjust( -1 );
+    }
+}
+
+void Emitter::EmitJump( const BlockId target, const BlockId next ) {
+    if ( target != next ) {
+        writer.EmitBranch( OpCode::GOTO, labels[target] );
+    }
+}
+
+void Emitter::EmitBranch( const ValueId branch, const BlockId next ) {
+    const Instruction& instruction = function.values[branch];
+    const ValueId condition = function.Resolve( function.Operands( branch )[0] );
+    const Instruction& conditionInstruction = function.values[condition];
+    const BlockId onTrue = instruction.targets[0];
+    const BlockId onFalse = instruction.targets[1];
+
+    OpCode ifTrue = OpCode::IFNE;
+    if ( rebuilt[condition] && IsComparison( conditionInstruction.op ) ) {
+        // Fused into the branch, no 0/1 in between
+        const auto operands = function.Operands( condition );
+        Push( operands[1] );
+        Push( operands[0] );
+        writer.Emit( CompareOpcode( function, condition ) );
+        Adjust( -1 );
+        ifTrue = BranchIfTrue( conditionInstruction.op );
+    } else {
+        Push( condition );
+    }
+    Adjust( -1 );
+
+    if ( onTrue == next ) {
+        AddSite( instruction.block, onFalse, onTrue );
+        writer.EmitBranch( Invert( ifTrue ), labels[onFalse] );
+    } else {
+        AddSite( instruction.block, onTrue, onFalse );
+        writer.EmitBranch( ifTrue, labels[onTrue] );
+        EmitJump( onFalse, next );
+    }
+}
+
+BlockId Emitter::SwitchTarget( const BlockId target ) const {
+    const auto& instructions = function.blocks[target].instructions;
+    if ( instructions.size() != 1 || function.values[instructions.front()].op != Op::JUMP ) {
+        return target;
+    }
+    const BlockId next = function.values[instructions.front()].targets[0];
+    const auto& nextInstructions = function.blocks[next].instructions;
+    const bool hasPhis = !nextInstructions.empty() && function.values[nextInstructions.front()].op == Op::PHI;
+    return hasPhis ? target : next;
+}
+
+// TABLESWITCH when at least a third of its entries are keys, at 4 bytes an
+// entry against 8 a key it is then at most half again the size of
+// LOOKUPSWITCH and finds the target in constant time
+void Emitter::EmitSwitch( const ValueId value ) {
+    const SwitchTable& table = function.switches[function.values[value].index];
+    Push( function.Operands( value )[0] );
+    Adjust( -1 );
+
+    const Label fallback = labels[SwitchTarget( table.targets.back() )];
+    const int64_t range = static_cast<int64_t>( table.keys.back() ) - table.keys.front() + 1;
+    if ( range <= 3 * static_cast<int64_t>( table.keys.size() ) ) {
+        std::vector<Label> entries( static_cast<size_t>( range ), fallback );
+        for ( size_t i = 0; i < table.keys.size(); ++i ) {
+            entries[static_cast<size_t>( static_cast<int64_t>( table.keys[i] ) - table.keys.front() )] = labels[SwitchTarget( table.targets[i] )];
+        }
+        writer.EmitTableSwitch( table.keys.front(), entries, fallback );
+    } else {
+        std::vector<Label> entries;
+        for ( size_t i = 0; i < table.keys.size(); ++i ) {
+            entries.push_back( labels[SwitchTarget( table.targets[i] )] );
+        }
+        writer.EmitLookupSwitch( table.keys, entries, fallback );
+    }
+}
+
+void Emitter::EmitBlock( const BlockId block, const BlockId next ) {
+    const Block& info = function.blocks[block];
+    writer.Bind( labels[block] );
+
+    // A branch or switch cannot carry copies, a phi block reached by one has
+    // it as its only predecessor and copies on entry
+    if ( info.predecessors.size() == 1 ) {
+        const ValueId terminator = function.Terminator( info.predecessors.front() );
+        if ( terminator != NO_ID && ( function.values[terminator].op == Op::BRANCH || function.values[terminator].op == Op::SWITCH ) ) {
+            EmitPhiCopies( info.predecessors.front(), block );
+        }
+    }
+
+    for ( const ValueId value : info.instructions ) {
+        const Instruction& instruction = function.values[value];
+        switch ( instruction.op ) {
+            case Op::PHI: case Op::COPY: case Op::NOP:
+                continue;
+            case Op::JUMP:
+                if ( countedLoopOf[block] != NO_ID ) {
+                    // Back to the body, the counter goes up in LOOP_NEXT rather than by its phi copy
+                    const CountedLoop& loop = countedLoops[countedLoopOf[block]];
+                    EmitPhiCopies( block, loop.header, loop.counter );
+                    AddSite( loop.header, loop.body, loop.exit );
+                    writer.EmitCountedLoop( OpCode::LOOP_NEXT, static_cast<uint16_t>( slots[loop.counter] ),
+                        static_cast<uint16_t>( loop.limitSlot ), labels[loop.body] );
+                    EmitJump( loop.exit, next );
+                    continue;
+                }
+                EmitPhiCopies( block, instruction.targets[0] );
+                EmitJump( instruction.targets[0], next );
+                continue;
+            case Op::BRANCH:
+                if ( countedLoopOf[block] != NO_ID ) {
+                    const CountedLoop& loop = countedLoops[countedLoopOf[block]];
+                    Push( loop.limit );
+                    Adjust( -1 );
+                    AddSite( loop.header, loop.exit, loop.body );
+                    writer.EmitCountedLoop( OpCode::FOR_RANGE, static_cast<uint16_t>( slots[loop.counter] ),
+                        static_cast<uint16_t>( loop.limitSlot ), labels[loop.exit] );
+                    EmitJump( loop.body, next );
+                    continue;
+                }
+                EmitBranch( value, next );
+                continue;
+            case Op::SWITCH:
+                EmitSwitch( value );
+                continue;
+            case Op::RETURN:
+                if ( tailCalls[block] != NO_ID ) {
+                    continue;
+                }
+                if ( instruction.operandCount != 0 ) {
+                    Push( function.Operands( value )[0] );
+                    Adjust( -1 );
+                }
+                writer.Emit( OpCode::RETURN );
+                continue;
+            default:
+                break;
+        }
+
+        if ( rebuilt[value] ) {
+            continue;
+        }
+        if ( slots[value] == NO_SLOT && IsPure( instruction.op ) ) {
+            // Unused, only left behind when optimization is off
+            continue;
+        }
+
+        Compute( value );
+        if ( value == tailCalls[block] ) {
+            continue;
+        }
+        if ( slots[value] != NO_SLOT ) {
+            writer.EmitIStore( static_cast<uint16_t>( slots[value] ) );
+            Adjust( -1 );
+        } else if ( instruction.op != Op::STORE && instruction.op != Op::SNAPSHOT
+                    && ( instruction.op != Op::CALL || module.functions[instruction.index].returnsValue ) ) {
+            writer.Emit( OpCode::POP );
+            Adjust( -1 );
+        }
+    }
+}
+
+EmittedMethod Emitter::Run( const std::span<const BlockId> layout ) {
+    RemoveUnreachableBlocks( function );
+    SplitCriticalEdges( function );
+    AssignSlots();
+
+    std::vector<BlockId> order = ReversePostOrder( function );
+    if ( !layout.empty() ) {
+        std::vector<BlockId> given( layout.begin(), layout.end() );
+        const bool sameBlocks = given.size() == order.size() && given.front() == order.front()
+            && std::ranges::is_permutation( given, order );
+        if ( !sameBlocks ) {
+            throw std::logic_error( std::format( "The layout of '{}' does not hold its blocks once, entry first", function.name ) );
+        }
+        order = std::move( given );
+    }
+    // Blocks a switch jumps past are never entered
+    std::erase_if( order, [this]( const BlockId block ) {
+        const auto& predecessors = function.blocks[block].predecessors;
+        const ValueId terminator = predecessors.size() == 1 ? function.Terminator( predecessors.front() ) : NO_ID;
+        return terminator != NO_ID && function.values[terminator].op == Op::SWITCH && SwitchTarget( block ) != block;
+    } );
+    labels.clear();
+    labels.reserve( function.blocks.size() );
+    for ( size_t i = 0; i < function.blocks.size(); ++i ) {
+        labels.push_back( writer.NewLabel() );
+    }
+    writer.Reserve( function.values.size() * 3 );
+
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        EmitBlock( order[i], i + 1 < order.size() ? order[i + 1] : NO_ID );
+    }
+    writer.Finish();
+
+    EmittedMethod method;
+    for ( auto& [label, site] : sites ) {
+        site.offset = static_cast<uint32_t>( writer.Offset( label ) );
+        method.branches.push_back( site );
+    }
+    method.code = std::move( writer.bytecode );
+    method.maxLocals = static_cast<uint16_t>( localCount );
+    method.valueLocals = valueLocals;
+    method.maxStack = static_cast<uint16_t>( std::min( maxDepth, static_cast<int>( UINT16_MAX ) ) );
+    return method;
+}
+
+}
+
+EmittedMethod Lumin::Compiler::IR::EmitBytecode( Module& module, const uint32_t function, const EmitOptions& options,
+    const std::span<const BlockId> layout ) {
+    return Emitter( module, module.functions[function], options ).Run( layout );
+}
@@ -0,0 +1,213 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <ir/CodeLayout.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// An edge that may become a fall-through, with what it is sorted by
+struct Candidate {
+    uint64_t weight;
+    size_t from; // Positions in reverse post order, for a stable order among equal weights
+    size_t to;
+};
+
+}
+
+BlockLayout Lumin::Compiler::IR::ProfiledBlockOrder( const Function& function, const std::span<const BranchSite> sites,
+    const std::span<const Utils::BranchCount> counts, const uint64_t calls ) {
+    const std::vector<BlockId> order = ReversePostOrder( function );
+    const size_t blockCount = function.blocks.size();
+    std::vector<size_t> position( blockCount, SIZE_MAX );
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        position[order[i]] = i;
+    }
+
+    // Edges out of branches as counted, a branch the run never reached has
+    // no record and counts 0 both ways
+    std::map<std::pair<BlockId, BlockId>, uint64_t> edges;
+    std::vector<bool> branches( blockCount, false );
+    std::vector<uint64_t> frequency( blockCount, 0 );
+    for ( const BranchSite& site : sites ) {
+        const auto count = std::ranges::lower_bound( counts, site.offset, {}, &Utils::BranchCount::offset );
+        const bool found = count != counts.end() && count->offset == site.offset;
+        edges[{ site.from, site.taken }] += found ? count->taken : 0;
+        edges[{ site.from, site.notTaken }] += found ? count->notTaken : 0;
+        frequency[site.from] += found ? count->taken + count->notTaken : 0;
+        branches[site.from] = true;
+    }
+
+    const auto edgeCount = [&]( const BlockId from, const BlockId to ) -> uint64_t {
+        if ( !branches[from] ) {
+            return frequency[from];
+        }
+        const auto edge = edges.find( { from, to } );
+        return edge != edges.end() ? edge->second : 0;
+    };
+
+    // Blocks that end in a jump run as often as they are entered. Only a
+    // cycle without a branch, which never ends, keeps changing, the passes
+    // are bounded for it.
+    bool changed = true;
+    for ( size_t pass = 0; changed && pass <= blockCount; ++pass ) {
+        changed = false;
+        for ( const BlockId block : order ) {
+            if ( branches[block] ) {
+                continue;
+            }
+            uint64_t count = block == order.front() ? calls : 0;
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                if ( position[predecessor] != SIZE_MAX ) {
+                    count += edgeCount( predecessor, block );
+                }
+            }
+            if ( count != frequency[block] ) {
+                frequency[block] = count;
+                changed = true;
+            }
+        }
+    }
+
+    // A switch always jumps, none of its targets can fall through
+    std::vector<Candidate> candidates;
+    for ( const BlockId block : order ) {
+        const ValueId terminator = function.Terminator( block );
+        if ( terminator == NO_ID || function.values[terminator].op == Op::SWITCH ) {
+            continue;
+        }
+        for ( const BlockId successor : function.Successors( block ) ) {
+            const uint64_t weight = edgeCount( block, successor );
+            if ( weight != 0 && successor != order.front() ) {
+                candidates.push_back( { weight, position[block], position[successor] } );
+            }
+        }
+    }
+    std::ranges::sort( candidates, []( const Candidate& a, const Candidate& b ) {
+        return std::tuple( b.weight, a.from, a.to ) < std::tuple( a.weight, b.from, b.to );
+    } );
+
+    // Chains by position, linked through next and previous
+    std::vector<size_t> next( order.size(), SIZE_MAX );
+    std::vector<size_t> previous( order.size(), SIZE_MAX );
+    std::vector<size_t> chain( order.size() );
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        chain[i] = i;
+    }
+    for ( const auto& [weight, from, to] : candidates ) {
+        if ( next[from] != SIZE_MAX || previous[to] != SIZE_MAX || chain[from] == chain[to] ) {
+            continue;
+        }
+        next[from] = to;
+        previous[to] = from;
+        for ( size_t at = to; at != SIZE_MAX; at = next[at] ) {
+            chain[at] = chain[from];
+        }
+    }
+
+    BlockLayout layout;
+    layout.order.reserve( order.size() );
+    const auto place = [&]( const size_t head ) {
+        for ( size_t at = head; at != SIZE_MAX; at = next[at] ) {
+            layout.order.push_back( order[at] );
+        }
+    };
+
+    // The entry heads its chain, no edge may enter it
+    place( 0 );
+    for ( size_t i = 1; i < order.size(); ++i ) {
+        if ( previous[i] == SIZE_MAX && chain[i] != chain[0] && frequency[order[i]] != 0 ) {
+            place( i );
+        }
+    }
+    for ( size_t i = 1; i < order.size(); ++i ) {
+        if ( previous[i] == SIZE_MAX && chain[i] != chain[0] && frequency[order[i]] == 0 ) {
+            place( i );
+            ++layout.coldBlocks;
+        }
+    }
+    return layout;
+}
+
+std::vector<uint32_t> Lumin::Compiler::IR::ProfiledMethodOrder( const Utils::ExecutionProfile& profile, const size_t methodCount ) {
+    std::vector<uint64_t> calls( methodCount, 0 );
+    for ( size_t i = 0; i < std::min( methodCount, profile.methods.size() ); ++i ) {
+        calls[i] = profile.methods[i].calls;
+    }
+
+    // Calls either way between a pair, the caller of the heavier way first
+    std::map<std::pair<uint32_t, uint32_t>, std::pair<uint64_t, uint64_t>> pairs;
+    for ( const auto& [caller, callee, count] : profile.calls ) {
+        if ( caller == callee || caller >= methodCount || callee >= methodCount ) {
+            continue;
+        }
+        auto& [forward, backward] = pairs[{ std::min( caller, callee ), std::max( caller, callee ) }];
+        ( caller < callee ? forward : backward ) += count;
+    }
+
+    std::vector<std::tuple<uint64_t, uint32_t, uint32_t>> affinities;
+    for ( const auto& [pair, counts] : pairs ) {
+        const auto& [forward, backward] = counts;
+        affinities.emplace_back( forward + backward, forward >= backward ? pair.first : pair.second,
+            forward >= backward ? pair.second : pair.first );
+    }
+    std::ranges::sort( affinities, []( const auto& a, const auto& b ) {
+        return std::tuple( std::get<0>( b ), std::get<1>( a ), std::get<2>( a ) )
+            < std::tuple( std::get<0>( a ), std::get<1>( b ), std::get<2>( b ) );
+    } );
+
+    // Merging appends the callee's whole chain to the caller's
+    std::vector<std::vector<uint32_t>> chains( methodCount );
+    std::vector<size_t> chainOf( methodCount );
+    for ( uint32_t i = 0; i < methodCount; ++i ) {
+        chains[i] = { i };
+        chainOf[i] = i;
+    }
+    for ( const auto& [weight, caller, callee] : affinities ) {
+        const size_t into = chainOf[caller];
+        const size_t from = chainOf[callee];
+        if ( into == from ) {
+            continue;
+        }
+        for ( const uint32_t method : chains[from] ) {
+            chainOf[method] = into;
+        }
+        chains[into].insert( chains[into].end(), chains[from].begin(), chains[from].end() );
+        chains[from].clear();
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> hottest;
+    for ( size_t i = 0; i < methodCount; ++i ) {
+        if ( !chains[i].empty() ) {
+            uint64_t most = 0;
+            for ( const uint32_t method : chains[i] ) {
+                most = std::max( most, calls[method] );
+            }
+            hottest.emplace_back( most, i );
+        }
+    }
+    std::ranges::stable_sort( hottest, std::greater<>(), &std::pair<uint64_t, size_t>::first );
+
+    std::vector<uint32_t> order;
+    order.reserve( methodCount );
+    for ( const auto& [most, index] : hottest ) {
+        order.insert( order.end(), chains[index].begin(), chains[index].end() );
+    }
+    return order;
+}
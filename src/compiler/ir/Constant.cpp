@@ -0,0 +1,117 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <bit>
+#include <limits>
+#include <ir/Constant.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+int32_t Wrap( const int64_t value ) {
+    return static_cast<int32_t>( static_cast<uint32_t>( value ) );
+}
+
+}
+
+Constant Constant::Int( const int32_t value ) {
+    Constant constant;
+    constant.intValue = value;
+    return constant;
+}
+
+Constant Constant::Float( const float value ) {
+    Constant constant;
+    constant.isFloat = true;
+    constant.floatValue = value;
+    return constant;
+}
+
+Constant Constant::Of( const Instruction& instruction ) {
+    return instruction.op == Op::CONST_FLOAT ? Float( instruction.floatValue ) : Int( instruction.intValue );
+}
+
+Instruction Constant::ToInstruction() const {
+    Instruction instruction = MakeInstruction( isFloat ? Op::CONST_FLOAT : Op::CONST_INT );
+    instruction.intValue = intValue;
+    instruction.floatValue = floatValue;
+    return instruction;
+}
+
+bool Constant::operator==( const Constant& other ) const {
+    return isFloat == other.isFloat && intValue == other.intValue
+        && std::bit_cast<uint32_t>( floatValue ) == std::bit_cast<uint32_t>( other.floatValue );
+}
+
+std::optional<Constant> Lumin::Compiler::IR::Fold( const Op op, const Constant& left, const Constant& right ) {
+    if ( op >= Op::CMP_EQ && op <= Op::CMP_GE ) {
+        int order;
+        if ( left.isFloat || right.isFloat ) {
+            const float a = left.AsFloat();
+            const float b = right.AsFloat();
+            if ( a != a || b != b ) {
+                return std::nullopt;
+            }
+            order = a < b ? -1 : a > b ? 1 : 0;
+        } else {
+            order = left.intValue < right.intValue ? -1 : left.intValue > right.intValue ? 1 : 0;
+        }
+
+        switch ( op ) {
+            case Op::CMP_EQ: return Constant::Int( order == 0 );
+            case Op::CMP_NE: return Constant::Int( order != 0 );
+            case Op::CMP_LT: return Constant::Int( order < 0 );
+            case Op::CMP_LE: return Constant::Int( order <= 0 );
+            case Op::CMP_GT: return Constant::Int( order > 0 );
+            default: return Constant::Int( order >= 0 );
+        }
+    }
+
+    if ( left.isFloat || right.isFloat ) {
+        const float a = left.AsFloat();
+        const float b = right.AsFloat();
+        switch ( op ) {
+            case Op::ADD: return Constant::Float( a + b );
+            case Op::SUB: return Constant::Float( a - b );
+            case Op::MUL: return Constant::Float( a * b );
+            case Op::DIV: return Constant::Float( a / b );
+            default: return std::nullopt;
+        }
+    }
+
+    const int64_t a = left.intValue;
+    const int64_t b = right.intValue;
+    switch ( op ) {
+        case Op::ADD: return Constant::Int( Wrap( a + b ) );
+        case Op::SUB: return Constant::Int( Wrap( a - b ) );
+        case Op::MUL: return Constant::Int( Wrap( a * b ) );
+        case Op::DIV:
+            // Left for the VM to report
+            if ( b == 0 || ( a == std::numeric_limits<int32_t>::min() && b == -1 ) ) {
+                return std::nullopt;
+            }
+            return Constant::Int( static_cast<int32_t>( a / b ) );
+        default: return std::nullopt;
+    }
+}
+
+Constant Lumin::Compiler::IR::ToFloat( const Constant& value ) {
+    return Constant::Float( value.AsFloat() );
+}
+
+Constant Lumin::Compiler::IR::Negate( const Constant& value ) {
+    return value.isFloat ? Constant::Float( -value.floatValue ) : Constant::Int( Wrap( -static_cast<int64_t>( value.intValue ) ) );
+}
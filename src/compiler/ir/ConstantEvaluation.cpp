@@ -0,0 +1,309 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <stdexcept>
+#include <unordered_map>
+#include <ir/Constant.hpp>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+struct CallKey {
+    uint32_t function;
+    std::vector<uint64_t> arguments; // Type and bit pattern of each argument
+
+    bool operator==( const CallKey& ) const = default;
+};
+
+struct CallKeyHash {
+    size_t operator()( const CallKey& key ) const {
+        uint64_t hash = 0xCBF29CE484222325ULL ^ key.function;
+        for ( const uint64_t argument : key.arguments ) {
+            hash = ( hash ^ argument ) * 0x100000001B3ULL;
+        }
+        return static_cast<size_t>( hash ^ ( hash >> 29 ) );
+    }
+};
+
+uint64_t Bits( const Constant& value ) {
+    return static_cast<uint64_t>( value.isFloat ) << 32
+        | ( value.isFloat ? std::bit_cast<uint32_t>( value.floatValue ) : static_cast<uint32_t>( value.intValue ) );
+}
+
+// Runs IR functions on constant arguments. Results are remembered, the same
+// call always gives the same value, which also turns naive recursion like
+// fib into a linear number of steps.
+class Interpreter {
+public:
+    Interpreter( const Module& module, const EvaluationLimits& limits ) : module( module ), limits( limits ) {}
+
+    // With a fresh step budget
+    std::optional<Constant> Evaluate( uint32_t function, std::span<const Constant> arguments );
+    // Why the last evaluation gave up
+    [[nodiscard]] const std::string& Failure() const { return failure; }
+
+private:
+    std::optional<Constant> Call( uint32_t function, std::span<const Constant> arguments );
+    std::optional<Constant> Fail( std::string reason );
+
+    const Module& module;
+    const EvaluationLimits& limits;
+    uint64_t steps = 0;
+    uint32_t depth = 0;
+    std::string failure;
+    std::unordered_map<CallKey, Constant, CallKeyHash> results;
+};
+
+std::optional<Constant> Interpreter::Evaluate( const uint32_t function, const std::span<const Constant> arguments ) {
+    steps = 0;
+    failure.clear();
+    return Call( function, arguments );
+}
+
+std::optional<Constant> Interpreter::Fail( std::string reason ) {
+    if ( failure.empty() ) {
+        failure = std::move( reason );
+    }
+    return std::nullopt;
+}
+
+std::optional<Constant> Interpreter::Call( const uint32_t function, const std::span<const Constant> arguments ) {
+    CallKey key { function, {} };
+    key.arguments.reserve( arguments.size() );
+    for ( const Constant& argument : arguments ) {
+        key.arguments.push_back( Bits( argument ) );
+    }
+    if ( const auto cached = results.find( key ); cached != results.end() ) {
+        return cached->second;
+    }
+
+    const Function& callee = module.functions[function];
+    if ( depth >= limits.maxDepth ) {
+        return Fail( std::format( "calls nest deeper than {} in '{}'", limits.maxDepth, callee.name ) );
+    }
+
+    struct Nesting {
+        uint32_t& depth;
+        explicit Nesting( uint32_t& depth ) : depth( ++depth ) {}
+        ~Nesting() { --depth; }
+    } nesting( depth );
+
+    std::vector<Constant> values( callee.values.size() );
+    std::vector<Constant> incoming;
+    std::vector<Constant> callArguments;
+    BlockId block = 0;
+    BlockId previous = NO_ID;
+    std::optional<Constant> result;
+
+    while ( !result ) {
+        const auto& instructions = callee.blocks[block].instructions;
+        size_t i = 0;
+        if ( previous != NO_ID ) {
+            // Phis read their operands before any of them is written
+            const auto& predecessors = callee.blocks[block].predecessors;
+            const auto edge = static_cast<size_t>( std::ranges::find( predecessors, previous ) - predecessors.begin() );
+            incoming.clear();
+            for ( ; i < instructions.size() && callee.values[instructions[i]].op == Op::PHI; ++i ) {
+                incoming.push_back( values[callee.Operands( instructions[i] )[edge]] );
+            }
+            for ( size_t phi = 0; phi < incoming.size(); ++phi ) {
+                values[instructions[phi]] = incoming[phi];
+            }
+        }
+
+        BlockId next = NO_ID;
+        for ( ; i < instructions.size() && !result && next == NO_ID; ++i ) {
+            const ValueId value = instructions[i];
+            const Instruction& instruction = callee.values[value];
+            const auto operands = callee.Operands( value );
+            if ( ++steps > limits.maxSteps ) {
+                return Fail( std::format( "it takes more than {} steps", limits.maxSteps ) );
+            }
+
+            switch ( instruction.op ) {
+                case Op::CONST_INT: case Op::CONST_FLOAT:
+                    values[value] = Constant::Of( instruction );
+                    break;
+                case Op::PARAM:
+                    values[value] = arguments[instruction.index];
+                    break;
+                case Op::COPY:
+                    values[value] = values[operands[0]];
+                    break;
+                case Op::NEG:
+                    values[value] = Negate( values[operands[0]] );
+                    break;
+                case Op::TO_FLOAT:
+                    values[value] = ToFloat( values[operands[0]] );
+                    break;
+                case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIV:
+                case Op::CMP_EQ: case Op::CMP_NE: case Op::CMP_LT: case Op::CMP_LE: case Op::CMP_GT: case Op::CMP_GE: {
+                    const auto folded = Fold( instruction.op, values[operands[0]], values[operands[1]] );
+                    if ( !folded ) {
+                        return Fail( std::format( "'{}' would fail at runtime on {}", callee.name, OpName( instruction.op ) ) );
+                    }
+                    values[value] = *folded;
+                    break;
+                }
+                case Op::CALL: {
+                    callArguments.clear();
+                    for ( const ValueId operand : operands ) {
+                        callArguments.push_back( values[operand] );
+                    }
+                    const auto returned = Call( instruction.index, callArguments );
+                    if ( !returned ) {
+                        return std::nullopt;
+                    }
+                    values[value] = *returned;
+                    break;
+                }
+                case Op::JUMP:
+                    next = instruction.targets[0];
+                    break;
+                case Op::BRANCH: {
+                    const Constant& condition = values[operands[0]];
+                    if ( condition.isFloat ) {
+                        return Fail( std::format( "'{}' branches on a float", callee.name ) );
+                    }
+                    next = instruction.targets[condition.intValue != 0 ? 0 : 1];
+                    break;
+                }
+                case Op::SWITCH:
+                    next = callee.switches[instruction.index].Target( values[operands[0]].intValue );
+                    break;
+                case Op::RETURN:
+                    result = operands.empty() ? Constant::Int( 0 ) : values[operands[0]];
+                    break;
+                case Op::CONST_NULL: case Op::IS_NULL: case Op::NEW_ARRAY: case Op::LOAD: case Op::STORE: case Op::VECTOR:
+                    // Constants are numbers, arrays live on the VM's heap
+                    return Fail( std::format( "'{}' uses an array", callee.name ) );
+                case Op::SNAPSHOT:
+                    return Fail( std::format( "'{}' snapshots the VM", callee.name ) );
+                default:
+                    break;
+            }
+        }
+
+        if ( !result && next == NO_ID ) {
+            result = Constant::Int( 0 ); // Ran off the end
+        }
+        previous = block;
+        block = next;
+    }
+
+    results.emplace( std::move( key ), *result );
+    return result;
+}
+
+}
+
+uint32_t Lumin::Compiler::IR::EvaluateConstants( Module& module, const EvaluationLimits& limits ) {
+    Interpreter interpreter( module, limits );
+    uint32_t replaced = 0;
+    std::vector<std::optional<Constant>> known;
+    std::vector<Constant> arguments;
+
+    for ( Function& function : module.functions ) {
+        const bool callsConstexpr = std::ranges::any_of( function.values, [&module]( const Instruction& instruction ) {
+            return instruction.op == Op::CALL && module.functions[instruction.index].isConstexpr;
+        } );
+        if ( !callsConstexpr && function.constantInitializers.empty() ) {
+            continue;
+        }
+
+        // What is known without running anything, reverse post order puts
+        // definitions before their uses
+        known.assign( function.values.size(), std::nullopt );
+        std::vector<std::pair<ValueId, Constant>> replacements;
+        std::unordered_map<ValueId, std::string> failures;
+
+        for ( const BlockId block : ReversePostOrder( function ) ) {
+            for ( const ValueId value : function.blocks[block].instructions ) {
+                const Instruction& instruction = function.values[value];
+                const auto operands = function.Operands( value );
+                switch ( instruction.op ) {
+                    case Op::CONST_INT: case Op::CONST_FLOAT:
+                        known[value] = Constant::Of( instruction );
+                        break;
+                    case Op::COPY:
+                        known[value] = known[operands[0]];
+                        break;
+                    case Op::NEG:
+                        if ( known[operands[0]] ) {
+                            known[value] = Negate( *known[operands[0]] );
+                        }
+                        break;
+                    case Op::TO_FLOAT:
+                        if ( known[operands[0]] ) {
+                            known[value] = ToFloat( *known[operands[0]] );
+                        }
+                        break;
+                    case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIV:
+                    case Op::CMP_EQ: case Op::CMP_NE: case Op::CMP_LT: case Op::CMP_LE: case Op::CMP_GT: case Op::CMP_GE:
+                        if ( known[operands[0]] && known[operands[1]] ) {
+                            known[value] = Fold( instruction.op, *known[operands[0]], *known[operands[1]] );
+                        }
+                        break;
+                    case Op::CALL: {
+                        const Function& callee = module.functions[instruction.index];
+                        if ( !callee.isConstexpr || !callee.returnsValue
+                             || !std::ranges::all_of( operands, [&known]( const ValueId operand ) { return known[operand].has_value(); } ) ) {
+                            break;
+                        }
+
+                        arguments.clear();
+                        for ( const ValueId operand : operands ) {
+                            arguments.push_back( *known[operand] );
+                        }
+                        known[value] = interpreter.Evaluate( instruction.index, arguments );
+                        if ( known[value] ) {
+                            replacements.emplace_back( value, *known[value] );
+                        } else {
+                            failures.emplace( value, interpreter.Failure() );
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        }
+
+        for ( const auto& [value, variable] : function.constantInitializers ) {
+            const ValueId source = function.Resolve( value );
+            if ( !known[source] ) {
+                const auto failure = failures.find( source );
+                throw std::runtime_error( std::format( "The initializer of constexpr '{}' in '{}' is not a constant: {}",
+                    variable, function.name, failure != failures.end() ? failure->second : "it depends on values only known at runtime" ) );
+            }
+            replacements.emplace_back( source, *known[source] );
+        }
+        function.constantInitializers.clear();
+
+        for ( const auto& [value, constant] : replacements ) {
+            const Op op = function.values[value].op;
+            if ( op != Op::CONST_INT && op != Op::CONST_FLOAT ) {
+                function.ReplaceWithConstant( value, constant.ToInstruction() );
+                ++replaced;
+            }
+        }
+    }
+    return replaced;
+}
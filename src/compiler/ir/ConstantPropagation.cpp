@@ -0,0 +1,339 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <ir/Constant.hpp>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+struct LatticeValue : Constant {
+    enum class State : uint8_t { TOP, CONSTANT, BOTTOM } state = State::TOP;
+
+    bool operator==( const LatticeValue& other ) const {
+        if ( state != other.state ) {
+            return false;
+        }
+        // Bit patterns, so NaN and -0.0 settle instead of flipping forever
+        return state != State::CONSTANT || Constant::operator==( other );
+    }
+};
+
+using State = LatticeValue::State;
+
+LatticeValue Bottom() {
+    LatticeValue value;
+    value.state = State::BOTTOM;
+    return value;
+}
+
+LatticeValue Known( const Constant& constant ) {
+    LatticeValue value;
+    static_cast<Constant&>( value ) = constant;
+    value.state = State::CONSTANT;
+    return value;
+}
+
+class ConstantPropagation {
+public:
+    explicit ConstantPropagation( Function& function ) : function( function ) {}
+
+    bool Run();
+
+private:
+    void BuildUses();
+    void MarkEdge( BlockId from, BlockId to );
+    void VisitBlock( BlockId block );
+    void VisitInstruction( ValueId value );
+    LatticeValue Evaluate( ValueId value ) const;
+    bool Rewrite();
+
+    Function& function;
+    std::vector<LatticeValue> lattice;
+    std::vector<bool> executableBlocks;
+    // Flat, edgeBegin[block] + predecessor index
+    std::vector<bool> executableEdges;
+    std::vector<uint32_t> edgeBegin;
+    // Users of each value in one array, useBegin[value] to useBegin[value + 1]
+    std::vector<uint32_t> useBegin;
+    std::vector<ValueId> uses;
+    std::vector<std::pair<BlockId, BlockId>> edgeWork;
+    std::vector<ValueId> valueWork;
+};
+
+void ConstantPropagation::BuildUses() {
+    const size_t count = function.values.size();
+    useBegin.assign( count + 1, 0 );
+    for ( ValueId value = 0; value < count; ++value ) {
+        if ( function.values[value].op != Op::NOP ) {
+            for ( const ValueId operand : function.Operands( value ) ) {
+                ++useBegin[operand + 1];
+            }
+        }
+    }
+    for ( size_t i = 0; i < count; ++i ) {
+        useBegin[i + 1] += useBegin[i];
+    }
+
+    uses.resize( useBegin[count] );
+    std::vector<uint32_t> next( useBegin.begin(), useBegin.end() - 1 );
+    for ( ValueId value = 0; value < count; ++value ) {
+        if ( function.values[value].op != Op::NOP ) {
+            for ( const ValueId operand : function.Operands( value ) ) {
+                uses[next[operand]++] = value;
+            }
+        }
+    }
+}
+
+void ConstantPropagation::MarkEdge( const BlockId from, const BlockId to ) {
+    edgeWork.emplace_back( from, to );
+}
+
+LatticeValue ConstantPropagation::Evaluate( const ValueId value ) const {
+    const Instruction& instruction = function.values[value];
+    const auto operands = function.Operands( value );
+
+    switch ( instruction.op ) {
+        case Op::CONST_INT: case Op::CONST_FLOAT: return Known( Constant::Of( instruction ) );
+        case Op::COPY: return lattice[operands[0]];
+        case Op::PHI: {
+            const uint32_t edges = edgeBegin[instruction.block];
+            LatticeValue merged;
+            for ( size_t i = 0; i < operands.size(); ++i ) {
+                if ( !executableEdges[edges + i] ) {
+                    continue;
+                }
+                const LatticeValue& incoming = lattice[operands[i]];
+                if ( incoming.state == State::TOP ) {
+                    continue;
+                }
+                if ( incoming.state == State::BOTTOM || ( merged.state == State::CONSTANT && !( merged == incoming ) ) ) {
+                    return Bottom();
+                }
+                merged = incoming;
+            }
+            return merged;
+        }
+        case Op::NEG: {
+            const LatticeValue& operand = lattice[operands[0]];
+            if ( operand.state != State::CONSTANT ) {
+                return operand;
+            }
+            return Known( Negate( operand ) );
+        }
+        case Op::TO_FLOAT: {
+            const LatticeValue& operand = lattice[operands[0]];
+            if ( operand.state != State::CONSTANT ) {
+                return operand;
+            }
+            return Known( ToFloat( operand ) );
+        }
+        case Op::IS_NULL: {
+            // Arrays are not in the lattice, only where one comes from tells
+            const Op source = function.values[function.Resolve( operands[0] )].op;
+            return source == Op::NEW_ARRAY ? Known( Constant::Int( 0 ) )
+                : source == Op::CONST_NULL ? Known( Constant::Int( 1 ) ) : Bottom();
+        }
+        case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIV:
+        case Op::CMP_EQ: case Op::CMP_NE: case Op::CMP_LT: case Op::CMP_LE: case Op::CMP_GT: case Op::CMP_GE: {
+            const LatticeValue& left = lattice[operands[0]];
+            const LatticeValue& right = lattice[operands[1]];
+            if ( left.state == State::BOTTOM || right.state == State::BOTTOM ) {
+                return Bottom();
+            }
+            if ( left.state == State::TOP || right.state == State::TOP ) {
+                return {};
+            }
+            const auto folded = Fold( instruction.op, left, right );
+            return folded ? Known( *folded ) : Bottom();
+        }
+        default:
+            return Bottom();
+    }
+}
+
+void ConstantPropagation::VisitInstruction( const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    if ( instruction.op == Op::JUMP ) {
+        MarkEdge( instruction.block, instruction.targets[0] );
+        return;
+    }
+    if ( instruction.op == Op::BRANCH ) {
+        const LatticeValue& condition = lattice[function.Operands( value )[0]];
+        if ( condition.state == State::BOTTOM || ( condition.state == State::CONSTANT && condition.isFloat ) ) {
+            MarkEdge( instruction.block, instruction.targets[0] );
+            MarkEdge( instruction.block, instruction.targets[1] );
+        } else if ( condition.state == State::CONSTANT ) {
+            MarkEdge( instruction.block, instruction.targets[condition.intValue != 0 ? 0 : 1] );
+        }
+        return;
+    }
+    if ( instruction.op == Op::SWITCH ) {
+        const LatticeValue& key = lattice[function.Operands( value )[0]];
+        if ( key.state == State::BOTTOM ) {
+            for ( const BlockId target : function.switches[instruction.index].targets ) {
+                MarkEdge( instruction.block, target );
+            }
+        } else if ( key.state == State::CONSTANT ) {
+            MarkEdge( instruction.block, function.switches[instruction.index].Target( key.intValue ) );
+        }
+        return;
+    }
+    if ( instruction.op == Op::RETURN || instruction.op == Op::NOP ) {
+        return;
+    }
+
+    const LatticeValue updated = Evaluate( value );
+    if ( !( updated == lattice[value] ) ) {
+        lattice[value] = updated;
+        valueWork.push_back( value );
+    }
+}
+
+void ConstantPropagation::VisitBlock( const BlockId block ) {
+    for ( const ValueId value : function.blocks[block].instructions ) {
+        VisitInstruction( value );
+    }
+}
+
+bool ConstantPropagation::Run() {
+    lattice.assign( function.values.size(), {} );
+    executableBlocks.assign( function.blocks.size(), false );
+    edgeBegin.resize( function.blocks.size() );
+    uint32_t edgeCount = 0;
+    for ( BlockId block = 0; block < function.blocks.size(); ++block ) {
+        edgeBegin[block] = edgeCount;
+        edgeCount += static_cast<uint32_t>( function.blocks[block].predecessors.size() );
+    }
+    executableEdges.assign( edgeCount, false );
+    BuildUses();
+
+    executableBlocks[0] = true;
+    VisitBlock( 0 );
+
+    while ( !edgeWork.empty() || !valueWork.empty() ) {
+        while ( !edgeWork.empty() ) {
+            const auto [from, to] = edgeWork.back();
+            edgeWork.pop_back();
+
+            const auto& predecessors = function.blocks[to].predecessors;
+            bool changed = false;
+            for ( size_t i = 0; i < predecessors.size(); ++i ) {
+                if ( predecessors[i] == from && !executableEdges[edgeBegin[to] + i] ) {
+                    executableEdges[edgeBegin[to] + i] = true;
+                    changed = true;
+                }
+            }
+            if ( !changed ) {
+                continue;
+            }
+
+            if ( !executableBlocks[to] ) {
+                executableBlocks[to] = true;
+                VisitBlock( to );
+            } else {
+                // Only the phis can see the new edge
+                for ( const ValueId value : function.blocks[to].instructions ) {
+                    if ( function.values[value].op != Op::PHI ) {
+                        break;
+                    }
+                    VisitInstruction( value );
+                }
+            }
+        }
+
+        while ( !valueWork.empty() ) {
+            const ValueId value = valueWork.back();
+            valueWork.pop_back();
+            for ( uint32_t i = useBegin[value]; i < useBegin[value + 1]; ++i ) {
+                const ValueId user = uses[i];
+                if ( executableBlocks[function.values[user].block] ) {
+                    VisitInstruction( user );
+                }
+            }
+        }
+    }
+
+    return Rewrite();
+}
+
+bool ConstantPropagation::Rewrite() {
+    bool changed = false;
+
+    for ( ValueId value = 0; value < function.values.size(); ++value ) {
+        Instruction& instruction = function.values[value];
+        const LatticeValue& result = lattice[value];
+        if ( result.state != State::CONSTANT || instruction.op == Op::CONST_INT || instruction.op == Op::CONST_FLOAT
+             || instruction.op == Op::NOP || !executableBlocks[instruction.block] ) {
+            continue;
+        }
+
+        function.ReplaceWithConstant( value, result.ToInstruction() );
+        changed = true;
+    }
+
+    for ( BlockId block = 0; block < function.blocks.size(); ++block ) {
+        const ValueId terminator = executableBlocks[block] ? function.Terminator( block ) : NO_ID;
+        if ( terminator == NO_ID || ( function.values[terminator].op != Op::BRANCH && function.values[terminator].op != Op::SWITCH ) ) {
+            continue;
+        }
+
+        const LatticeValue& condition = lattice[function.Operands( terminator )[0]];
+        if ( condition.state != State::CONSTANT || condition.isFloat ) {
+            continue;
+        }
+
+        if ( function.values[terminator].op == Op::SWITCH ) {
+            const SwitchTable& table = function.switches[function.values[terminator].index];
+            const BlockId taken = table.Target( condition.intValue );
+            for ( const BlockId dropped : std::vector( table.targets ) ) {
+                if ( dropped != taken ) {
+                    function.RemoveEdge( block, dropped );
+                }
+            }
+            Instruction& jump = function.values[terminator];
+            jump.op = Op::JUMP;
+            jump.operandCount = 0;
+            jump.targets = { taken, NO_ID };
+            changed = true;
+            continue;
+        }
+
+        Instruction& branch = function.values[terminator];
+        const BlockId taken = branch.targets[condition.intValue != 0 ? 0 : 1];
+        const BlockId dropped = branch.targets[condition.intValue != 0 ? 1 : 0];
+        branch.op = Op::JUMP;
+        branch.operandCount = 0;
+        branch.targets = { taken, NO_ID };
+        if ( dropped != taken ) {
+            function.RemoveEdge( block, dropped );
+        }
+        changed = true;
+    }
+
+    const size_t removedBefore = std::ranges::count_if( function.blocks, []( const Block& block ) { return block.removed; } );
+    RemoveUnreachableBlocks( function );
+    const size_t removedAfter = std::ranges::count_if( function.blocks, []( const Block& block ) { return block.removed; } );
+    return changed || removedAfter != removedBefore;
+}
+
+}
+
+bool Lumin::Compiler::IR::PropagateConstants( Function& function ) {
+    return ConstantPropagation( function ).Run();
+}
@@ -0,0 +1,75 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// A phi whose operands are all one value besides itself, or NO_ID
+ValueId TrivialPhiValue( const Function& function, const ValueId phi ) {
+    ValueId same = NO_ID;
+    for ( const ValueId operand : function.Operands( phi ) ) {
+        const ValueId resolved = function.Resolve( operand );
+        if ( resolved == phi || resolved == same ) {
+            continue;
+        }
+        if ( same != NO_ID ) {
+            return NO_ID;
+        }
+        same = resolved;
+    }
+    return same;
+}
+
+}
+
+bool Lumin::Compiler::IR::PropagateCopies( Function& function ) {
+    bool changed = false;
+
+    // Removing one phi can make another trivial, so run until nothing changes
+    for ( bool removedPhi = true; removedPhi; ) {
+        removedPhi = false;
+        for ( ValueId value = 0; value < function.values.size(); ++value ) {
+            if ( function.values[value].op != Op::PHI ) {
+                continue;
+            }
+            if ( const ValueId same = TrivialPhiValue( function, value ); same != NO_ID ) {
+                function.ReplaceWith( value, same );
+                removedPhi = true;
+                changed = true;
+            }
+        }
+    }
+
+    for ( ValueId value = 0; value < function.values.size(); ++value ) {
+        if ( function.values[value].op == Op::NOP ) {
+            continue;
+        }
+        for ( ValueId& operand : function.Operands( value ) ) {
+            operand = function.Resolve( operand );
+        }
+    }
+
+    for ( ValueId value = 0; value < function.values.size(); ++value ) {
+        if ( function.values[value].op == Op::COPY ) {
+            function.values[value].op = Op::NOP;
+            changed = true;
+        }
+    }
+    CompactBlocks( function );
+    return changed;
+}
@@ -0,0 +1,55 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+bool Lumin::Compiler::IR::EliminateDeadCode( Function& function ) {
+    std::vector<bool> live( function.values.size(), false );
+    std::vector<ValueId> work;
+
+    // Terminators, calls and divisions are kept whether or not their result is used
+    for ( ValueId value = 0; value < function.values.size(); ++value ) {
+        const Op op = function.values[value].op;
+        if ( op != Op::NOP && !IsPure( op ) ) {
+            live[value] = true;
+            work.push_back( value );
+        }
+    }
+
+    while ( !work.empty() ) {
+        const ValueId value = work.back();
+        work.pop_back();
+        for ( const ValueId operand : function.Operands( value ) ) {
+            if ( !live[operand] ) {
+                live[operand] = true;
+                work.push_back( operand );
+            }
+        }
+    }
+
+    bool changed = false;
+    for ( ValueId value = 0; value < function.values.size(); ++value ) {
+        if ( !live[value] && function.values[value].op != Op::NOP ) {
+            function.values[value].op = Op::NOP;
+            changed = true;
+        }
+    }
+    if ( changed ) {
+        CompactBlocks( function );
+    }
+    return changed;
+}
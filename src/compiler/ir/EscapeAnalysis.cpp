@@ -0,0 +1,223 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// Where a NEW_ARRAY's reference goes
+struct ArrayUses {
+    std::vector<ValueId> accesses; // LOADs and STOREs of its elements
+    bool vectorized = false;       // Operand of a VECTOR
+    bool escapes = false;          // Passed, returned, merged by a phi or anything else
+};
+
+std::vector<ArrayUses> FindArrayUses( const Function& function ) {
+    std::vector<ArrayUses> uses( function.values.size() );
+    for ( const Block& block : function.blocks ) {
+        if ( block.removed ) {
+            continue;
+        }
+        for ( const ValueId user : block.instructions ) {
+            const Instruction& instruction = function.values[user];
+            const auto operands = function.Operands( user );
+            for ( size_t i = 0; i < operands.size(); ++i ) {
+                const ValueId value = function.Resolve( operands[i] );
+                if ( function.values[value].op != Op::NEW_ARRAY ) {
+                    continue;
+                }
+                if ( i == 0 && ( instruction.op == Op::LOAD || instruction.op == Op::STORE ) ) {
+                    uses[value].accesses.push_back( user );
+                } else if ( i < 3 && instruction.op == Op::VECTOR ) {
+                    uses[value].vectorized = true;
+                } else {
+                    uses[value].escapes = true;
+                }
+            }
+        }
+    }
+    return uses;
+}
+
+// The constant an operand resolves to, if it is an int constant
+std::optional<int32_t> ConstantInt( const Function& function, const ValueId operand ) {
+    const Instruction& instruction = function.values[function.Resolve( operand )];
+    if ( instruction.op != Op::CONST_INT ) {
+        return std::nullopt;
+    }
+    return instruction.intValue;
+}
+
+// Turns the elements of one array into SSA values. Every element is a
+// variable the STOREs assign and the LOADs read, and the NEW_ARRAY assigns
+// 0 to all of them. Reads are resolved like Braun et al.'s construction on a
+// complete CFG: the last assignment in the block, or a phi where
+// predecessors meet. Every access is dominated by the allocation, so the
+// walk back ends at it.
+class ScalarReplacement {
+public:
+    ScalarReplacement( Function& function, const ValueId array, const uint32_t length )
+        : function( function ), array( array ), element( ElementOf( function.values[array].type ) ),
+          length( length ), atEnd( length ), atEntry( length ) {}
+
+    void Run( const std::vector<ValueId>& accesses );
+
+private:
+    Function& function;
+    ValueId array;
+    Type element;
+    uint32_t length;
+    ValueId zero = NO_ID;
+    std::vector<std::unordered_map<BlockId, ValueId>> atEnd;   // Per element, last assignment in a block
+    std::vector<std::unordered_map<BlockId, ValueId>> atEntry; // Per element, resolved reads at block entry
+
+    ValueId ReadAtEnd( uint32_t index, BlockId block );
+    ValueId ReadAtEntry( uint32_t index, BlockId block );
+};
+
+ValueId ScalarReplacement::ReadAtEnd( const uint32_t index, const BlockId block ) {
+    if ( const auto found = atEnd[index].find( block ); found != atEnd[index].end() ) {
+        return found->second;
+    }
+    return ReadAtEntry( index, block );
+}
+
+ValueId ScalarReplacement::ReadAtEntry( const uint32_t index, const BlockId block ) {
+    if ( const auto found = atEntry[index].find( block ); found != atEntry[index].end() ) {
+        return found->second;
+    }
+
+    const std::vector<BlockId> predecessors = function.blocks[block].predecessors;
+    if ( predecessors.size() == 1 ) {
+        const ValueId value = ReadAtEnd( index, predecessors[0] );
+        atEntry[index][block] = value;
+        return value;
+    }
+
+    // Recorded before the operands are read, so a loop back to this block
+    // finds the phi. Trivial ones are left to copy propagation.
+    const ValueId phi = function.Append( block, MakeInstruction( Op::PHI, element ) );
+    atEntry[index][block] = phi;
+    std::vector<ValueId> operands;
+    operands.reserve( predecessors.size() );
+    for ( const BlockId predecessor : predecessors ) {
+        operands.push_back( ReadAtEnd( index, predecessor ) );
+    }
+    function.SetOperands( phi, operands );
+    return phi;
+}
+
+void ScalarReplacement::Run( const std::vector<ValueId>& accesses ) {
+    const BlockId allocation = function.values[array].block;
+    function.ReplaceWithConstant( array, MakeZero( element ) );
+    zero = array;
+
+    // Blocks in which each element is assigned, the allocation's included
+    std::vector<BlockId> blocks { allocation };
+    for ( const ValueId access : accesses ) {
+        blocks.push_back( function.values[access].block );
+    }
+    std::ranges::sort( blocks );
+    const auto [first, last] = std::ranges::unique( blocks );
+    blocks.erase( first, last );
+
+    for ( const BlockId block : blocks ) {
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            if ( value == array ) {
+                for ( uint32_t index = 0; index < length; ++index ) {
+                    atEnd[index][block] = zero;
+                }
+                continue;
+            }
+            if ( function.values[value].op != Op::STORE || function.Resolve( function.Operands( value )[0] ) != array ) {
+                continue;
+            }
+            const auto operands = function.Operands( value );
+            atEnd[static_cast<uint32_t>( *ConstantInt( function, operands[1] ) )][block] = function.Resolve( operands[2] );
+        }
+    }
+
+    // Loads read the assignment before them, walking each block in order
+    for ( const BlockId block : blocks ) {
+        std::vector<ValueId> current( length, NO_ID );
+        const std::vector<ValueId> instructions = function.blocks[block].instructions;
+        for ( const ValueId value : instructions ) {
+            if ( value == array ) {
+                std::ranges::fill( current, zero );
+                continue;
+            }
+            const Instruction& instruction = function.values[value];
+            if ( ( instruction.op != Op::LOAD && instruction.op != Op::STORE )
+                 || function.Resolve( function.Operands( value )[0] ) != array ) {
+                continue;
+            }
+
+            const auto operands = function.Operands( value );
+            const auto index = static_cast<uint32_t>( *ConstantInt( function, operands[1] ) );
+            if ( instruction.op == Op::STORE ) {
+                current[index] = function.Resolve( operands[2] );
+                function.values[value].op = Op::NOP;
+            } else {
+                function.ReplaceWith( value, current[index] != NO_ID ? current[index] : ReadAtEntry( index, block ) );
+            }
+        }
+    }
+}
+
+}
+
+uint32_t Lumin::Compiler::IR::OptimizeAllocations( Function& function, const AllocationOptions& options ) {
+    const std::vector<ArrayUses> uses = FindArrayUses( function );
+    uint32_t changes = 0;
+
+    for ( ValueId value = 0; value < uses.size(); ++value ) {
+        const ArrayUses& arrayUses = uses[value];
+        if ( function.values[value].op != Op::NEW_ARRAY || arrayUses.escapes ) {
+            continue;
+        }
+
+        // A short array indexed only by constants within its bounds needs no
+        // memory at all. An access out of bounds has to fail at runtime, so
+        // it keeps the array.
+        const std::optional<int32_t> length = ConstantInt( function, function.Operands( value )[0] );
+        bool replaceable = options.scalarReplace && !arrayUses.vectorized && length
+                           && *length >= 0 && static_cast<uint32_t>( *length ) <= options.maxScalarElements;
+        for ( const ValueId access : arrayUses.accesses ) {
+            if ( !replaceable ) {
+                break;
+            }
+            const std::optional<int32_t> index = ConstantInt( function, function.Operands( access )[1] );
+            replaceable = index && *index >= 0 && *index < *length;
+        }
+
+        if ( replaceable ) {
+            ScalarReplacement( function, value, static_cast<uint32_t>( *length ) ).Run( arrayUses.accesses );
+            ++changes;
+        } else if ( options.allocateInFrame ) {
+            function.values[value].index = 1;
+            ++changes;
+        }
+    }
+
+    if ( changes != 0 ) {
+        CompactBlocks( function );
+    }
+    return changes;
+}
@@ -0,0 +1,582 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <format>
+#include <ir/IR.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+bool Lumin::Compiler::IR::IsTerminator( const Op op ) {
+    return op == Op::JUMP || op == Op::BRANCH || op == Op::SWITCH || op == Op::RETURN;
+}
+
+bool Lumin::Compiler::IR::IsPure( const Op op ) {
+    switch ( op ) {
+        case Op::CONST_INT: case Op::CONST_FLOAT: case Op::PARAM:
+        case Op::ADD: case Op::SUB: case Op::MUL: case Op::NEG: case Op::TO_FLOAT:
+        case Op::CMP_EQ: case Op::CMP_NE: case Op::CMP_LT: case Op::CMP_LE: case Op::CMP_GT: case Op::CMP_GE:
+        case Op::PHI: case Op::COPY: case Op::CONST_NULL: case Op::IS_NULL:
+            return true;
+        default:
+            // DIV can trap on a zero divisor, so it stays where it was written.
+            // Array accesses can trap too and see each other's stores.
+            return false;
+    }
+}
+
+const char* Lumin::Compiler::IR::TypeName( const Type type ) {
+    switch ( type ) {
+        case Type::INT: return "int";
+        case Type::FLOAT: return "float";
+        case Type::INT_ARRAY: return "int[]";
+        case Type::FLOAT_ARRAY: return "float[]";
+    }
+    return "?";
+}
+
+const char* Lumin::Compiler::IR::OpName( const Op op ) {
+    switch ( op ) {
+        case Op::CONST_INT: return "iconst";
+        case Op::CONST_FLOAT: return "fconst";
+        case Op::PARAM: return "param";
+        case Op::ADD: return "add";
+        case Op::SUB: return "sub";
+        case Op::MUL: return "mul";
+        case Op::DIV: return "div";
+        case Op::NEG: return "neg";
+        case Op::TO_FLOAT: return "tofloat";
+        case Op::CONST_NULL: return "null";
+        case Op::IS_NULL: return "isnull";
+        case Op::CMP_EQ: return "eq";
+        case Op::CMP_NE: return "ne";
+        case Op::CMP_LT: return "lt";
+        case Op::CMP_LE: return "le";
+        case Op::CMP_GT: return "gt";
+        case Op::CMP_GE: return "ge";
+        case Op::CALL: return "call";
+        case Op::PHI: return "phi";
+        case Op::COPY: return "copy";
+        case Op::NEW_ARRAY: return "newarray";
+        case Op::LOAD: return "load";
+        case Op::STORE: return "store";
+        case Op::VECTOR: return "vector";
+        case Op::SNAPSHOT: return "snapshot";
+        case Op::JUMP: return "jump";
+        case Op::BRANCH: return "branch";
+        case Op::SWITCH: return "switch";
+        case Op::RETURN: return "ret";
+        case Op::NOP: return "nop";
+    }
+    return "?";
+}
+
+BlockId SwitchTable::Target( const int32_t key ) const {
+    const auto position = std::ranges::lower_bound( keys, key );
+    return position != keys.end() && *position == key ? targets[static_cast<size_t>( position - keys.begin() )] : targets.back();
+}
+
+BlockId Function::AddBlock() {
+    blocks.emplace_back();
+    return static_cast<BlockId>( blocks.size() - 1 );
+}
+
+ValueId Function::Append( const BlockId block, Instruction instruction, const std::span<const ValueId> operands ) {
+    const auto value = static_cast<ValueId>( values.size() );
+    instruction.block = block;
+    instruction.operandBegin = static_cast<uint32_t>( operandPool.size() );
+    instruction.operandCount = static_cast<uint32_t>( operands.size() );
+    operandPool.insert( operandPool.end(), operands.begin(), operands.end() );
+    values.push_back( instruction );
+
+    auto& instructions = blocks[block].instructions;
+    if ( instruction.op == Op::PHI ) {
+        const auto firstOther = std::ranges::find_if( instructions, [this]( const ValueId id ) {
+            return values[id].op != Op::PHI;
+        } );
+        instructions.insert( firstOther, value );
+    } else if ( !instructions.empty() && IsTerminator( values[instructions.back()].op ) ) {
+        // Values materialized late, like the 0 read in an unreachable block,
+        // still go before the terminator
+        instructions.insert( instructions.end() - 1, value );
+    } else {
+        instructions.push_back( value );
+    }
+    return value;
+}
+
+void Function::SetOperands( const ValueId value, const std::span<const ValueId> operands ) {
+    Instruction& instruction = values[value];
+    if ( operands.size() > instruction.operandCount ) {
+        // Grown ranges move to the end of the pool, the old slots are abandoned
+        std::vector<ValueId> copy( operands.begin(), operands.end() );
+        instruction.operandBegin = static_cast<uint32_t>( operandPool.size() );
+        operandPool.insert( operandPool.end(), copy.begin(), copy.end() );
+    } else {
+        std::copy( operands.begin(), operands.end(), operandPool.begin() + instruction.operandBegin );
+    }
+    instruction.operandCount = static_cast<uint32_t>( operands.size() );
+}
+
+ValueId Function::Terminator( const BlockId block ) const {
+    const auto& instructions = blocks[block].instructions;
+    if ( instructions.empty() || !IsTerminator( values[instructions.back()].op ) ) {
+        return NO_ID;
+    }
+    return instructions.back();
+}
+
+std::span<const BlockId> Function::Successors( const BlockId block ) const {
+    const ValueId terminator = Terminator( block );
+    if ( terminator == NO_ID ) {
+        return {};
+    }
+
+    const Instruction& instruction = values[terminator];
+    switch ( instruction.op ) {
+        case Op::JUMP: return { instruction.targets.data(), 1 };
+        case Op::BRANCH: return { instruction.targets.data(), 2 };
+        case Op::SWITCH: return switches[instruction.index].targets;
+        default: return {};
+    }
+}
+
+std::span<BlockId> Function::Targets( const ValueId terminator ) {
+    Instruction& instruction = values[terminator];
+    switch ( instruction.op ) {
+        case Op::JUMP: return { instruction.targets.data(), 1 };
+        case Op::BRANCH: return { instruction.targets.data(), 2 };
+        case Op::SWITCH: return switches[instruction.index].targets;
+        default: return {};
+    }
+}
+
+ValueId Function::Resolve( ValueId value ) const {
+    while ( values[value].op == Op::COPY ) {
+        value = operandPool[values[value].operandBegin];
+    }
+    return value;
+}
+
+void Function::ReplaceWith( const ValueId value, const ValueId replacement ) {
+    const bool wasPhi = values[value].op == Op::PHI;
+    values[value].op = Op::COPY;
+    SetOperands( value, std::span( &replacement, 1 ) );
+    if ( wasPhi ) {
+        LeavePhiGroup( value );
+    }
+}
+
+// Moves an instruction that stopped being a phi behind the block's phis, so
+// the phi group at the top stays contiguous
+void Function::LeavePhiGroup( const ValueId value ) {
+    auto& instructions = blocks[values[value].block].instructions;
+    const auto position = std::ranges::find( instructions, value );
+    const auto firstOther = std::find_if( position + 1, instructions.end(), [this]( const ValueId id ) {
+        return values[id].op != Op::PHI;
+    } );
+    std::rotate( position, position + 1, firstOther );
+}
+
+void Function::ReplaceWithConstant( const ValueId value, const Instruction& constant ) {
+    Instruction& instruction = values[value];
+    const bool wasPhi = instruction.op == Op::PHI;
+    instruction.op = constant.op;
+    instruction.type = constant.type;
+    instruction.intValue = constant.intValue;
+    instruction.floatValue = constant.floatValue;
+    instruction.operandCount = 0;
+
+    if ( wasPhi ) {
+        LeavePhiGroup( value );
+    }
+}
+
+void Function::RemoveEdge( const BlockId from, const BlockId to ) {
+    auto& predecessors = blocks[to].predecessors;
+    const auto position = std::ranges::find( predecessors, from );
+    if ( position == predecessors.end() ) {
+        return;
+    }
+
+    const auto index = static_cast<size_t>( position - predecessors.begin() );
+    predecessors.erase( position );
+    for ( const ValueId value : blocks[to].instructions ) {
+        if ( values[value].op != Op::PHI ) {
+            break;
+        }
+        std::vector<ValueId> operands( Operands( value ).begin(), Operands( value ).end() );
+        operands.erase( operands.begin() + static_cast<std::ptrdiff_t>( index ) );
+        SetOperands( value, operands );
+    }
+}
+
+std::vector<BlockId> Lumin::Compiler::IR::ReversePostOrder( const Function& function ) {
+    std::vector<BlockId> order;
+    if ( function.blocks.empty() ) {
+        return order;
+    }
+
+    std::vector<bool> visited( function.blocks.size(), false );
+    // Explicit stack of (block, next successor) so deep CFGs cannot overflow
+    std::vector<std::pair<BlockId, size_t>> stack { { 0, 0 } };
+    visited[0] = true;
+    while ( !stack.empty() ) {
+        auto& [block, next] = stack.back();
+        const auto successors = function.Successors( block );
+        if ( next < successors.size() ) {
+            const BlockId successor = successors[next++];
+            if ( !visited[successor] && !function.blocks[successor].removed ) {
+                visited[successor] = true;
+                stack.emplace_back( successor, 0 );
+            }
+            continue;
+        }
+        order.push_back( block );
+        stack.pop_back();
+    }
+
+    std::ranges::reverse( order );
+    return order;
+}
+
+bool DominatorTree::Dominates( const BlockId a, BlockId b ) const {
+    while ( b != NO_ID ) {
+        if ( a == b ) {
+            return true;
+        }
+        b = idom[b];
+    }
+    return false;
+}
+
+DominatorTree Lumin::Compiler::IR::ComputeDominators( const Function& function ) {
+    DominatorTree tree;
+    tree.order = ReversePostOrder( function );
+    tree.idom.assign( function.blocks.size(), NO_ID );
+    tree.children.resize( function.blocks.size() );
+    if ( tree.order.empty() ) {
+        return tree;
+    }
+
+    std::vector<uint32_t> position( function.blocks.size(), NO_ID );
+    for ( uint32_t i = 0; i < tree.order.size(); ++i ) {
+        position[tree.order[i]] = i;
+    }
+
+    const auto intersect = [&]( BlockId a, BlockId b ) {
+        while ( a != b ) {
+            while ( position[a] > position[b] ) a = tree.idom[a];
+            while ( position[b] > position[a] ) b = tree.idom[b];
+        }
+        return a;
+    };
+
+    const BlockId entry = tree.order.front();
+    tree.idom[entry] = entry;
+    bool changed = true;
+    while ( changed ) {
+        changed = false;
+        for ( size_t i = 1; i < tree.order.size(); ++i ) {
+            const BlockId block = tree.order[i];
+            BlockId dominator = NO_ID;
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                if ( position[predecessor] == NO_ID || tree.idom[predecessor] == NO_ID ) {
+                    continue;
+                }
+                dominator = dominator == NO_ID ? predecessor : intersect( predecessor, dominator );
+            }
+            if ( dominator != tree.idom[block] ) {
+                tree.idom[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    tree.idom[entry] = NO_ID;
+    for ( const BlockId block : tree.order ) {
+        if ( tree.idom[block] != NO_ID ) {
+            tree.children[tree.idom[block]].push_back( block );
+        }
+    }
+    return tree;
+}
+
+bool LoopForest::Contains( const uint32_t loop, const BlockId block ) const {
+    // Blocks added since the analysis are in no loop
+    if ( block >= innermost.size() ) {
+        return false;
+    }
+    for ( uint32_t inner = innermost[block]; inner != NO_ID; inner = loops[inner].parent ) {
+        if ( inner == loop ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LoopForest Lumin::Compiler::IR::FindLoops( const Function& function, const DominatorTree& dominators ) {
+    LoopForest forest;
+    forest.innermost.assign( function.blocks.size(), NO_ID );
+
+    std::vector<uint32_t> position( function.blocks.size(), NO_ID );
+    for ( uint32_t i = 0; i < dominators.order.size(); ++i ) {
+        position[dominators.order[i]] = i;
+    }
+
+    std::vector<uint32_t> loopOfHeader( function.blocks.size(), NO_ID );
+    for ( const BlockId block : dominators.order ) {
+        for ( const BlockId successor : function.Successors( block ) ) {
+            // Dominators come first in reverse post order, so only edges
+            // going back can be back edges and the walk up the tree stops
+            // once it has passed the header
+            BlockId dominator = block;
+            while ( dominator != NO_ID && position[dominator] > position[successor] ) {
+                dominator = dominators.idom[dominator];
+            }
+            if ( dominator != successor ) {
+                continue;
+            }
+            if ( loopOfHeader[successor] == NO_ID ) {
+                loopOfHeader[successor] = static_cast<uint32_t>( forest.loops.size() );
+                forest.loops.emplace_back().header = successor;
+            }
+            auto& latches = forest.loops[loopOfHeader[successor]].latches;
+            if ( std::ranges::find( latches, block ) == latches.end() ) {
+                latches.push_back( block );
+            }
+        }
+    }
+
+    // A header comes after the headers of the loops around it in reverse
+    // post order, so sorting by it backwards puts inner loops first
+    std::ranges::sort( forest.loops, [&position]( const Loop& a, const Loop& b ) {
+        return position[a.header] > position[b.header];
+    } );
+
+    std::vector<bool> inLoop( function.blocks.size(), false );
+    std::vector<BlockId> work;
+    for ( auto index = static_cast<uint32_t>( forest.loops.size() ); index-- > 0; ) {
+        Loop& loop = forest.loops[index];
+        inLoop[loop.header] = true;
+        loop.blocks.push_back( loop.header );
+        work.assign( loop.latches.begin(), loop.latches.end() );
+        while ( !work.empty() ) {
+            const BlockId block = work.back();
+            work.pop_back();
+            if ( inLoop[block] ) {
+                continue;
+            }
+            inLoop[block] = true;
+            loop.blocks.push_back( block );
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                if ( !inLoop[predecessor] && position[predecessor] != NO_ID ) {
+                    work.push_back( predecessor );
+                }
+            }
+        }
+        std::ranges::sort( loop.blocks, [&position]( const BlockId a, const BlockId b ) {
+            return position[a] < position[b];
+        } );
+
+        // Outer loops are done first, what an inner loop claims was theirs
+        loop.parent = forest.innermost[loop.header];
+        if ( loop.parent != NO_ID ) {
+            forest.loops[loop.parent].hasInnerLoops = true;
+        }
+        for ( const BlockId block : loop.blocks ) {
+            forest.innermost[block] = index;
+            inLoop[block] = false;
+        }
+    }
+    return forest;
+}
+
+void Lumin::Compiler::IR::RemoveUnreachableBlocks( Function& function ) {
+    std::vector<bool> reachable( function.blocks.size(), false );
+    for ( const BlockId block : ReversePostOrder( function ) ) {
+        reachable[block] = true;
+    }
+
+    for ( BlockId block = 0; block < function.blocks.size(); ++block ) {
+        if ( reachable[block] || function.blocks[block].removed ) {
+            continue;
+        }
+
+        const auto successors = function.Successors( block );
+        for ( const BlockId successor : std::vector( successors.begin(), successors.end() ) ) {
+            function.RemoveEdge( block, successor );
+        }
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            function.values[value].op = Op::NOP;
+        }
+        function.blocks[block].instructions.clear();
+        function.blocks[block].predecessors.clear();
+        function.blocks[block].removed = true;
+    }
+}
+
+void Lumin::Compiler::IR::CompactBlocks( Function& function ) {
+    for ( Block& block : function.blocks ) {
+        std::erase_if( block.instructions, [&function]( const ValueId value ) {
+            return function.values[value].op == Op::NOP;
+        } );
+    }
+}
+
+void Lumin::Compiler::IR::MergeBlocks( Function& function ) {
+    for ( const BlockId block : ReversePostOrder( function ) ) {
+        if ( function.blocks[block].removed ) {
+            continue; // Already folded into its predecessor
+        }
+
+        while ( true ) {
+            const ValueId jump = function.Terminator( block );
+            if ( jump == NO_ID || function.values[jump].op != Op::JUMP ) {
+                break;
+            }
+            const BlockId next = function.values[jump].targets[0];
+            if ( next == block || function.blocks[next].predecessors.size() != 1 ) {
+                break;
+            }
+
+            function.values[jump].op = Op::NOP;
+            auto& instructions = function.blocks[block].instructions;
+            instructions.pop_back();
+
+            Block& merged = function.blocks[next];
+            for ( const ValueId value : merged.instructions ) {
+                Instruction& instruction = function.values[value];
+                if ( instruction.op == Op::PHI ) {
+                    instruction.op = Op::COPY; // One predecessor, one operand
+                }
+                instruction.block = block;
+            }
+            instructions.insert( instructions.end(), merged.instructions.begin(), merged.instructions.end() );
+            merged.instructions.clear();
+            merged.predecessors.clear();
+            merged.removed = true;
+
+            for ( const BlockId successor : function.Successors( block ) ) {
+                std::ranges::replace( function.blocks[successor].predecessors, next, block );
+            }
+        }
+    }
+}
+
+void Lumin::Compiler::IR::SplitCriticalEdges( Function& function ) {
+    const auto blockCount = static_cast<BlockId>( function.blocks.size() );
+    for ( BlockId block = 0; block < blockCount; ++block ) {
+        if ( function.blocks[block].removed || function.Successors( block ).size() < 2 ) {
+            continue;
+        }
+
+        const ValueId terminator = function.Terminator( block );
+        for ( size_t edge = 0; edge < function.Targets( terminator ).size(); ++edge ) {
+            const BlockId target = function.Targets( terminator )[edge];
+            const auto& targetBlock = function.blocks[target];
+            const bool hasPhis = !targetBlock.instructions.empty() && function.values[targetBlock.instructions.front()].op == Op::PHI;
+            if ( targetBlock.predecessors.size() < 2 || !hasPhis ) {
+                continue;
+            }
+
+            const BlockId split = function.AddBlock();
+            function.blocks[split].predecessors.push_back( block );
+            function.blocks[split].sealed = true;
+            Instruction jump = MakeInstruction( Op::JUMP );
+            jump.targets[0] = target;
+            function.Append( split, jump );
+
+            auto& predecessors = function.blocks[target].predecessors;
+            *std::ranges::find( predecessors, block ) = split;
+            function.Targets( terminator )[edge] = split;
+        }
+    }
+}
+
+std::string Lumin::Compiler::IR::Dump( const Function& function ) {
+    const char* hint = function.inlineHint == InlineHint::ALWAYS ? "inline "
+                     : function.inlineHint == InlineHint::NEVER ? "noinline " : "";
+    std::string out = std::format( "{}{}fun {}( {} parameters ){}\n", function.isConstexpr ? "constexpr " : "", hint, function.name, function.parameterCount,
+        function.returnsValue ? " -> value" : "" );
+
+    for ( const BlockId block : ReversePostOrder( function ) ) {
+        out += std::format( "  b{}:", block );
+        if ( !function.blocks[block].predecessors.empty() ) {
+            out += " ; preds";
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                out += std::format( " b{}", predecessor );
+            }
+        }
+        out += "\n";
+
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            const Instruction& instruction = function.values[value];
+            out += "    ";
+            if ( !IsTerminator( instruction.op ) && instruction.op != Op::STORE && instruction.op != Op::SNAPSHOT ) {
+                out += std::format( "v{} = ", value );
+            }
+            out += OpName( instruction.op );
+            if ( instruction.type == Type::FLOAT && instruction.op != Op::CONST_FLOAT && instruction.op != Op::TO_FLOAT ) {
+                out += ".f";
+            } else if ( IsArray( instruction.type ) ) {
+                out += std::format( ".{}", TypeName( instruction.type ) );
+            }
+
+            switch ( instruction.op ) {
+                case Op::CONST_INT: out += std::format( " {}", instruction.intValue ); break;
+                case Op::CONST_FLOAT: out += std::format( " {}", instruction.floatValue ); break;
+                case Op::PARAM: out += std::format( " {}", instruction.index ); break;
+                case Op::CALL: out += std::format( " {}", instruction.index ); break;
+                case Op::NEW_ARRAY: out += instruction.index != 0 ? " local" : ""; break;
+                case Op::LOAD: case Op::STORE: out += instruction.index != 0 ? " nonnull" : ""; break;
+                case Op::VECTOR:
+                    out += std::format( " {}{}", OpName( static_cast<Op>( instruction.intValue ) ), instruction.index != 0 ? " check" : "" );
+                    break;
+                default: break;
+            }
+
+            const auto operands = function.Operands( value );
+            for ( size_t i = 0; i < operands.size(); ++i ) {
+                out += std::format( "{} v{}", i == 0 && instruction.op != Op::CALL && instruction.op != Op::VECTOR ? "" : ",", operands[i] );
+                if ( instruction.op == Op::PHI ) {
+                    out += std::format( " b{}", function.blocks[block].predecessors[i] );
+                }
+            }
+
+            if ( instruction.op == Op::JUMP ) {
+                out += std::format( " b{}", instruction.targets[0] );
+            } else if ( instruction.op == Op::BRANCH ) {
+                out += std::format( ", b{}, b{}", instruction.targets[0], instruction.targets[1] );
+            } else if ( instruction.op == Op::SWITCH ) {
+                const SwitchTable& table = function.switches[instruction.index];
+                for ( size_t i = 0; i < table.keys.size(); ++i ) {
+                    out += std::format( ", {} b{}", table.keys[i], table.targets[i] );
+                }
+                out += std::format( ", _ b{}", table.targets.back() );
+            }
+            out += "\n";
+        }
+    }
+    return out;
+}
+
+std::string Lumin::Compiler::IR::Dump( const Module& module ) {
+    std::string out;
+    for ( const auto& function : module.functions ) {
+        out += Dump( function ) + "\n";
+    }
+    return out;
+}
@@ -0,0 +1,323 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// Bytecode the body turns into, roughly one instruction per value
+uint32_t BodySize( const Function& function ) {
+    uint32_t size = 0;
+    for ( const Block& block : function.blocks ) {
+        if ( block.removed ) {
+            continue;
+        }
+        for ( const ValueId value : block.instructions ) {
+            switch ( function.values[value].op ) {
+                case Op::NOP: case Op::PHI: case Op::COPY: case Op::PARAM: case Op::JUMP:
+                    break;
+                case Op::SWITCH:
+                    size += 1 + static_cast<uint32_t>( function.switches[function.values[value].index].keys.size() );
+                    break;
+                default:
+                    ++size;
+            }
+        }
+    }
+    return size;
+}
+
+std::vector<std::vector<uint32_t>> CallGraph( const Module& module ) {
+    std::vector<std::vector<uint32_t>> callees( module.functions.size() );
+    for ( size_t i = 0; i < module.functions.size(); ++i ) {
+        for ( const Instruction& instruction : module.functions[i].values ) {
+            if ( instruction.op == Op::CALL ) {
+                callees[i].push_back( instruction.index );
+            }
+        }
+        std::ranges::sort( callees[i] );
+        const auto duplicates = std::ranges::unique( callees[i] );
+        callees[i].erase( duplicates.begin(), duplicates.end() );
+    }
+    return callees;
+}
+
+// Tarjan's algorithm with an explicit stack, a long call chain must not
+// overflow the compiler's own. Components come out callees first.
+std::vector<std::vector<uint32_t>> StronglyConnectedComponents( const std::vector<std::vector<uint32_t>>& callees ) {
+    const auto count = static_cast<uint32_t>( callees.size() );
+    std::vector<uint32_t> index( count, NO_ID );
+    std::vector<uint32_t> low( count, 0 );
+    std::vector<bool> onStack( count, false );
+    std::vector<uint32_t> stack;
+    std::vector<std::pair<uint32_t, size_t>> frames; // Function, next callee
+    std::vector<std::vector<uint32_t>> components;
+    uint32_t next = 0;
+
+    const auto visit = [&]( const uint32_t function ) {
+        index[function] = low[function] = next++;
+        stack.push_back( function );
+        onStack[function] = true;
+        frames.emplace_back( function, 0 );
+    };
+
+    for ( uint32_t root = 0; root < count; ++root ) {
+        if ( index[root] != NO_ID ) {
+            continue;
+        }
+
+        visit( root );
+        while ( !frames.empty() ) {
+            const uint32_t function = frames.back().first;
+            const size_t edge = frames.back().second;
+            if ( edge < callees[function].size() ) {
+                ++frames.back().second;
+                const uint32_t callee = callees[function][edge];
+                if ( index[callee] == NO_ID ) {
+                    visit( callee );
+                } else if ( onStack[callee] ) {
+                    low[function] = std::min( low[function], index[callee] );
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if ( !frames.empty() ) {
+                const uint32_t caller = frames.back().first;
+                low[caller] = std::min( low[caller], low[function] );
+            }
+            if ( low[function] == index[function] ) {
+                auto& component = components.emplace_back();
+                uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component.push_back( member );
+                } while ( member != function );
+            }
+        }
+    }
+    return components;
+}
+
+bool ShouldInline( const Function& callee, const uint32_t callSites, const uint32_t constantArguments,
+                   const uint32_t callerSize, const InlineOptions& options ) {
+    if ( callee.inlineHint != InlineHint::NONE ) {
+        return callee.inlineHint == InlineHint::ALWAYS;
+    }
+    if ( callerSize > options.callerLimit ) {
+        return false;
+    }
+
+    const uint32_t size = BodySize( callee );
+    const uint32_t bonus = constantArguments * options.constantArgumentBonus;
+    const uint32_t cost = size > bonus ? size - bonus : 0;
+    if ( cost <= options.smallSize ) {
+        return true;
+    }
+    if ( callSites == 1 ) {
+        return cost <= options.singleCallSiteSize;
+    }
+    return cost <= options.maxSize && cost * callSites <= options.growthBudget;
+}
+
+// Splits the caller's block at the call, copies the callee's blocks in
+// between and turns the call into the returned value: a copy for one
+// return, a phi for several
+void InlineCall( Function& caller, const ValueId call, const Function& callee ) {
+    const BlockId block = caller.values[call].block;
+    const std::vector<ValueId> arguments( caller.Operands( call ).begin(), caller.Operands( call ).end() );
+
+    const BlockId continuation = caller.AddBlock();
+    {
+        auto& instructions = caller.blocks[block].instructions;
+        const auto position = std::ranges::find( instructions, call );
+        caller.blocks[continuation].instructions.assign( position, instructions.end() );
+        instructions.erase( position, instructions.end() );
+    }
+    caller.blocks[continuation].sealed = true;
+    for ( const ValueId value : caller.blocks[continuation].instructions ) {
+        caller.values[value].block = continuation;
+    }
+    for ( const BlockId successor : caller.Successors( continuation ) ) {
+        std::ranges::replace( caller.blocks[successor].predecessors, block, continuation );
+    }
+
+    std::vector<BlockId> blockMap( callee.blocks.size(), NO_ID );
+    for ( BlockId source = 0; source < callee.blocks.size(); ++source ) {
+        if ( !callee.blocks[source].removed ) {
+            blockMap[source] = caller.AddBlock();
+        }
+    }
+
+    // Operands still name callee values until everything is cloned, a phi
+    // can refer to a value further down
+    std::vector<ValueId> valueMap( callee.values.size(), NO_ID );
+    std::vector<ValueId> cloned;
+    std::vector<std::pair<BlockId, ValueId>> returns; // Cloned block, returned callee value
+    for ( BlockId source = 0; source < callee.blocks.size(); ++source ) {
+        if ( blockMap[source] == NO_ID ) {
+            continue;
+        }
+
+        const BlockId target = blockMap[source];
+        for ( const ValueId value : callee.blocks[source].instructions ) {
+            const Instruction& instruction = callee.values[value];
+            if ( instruction.op == Op::PARAM ) {
+                valueMap[value] = arguments[instruction.index];
+            } else if ( instruction.op == Op::RETURN ) {
+                Instruction jump = MakeInstruction( Op::JUMP );
+                jump.targets[0] = continuation;
+                caller.Append( target, jump );
+                returns.emplace_back( target, instruction.operandCount != 0 ? callee.Operands( value )[0] : NO_ID );
+            } else {
+                Instruction copy = instruction;
+                for ( BlockId& successor : copy.targets ) {
+                    if ( successor != NO_ID ) {
+                        successor = blockMap[successor];
+                    }
+                }
+                if ( instruction.op == Op::SWITCH ) {
+                    SwitchTable table = callee.switches[instruction.index];
+                    for ( BlockId& successor : table.targets ) {
+                        successor = blockMap[successor];
+                    }
+                    copy.index = static_cast<uint32_t>( caller.switches.size() );
+                    caller.switches.push_back( std::move( table ) );
+                }
+                valueMap[value] = caller.Append( target, copy, callee.Operands( value ) );
+                cloned.push_back( valueMap[value] );
+            }
+        }
+
+        auto& predecessors = caller.blocks[target].predecessors;
+        for ( const BlockId predecessor : callee.blocks[source].predecessors ) {
+            predecessors.push_back( blockMap[predecessor] );
+        }
+        caller.blocks[target].sealed = true;
+    }
+    for ( const ValueId value : cloned ) {
+        for ( ValueId& operand : caller.Operands( value ) ) {
+            operand = valueMap[operand];
+        }
+    }
+
+    Instruction jump = MakeInstruction( Op::JUMP );
+    jump.targets[0] = blockMap[0];
+    caller.Append( block, jump );
+    caller.blocks[blockMap[0]].predecessors.push_back( block );
+
+    const Instruction zero = MakeZero( callee.returnType );
+    std::vector<ValueId> results;
+    for ( const auto& [returnBlock, value] : returns ) {
+        caller.blocks[continuation].predecessors.push_back( returnBlock );
+        if ( value != NO_ID ) {
+            results.push_back( valueMap[value] );
+        } else {
+            results.push_back( caller.Append( returnBlock, zero ) );
+        }
+    }
+
+    if ( results.empty() ) {
+        // The callee never returns, the continuation is unreachable
+        caller.ReplaceWithConstant( call, zero );
+    } else if ( results.size() == 1 ) {
+        caller.ReplaceWith( call, results.front() );
+    } else {
+        caller.values[call].op = Op::PHI;
+        caller.SetOperands( call, results );
+    }
+}
+
+}
+
+uint32_t Lumin::Compiler::IR::InlineCalls( Module& module, const InlineOptions& options ) {
+    const auto callees = CallGraph( module );
+    const auto components = StronglyConnectedComponents( callees );
+
+    std::vector<uint32_t> component( module.functions.size() );
+    for ( uint32_t i = 0; i < components.size(); ++i ) {
+        for ( const uint32_t function : components[i] ) {
+            component[function] = i;
+        }
+    }
+
+    std::vector<uint32_t> callSites( module.functions.size(), 0 );
+    for ( const Function& function : module.functions ) {
+        for ( const Instruction& instruction : function.values ) {
+            if ( instruction.op == Op::CALL ) {
+                ++callSites[instruction.index];
+            }
+        }
+    }
+
+    uint32_t inlined = 0;
+    for ( const auto& members : components ) {
+        for ( const uint32_t index : members ) {
+            Function& caller = module.functions[index];
+
+            std::vector<ValueId> calls;
+            std::vector<bool> used( caller.values.size(), false );
+            for ( ValueId value = 0; value < caller.values.size(); ++value ) {
+                if ( caller.values[value].op == Op::CALL ) {
+                    calls.push_back( value );
+                }
+                for ( const ValueId operand : caller.Operands( value ) ) {
+                    used[operand] = true;
+                }
+            }
+
+            uint32_t callerSize = BodySize( caller );
+            bool changed = false;
+            for ( const ValueId call : calls ) {
+                const Instruction& instruction = caller.values[call];
+                const Function& callee = module.functions[instruction.index];
+                if ( component[instruction.index] == component[index] ) {
+                    continue; // Recursive, there is no end to unroll to
+                }
+                if ( !callee.returnsValue && used[call] ) {
+                    continue; // Left to the emitter to report
+                }
+
+                const uint32_t constantArguments = static_cast<uint32_t>( std::ranges::count_if( caller.Operands( call ),
+                    [&caller]( const ValueId argument ) {
+                        const Op op = caller.values[caller.Resolve( argument )].op;
+                        return op == Op::CONST_INT || op == Op::CONST_FLOAT;
+                    } ) );
+                if ( !ShouldInline( callee, callSites[instruction.index], constantArguments, callerSize, options ) ) {
+                    continue;
+                }
+
+                callerSize += BodySize( callee );
+                InlineCall( caller, call, callee );
+                changed = true;
+                ++inlined;
+            }
+
+            if ( changed ) {
+                // Cleaned up now, callers further up see its real size
+                MergeBlocks( caller );
+                PropagateConstants( caller );
+                PropagateCopies( caller );
+                EliminateDeadCode( caller );
+            }
+        }
+    }
+    return inlined;
+}
@@ -0,0 +1,1004 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <optional>
+#include <OpCode.hpp>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// A header phi that every back edge advances by the same loop-invariant step
+struct InductionVariable {
+    ValueId phi;
+    ValueId initial;   // Coming in from the preheader
+    ValueId increment; // phi + step, or phi - step, on every back edge
+    ValueId step;
+    bool subtracts;
+};
+
+// dst[i] = left op right, left and right are arrays read at i or scalars
+struct VectorStatement {
+    Op op;
+    ValueId destination;
+    ValueId left;
+    ValueId right;
+};
+
+class LoopOptimizer {
+public:
+    LoopOptimizer( Function& function, const LoopOptions& options ) : function( function ), options( options ) {}
+
+    uint32_t Run();
+
+private:
+    void Analyze();
+    bool InsertPreheaders();
+    uint32_t HoistInvariants();
+    uint32_t ComputeExitValues();
+    uint32_t RemoveDeadLoops();
+    uint32_t Vectorize();
+    uint32_t Unroll();
+    uint32_t ReduceStrength();
+
+    [[nodiscard]] bool Inside( const uint32_t loop, const ValueId value ) const {
+        return forest.Contains( loop, function.values[value].block );
+    }
+    [[nodiscard]] BlockId Preheader( uint32_t loop ) const;
+    [[nodiscard]] BlockId OnlyExit( uint32_t loop ) const;
+    [[nodiscard]] std::vector<InductionVariable> InductionVariables( uint32_t loop, BlockId preheader ) const;
+    [[nodiscard]] std::optional<int64_t> TripCount( uint32_t loop, const std::vector<InductionVariable>& variables ) const;
+    [[nodiscard]] bool CanHoist( ValueId value ) const;
+    [[nodiscard]] uint32_t Size( const Loop& loop ) const;
+    [[nodiscard]] std::vector<bool> Escaping() const;
+    [[nodiscard]] std::vector<VectorStatement> VectorStatements( uint32_t loop, BlockId body, const InductionVariable& variable,
+                                                                 const std::vector<uint32_t>& uses ) const;
+    void ReplaceEscapingUses( const std::vector<ValueId>& replacements );
+    void Peel( uint32_t loop, BlockId exit, const std::vector<std::pair<ValueId, ValueId>>& exitPhis );
+    ValueId InsertAt( BlockId block, size_t position, Instruction instruction, std::span<const ValueId> operands = {} );
+    ValueId InsertBeforeTerminator( BlockId block, Instruction instruction, std::span<const ValueId> operands = {} );
+
+    Function& function;
+    const LoopOptions& options;
+    DominatorTree dominators;
+    LoopForest forest;
+    // From originals to copies while peeling, NO_ID in between
+    std::vector<BlockId> blockCopies;
+    std::vector<ValueId> valueCopies;
+};
+
+void LoopOptimizer::Analyze() {
+    dominators = ComputeDominators( function );
+    forest = FindLoops( function, dominators );
+}
+
+ValueId LoopOptimizer::InsertAt( const BlockId block, const size_t position, const Instruction instruction, const std::span<const ValueId> operands ) {
+    const std::vector<ValueId> copied( operands.begin(), operands.end() );
+    const ValueId value = function.Append( block, instruction, copied );
+    auto& instructions = function.blocks[block].instructions;
+    std::erase( instructions, value );
+    instructions.insert( instructions.begin() + static_cast<std::ptrdiff_t>( position ), value );
+    return value;
+}
+
+ValueId LoopOptimizer::InsertBeforeTerminator( const BlockId block, const Instruction instruction, const std::span<const ValueId> operands ) {
+    const std::vector<ValueId> copied( operands.begin(), operands.end() );
+    return function.Append( block, instruction, copied );
+}
+
+// The single block outside the loop that jumps to the header
+BlockId LoopOptimizer::Preheader( const uint32_t loop ) const {
+    BlockId preheader = NO_ID;
+    for ( const BlockId predecessor : function.blocks[forest.loops[loop].header].predecessors ) {
+        if ( forest.Contains( loop, predecessor ) ) {
+            continue;
+        }
+        if ( preheader != NO_ID ) {
+            return NO_ID;
+        }
+        preheader = predecessor;
+    }
+
+    const ValueId terminator = function.Terminator( preheader );
+    return terminator != NO_ID && function.values[terminator].op == Op::JUMP ? preheader : NO_ID;
+}
+
+// The block the loop leaves to, when only the header's branch leaves and the
+// block has no other way in, so every use after the loop sees the header
+BlockId LoopOptimizer::OnlyExit( const uint32_t loop ) const {
+    const Loop& info = forest.loops[loop];
+    BlockId exit = NO_ID;
+    for ( const BlockId block : info.blocks ) {
+        for ( const BlockId successor : function.Successors( block ) ) {
+            if ( forest.Contains( loop, successor ) ) {
+                continue;
+            }
+            if ( block != info.header || exit != NO_ID ) {
+                return NO_ID;
+            }
+            exit = successor;
+        }
+    }
+
+    if ( exit == NO_ID || function.blocks[exit].predecessors.size() != 1 ) {
+        return NO_ID;
+    }
+    const auto& instructions = function.blocks[exit].instructions;
+    const bool hasPhis = !instructions.empty() && function.values[instructions.front()].op == Op::PHI;
+    return hasPhis ? NO_ID : exit;
+}
+
+// Loops entered from several blocks, or from a branch, get a block of their
+// own in front of the header, so there is one place to hoist to
+bool LoopOptimizer::InsertPreheaders() {
+    bool inserted = false;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const BlockId header = forest.loops[loop].header;
+        if ( Preheader( loop ) != NO_ID ) {
+            continue;
+        }
+
+        std::vector<BlockId> outside;
+        std::vector<BlockId> inside;
+        std::vector<size_t> outsideEdges;
+        std::vector<size_t> insideEdges;
+        const std::vector<BlockId> predecessors = function.blocks[header].predecessors;
+        for ( size_t i = 0; i < predecessors.size(); ++i ) {
+            const bool isInside = forest.Contains( loop, predecessors[i] );
+            ( isInside ? inside : outside ).push_back( predecessors[i] );
+            ( isInside ? insideEdges : outsideEdges ).push_back( i );
+        }
+
+        const BlockId preheader = function.AddBlock();
+        function.blocks[preheader].sealed = true;
+        function.blocks[preheader].predecessors = outside;
+
+        // What comes in from outside merges in the preheader
+        const std::vector<ValueId> instructions = function.blocks[header].instructions;
+        for ( const ValueId phi : instructions ) {
+            if ( function.values[phi].op != Op::PHI ) {
+                break;
+            }
+            const auto operands = function.Operands( phi );
+            std::vector<ValueId> entering;
+            std::vector<ValueId> merged;
+            for ( const size_t edge : outsideEdges ) {
+                entering.push_back( operands[edge] );
+            }
+            merged.push_back( std::ranges::all_of( entering, [&]( const ValueId value ) { return value == entering.front(); } )
+                ? entering.front()
+                : function.Append( preheader, MakeInstruction( Op::PHI, function.values[phi].type ), entering ) );
+            for ( const size_t edge : insideEdges ) {
+                merged.push_back( function.Operands( phi )[edge] );
+            }
+            function.SetOperands( phi, merged );
+        }
+
+        Instruction jump = MakeInstruction( Op::JUMP );
+        jump.targets[0] = header;
+        function.Append( preheader, jump );
+
+        for ( const BlockId block : outside ) {
+            for ( BlockId& target : function.Targets( function.Terminator( block ) ) ) {
+                if ( target == header ) {
+                    target = preheader;
+                }
+            }
+        }
+        inside.insert( inside.begin(), preheader );
+        function.blocks[header].predecessors = inside;
+        inserted = true;
+    }
+    return inserted;
+}
+
+bool LoopOptimizer::CanHoist( const ValueId value ) const {
+    const Instruction& instruction = function.values[value];
+    switch ( instruction.op ) {
+        case Op::PHI: case Op::COPY: case Op::PARAM:
+            return false;
+        case Op::DIV: {
+            if ( instruction.type == Type::FLOAT ) {
+                return true;
+            }
+            // Only a divisor that cannot trap or overflow lets it run early
+            const Instruction& divisor = function.values[function.Operands( value )[1]];
+            return divisor.op == Op::CONST_INT && divisor.intValue != 0 && divisor.intValue != -1;
+        }
+        default:
+            return IsPure( instruction.op );
+    }
+}
+
+// Pure instructions whose operands are all defined outside the loop move to
+// the preheader. Inner loops go first, what they hoist lands in the outer
+// loop and can move again.
+uint32_t LoopOptimizer::HoistInvariants() {
+    uint32_t hoisted = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const BlockId preheader = Preheader( loop );
+        if ( preheader == NO_ID ) {
+            continue;
+        }
+
+        // Reverse post order, operands are visited before their users
+        for ( const BlockId block : forest.loops[loop].blocks ) {
+            std::vector<ValueId> kept;
+            for ( const ValueId value : function.blocks[block].instructions ) {
+                const auto operands = function.Operands( value );
+                if ( !CanHoist( value ) || std::ranges::any_of( operands, [&]( const ValueId operand ) { return Inside( loop, operand ); } ) ) {
+                    kept.push_back( value );
+                    continue;
+                }
+
+                auto& target = function.blocks[preheader].instructions;
+                target.insert( target.end() - 1, value );
+                function.values[value].block = preheader;
+                ++hoisted;
+            }
+            function.blocks[block].instructions = std::move( kept );
+        }
+    }
+    return hoisted;
+}
+
+std::vector<InductionVariable> LoopOptimizer::InductionVariables( const uint32_t loop, const BlockId preheader ) const {
+    std::vector<InductionVariable> variables;
+    const Block& header = function.blocks[forest.loops[loop].header];
+    for ( const ValueId phi : header.instructions ) {
+        const Instruction& instruction = function.values[phi];
+        if ( instruction.op != Op::PHI ) {
+            break;
+        }
+        if ( instruction.type != Type::INT ) {
+            continue;
+        }
+
+        InductionVariable variable { phi, NO_ID, NO_ID, NO_ID, false };
+        const auto operands = function.Operands( phi );
+        bool advancesByStep = true;
+        for ( size_t edge = 0; edge < operands.size() && advancesByStep; ++edge ) {
+            const ValueId incoming = function.Resolve( operands[edge] );
+            if ( header.predecessors[edge] == preheader ) {
+                variable.initial = incoming;
+            } else if ( variable.increment == NO_ID ) {
+                variable.increment = incoming;
+            } else {
+                advancesByStep = incoming == variable.increment;
+            }
+        }
+        if ( !advancesByStep || variable.increment == NO_ID ) {
+            continue;
+        }
+
+        const Instruction& increment = function.values[variable.increment];
+        const auto steps = function.Operands( variable.increment );
+        if ( increment.op == Op::ADD && function.Resolve( steps[0] ) == phi ) {
+            variable.step = function.Resolve( steps[1] );
+        } else if ( increment.op == Op::ADD && function.Resolve( steps[1] ) == phi ) {
+            variable.step = function.Resolve( steps[0] );
+        } else if ( increment.op == Op::SUB && function.Resolve( steps[0] ) == phi ) {
+            variable.step = function.Resolve( steps[1] );
+            variable.subtracts = true;
+        } else {
+            continue;
+        }
+        if ( !Inside( loop, variable.step ) ) {
+            variables.push_back( variable );
+        }
+    }
+    return variables;
+}
+
+// Iterations of a loop whose header leaves on a comparison of an induction
+// variable with a constant, when its start and step are constants too. No
+// count is given when the variable would wrap around before the loop ends.
+std::optional<int64_t> LoopOptimizer::TripCount( const uint32_t loop, const std::vector<InductionVariable>& variables ) const {
+    const Loop& info = forest.loops[loop];
+    const ValueId branch = function.Terminator( info.header );
+    if ( branch == NO_ID || function.values[branch].op != Op::BRANCH ) {
+        return std::nullopt;
+    }
+
+    const ValueId condition = function.Resolve( function.Operands( branch )[0] );
+    Op op = function.values[condition].op;
+    if ( op < Op::CMP_EQ || op > Op::CMP_GE ) {
+        return std::nullopt;
+    }
+    const auto operands = function.Operands( condition );
+    ValueId left = function.Resolve( operands[0] );
+    ValueId right = function.Resolve( operands[1] );
+    const auto isVariable = [&]( const ValueId value ) {
+        return std::ranges::find( variables, value, &InductionVariable::phi ) != variables.end();
+    };
+    if ( !isVariable( left ) ) {
+        std::swap( left, right );
+        switch ( op ) {
+            case Op::CMP_LT: op = Op::CMP_GT; break;
+            case Op::CMP_LE: op = Op::CMP_GE; break;
+            case Op::CMP_GT: op = Op::CMP_LT; break;
+            case Op::CMP_GE: op = Op::CMP_LE; break;
+            default: break;
+        }
+    }
+    if ( !isVariable( left ) || function.values[right].op != Op::CONST_INT ) {
+        return std::nullopt;
+    }
+
+    // Turned into the condition to stay in the loop
+    const auto& targets = function.values[branch].targets;
+    if ( forest.Contains( loop, targets[0] ) == forest.Contains( loop, targets[1] ) ) {
+        return std::nullopt;
+    }
+    if ( forest.Contains( loop, targets[1] ) ) {
+        switch ( op ) {
+            case Op::CMP_EQ: op = Op::CMP_NE; break;
+            case Op::CMP_NE: op = Op::CMP_EQ; break;
+            case Op::CMP_LT: op = Op::CMP_GE; break;
+            case Op::CMP_LE: op = Op::CMP_GT; break;
+            case Op::CMP_GT: op = Op::CMP_LE; break;
+            default: op = Op::CMP_LT; break;
+        }
+    }
+
+    const InductionVariable& variable = *std::ranges::find( variables, left, &InductionVariable::phi );
+    const Instruction& initial = function.values[variable.initial];
+    const Instruction& step = function.values[variable.step];
+    if ( initial.op != Op::CONST_INT || step.op != Op::CONST_INT ) {
+        return std::nullopt;
+    }
+
+    const int64_t start = initial.intValue;
+    const int64_t by = variable.subtracts ? -static_cast<int64_t>( step.intValue ) : step.intValue;
+    const int64_t bound = function.values[right].intValue;
+    int64_t trips;
+    switch ( op ) {
+        case Op::CMP_LT:
+            if ( start >= bound ) return 0;
+            if ( by <= 0 ) return std::nullopt;
+            trips = ( bound - start + by - 1 ) / by;
+            break;
+        case Op::CMP_LE:
+            if ( start > bound ) return 0;
+            if ( by <= 0 ) return std::nullopt;
+            trips = ( bound - start ) / by + 1;
+            break;
+        case Op::CMP_GT:
+            if ( start <= bound ) return 0;
+            if ( by >= 0 ) return std::nullopt;
+            trips = ( start - bound - by - 1 ) / -by;
+            break;
+        case Op::CMP_GE:
+            if ( start < bound ) return 0;
+            if ( by >= 0 ) return std::nullopt;
+            trips = ( start - bound ) / -by + 1;
+            break;
+        case Op::CMP_NE:
+            if ( start == bound ) return 0;
+            if ( by == 0 || ( bound - start ) % by != 0 || ( bound - start ) / by < 0 ) return std::nullopt;
+            trips = ( bound - start ) / by;
+            break;
+        default:
+            if ( start != bound ) return 0;
+            if ( by == 0 ) return std::nullopt;
+            trips = 1;
+            break;
+    }
+
+    // The variable moves one way, staying in range at the end means it
+    // never wrapped
+    const int64_t last = start + trips * by;
+    if ( last < INT32_MIN || last > INT32_MAX ) {
+        return std::nullopt;
+    }
+    return trips;
+}
+
+// Per value, whether something outside the innermost loop around it uses it
+std::vector<bool> LoopOptimizer::Escaping() const {
+    std::vector<bool> escaping( function.values.size(), false );
+    for ( BlockId block = 0; block < function.blocks.size(); ++block ) {
+        if ( function.blocks[block].removed ) {
+            continue;
+        }
+        for ( const ValueId user : function.blocks[block].instructions ) {
+            for ( const ValueId operand : function.Operands( user ) ) {
+                const ValueId value = function.Resolve( operand );
+                const BlockId definition = function.values[value].block;
+                const uint32_t loop = definition < forest.innermost.size() ? forest.innermost[definition] : NO_ID;
+                if ( loop != NO_ID && !forest.Contains( loop, block ) ) {
+                    escaping[value] = true;
+                }
+            }
+        }
+    }
+    return escaping;
+}
+
+// Points the uses of loop values outside their innermost loop at the
+// replacement of the value, values without one are NO_ID
+void LoopOptimizer::ReplaceEscapingUses( const std::vector<ValueId>& replacements ) {
+    for ( BlockId block = 0; block < function.blocks.size(); ++block ) {
+        if ( function.blocks[block].removed ) {
+            continue;
+        }
+        for ( const ValueId user : function.blocks[block].instructions ) {
+            for ( ValueId& operand : function.Operands( user ) ) {
+                const ValueId value = function.Resolve( operand );
+                if ( value >= replacements.size() || replacements[value] == NO_ID || replacements[value] == user ) {
+                    continue;
+                }
+                if ( !forest.Contains( forest.innermost[function.values[value].block], block ) ) {
+                    operand = replacements[value];
+                }
+            }
+        }
+    }
+}
+
+// With a known trip count, an induction variable leaves the loop as
+// start + trips * step, computed after the loop instead of carried out of it
+uint32_t LoopOptimizer::ComputeExitValues() {
+    const std::vector<bool> escaping = Escaping();
+    std::vector<ValueId> exitValues( function.values.size(), NO_ID );
+    uint32_t replaced = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const BlockId preheader = Preheader( loop );
+        const BlockId exit = preheader != NO_ID ? OnlyExit( loop ) : NO_ID;
+        if ( exit == NO_ID ) {
+            continue;
+        }
+        const auto variables = InductionVariables( loop, preheader );
+        const auto trips = TripCount( loop, variables );
+        if ( !trips ) {
+            continue;
+        }
+
+        size_t position = 0;
+        for ( const InductionVariable& variable : variables ) {
+            if ( !escaping[variable.phi] ) {
+                continue;
+            }
+
+            // Multiplication wraps like the additions it stands for
+            Instruction count = MakeInstruction( Op::CONST_INT );
+            count.intValue = static_cast<int32_t>( static_cast<uint32_t>( *trips ) );
+            const ValueId tripCount = InsertAt( exit, position++, count );
+            const std::array scale { variable.step, tripCount };
+            const ValueId travelled = InsertAt( exit, position++, MakeInstruction( Op::MUL ), scale );
+            const std::array moved { variable.initial, travelled };
+            exitValues[variable.phi] = InsertAt( exit, position++, MakeInstruction( variable.subtracts ? Op::SUB : Op::ADD ), moved );
+            ++replaced;
+        }
+    }
+    if ( replaced != 0 ) {
+        ReplaceEscapingUses( exitValues );
+    }
+    return replaced;
+}
+
+// A loop that ends, has no effect and computes nothing used after it is
+// dropped. Loops with inner loops are kept, the inner ones may not end.
+uint32_t LoopOptimizer::RemoveDeadLoops() {
+    const std::vector<bool> escaping = Escaping();
+    uint32_t removed = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const Loop& info = forest.loops[loop];
+        const BlockId preheader = Preheader( loop );
+        const BlockId exit = preheader != NO_ID && !info.hasInnerLoops ? OnlyExit( loop ) : NO_ID;
+        if ( exit == NO_ID || !TripCount( loop, InductionVariables( loop, preheader ) ) ) {
+            continue;
+        }
+
+        bool removable = true;
+        for ( const BlockId block : info.blocks ) {
+            for ( const ValueId value : function.blocks[block].instructions ) {
+                const Op op = function.values[value].op;
+                const bool harmless = op == Op::JUMP || op == Op::BRANCH || op == Op::PHI || op == Op::COPY || CanHoist( value );
+                removable = removable && harmless && !escaping[value];
+            }
+        }
+        if ( !removable ) {
+            continue;
+        }
+
+        // Loops that follow each other stay valid, a preheader can be the
+        // exit of the loop before
+        function.values[function.Terminator( preheader )].targets[0] = exit;
+        function.blocks[exit].predecessors = { preheader };
+        ++removed;
+    }
+    if ( removed != 0 ) {
+        RemoveUnreachableBlocks( function );
+    }
+    return removed;
+}
+
+// The statements of a loop body that only does dst[i] = a[i] op b[i], with
+// scalars allowed for a or b, and advances i. Every access is at index i,
+// so iterations touch different elements and each statement can run over
+// the whole range before the next one, even when the arrays are the same.
+// Empty for any other body.
+std::vector<VectorStatement> LoopOptimizer::VectorStatements( const uint32_t loop, const BlockId body,
+                                                              const InductionVariable& variable,
+                                                              const std::vector<uint32_t>& uses ) const {
+    std::vector<VectorStatement> statements;
+    std::vector<ValueId> loads; // Of the statement being matched
+    ValueId operation = NO_ID;
+    const auto invariant = [&]( const ValueId value ) {
+        const Op op = function.values[value].op;
+        return !Inside( loop, value ) || op == Op::CONST_INT || op == Op::CONST_FLOAT;
+    };
+
+    for ( const ValueId value : function.blocks[body].instructions ) {
+        const Instruction& instruction = function.values[value];
+        const auto operands = function.Operands( value );
+        switch ( instruction.op ) {
+            case Op::NOP: case Op::COPY: case Op::JUMP:
+            case Op::CONST_INT: case Op::CONST_FLOAT:
+                continue;
+            case Op::LOAD:
+                if ( function.Resolve( operands[1] ) != variable.phi || Inside( loop, function.Resolve( operands[0] ) ) ) {
+                    return {};
+                }
+                loads.push_back( value );
+                continue;
+            case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIV: {
+                if ( value == variable.increment ) {
+                    continue;
+                }
+                // The VM has no vector integer division
+                if ( operation != NO_ID || ( instruction.op == Op::DIV && instruction.type != Type::FLOAT ) ) {
+                    return {};
+                }
+                for ( const ValueId operand : operands ) {
+                    const ValueId resolved = function.Resolve( operand );
+                    const bool loaded = std::ranges::find( loads, resolved ) != loads.end();
+                    if ( !loaded && ( !invariant( resolved ) || function.values[resolved].type != instruction.type ) ) {
+                        return {};
+                    }
+                }
+                operation = value;
+                continue;
+            }
+            case Op::STORE: {
+                const ValueId destination = function.Resolve( operands[0] );
+                if ( operation == NO_ID || Inside( loop, destination ) || function.Resolve( operands[1] ) != variable.phi
+                     || function.Resolve( operands[2] ) != operation || uses[operation] != 1 ) {
+                    return {};
+                }
+
+                // Each load only feeds this statement's operation
+                const auto sides = function.Operands( operation );
+                std::array<ValueId, 2> resolved { function.Resolve( sides[0] ), function.Resolve( sides[1] ) };
+                for ( const ValueId load : loads ) {
+                    if ( uses[load] != static_cast<uint32_t>( std::ranges::count( resolved, load ) ) ) {
+                        return {};
+                    }
+                }
+                for ( ValueId& side : resolved ) {
+                    if ( function.values[side].op == Op::LOAD ) {
+                        side = function.Resolve( function.Operands( side )[0] );
+                    }
+                }
+                if ( !IsArray( function.values[resolved[0]].type ) && !IsArray( function.values[resolved[1]].type ) ) {
+                    return {};
+                }
+
+                statements.push_back( { function.values[operation].op, destination, resolved[0], resolved[1] } );
+                loads.clear();
+                operation = NO_ID;
+                continue;
+            }
+            default:
+                return {};
+        }
+    }
+
+    if ( !loads.empty() || operation != NO_ID ) {
+        return {};
+    }
+    return statements;
+}
+
+// Loops of the form while ( i < n ) { dst[i] = a[i] op b[i]; ... i = i + 1; }
+// run their statements as vector instructions in the preheader, over the
+// longest prefix of [i, n) that fills whole vectors. The loop stays as it
+// was and picks up at the index they leave, so it is the epilogue for the
+// last few elements and the fallback when an array is null or too short.
+uint32_t LoopOptimizer::Vectorize() {
+    std::vector<uint32_t> uses( function.values.size(), 0 );
+    for ( const Block& block : function.blocks ) {
+        if ( block.removed ) {
+            continue;
+        }
+        for ( const ValueId user : block.instructions ) {
+            if ( function.values[user].op == Op::COPY ) {
+                continue;
+            }
+            for ( const ValueId operand : function.Operands( user ) ) {
+                ++uses[function.Resolve( operand )];
+            }
+        }
+    }
+
+    uint32_t vectorized = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const Loop& info = forest.loops[loop];
+        const BlockId preheader = Preheader( loop );
+        if ( preheader == NO_ID || info.hasInnerLoops || info.blocks.size() != 2 || info.latches.size() != 1 ) {
+            continue;
+        }
+        const BlockId header = info.header;
+        const BlockId body = info.blocks[1];
+        const ValueId branch = function.Terminator( header );
+        if ( branch == NO_ID || function.values[branch].op != Op::BRANCH || function.values[branch].targets[0] != body ) {
+            continue;
+        }
+
+        // Stays in the loop while i < n, or n > i
+        const ValueId condition = function.Resolve( function.Operands( branch )[0] );
+        const Op comparison = function.values[condition].op;
+        if ( comparison != Op::CMP_LT && comparison != Op::CMP_GT ) {
+            continue;
+        }
+        const auto compared = function.Operands( condition );
+        const ValueId index = function.Resolve( compared[comparison == Op::CMP_LT ? 0 : 1] );
+        const ValueId bound = function.Resolve( compared[comparison == Op::CMP_LT ? 1 : 0] );
+        if ( Inside( loop, bound ) || function.values[bound].type != Type::INT ) {
+            continue;
+        }
+
+        const auto variables = InductionVariables( loop, preheader );
+        const auto variable = std::ranges::find( variables, index, &InductionVariable::phi );
+        if ( variable == variables.end() || variable->subtracts || function.values[variable->step].op != Op::CONST_INT
+             || function.values[variable->step].intValue != 1 || function.values[variable->initial].op == Op::VECTOR ) {
+            continue;
+        }
+
+        // Nothing else may be carried around the loop
+        const bool onlyCounts = std::ranges::all_of( function.blocks[header].instructions, [&]( const ValueId value ) {
+            const Op op = function.values[value].op;
+            return value == index || value == condition || value == branch || op == Op::COPY || op == Op::NOP;
+        } );
+        const auto trips = TripCount( loop, variables );
+        if ( !onlyCounts || ( trips && *trips < Lumin::Bytecode::VECTOR_LANES ) ) {
+            continue;
+        }
+
+        const std::vector<VectorStatement> statements = VectorStatements( loop, body, *variable, uses );
+        if ( statements.empty() ) {
+            continue;
+        }
+
+        const auto emit = [&]( const VectorStatement& statement, const ValueId end, const bool check ) {
+            std::array operands { statement.destination, statement.left, statement.right, variable->initial, end };
+            for ( ValueId& operand : std::span( operands ).subspan( 1, 2 ) ) {
+                if ( Inside( loop, operand ) ) {
+                    // A constant left in the body, the preheader gets its own
+                    operand = InsertBeforeTerminator( preheader, function.values[operand] );
+                }
+            }
+            Instruction vector = MakeInstruction( Op::VECTOR );
+            vector.intValue = static_cast<int32_t>( statement.op );
+            vector.index = check ? 1 : 0;
+            return InsertBeforeTerminator( preheader, vector, operands );
+        };
+
+        // With several statements, the range all of them accept is found
+        // before any runs, one of them falling back leaves the others undone
+        ValueId end = bound;
+        if ( statements.size() > 1 ) {
+            for ( const VectorStatement& statement : statements ) {
+                end = emit( statement, end, true );
+            }
+        }
+        ValueId next = NO_ID;
+        for ( const VectorStatement& statement : statements ) {
+            next = emit( statement, end, false );
+        }
+
+        const auto& predecessors = function.blocks[header].predecessors;
+        const auto edge = static_cast<size_t>( std::ranges::find( predecessors, preheader ) - predecessors.begin() );
+        function.Operands( index )[edge] = next;
+        ++vectorized;
+    }
+    return vectorized;
+}
+
+// Instructions that turn into code, the unroll budget is counted in these
+uint32_t LoopOptimizer::Size( const Loop& loop ) const {
+    uint32_t size = 0;
+    for ( const BlockId block : loop.blocks ) {
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            const Op op = function.values[value].op;
+            size += op != Op::PHI && op != Op::COPY && op != Op::NOP && op != Op::JUMP;
+        }
+    }
+    return size;
+}
+
+// Copies the loop's blocks in front of it as its first iteration: the
+// copied header takes the ways in, and its back edges enter the loop. The
+// copied header leaves to the exit too, exitPhis merge the header values
+// used after the loop and get the copies' operands.
+void LoopOptimizer::Peel( const uint32_t loop, const BlockId exit, const std::vector<std::pair<ValueId, ValueId>>& exitPhis ) {
+    const Loop& info = forest.loops[loop];
+    const BlockId header = info.header;
+    const std::vector<BlockId> predecessors = function.blocks[header].predecessors;
+    std::vector<size_t> entries;
+    std::vector<size_t> latches;
+    for ( size_t i = 0; i < predecessors.size(); ++i ) {
+        ( forest.Contains( loop, predecessors[i] ) ? latches : entries ).push_back( i );
+    }
+
+    blockCopies.resize( function.blocks.size(), NO_ID );
+    for ( const BlockId block : info.blocks ) {
+        blockCopies[block] = function.AddBlock();
+        function.blocks[blockCopies[block]].sealed = true;
+    }
+
+    valueCopies.resize( function.values.size(), NO_ID );
+    std::vector<ValueId> copies;
+    for ( const BlockId block : info.blocks ) {
+        const std::vector<ValueId> instructions = function.blocks[block].instructions;
+        for ( const ValueId value : instructions ) {
+            Instruction copy = function.values[value];
+            std::vector<ValueId> operands( function.Operands( value ).begin(), function.Operands( value ).end() );
+            if ( block == header && copy.op == Op::PHI ) {
+                // The first iteration only comes in from outside
+                std::vector<ValueId> entering;
+                for ( const size_t edge : entries ) {
+                    entering.push_back( operands[edge] );
+                }
+                operands = std::move( entering );
+                if ( operands.size() == 1 ) {
+                    copy.op = Op::COPY;
+                }
+            }
+            const auto retarget = [&]( BlockId& target ) {
+                if ( target != NO_ID && target != header && forest.Contains( loop, target ) ) {
+                    target = blockCopies[target];
+                }
+            };
+            std::ranges::for_each( copy.targets, retarget );
+            if ( copy.op == Op::SWITCH ) {
+                SwitchTable table = function.switches[copy.index];
+                std::ranges::for_each( table.targets, retarget );
+                copy.index = static_cast<uint32_t>( function.switches.size() );
+                function.switches.push_back( std::move( table ) );
+            }
+            valueCopies[value] = function.Append( blockCopies[block], copy, operands );
+            copies.push_back( valueCopies[value] );
+        }
+    }
+
+    const auto remap = [this]( const ValueId value ) {
+        return value < valueCopies.size() && valueCopies[value] != NO_ID ? valueCopies[value] : value;
+    };
+    for ( const ValueId value : copies ) {
+        for ( ValueId& operand : function.Operands( value ) ) {
+            operand = remap( operand );
+        }
+    }
+
+    for ( const BlockId block : info.blocks ) {
+        auto& copiedPredecessors = function.blocks[blockCopies[block]].predecessors;
+        if ( block == header ) {
+            for ( const size_t edge : entries ) {
+                copiedPredecessors.push_back( predecessors[edge] );
+            }
+        } else {
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                copiedPredecessors.push_back( blockCopies[predecessor] );
+            }
+        }
+    }
+    for ( const size_t edge : entries ) {
+        for ( BlockId& target : function.Targets( function.Terminator( predecessors[edge] ) ) ) {
+            if ( target == header ) {
+                target = blockCopies[header];
+            }
+        }
+    }
+
+    // The loop is now entered from the copied latches
+    std::vector<BlockId> headerPredecessors;
+    for ( const size_t edge : latches ) {
+        headerPredecessors.push_back( blockCopies[predecessors[edge]] );
+    }
+    for ( const size_t edge : latches ) {
+        headerPredecessors.push_back( predecessors[edge] );
+    }
+    for ( const ValueId phi : function.blocks[header].instructions ) {
+        if ( function.values[phi].op != Op::PHI ) {
+            break;
+        }
+        std::vector<ValueId> operands;
+        for ( const size_t edge : latches ) {
+            operands.push_back( remap( function.Operands( phi )[edge] ) );
+        }
+        for ( const size_t edge : latches ) {
+            operands.push_back( function.Operands( phi )[edge] );
+        }
+        function.SetOperands( phi, operands );
+    }
+    function.blocks[header].predecessors = std::move( headerPredecessors );
+
+    function.blocks[exit].predecessors.push_back( blockCopies[header] );
+    for ( const auto& [value, phi] : exitPhis ) {
+        std::vector<ValueId> operands( function.Operands( phi ).begin(), function.Operands( phi ).end() );
+        operands.push_back( remap( value ) );
+        function.SetOperands( phi, operands );
+    }
+
+    for ( const BlockId block : info.blocks ) {
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            valueCopies[value] = NO_ID;
+        }
+        blockCopies[block] = NO_ID;
+    }
+}
+
+// Peels every iteration of the loops with a small constant trip count. What
+// remains of a loop is entered with its condition false, constant
+// propagation sees that and drops it. Loops without inner loops do not
+// overlap, so one analysis serves all of them.
+uint32_t LoopOptimizer::Unroll() {
+    const std::vector<bool> escaping = Escaping();
+    std::vector<ValueId> exitValues( function.values.size(), NO_ID );
+    uint32_t unrolled = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const Loop& info = forest.loops[loop];
+        const BlockId preheader = Preheader( loop );
+        const BlockId exit = preheader != NO_ID && !info.hasInnerLoops ? OnlyExit( loop ) : NO_ID;
+        if ( exit == NO_ID ) {
+            continue;
+        }
+        const auto trips = TripCount( loop, InductionVariables( loop, preheader ) );
+        if ( !trips || *trips == 0 || *trips > options.maxUnrollTrips || *trips * Size( info ) > options.maxUnrolledSize ) {
+            continue;
+        }
+
+        // Values of the header used after the loop come from the loop or
+        // from one of the copies
+        std::vector<std::pair<ValueId, ValueId>> exitPhis;
+        const std::vector<ValueId> instructions = function.blocks[info.header].instructions;
+        for ( const ValueId value : instructions ) {
+            if ( escaping[value] ) {
+                const std::array operand { value };
+                exitValues[value] = function.Append( exit, MakeInstruction( Op::PHI, function.values[value].type ), operand );
+                exitPhis.emplace_back( value, exitValues[value] );
+            }
+        }
+
+        for ( int64_t i = 0; i < *trips; ++i ) {
+            Peel( loop, exit, exitPhis );
+        }
+        ++unrolled;
+    }
+    if ( unrolled != 0 ) {
+        ReplaceEscapingUses( exitValues );
+    }
+    return unrolled;
+}
+
+// A multiply of an induction variable by a loop-invariant factor becomes a
+// variable of its own, advanced by step * factor next to the original
+uint32_t LoopOptimizer::ReduceStrength() {
+    uint32_t reduced = 0;
+    for ( uint32_t loop = 0; loop < forest.loops.size(); ++loop ) {
+        const BlockId preheader = Preheader( loop );
+        if ( preheader == NO_ID ) {
+            continue;
+        }
+
+        const BlockId header = forest.loops[loop].header;
+        for ( const InductionVariable& variable : InductionVariables( loop, preheader ) ) {
+            // One new variable per factor, shared by the multiplies using it
+            std::vector<std::pair<ValueId, ValueId>> scaled;
+            for ( const BlockId block : forest.loops[loop].blocks ) {
+                const std::vector<ValueId> instructions = function.blocks[block].instructions;
+                for ( const ValueId value : instructions ) {
+                    if ( function.values[value].op != Op::MUL || function.values[value].type != Type::INT ) {
+                        continue;
+                    }
+                    const auto operands = function.Operands( value );
+                    const ValueId left = function.Resolve( operands[0] );
+                    const ValueId right = function.Resolve( operands[1] );
+                    const ValueId factor = left == variable.phi ? right : right == variable.phi ? left : NO_ID;
+                    if ( factor == NO_ID || Inside( loop, factor ) ) {
+                        continue;
+                    }
+
+                    auto existing = std::ranges::find( scaled, factor, &std::pair<ValueId, ValueId>::first );
+                    if ( existing == scaled.end() ) {
+                        const std::array start { variable.initial, factor };
+                        const std::array stride { variable.step, factor };
+                        const ValueId initial = InsertBeforeTerminator( preheader, MakeInstruction( Op::MUL ), start );
+                        const ValueId step = InsertBeforeTerminator( preheader, MakeInstruction( Op::MUL ), stride );
+
+                        const ValueId phi = function.Append( header, MakeInstruction( Op::PHI ) );
+                        const BlockId incrementBlock = function.values[variable.increment].block;
+                        const auto& incrementBlockInstructions = function.blocks[incrementBlock].instructions;
+                        const auto after = static_cast<size_t>( std::ranges::find( incrementBlockInstructions, variable.increment )
+                            - incrementBlockInstructions.begin() ) + 1;
+                        const std::array advance { phi, step };
+                        const ValueId next = InsertAt( incrementBlock, after,
+                            MakeInstruction( variable.subtracts ? Op::SUB : Op::ADD ), advance );
+
+                        std::vector<ValueId> incoming;
+                        for ( const BlockId predecessor : function.blocks[header].predecessors ) {
+                            incoming.push_back( predecessor == preheader ? initial : next );
+                        }
+                        function.SetOperands( phi, incoming );
+                        existing = scaled.insert( scaled.end(), { factor, phi } );
+                    }
+                    function.ReplaceWith( value, existing->second );
+                    ++reduced;
+                }
+            }
+        }
+    }
+    return reduced;
+}
+
+uint32_t LoopOptimizer::Run() {
+    Analyze();
+    if ( forest.loops.empty() ) {
+        return 0;
+    }
+    if ( InsertPreheaders() ) {
+        Analyze();
+    }
+
+    uint32_t changes = 0;
+    if ( options.hoistInvariants ) {
+        changes += HoistInvariants();
+    }
+    if ( options.simplifyInductionVariables ) {
+        changes += ComputeExitValues();
+        // Dropping inner loops can leave the loops around them dead
+        while ( const uint32_t removed = RemoveDeadLoops() ) {
+            changes += removed;
+            Analyze();
+        }
+    }
+    if ( options.vectorize ) {
+        changes += Vectorize();
+    }
+    if ( options.unroll ) {
+        // Unrolled inner loops can leave the loops around them unrollable
+        while ( const uint32_t unrolled = Unroll() ) {
+            changes += unrolled;
+            PropagateConstants( function );
+            PropagateCopies( function );
+            MergeBlocks( function );
+            Analyze();
+        }
+    }
+    if ( options.reduceStrength ) {
+        changes += ReduceStrength();
+    }
+    return changes;
+}
+
+}
+
+uint32_t Lumin::Compiler::IR::OptimizeLoops( Function& function, const LoopOptions& options ) {
+    return LoopOptimizer( function, options ).Run();
+}
@@ -0,0 +1,873 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <ir/Lowering.hpp>
+#include <ir/TypeInference.hpp>
+#include <LuminFile.hpp>
+#include <Parser.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+bool ReturnsValue( const Statement* statement ) {
+    if ( const auto* returnStatement = dynamic_cast<const ReturnStatement*>( statement ) ) {
+        return returnStatement->value != nullptr;
+    }
+    if ( const auto* block = dynamic_cast<const BlockStatement*>( statement ) ) {
+        return std::ranges::any_of( block->statements, []( const auto& inner ) { return ReturnsValue( inner.get() ); } );
+    }
+    if ( const auto* ifStatement = dynamic_cast<const IfStatement*>( statement ) ) {
+        return ReturnsValue( ifStatement->thenBranch.get() ) || ReturnsValue( ifStatement->elseBranch.get() );
+    }
+    if ( const auto* whileStatement = dynamic_cast<const WhileStatement*>( statement ) ) {
+        return ReturnsValue( whileStatement->body.get() );
+    }
+    if ( const auto* forStatement = dynamic_cast<const ForStatement*>( statement ) ) {
+        return ReturnsValue( forStatement->body.get() );
+    }
+    if ( const auto* matchStatement = dynamic_cast<const MatchStatement*>( statement ) ) {
+        return std::ranges::any_of( matchStatement->arms, []( const MatchArm& arm ) { return ReturnsValue( arm.body.get() ); } );
+    }
+    return false;
+}
+
+// The type with its article, for type errors
+std::string Described( const Type type ) {
+    return std::format( "{} {}", type == Type::INT || type == Type::INT_ARRAY ? "an" : "a", TypeName( type ) );
+}
+
+// Open addressing map from a (variable, block) key to the value the block
+// last wrote to the variable. Every variable read looks here first, so it
+// avoids the node allocations of std::unordered_map.
+class DefinitionTable {
+public:
+    [[nodiscard]] ValueId Find( const uint64_t key ) const {
+        for ( size_t i = Home( key );; i = ( i + 1 ) & ( slots.size() - 1 ) ) {
+            if ( slots[i].key == key ) {
+                return slots[i].value;
+            }
+            if ( slots[i].key == EMPTY ) {
+                return NO_ID;
+            }
+        }
+    }
+
+    void Set( const uint64_t key, const ValueId value ) {
+        if ( ( count + 1 ) * 2 > slots.size() ) {
+            Grow();
+        }
+        size_t i = Home( key );
+        while ( slots[i].key != EMPTY && slots[i].key != key ) {
+            i = ( i + 1 ) & ( slots.size() - 1 );
+        }
+        count += slots[i].key == EMPTY;
+        slots[i] = { key, value };
+    }
+
+private:
+    static constexpr uint64_t EMPTY = UINT64_MAX;
+
+    struct Slot {
+        uint64_t key = EMPTY;
+        ValueId value = NO_ID;
+    };
+
+    [[nodiscard]] size_t Home( const uint64_t key ) const {
+        return static_cast<size_t>( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( slots.size() - 1 );
+    }
+
+    void Grow() {
+        std::vector<Slot> old( slots.size() * 2 );
+        old.swap( slots );
+        count = 0;
+        for ( const Slot& slot : old ) {
+            if ( slot.key != EMPTY ) {
+                Set( slot.key, slot.value );
+            }
+        }
+    }
+
+    std::vector<Slot> slots = std::vector<Slot>( 64 );
+    size_t count = 0;
+};
+
+class FunctionLowering final : public StatementVisitor<void>, public ExpressionVisitor<void> {
+public:
+    FunctionLowering( Function& function, const std::vector<Instance>& instances, const uint32_t instance,
+                      const std::vector<Signature>& signatures )
+        : function( function ), instances( instances ), instance( instances[instance] ), signatures( signatures ) {}
+
+    void Lower( const FunctionStatement& declaration );
+
+    void visit( const IfStatement& statement ) override;
+    void visit( const WhileStatement& statement ) override;
+    void visit( const ForStatement& statement ) override;
+    void visit( const MatchStatement& statement ) override;
+    void visit( const ExpressionStatement& statement ) override;
+    void visit( const FunctionStatement& statement ) override;
+    void visit( const ReturnStatement& statement ) override;
+    void visit( const VariableStatement& statement ) override;
+    void visit( const BlockStatement& statement ) override;
+    void visit( const ClassStatement& statement ) override;
+
+    void visit( const LiteralExpression& expression ) override;
+    void visit( const AssignmentExpression& expression ) override;
+    void visit( const BinaryExpression& expression ) override;
+    void visit( const UnaryExpression& expression ) override;
+    void visit( const GetVariableExpression& expression ) override;
+    void visit( const CallExpression& expression ) override;
+    void visit( const NewArrayExpression& expression ) override;
+    void visit( const IndexExpression& expression ) override;
+    void visit( const IndexAssignmentExpression& expression ) override;
+
+private:
+    ValueId LowerExpression( Expression& expression );
+    ValueId Emit( Op op, std::span<const ValueId> operands = {} );
+    ValueId IntConstant( int32_t value );
+    ValueId Zero( Type type );
+    [[nodiscard]] Type TypeOf( const ValueId value ) const { return function.values[value].type; }
+    // Int to float, the only implicit conversion
+    ValueId Widen( ValueId value );
+    // The value as the target type, what goes where is described for the error
+    ValueId Convert( ValueId value, Type type, const std::string& what );
+    ValueId NullTest( const std::array<ValueId, 2>& operands, Op op );
+    ValueId ElseNull( Expression& left, Expression& right );
+    // An array and an int index into it, construct names the access for the error
+    std::pair<ValueId, ValueId> Element( Expression& array, Expression& index, const char* construct );
+    void Terminate( Instruction terminator, std::span<const ValueId> operands = {} );
+    BlockId NewBlock();
+    uint32_t Variable( const std::string& name ) const;
+
+    // An int to branch on, statement names the construct for the error
+    ValueId Condition( Expression& expression, const char* statement );
+
+    // SSA construction, Braun et al. 2013
+    void WriteVariable( uint32_t variable, BlockId block, ValueId value );
+    ValueId ReadVariable( uint32_t variable, BlockId block );
+    ValueId ReadVariableRecursive( uint32_t variable, BlockId block );
+    ValueId AddPhiOperands( uint32_t variable, ValueId phi );
+    ValueId TryRemoveTrivialPhi( ValueId phi );
+    void SealBlock( BlockId block );
+
+    static uint64_t Key( const uint32_t variable, const BlockId block ) {
+        return static_cast<uint64_t>( variable ) << 32 | block;
+    }
+
+    Function& function;
+    const std::vector<Instance>& instances;
+    const Instance& instance; // The one being lowered, for its callees and type arguments
+    const std::vector<Signature>& signatures;
+    BlockId current = 0;
+    ValueId result = NO_ID;
+
+    std::unordered_map<std::string, uint32_t> variables;
+    std::vector<std::string> variableNames;
+    std::vector<Type> variableTypes; // Fixed by the declaration
+    std::unordered_set<ValueId> nullLiterals; // Written null, converted to any array type
+    DefinitionTable currentDefinition;
+    std::vector<std::vector<std::pair<uint32_t, ValueId>>> incompletePhis; // Per unsealed block
+};
+
+BlockId FunctionLowering::NewBlock() {
+    return function.AddBlock();
+}
+
+// Arithmetic is done in the wider operand type, comparisons too but give an int
+ValueId FunctionLowering::Emit( const Op op, const std::span<const ValueId> operands ) {
+    for ( const ValueId operand : operands ) {
+        if ( IsArray( TypeOf( operand ) ) ) {
+            throw std::runtime_error( std::format( "Type error in '{}': {} operand is an array, index it to get an element",
+                function.name, OpName( op ) ) );
+        }
+    }
+
+    const bool anyFloat = std::ranges::any_of( operands, [this]( const ValueId operand ) { return TypeOf( operand ) == Type::FLOAT; } );
+    std::vector<ValueId> converted( operands.begin(), operands.end() );
+    if ( anyFloat ) {
+        for ( ValueId& operand : converted ) {
+            operand = Widen( operand );
+        }
+    }
+
+    const bool comparison = op >= Op::CMP_EQ && op <= Op::CMP_GE;
+    return function.Append( current, MakeInstruction( op, anyFloat && !comparison ? Type::FLOAT : Type::INT ), converted );
+}
+
+ValueId FunctionLowering::IntConstant( const int32_t value ) {
+    Instruction constant = MakeInstruction( Op::CONST_INT );
+    constant.intValue = value;
+    return function.Append( current, constant );
+}
+
+ValueId FunctionLowering::Zero( const Type type ) {
+    return function.Append( current, MakeZero( type ) );
+}
+
+ValueId FunctionLowering::Widen( const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    if ( instruction.type == Type::FLOAT ) {
+        return value;
+    }
+    if ( instruction.op == Op::CONST_INT ) {
+        // Literals are widened here rather than by an I2F at runtime
+        Instruction constant = MakeInstruction( Op::CONST_FLOAT );
+        constant.floatValue = static_cast<float>( instruction.intValue );
+        return function.Append( current, constant );
+    }
+    return function.Append( current, MakeInstruction( Op::TO_FLOAT ), std::span( &value, 1 ) );
+}
+
+ValueId FunctionLowering::Convert( const ValueId value, const Type type, const std::string& what ) {
+    const Type given = TypeOf( value );
+    if ( given == type ) {
+        return value;
+    }
+    if ( nullLiterals.contains( value ) ) {
+        if ( !IsArray( type ) ) {
+            throw std::runtime_error( std::format( "Type error in '{}': {} is {}, only arrays can be null", function.name, what,
+                Described( type ) ) );
+        }
+        return Zero( type );
+    }
+    if ( given != Type::INT || type != Type::FLOAT ) {
+        throw std::runtime_error( std::format( "Type error in '{}': {} is {}, {} is given", function.name, what,
+            Described( type ), Described( given ) ) );
+    }
+    return Widen( value );
+}
+
+std::pair<ValueId, ValueId> FunctionLowering::Element( Expression& array, Expression& index, const char* construct ) {
+    const ValueId reference = LowerExpression( array );
+    if ( !IsArray( TypeOf( reference ) ) ) {
+        throw std::runtime_error( std::format( "Type error in '{}': {} of {}", function.name, construct,
+            Described( TypeOf( reference ) ) ) );
+    }
+    return { reference, Convert( LowerExpression( index ), Type::INT, "an array index" ) };
+}
+
+void FunctionLowering::Terminate( const Instruction terminator, const std::span<const ValueId> operands ) {
+    function.Append( current, terminator, operands );
+    for ( const BlockId successor : function.Successors( current ) ) {
+        function.blocks[successor].predecessors.push_back( current );
+    }
+
+    // Anything after a terminator is unreachable, it gets a block with no
+    // predecessors that is dropped before emission
+    current = NewBlock();
+    function.blocks[current].sealed = true;
+}
+
+uint32_t FunctionLowering::Variable( const std::string& name ) const {
+    const auto it = variables.find( name );
+    if ( it == variables.end() ) {
+        throw std::runtime_error( std::format( "Undefined variable '{}' in '{}'", name, function.name ) );
+    }
+    return it->second;
+}
+
+void FunctionLowering::WriteVariable( const uint32_t variable, const BlockId block, const ValueId value ) {
+    currentDefinition.Set( Key( variable, block ), value );
+}
+
+ValueId FunctionLowering::ReadVariable( const uint32_t variable, const BlockId block ) {
+    if ( const ValueId value = currentDefinition.Find( Key( variable, block ) ); value != NO_ID ) {
+        return function.Resolve( value );
+    }
+    return ReadVariableRecursive( variable, block );
+}
+
+ValueId FunctionLowering::ReadVariableRecursive( const uint32_t variable, const BlockId block ) {
+    const Block& info = function.blocks[block];
+    ValueId value;
+    if ( !info.sealed ) {
+        value = function.Append( block, MakeInstruction( Op::PHI, variableTypes[variable] ) );
+        if ( block >= incompletePhis.size() ) {
+            incompletePhis.resize( function.blocks.size() );
+        }
+        incompletePhis[block].emplace_back( variable, value );
+    } else if ( info.predecessors.size() == 1 ) {
+        value = ReadVariable( variable, info.predecessors.front() );
+    } else if ( info.predecessors.empty() ) {
+        if ( block == 0 ) {
+            throw std::runtime_error( std::format( "Variable '{}' may be used before it is assigned in '{}'",
+                variableNames[variable], function.name ) );
+        }
+        // Unreachable code, any value will do
+        const BlockId saved = current;
+        current = block;
+        value = Zero( variableTypes[variable] );
+        current = saved;
+    } else {
+        // The phi is recorded first so a loop back to this block finds it
+        value = function.Append( block, MakeInstruction( Op::PHI, variableTypes[variable] ) );
+        WriteVariable( variable, block, value );
+        value = AddPhiOperands( variable, value );
+    }
+
+    WriteVariable( variable, block, value );
+    return value;
+}
+
+ValueId FunctionLowering::AddPhiOperands( const uint32_t variable, const ValueId phi ) {
+    const auto predecessors = function.blocks[function.values[phi].block].predecessors;
+    std::vector<ValueId> operands;
+    operands.reserve( predecessors.size() );
+    for ( const BlockId predecessor : predecessors ) {
+        operands.push_back( ReadVariable( variable, predecessor ) );
+    }
+    function.SetOperands( phi, operands );
+    return TryRemoveTrivialPhi( phi );
+}
+
+// A phi whose operands are all one value (or itself) is that value. Phis
+// that only become trivial later are left for copy propagation.
+ValueId FunctionLowering::TryRemoveTrivialPhi( const ValueId phi ) {
+    ValueId same = NO_ID;
+    for ( const ValueId operand : function.Operands( phi ) ) {
+        const ValueId resolved = function.Resolve( operand );
+        if ( resolved == same || resolved == phi ) {
+            continue;
+        }
+        if ( same != NO_ID ) {
+            return phi;
+        }
+        same = resolved;
+    }
+
+    if ( same == NO_ID ) {
+        function.ReplaceWithConstant( phi, MakeZero( TypeOf( phi ) ) );
+        return phi;
+    }
+    function.ReplaceWith( phi, same );
+    return same;
+}
+
+void FunctionLowering::SealBlock( const BlockId block ) {
+    if ( block < incompletePhis.size() ) {
+        for ( const auto& [variable, phi] : std::exchange( incompletePhis[block], {} ) ) {
+            AddPhiOperands( variable, phi );
+        }
+    }
+    function.blocks[block].sealed = true;
+}
+
+void FunctionLowering::Lower( const FunctionStatement& declaration ) {
+    current = NewBlock();
+    function.blocks[current].sealed = true;
+
+    for ( uint32_t i = 0; i < declaration.parameters.size(); ++i ) {
+        const std::string& name = declaration.parameters[i].first;
+        if ( !variables.try_emplace( name, static_cast<uint32_t>( variableNames.size() ) ).second ) {
+            throw std::runtime_error( std::format( "Duplicate parameter '{}' in '{}'", name, function.name ) );
+        }
+        variableNames.push_back( name );
+        variableTypes.push_back( function.parameterTypes[i] );
+
+        Instruction parameter = MakeInstruction( Op::PARAM, function.parameterTypes[i] );
+        parameter.index = i;
+        WriteVariable( i, current, function.Append( current, parameter ) );
+    }
+
+    for ( const auto& statement : declaration.body ) {
+        statement->accept( *this );
+    }
+
+    // Falling off the end returns, with 0 when other paths return a value
+    if ( function.Terminator( current ) == NO_ID ) {
+        if ( function.returnsValue ) {
+            const ValueId zero = Zero( function.returnType );
+            Terminate( MakeInstruction( Op::RETURN ), std::span( &zero, 1 ) );
+        } else {
+            Terminate( MakeInstruction( Op::RETURN ) );
+        }
+    }
+}
+
+ValueId FunctionLowering::LowerExpression( Expression& expression ) {
+    expression.accept( *this );
+    return result;
+}
+
+ValueId FunctionLowering::Condition( Expression& expression, const char* statement ) {
+    const ValueId condition = LowerExpression( expression );
+    if ( TypeOf( condition ) != Type::INT ) {
+        throw std::runtime_error( std::format( "Type error in '{}': {} condition is {}, compare it to get an int",
+            function.name, statement, Described( TypeOf( condition ) ) ) );
+    }
+    return condition;
+}
+
+void FunctionLowering::visit( const IfStatement& statement ) {
+    const ValueId condition = Condition( *statement.condition, "an if" );
+
+    const BlockId thenBlock = NewBlock();
+    const BlockId merge = NewBlock();
+    const BlockId elseBlock = statement.elseBranch ? NewBlock() : merge;
+
+    Instruction branch = MakeInstruction( Op::BRANCH );
+    branch.targets = { thenBlock, elseBlock };
+    Terminate( branch, std::span( &condition, 1 ) );
+
+    const auto lowerArm = [&]( const BlockId block, Statement& arm ) {
+        SealBlock( block );
+        current = block;
+        arm.accept( *this );
+        Instruction jump = MakeInstruction( Op::JUMP );
+        jump.targets[0] = merge;
+        Terminate( jump );
+    };
+
+    lowerArm( thenBlock, *statement.thenBranch );
+    if ( statement.elseBranch ) {
+        lowerArm( elseBlock, *statement.elseBranch );
+    }
+
+    SealBlock( merge );
+    current = merge;
+}
+
+// The header is sealed only after the body, the back edge is its last
+// predecessor and variables read in the loop get phis until then
+void FunctionLowering::visit( const WhileStatement& statement ) {
+    const BlockId header = NewBlock();
+    Instruction enter = MakeInstruction( Op::JUMP );
+    enter.targets[0] = header;
+    Terminate( enter );
+
+    current = header;
+    const ValueId condition = Condition( *statement.condition, "a while" );
+    const BlockId body = NewBlock();
+    const BlockId exit = NewBlock();
+    Instruction branch = MakeInstruction( Op::BRANCH );
+    branch.targets = { body, exit };
+    Terminate( branch, std::span( &condition, 1 ) );
+
+    SealBlock( body );
+    current = body;
+    statement.body->accept( *this );
+    Instruction loop = MakeInstruction( Op::JUMP );
+    loop.targets[0] = header;
+    Terminate( loop );
+
+    SealBlock( header );
+    SealBlock( exit );
+    current = exit;
+}
+
+// A while loop over the variable with the end evaluated up front, so the
+// bound is an SSA value from outside the loop. The variable is declared by
+// the loop unless an int of that name already is, which it then counts with.
+void FunctionLowering::visit( const ForStatement& statement ) {
+    const ValueId begin = Convert( LowerExpression( *statement.begin ), Type::INT, "a range bound" );
+    const ValueId end = Convert( LowerExpression( *statement.end ), Type::INT, "a range bound" );
+
+    const auto [it, declared] = variables.try_emplace( statement.variable, static_cast<uint32_t>( variableNames.size() ) );
+    const uint32_t variable = it->second;
+    if ( declared ) {
+        variableNames.push_back( statement.variable );
+        variableTypes.push_back( Type::INT );
+    } else if ( variableTypes[variable] != Type::INT ) {
+        throw std::runtime_error( std::format( "Type error in '{}': loop variable '{}' is {}, ranges count ints",
+            function.name, statement.variable, Described( variableTypes[variable] ) ) );
+    }
+    WriteVariable( variable, current, begin );
+
+    const BlockId header = NewBlock();
+    Instruction enter = MakeInstruction( Op::JUMP );
+    enter.targets[0] = header;
+    Terminate( enter );
+
+    current = header;
+    const std::array bounds { ReadVariable( variable, header ), end };
+    const ValueId condition = Emit( Op::CMP_LT, bounds );
+    const BlockId body = NewBlock();
+    const BlockId exit = NewBlock();
+    Instruction branch = MakeInstruction( Op::BRANCH );
+    branch.targets = { body, exit };
+    Terminate( branch, std::span( &condition, 1 ) );
+
+    SealBlock( body );
+    current = body;
+    statement.body->accept( *this );
+    const std::array step { ReadVariable( variable, current ), IntConstant( 1 ) };
+    WriteVariable( variable, current, Emit( Op::ADD, step ) );
+    Instruction loop = MakeInstruction( Op::JUMP );
+    loop.targets[0] = header;
+    Terminate( loop );
+
+    SealBlock( header );
+    SealBlock( exit );
+    current = exit;
+}
+
+// Each key leads to a block of its own, an arm with several keys is entered
+// through a jump from each of them, so the switch names every block once
+void FunctionLowering::visit( const MatchStatement& statement ) {
+    const ValueId subject = LowerExpression( *statement.subject );
+    if ( TypeOf( subject ) != Type::INT ) {
+        throw std::runtime_error( std::format( "Type error in '{}': a match subject is {}, only ints are matched",
+            function.name, Described( TypeOf( subject ) ) ) );
+    }
+
+    const BlockId merge = NewBlock();
+    BlockId fallback = merge;
+    std::vector<BlockId> armBlocks;
+    std::vector<std::pair<int32_t, BlockId>> cases;
+    std::vector<std::pair<BlockId, BlockId>> trampolines; // Block, the arm it jumps to
+    for ( const MatchArm& arm : statement.arms ) {
+        armBlocks.push_back( NewBlock() );
+        if ( arm.keys.empty() ) {
+            fallback = armBlocks.back();
+        }
+        for ( const int32_t key : arm.keys ) {
+            if ( arm.keys.size() == 1 ) {
+                cases.emplace_back( key, armBlocks.back() );
+            } else {
+                trampolines.emplace_back( NewBlock(), armBlocks.back() );
+                cases.emplace_back( key, trampolines.back().first );
+            }
+        }
+    }
+
+    if ( cases.empty() ) {
+        Instruction jump = MakeInstruction( Op::JUMP );
+        jump.targets[0] = fallback;
+        Terminate( jump );
+    } else {
+        std::ranges::sort( cases );
+        SwitchTable table;
+        for ( const auto& [key, target] : cases ) {
+            table.keys.push_back( key );
+            table.targets.push_back( target );
+        }
+        table.targets.push_back( fallback );
+
+        Instruction branch = MakeInstruction( Op::SWITCH );
+        branch.index = static_cast<uint32_t>( function.switches.size() );
+        function.switches.push_back( std::move( table ) );
+        Terminate( branch, std::span( &subject, 1 ) );
+    }
+
+    for ( const auto& [block, arm] : trampolines ) {
+        SealBlock( block );
+        current = block;
+        Instruction jump = MakeInstruction( Op::JUMP );
+        jump.targets[0] = arm;
+        Terminate( jump );
+    }
+
+    // Matched arms do not fall through to the next one
+    for ( size_t i = 0; i < statement.arms.size(); ++i ) {
+        SealBlock( armBlocks[i] );
+        current = armBlocks[i];
+        statement.arms[i].body->accept( *this );
+        Instruction jump = MakeInstruction( Op::JUMP );
+        jump.targets[0] = merge;
+        Terminate( jump );
+    }
+
+    SealBlock( merge );
+    current = merge;
+}
+
+void FunctionLowering::visit( const ExpressionStatement& statement ) {
+    LowerExpression( *statement.expression );
+}
+
+void FunctionLowering::visit( const FunctionStatement& statement ) {
+    throw std::runtime_error( std::format( "Nested function '{}' in '{}' is not supported", statement.name, function.name ) );
+}
+
+void FunctionLowering::visit( const ReturnStatement& statement ) {
+    if ( statement.value ) {
+        const ValueId value = Convert( LowerExpression( *statement.value ), function.returnType, "the result" );
+        Terminate( MakeInstruction( Op::RETURN ), std::span( &value, 1 ) );
+    } else if ( function.returnsValue ) {
+        const ValueId zero = Zero( function.returnType );
+        Terminate( MakeInstruction( Op::RETURN ), std::span( &zero, 1 ) );
+    } else {
+        Terminate( MakeInstruction( Op::RETURN ) );
+    }
+}
+
+void FunctionLowering::visit( const VariableStatement& statement ) {
+    const auto* literal = dynamic_cast<const LiteralExpression*>( statement.initializer.get() );
+    if ( !statement.annotation && literal != nullptr && std::holds_alternative<std::monostate>( literal->value ) ) {
+        throw std::runtime_error( std::format( "Variable '{}' in '{}' is initialized with null, annotate its array type",
+            statement.name, function.name ) );
+    }
+
+    ValueId value = statement.initializer ? LowerExpression( *statement.initializer ) : IntConstant( 0 );
+    if ( statement.annotation ) {
+        const Type type = AnnotatedType( *statement.annotation, instance, std::format( "Variable '{}'", statement.name ) );
+        value = statement.initializer ? Convert( value, type, std::format( "variable '{}'", statement.name ) ) : Zero( type );
+    }
+
+    const auto variable = static_cast<uint32_t>( variableNames.size() );
+    if ( !variables.try_emplace( statement.name, variable ).second ) {
+        throw std::runtime_error( std::format( "Variable '{}' is already declared in '{}'", statement.name, function.name ) );
+    }
+    variableNames.push_back( statement.name );
+    variableTypes.push_back( TypeOf( value ) );
+    WriteVariable( variable, current, value );
+    if ( statement.isConstexpr ) {
+        function.constantInitializers.push_back( { value, statement.name } );
+    }
+}
+
+void FunctionLowering::visit( const BlockStatement& statement ) {
+    for ( const auto& inner : statement.statements ) {
+        inner->accept( *this );
+    }
+}
+
+void FunctionLowering::visit( const ClassStatement& ) {
+    throw std::runtime_error( "Classes are not supported by the code generator" );
+}
+
+void FunctionLowering::visit( const LiteralExpression& expression ) {
+    result = std::visit( [this]( const auto value ) -> ValueId {
+        using T = std::decay_t<decltype( value )>;
+        if constexpr ( std::is_same_v<T, float> || std::is_same_v<T, double> ) {
+            // The VM only has single precision floats
+            Instruction constant = MakeInstruction( Op::CONST_FLOAT );
+            constant.floatValue = static_cast<float>( value );
+            return function.Append( current, constant );
+        } else if constexpr ( std::is_same_v<T, int64_t> ) {
+            if ( value < INT32_MIN || value > INT32_MAX ) {
+                throw std::runtime_error( std::format( "Integer literal {} does not fit in 32 bits", value ) );
+            }
+            return IntConstant( static_cast<int32_t>( value ) );
+        } else if constexpr ( std::is_same_v<T, std::monostate> ) {
+            // An int[] until Convert gives it the array type it is used as
+            return *nullLiterals.insert( Zero( Type::INT_ARRAY ) ).first;
+        } else if constexpr ( std::is_same_v<T, ArrayRef> ) {
+            throw std::runtime_error( "Array references cannot be written as literals" );
+        } else {
+            return IntConstant( static_cast<int32_t>( value ) );
+        }
+    }, expression.value );
+}
+
+void FunctionLowering::visit( const AssignmentExpression& expression ) {
+    const uint32_t variable = Variable( expression.name );
+    result = Convert( LowerExpression( *expression.value ), variableTypes[variable], std::format( "variable '{}'", expression.name ) );
+    WriteVariable( variable, current, result );
+}
+
+void FunctionLowering::visit( const BinaryExpression& expression ) {
+    Op op;
+    switch ( expression.operator_ ) {
+        case TokenType::OPERATOR_PLUS: op = Op::ADD; break;
+        case TokenType::OPERATOR_MINUS: op = Op::SUB; break;
+        case TokenType::OPERATOR_MULTIPLY: op = Op::MUL; break;
+        case TokenType::OPERATOR_DIVIDE: op = Op::DIV; break;
+        case TokenType::OPERATOR_EQUALS: op = Op::CMP_EQ; break;
+        case TokenType::OPERATOR_BANG_EQUALS:
+        case TokenType::OPERATOR_NOT_EQUAL: op = Op::CMP_NE; break;
+        case TokenType::OPERATOR_LESS_THAN: op = Op::CMP_LT; break;
+        case TokenType::OPERATOR_LESS_EQUALS: op = Op::CMP_LE; break;
+        case TokenType::OPERATOR_GREATER_THAN: op = Op::CMP_GT; break;
+        case TokenType::OPERATOR_GREATER_EQUALS: op = Op::CMP_GE; break;
+        case TokenType::OPERATOR_ELSENULL:
+            result = ElseNull( *expression.left, *expression.right );
+            return;
+        default:
+            throw std::runtime_error( std::format( "Unsupported binary operator in '{}'", function.name ) );
+    }
+
+    const std::array operands { LowerExpression( *expression.left ), LowerExpression( *expression.right ) };
+    if ( ( op == Op::CMP_EQ || op == Op::CMP_NE ) && ( IsArray( TypeOf( operands[0] ) ) || IsArray( TypeOf( operands[1] ) ) ) ) {
+        result = NullTest( operands, op );
+        return;
+    }
+    result = Emit( op, operands );
+}
+
+// Arrays are only compared with null, a == null is isnull a and a != null
+// compares that with 0 like !
+ValueId FunctionLowering::NullTest( const std::array<ValueId, 2>& operands, const Op op ) {
+    const bool leftNull = nullLiterals.contains( operands[0] );
+    const ValueId array = leftNull ? operands[1] : operands[0];
+    const ValueId other = leftNull ? operands[0] : operands[1];
+    if ( !IsArray( TypeOf( array ) ) || !nullLiterals.contains( other ) ) {
+        throw std::runtime_error( std::format( "Type error in '{}': arrays can only be compared with null, {} is compared with {}",
+            function.name, Described( TypeOf( operands[0] ) ), Described( TypeOf( operands[1] ) ) ) );
+    }
+
+    const ValueId isNull = function.Append( current, MakeInstruction( Op::IS_NULL ), std::span( &array, 1 ) );
+    if ( op == Op::CMP_EQ ) {
+        return isNull;
+    }
+    const std::array compared { isNull, IntConstant( 0 ) };
+    return Emit( Op::CMP_EQ, compared );
+}
+
+// left ?: right is left unless it is null, right is only evaluated then
+ValueId FunctionLowering::ElseNull( Expression& left, Expression& right ) {
+    const ValueId value = LowerExpression( left );
+    const Type type = TypeOf( value );
+    if ( !IsArray( type ) ) {
+        throw std::runtime_error( std::format( "Type error in '{}': ?: takes an array that may be null, {} is given",
+            function.name, Described( type ) ) );
+    }
+
+    const ValueId isNull = function.Append( current, MakeInstruction( Op::IS_NULL ), std::span( &value, 1 ) );
+    const BlockId fallback = NewBlock();
+    const BlockId merge = NewBlock();
+    Instruction branch = MakeInstruction( Op::BRANCH );
+    branch.targets = { fallback, merge };
+    Terminate( branch, std::span( &isNull, 1 ) );
+
+    SealBlock( fallback );
+    current = fallback;
+    const ValueId replacement = Convert( LowerExpression( right ), type, "the right of ?:" );
+    Instruction jump = MakeInstruction( Op::JUMP );
+    jump.targets[0] = merge;
+    Terminate( jump );
+
+    // The branch is the first way into the merge, the fallback the second
+    SealBlock( merge );
+    current = merge;
+    const std::array incoming { value, replacement };
+    return function.Append( merge, MakeInstruction( Op::PHI, type ), incoming );
+}
+
+void FunctionLowering::visit( const UnaryExpression& expression ) {
+    const ValueId operand = LowerExpression( *expression.right );
+    if ( expression.operator_ == TokenType::OPERATOR_MINUS ) {
+        result = Emit( Op::NEG, std::span( &operand, 1 ) );
+    } else if ( expression.operator_ == TokenType::OPERATOR_BANG ) {
+        const std::array operands { operand, IntConstant( 0 ) };
+        result = Emit( Op::CMP_EQ, operands );
+    } else {
+        throw std::runtime_error( std::format( "Unsupported unary operator in '{}'", function.name ) );
+    }
+}
+
+void FunctionLowering::visit( const GetVariableExpression& expression ) {
+    result = ReadVariable( Variable( expression.name ), current );
+}
+
+// snapshot() is built in unless the program defines a function of that
+// name: it stops the VM there and writes a snapshot when lumin runs with
+// --snapshot-out, and does nothing otherwise
+void FunctionLowering::visit( const CallExpression& expression ) {
+    const auto callee = instance.callees.find( &expression );
+    if ( callee == instance.callees.end() && expression.name == "snapshot" ) {
+        if ( !expression.arguments.empty() || !expression.typeArguments.empty() ) {
+            throw std::runtime_error( std::format( "snapshot() takes no arguments in '{}'", function.name ) );
+        }
+        result = function.Append( current, MakeInstruction( Op::SNAPSHOT ) );
+        return;
+    }
+    if ( callee == instance.callees.end() ) {
+        throw std::runtime_error( std::format( "Undefined function '{}' called from '{}'", expression.name, function.name ) );
+    }
+    const size_t parameterCount = instances[callee->second].declaration->parameters.size();
+    if ( parameterCount != expression.arguments.size() ) {
+        throw std::runtime_error( std::format( "'{}' takes {} arguments, {} given in '{}'",
+            expression.name, parameterCount, expression.arguments.size(), function.name ) );
+    }
+
+    const Signature& signature = signatures[callee->second];
+    std::vector<ValueId> arguments;
+    arguments.reserve( expression.arguments.size() );
+    for ( size_t i = 0; i < expression.arguments.size(); ++i ) {
+        arguments.push_back( Convert( LowerExpression( *expression.arguments[i] ), signature.parameters[i],
+            std::format( "argument {} of '{}'", i + 1, expression.name ) ) );
+    }
+
+    Instruction call = MakeInstruction( Op::CALL, signature.result );
+    call.index = callee->second;
+    result = function.Append( current, call, arguments );
+}
+
+void FunctionLowering::visit( const NewArrayExpression& expression ) {
+    const ValueId length = Convert( LowerExpression( *expression.length ), Type::INT, "an array length" );
+    const Type element = AnnotatedType( expression.elementType, instance, "An array element" );
+    result = function.Append( current, MakeInstruction( Op::NEW_ARRAY, ArrayOf( element ) ), std::span( &length, 1 ) );
+}
+
+void FunctionLowering::visit( const IndexExpression& expression ) {
+    const auto [array, index] = Element( *expression.array, *expression.index, "indexing" );
+    const std::array operands { array, index };
+    result = function.Append( current, MakeInstruction( Op::LOAD, ElementOf( TypeOf( array ) ) ), operands );
+}
+
+// The stored value is the result, as with a variable assignment
+void FunctionLowering::visit( const IndexAssignmentExpression& expression ) {
+    const auto [array, index] = Element( *expression.array, *expression.index, "assigning an element" );
+    const Type element = ElementOf( TypeOf( array ) );
+    const ValueId value = Convert( LowerExpression( *expression.value ), element, "an array element" );
+    const std::array operands { array, index, value };
+    function.Append( current, MakeInstruction( Op::STORE, element ), operands );
+    result = value;
+}
+
+}
+
+Module Lumin::Compiler::IR::Lower( const std::vector<std::unique_ptr<Statement>>& program ) {
+    std::vector<const FunctionStatement*> declarations;
+    std::unordered_set<std::string_view> names;
+
+    for ( const auto& statement : program ) {
+        const auto* declaration = dynamic_cast<const FunctionStatement*>( statement.get() );
+        if ( declaration == nullptr ) {
+            throw std::runtime_error( "Only functions can be declared at the top level" );
+        }
+        if ( !names.insert( declaration->name ).second ) {
+            throw std::runtime_error( std::format( "Function '{}' is already declared", declaration->name ) );
+        }
+        declarations.push_back( declaration );
+    }
+
+    const std::vector<Instance> instances = Monomorphize( declarations );
+    const std::vector<Signature> signatures = InferSignatures( instances );
+
+    Module module;
+    for ( uint32_t i = 0; i < instances.size(); ++i ) {
+        const FunctionStatement& declaration = *instances[i].declaration;
+        Function& function = module.functions.emplace_back();
+        function.name = instances[i].name;
+        function.parameterCount = static_cast<uint32_t>( declaration.parameters.size() );
+        // Instantiations belong to the module that asked for them
+        function.flags = !declaration.typeParameters.empty() || declaration.access == AccessModifier::PRIVATE ? FLAG_PRIVATE
+                       : declaration.access == AccessModifier::INTERNAL ? FLAG_INTERNAL : FLAG_PUBLIC;
+        function.inlineHint = declaration.inlineSpec == InlineSpecifier::INLINE ? InlineHint::ALWAYS
+                            : declaration.inlineSpec == InlineSpecifier::NOINLINE ? InlineHint::NEVER : InlineHint::NONE;
+        function.isConstexpr = declaration.isConstexpr;
+        function.returnsValue = std::ranges::any_of( declaration.body, []( const auto& inner ) { return ReturnsValue( inner.get() ); } );
+        function.parameterTypes = signatures[i].parameters;
+        function.returnType = signatures[i].result;
+        if ( declaration.name == "main" ) {
+            module.entry = i;
+        }
+    }
+
+    for ( uint32_t i = 0; i < instances.size(); ++i ) {
+        FunctionLowering( module.functions[i], instances, i, signatures ).Lower( *instances[i].declaration );
+    }
+
+    return module;
+}
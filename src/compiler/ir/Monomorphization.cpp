@@ -0,0 +1,334 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <ir/Monomorphization.hpp>
+#include <Parser.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+bool IsTypeParameterArray( const TypeAnnotation& annotation ) {
+    return annotation.isArray && annotation.type == TokenType::LITERAL_IDENTIFIER;
+}
+
+// Visits every statement and expression of a body, for the calls in it and
+// its size
+class BodyWalker final : public StatementVisitor<void>, public ExpressionVisitor<void> {
+public:
+    explicit BodyWalker( std::function<void( const CallExpression& )> onCall = {} ) : onCall( std::move( onCall ) ) {}
+
+    void Walk( const FunctionStatement& declaration ) {
+        for ( const auto& statement : declaration.body ) {
+            statement->accept( *this );
+        }
+    }
+
+    size_t nodes = 0;
+    bool createsTypeParameterArrays = false; // Declares or allocates an array of a type parameter
+
+    void visit( const IfStatement& statement ) override {
+        ++nodes;
+        statement.condition->accept( *this );
+        statement.thenBranch->accept( *this );
+        if ( statement.elseBranch ) {
+            statement.elseBranch->accept( *this );
+        }
+    }
+
+    void visit( const WhileStatement& statement ) override {
+        ++nodes;
+        statement.condition->accept( *this );
+        statement.body->accept( *this );
+    }
+
+    void visit( const ForStatement& statement ) override {
+        ++nodes;
+        statement.begin->accept( *this );
+        statement.end->accept( *this );
+        statement.body->accept( *this );
+    }
+
+    void visit( const MatchStatement& statement ) override {
+        ++nodes;
+        statement.subject->accept( *this );
+        for ( const MatchArm& arm : statement.arms ) {
+            arm.body->accept( *this );
+        }
+    }
+
+    void visit( const ExpressionStatement& statement ) override {
+        ++nodes;
+        statement.expression->accept( *this );
+    }
+
+    void visit( const FunctionStatement& ) override {}
+
+    void visit( const ReturnStatement& statement ) override {
+        ++nodes;
+        if ( statement.value ) {
+            statement.value->accept( *this );
+        }
+    }
+
+    void visit( const VariableStatement& statement ) override {
+        ++nodes;
+        createsTypeParameterArrays |= statement.annotation && IsTypeParameterArray( *statement.annotation );
+        if ( statement.initializer ) {
+            statement.initializer->accept( *this );
+        }
+    }
+
+    void visit( const BlockStatement& statement ) override {
+        for ( const auto& inner : statement.statements ) {
+            inner->accept( *this );
+        }
+    }
+
+    void visit( const ClassStatement& ) override {}
+
+    void visit( const LiteralExpression& ) override {
+        ++nodes;
+    }
+
+    void visit( const AssignmentExpression& expression ) override {
+        ++nodes;
+        expression.value->accept( *this );
+    }
+
+    void visit( const BinaryExpression& expression ) override {
+        ++nodes;
+        expression.left->accept( *this );
+        expression.right->accept( *this );
+    }
+
+    void visit( const UnaryExpression& expression ) override {
+        ++nodes;
+        expression.right->accept( *this );
+    }
+
+    void visit( const GetVariableExpression& ) override {
+        ++nodes;
+    }
+
+    void visit( const CallExpression& expression ) override {
+        ++nodes;
+        for ( const auto& argument : expression.arguments ) {
+            argument->accept( *this );
+        }
+        if ( onCall ) {
+            onCall( expression );
+        }
+    }
+
+    void visit( const NewArrayExpression& expression ) override {
+        ++nodes;
+        createsTypeParameterArrays |= expression.elementType.type == TokenType::LITERAL_IDENTIFIER;
+        expression.length->accept( *this );
+    }
+
+    void visit( const IndexExpression& expression ) override {
+        ++nodes;
+        expression.array->accept( *this );
+        expression.index->accept( *this );
+    }
+
+    void visit( const IndexAssignmentExpression& expression ) override {
+        ++nodes;
+        expression.array->accept( *this );
+        expression.index->accept( *this );
+        expression.value->accept( *this );
+    }
+
+private:
+    std::function<void( const CallExpression& )> onCall;
+};
+
+class Monomorphizer {
+public:
+    explicit Monomorphizer( const std::vector<const FunctionStatement*>& declarations );
+
+    std::vector<Instance> Run();
+
+private:
+    // Size and budget of a generic function, measured on its first instantiation
+    struct Generic {
+        size_t size = 0;
+        size_t spent = 0;
+        bool canShare = true;
+    };
+
+    void ResolveCalls( uint32_t instance );
+    uint32_t Instantiate( const FunctionStatement& generic, const std::vector<Type>& typeArguments );
+    uint32_t Add( const FunctionStatement& declaration, std::vector<Type> typeArguments );
+
+    const std::vector<const FunctionStatement*>& declarations;
+    std::unordered_map<std::string_view, const FunctionStatement*> byName;
+    std::vector<Instance> instances;
+    std::map<std::pair<const FunctionStatement*, std::vector<Type>>, uint32_t> cache;
+    std::unordered_map<const FunctionStatement*, Generic> generics;
+};
+
+Monomorphizer::Monomorphizer( const std::vector<const FunctionStatement*>& declarations ) : declarations( declarations ) {
+    for ( const FunctionStatement* declaration : declarations ) {
+        byName.try_emplace( declaration->name, declaration );
+    }
+}
+
+std::vector<Instance> Monomorphizer::Run() {
+    for ( const FunctionStatement* declaration : declarations ) {
+        if ( declaration->typeParameters.empty() ) {
+            Add( *declaration, {} );
+        } else if ( declaration->name == "main" ) {
+            throw std::runtime_error( "'main' cannot be generic" );
+        }
+    }
+
+    // Instantiations are appended as calls find them and walked in turn
+    for ( uint32_t instance = 0; instance < instances.size(); ++instance ) {
+        ResolveCalls( instance );
+    }
+    return std::move( instances );
+}
+
+void Monomorphizer::ResolveCalls( const uint32_t instance ) {
+    BodyWalker( [this, instance]( const CallExpression& call ) {
+        const auto callee = byName.find( call.name );
+        if ( callee == byName.end() ) {
+            return; // Reported by lowering
+        }
+        const FunctionStatement& target = *callee->second;
+        const std::string& caller = instances[instance].name;
+
+        if ( target.typeParameters.empty() ) {
+            if ( !call.typeArguments.empty() ) {
+                throw std::runtime_error( std::format( "'{}' is not generic, it is given type arguments in '{}'", call.name, caller ) );
+            }
+            instances[instance].callees.emplace( &call, cache.at( { &target, {} } ) );
+            return;
+        }
+
+        if ( call.typeArguments.empty() ) {
+            throw std::runtime_error( std::format( "'{}' is generic, call it with type arguments such as {}<int>( ... ) in '{}'",
+                call.name, call.name, caller ) );
+        }
+        if ( call.typeArguments.size() != target.typeParameters.size() ) {
+            throw std::runtime_error( std::format( "'{}' takes {} type arguments, {} given in '{}'",
+                call.name, target.typeParameters.size(), call.typeArguments.size(), caller ) );
+        }
+
+        std::vector<Type> typeArguments;
+        for ( const TypeAnnotation& argument : call.typeArguments ) {
+            const Type type = AnnotatedType( argument, instances[instance], std::format( "A type argument of '{}'", call.name ) );
+            if ( IsArray( type ) ) {
+                throw std::runtime_error( std::format( "Type arguments of '{}' are int or float, {} given in '{}'",
+                    call.name, TypeName( type ), caller ) );
+            }
+            typeArguments.push_back( type );
+        }
+
+        const uint32_t instantiation = Instantiate( target, typeArguments );
+        instances[instance].callees.emplace( &call, instantiation );
+    } ).Walk( *instances[instance].declaration );
+}
+
+uint32_t Monomorphizer::Instantiate( const FunctionStatement& generic, const std::vector<Type>& typeArguments ) {
+    if ( const auto cached = cache.find( { &generic, typeArguments } ); cached != cache.end() ) {
+        return cached->second;
+    }
+
+    const auto [entry, first] = generics.try_emplace( &generic );
+    Generic& budget = entry->second;
+    if ( first ) {
+        BodyWalker walker;
+        walker.Walk( generic );
+        budget.size = walker.nodes;
+        budget.canShare = !walker.createsTypeParameterArrays && std::ranges::none_of( generic.parameters,
+            []( const auto& parameter ) { return IsTypeParameterArray( parameter.second ); } );
+    }
+
+    if ( budget.spent == 0 || budget.spent + budget.size <= INSTANTIATION_BUDGET ) {
+        budget.spent += budget.size;
+        return Add( generic, typeArguments );
+    }
+
+    if ( !budget.canShare ) {
+        throw std::runtime_error( std::format( "'{}' needs more instantiations than its code size budget of {} allows, "
+            "and arrays of its type parameters keep it from sharing a float version", generic.name, INSTANTIATION_BUDGET ) );
+    }
+
+    // The shared version is added once, over the budget, and then found
+    // under these type arguments too
+    const std::vector shared( typeArguments.size(), Type::FLOAT );
+    const auto cached = cache.find( { &generic, shared } );
+    const uint32_t instance = cached != cache.end() ? cached->second : Add( generic, shared );
+    cache.emplace( std::pair { &generic, typeArguments }, instance );
+    return instance;
+}
+
+uint32_t Monomorphizer::Add( const FunctionStatement& declaration, std::vector<Type> typeArguments ) {
+    const auto index = static_cast<uint32_t>( instances.size() );
+    Instance& instance = instances.emplace_back();
+    instance.declaration = &declaration;
+    instance.name = declaration.name;
+    if ( !declaration.typeParameters.empty() ) {
+        instance.name += '<';
+        for ( size_t i = 0; i < typeArguments.size(); ++i ) {
+            instance.name += std::format( "{}{}", i == 0 ? "" : ", ", TypeName( typeArguments[i] ) );
+        }
+        instance.name += '>';
+    }
+    instance.typeArguments = std::move( typeArguments );
+    cache.emplace( std::pair { &declaration, instance.typeArguments }, index );
+    return index;
+}
+
+}
+
+Type Lumin::Compiler::IR::AnnotatedType( const TypeAnnotation& annotation, const Instance& instance, const std::string& what ) {
+    Type element;
+    switch ( annotation.type ) {
+        case TokenType::KEYWORD_INT: case TokenType::KEYWORD_BOOL:
+            element = Type::INT;
+            break;
+        case TokenType::KEYWORD_FLOAT: case TokenType::KEYWORD_DOUBLE:
+            // The VM only has single precision floats
+            element = Type::FLOAT;
+            break;
+        case TokenType::LITERAL_IDENTIFIER: {
+            // The parser only takes the function's own type parameters as types
+            const std::vector<std::string>& parameters = instance.declaration->typeParameters;
+            const auto parameter = std::ranges::find( parameters, annotation.name );
+            if ( parameter == parameters.end() ) {
+                throw std::logic_error( std::format( "'{}' is not a type parameter of '{}'", annotation.name, instance.name ) );
+            }
+            element = instance.typeArguments[parameter - parameters.begin()];
+            break;
+        }
+        default:
+            throw std::runtime_error( std::format( "{} of '{}' has a type the code generator does not support", what, instance.name ) );
+    }
+    return annotation.isArray ? ArrayOf( element ) : element;
+}
+
+std::vector<Instance> Lumin::Compiler::IR::Monomorphize( const std::vector<const FunctionStatement*>& declarations ) {
+    return Monomorphizer( declarations ).Run();
+}
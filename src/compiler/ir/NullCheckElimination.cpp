@@ -0,0 +1,332 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// The array a branch tests for null, and the target it goes to when the
+// array is not null
+struct NullTest {
+    ValueId array = NO_ID;
+    BlockId nonNull = NO_ID;
+};
+
+bool IsConstantZero( const Function& function, const ValueId value ) {
+    const Instruction& instruction = function.values[function.Resolve( value )];
+    return instruction.op == Op::CONST_INT && instruction.intValue == 0;
+}
+
+// `if ( a == null )` branches on isnull a, `if ( a != null )` on its
+// comparison with 0
+NullTest TestOf( const Function& function, const BlockId block ) {
+    const ValueId terminator = function.Terminator( block );
+    if ( terminator == NO_ID || function.values[terminator].op != Op::BRANCH ) {
+        return {};
+    }
+    const Instruction& branch = function.values[terminator];
+    if ( branch.targets[0] == branch.targets[1] ) {
+        return {};
+    }
+
+    const ValueId condition = function.Resolve( function.Operands( terminator )[0] );
+    const Instruction& instruction = function.values[condition];
+    if ( instruction.op == Op::IS_NULL ) {
+        return { function.Resolve( function.Operands( condition )[0] ), branch.targets[1] };
+    }
+    if ( instruction.op != Op::CMP_EQ && instruction.op != Op::CMP_NE ) {
+        return {};
+    }
+
+    const auto operands = function.Operands( condition );
+    for ( size_t i = 0; i < 2; ++i ) {
+        const ValueId tested = function.Resolve( operands[i] );
+        if ( function.values[tested].op == Op::IS_NULL && IsConstantZero( function, operands[1 - i] ) ) {
+            return { function.Resolve( function.Operands( tested )[0] ),
+                branch.targets[instruction.op == Op::CMP_EQ ? 0 : 1] };
+        }
+    }
+    return {};
+}
+
+// Sets of the array values of one function, a bit per array
+class ArraySet {
+public:
+    ArraySet() = default;
+    ArraySet( const size_t size, const bool full ) : words( ( size + 63 ) / 64, full ? ~0ull : 0ull ) {}
+
+    [[nodiscard]] bool Contains( const uint32_t bit ) const { return words[bit / 64] >> ( bit % 64 ) & 1; }
+    void Insert( const uint32_t bit ) { words[bit / 64] |= 1ull << ( bit % 64 ); }
+
+    // Keeps what both have, true when this set shrank
+    bool Intersect( const ArraySet& other ) {
+        bool changed = false;
+        for ( size_t i = 0; i < words.size(); ++i ) {
+            const uint64_t kept = words[i] & other.words[i];
+            changed |= kept != words[i];
+            words[i] = kept;
+        }
+        return changed;
+    }
+
+    bool operator==( const ArraySet& ) const = default;
+
+private:
+    std::vector<uint64_t> words;
+};
+
+/*
+ Arrays known not to be null, where. Some are never null: a NEW_ARRAY, a
+ call to a function whose every return is such an array and a phi whose
+ operands all are on their edges. The others become known on the way: an
+ array is not null after a LOAD or STORE of it, which would have failed
+ otherwise, and on the edge a null test leaves by when it is not.
+
+ Facts flow forward and meet by intersection. Phis start out optimistic
+ and lose the property until every one left has it, so a loop carrying a
+ non-null array keeps it.
+ */
+class NullCheckAnalysis {
+public:
+    NullCheckAnalysis( const Function& function, const std::vector<bool>& nonNullResults );
+
+    void Run();
+
+    // The array is known not to be null before the instruction in its block
+    // runs, known holds what is known before that instruction
+    [[nodiscard]] bool IsNonNull( ValueId array, const ArraySet& known ) const;
+    [[nodiscard]] const ArraySet& In( const BlockId block ) const { return in[block]; }
+    // Adds what the instruction tells about its array operand
+    void Learn( ValueId value, ArraySet& known ) const;
+    [[nodiscard]] bool ReturnsNonNull() const;
+
+    std::vector<BlockId> order;
+
+private:
+    void Propagate();
+    [[nodiscard]] ArraySet OnEdge( BlockId from, BlockId to ) const;
+    bool UpdatePhis();
+
+    const Function& function;
+    const std::vector<bool>& nonNullResults;
+    std::vector<uint32_t> bits; // Per value, NO_ID when it is not an array
+    uint32_t arrayCount = 0;
+    std::vector<bool> intrinsic; // Never null, per value
+    std::vector<bool> reachable;
+    std::vector<ArraySet> in;
+    std::vector<ArraySet> out;
+};
+
+NullCheckAnalysis::NullCheckAnalysis( const Function& function, const std::vector<bool>& nonNullResults )
+    : order( ReversePostOrder( function ) ), function( function ), nonNullResults( nonNullResults ),
+      bits( function.values.size(), NO_ID ), intrinsic( function.values.size(), false ),
+      reachable( function.blocks.size(), false ) {
+    for ( const BlockId block : order ) {
+        reachable[block] = true;
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            const Instruction& instruction = function.values[value];
+            if ( !IsArray( instruction.type ) || instruction.op == Op::COPY ) {
+                continue;
+            }
+            bits[value] = arrayCount++;
+            intrinsic[value] = instruction.op == Op::NEW_ARRAY || instruction.op == Op::PHI
+                || ( instruction.op == Op::CALL && nonNullResults[instruction.index] );
+        }
+    }
+}
+
+void NullCheckAnalysis::Run() {
+    do {
+        Propagate();
+    } while ( UpdatePhis() );
+}
+
+bool NullCheckAnalysis::IsNonNull( const ValueId array, const ArraySet& known ) const {
+    const ValueId value = function.Resolve( array );
+    return intrinsic[value] || ( bits[value] != NO_ID && known.Contains( bits[value] ) );
+}
+
+void NullCheckAnalysis::Learn( const ValueId value, ArraySet& known ) const {
+    const Op op = function.values[value].op;
+    if ( op != Op::LOAD && op != Op::STORE ) {
+        return;
+    }
+    const ValueId array = function.Resolve( function.Operands( value )[0] );
+    if ( bits[array] != NO_ID ) {
+        known.Insert( bits[array] );
+    }
+}
+
+ArraySet NullCheckAnalysis::OnEdge( const BlockId from, const BlockId to ) const {
+    ArraySet known = out[from];
+    if ( const NullTest test = TestOf( function, from ); test.nonNull == to && bits[test.array] != NO_ID ) {
+        known.Insert( bits[test.array] );
+    }
+    return known;
+}
+
+void NullCheckAnalysis::Propagate() {
+    // Everything is known in blocks not reached yet, the entry knows nothing
+    in.assign( function.blocks.size(), ArraySet( arrayCount, true ) );
+    out = in;
+    in[order.front()] = ArraySet( arrayCount, false );
+
+    bool changed = true;
+    while ( changed ) {
+        changed = false;
+        for ( const BlockId block : order ) {
+            ArraySet known = in[block];
+            for ( const BlockId predecessor : function.blocks[block].predecessors ) {
+                if ( reachable[predecessor] ) {
+                    known.Intersect( OnEdge( predecessor, block ) );
+                }
+            }
+            in[block] = known;
+            for ( const ValueId value : function.blocks[block].instructions ) {
+                Learn( value, known );
+            }
+            if ( known != out[block] ) {
+                out[block] = std::move( known );
+                changed = true;
+            }
+        }
+    }
+}
+
+bool NullCheckAnalysis::UpdatePhis() {
+    bool changed = false;
+    for ( const BlockId block : order ) {
+        const auto& predecessors = function.blocks[block].predecessors;
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            if ( function.values[value].op != Op::PHI ) {
+                break;
+            }
+            if ( !intrinsic[value] ) {
+                continue;
+            }
+            const auto operands = function.Operands( value );
+            for ( size_t i = 0; i < operands.size(); ++i ) {
+                if ( reachable[predecessors[i]] && !IsNonNull( operands[i], OnEdge( predecessors[i], block ) ) ) {
+                    intrinsic[value] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+bool NullCheckAnalysis::ReturnsNonNull() const {
+    if ( !IsArray( function.returnType ) ) {
+        return false;
+    }
+    for ( const BlockId block : order ) {
+        ArraySet known = in[block];
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            const Instruction& instruction = function.values[value];
+            if ( instruction.op == Op::RETURN && !function.Operands( value ).empty()
+                 && !IsNonNull( function.Operands( value )[0], known ) ) {
+                return false;
+            }
+            Learn( value, known );
+        }
+    }
+    return true;
+}
+
+// Marks the accesses and folds the tests the analysis settles
+uint32_t Apply( Function& function, const NullCheckAnalysis& analysis ) {
+    uint32_t changes = 0;
+    for ( const BlockId block : analysis.order ) {
+        ArraySet known = analysis.In( block );
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            Instruction& instruction = function.values[value];
+            if ( ( instruction.op == Op::LOAD || instruction.op == Op::STORE ) && instruction.index == 0
+                 && analysis.IsNonNull( function.Operands( value )[0], known ) ) {
+                instruction.index = 1;
+                ++changes;
+            } else if ( instruction.op == Op::IS_NULL ) {
+                const ValueId array = function.Resolve( function.Operands( value )[0] );
+                const bool isNull = function.values[array].op == Op::CONST_NULL;
+                if ( isNull || analysis.IsNonNull( array, known ) ) {
+                    Instruction constant = MakeInstruction( Op::CONST_INT );
+                    constant.intValue = isNull ? 1 : 0;
+                    function.ReplaceWithConstant( value, constant );
+                    ++changes;
+                }
+            }
+            analysis.Learn( value, known );
+        }
+    }
+    return changes;
+}
+
+}
+
+uint32_t Lumin::Compiler::IR::EliminateNullChecks( Module& module ) {
+    // Results start out non-null and lose it until the returns of every
+    // function agree, like the phis of one function
+    std::vector<bool> nonNullResults( module.functions.size() );
+    for ( size_t i = 0; i < module.functions.size(); ++i ) {
+        nonNullResults[i] = IsArray( module.functions[i].returnType );
+    }
+
+    std::vector<NullCheckAnalysis> analyses;
+    analyses.reserve( module.functions.size() );
+    bool changed = true;
+    while ( changed ) {
+        changed = false;
+        analyses.clear();
+        for ( size_t i = 0; i < module.functions.size(); ++i ) {
+            NullCheckAnalysis& analysis = analyses.emplace_back( module.functions[i], nonNullResults );
+            analysis.Run();
+            if ( nonNullResults[i] && !analysis.ReturnsNonNull() ) {
+                nonNullResults[i] = false;
+                changed = true;
+            }
+        }
+    }
+
+    uint32_t changes = 0;
+    for ( size_t i = 0; i < module.functions.size(); ++i ) {
+        changes += Apply( module.functions[i], analyses[i] );
+    }
+    return changes;
+}
+
+NullCheckCounts Lumin::Compiler::IR::CountNullChecks( const Module& module ) {
+    NullCheckCounts counts;
+    for ( const Function& function : module.functions ) {
+        for ( const Block& block : function.blocks ) {
+            if ( block.removed ) {
+                continue;
+            }
+            for ( const ValueId value : block.instructions ) {
+                const Instruction& instruction = function.values[value];
+                if ( instruction.op == Op::LOAD || instruction.op == Op::STORE ) {
+                    ++counts.accesses;
+                    counts.unchecked += instruction.index != 0;
+                } else if ( instruction.op == Op::IS_NULL ) {
+                    ++counts.tests;
+                }
+            }
+        }
+    }
+    return counts;
+}
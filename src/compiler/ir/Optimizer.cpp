@@ -0,0 +1,81 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+void RunScalarPasses( Function& function ) {
+    PropagateConstants( function );
+    PropagateCopies( function );
+    EliminateDeadCode( function );
+}
+
+}
+
+void Lumin::Compiler::IR::Optimize( Module& module, const int level, const LoopOptions& loops, const AllocationOptions& allocations ) {
+    // Part of the language rather than an optimization, runs at every level
+    EvaluateConstants( module );
+    if ( level <= 0 ) {
+        return;
+    }
+
+    for ( Function& function : module.functions ) {
+        RunScalarPasses( function );
+    }
+
+    // Propagation can turn more arguments of `constexpr` calls into constants
+    if ( EvaluateConstants( module ) != 0 ) {
+        for ( Function& function : module.functions ) {
+            RunScalarPasses( function );
+        }
+    }
+
+    // After the first cleanup, so the cost model sees what a body really costs
+    InlineCalls( module );
+
+    // Inlined bodies are part of the loops they were called from
+    for ( Function& function : module.functions ) {
+        if ( OptimizeLoops( function, loops ) != 0 ) {
+            RunScalarPasses( function );
+            MergeBlocks( function );
+        }
+        // After unrolling, which turns induction variables into constant
+        // indices. Loads that became values can fold further.
+        if ( OptimizeAllocations( function, allocations ) != 0 ) {
+            RunScalarPasses( function );
+        }
+    }
+
+    if ( level >= 2 ) {
+        for ( Function& function : module.functions ) {
+            // Merged values can make branches constant, so constant
+            // propagation gets another look afterwards
+            if ( NumberValues( function ) ) {
+                RunScalarPasses( function );
+            }
+        }
+    }
+
+    // Last, so it sees the accesses unrolling and inlining leave. Folded
+    // tests make their branches constant.
+    if ( EliminateNullChecks( module ) != 0 ) {
+        for ( Function& function : module.functions ) {
+            RunScalarPasses( function );
+        }
+    }
+}
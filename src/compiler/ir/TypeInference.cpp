@@ -0,0 +1,280 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <format>
+#include <string_view>
+#include <unordered_map>
+#include <ir/TypeInference.hpp>
+#include <Parser.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// Type lattice of the inference, NONE below everything until a value is seen.
+// Arrays sit above the numbers, joining them with anything else is a type
+// error that lowering reports where the values meet.
+enum class Inferred : uint8_t { NONE, INT, FLOAT, INT_ARRAY, FLOAT_ARRAY };
+
+Inferred Join( const Inferred a, const Inferred b ) {
+    return std::max( a, b );
+}
+
+Inferred Of( const Type type ) {
+    return static_cast<Inferred>( static_cast<uint8_t>( type ) + 1 );
+}
+
+Type ToType( const Inferred inferred ) {
+    return inferred == Inferred::NONE ? Type::INT : static_cast<Type>( static_cast<uint8_t>( inferred ) - 1 );
+}
+
+Inferred ElementOf( const Inferred array ) {
+    return array == Inferred::FLOAT_ARRAY ? Inferred::FLOAT : array == Inferred::INT_ARRAY ? Inferred::INT : Inferred::NONE;
+}
+
+class SignatureInference final : public StatementVisitor<void>, public ExpressionVisitor<void> {
+public:
+    explicit SignatureInference( const std::vector<Instance>& instances );
+
+    std::vector<Signature> Run();
+
+    void visit( const IfStatement& statement ) override;
+    void visit( const WhileStatement& statement ) override;
+    void visit( const ForStatement& statement ) override;
+    void visit( const MatchStatement& statement ) override;
+    void visit( const ExpressionStatement& statement ) override;
+    void visit( const FunctionStatement& ) override {}
+    void visit( const ReturnStatement& statement ) override;
+    void visit( const VariableStatement& statement ) override;
+    void visit( const BlockStatement& statement ) override;
+    void visit( const ClassStatement& ) override {}
+
+    void visit( const LiteralExpression& expression ) override;
+    void visit( const AssignmentExpression& expression ) override;
+    void visit( const BinaryExpression& expression ) override;
+    void visit( const UnaryExpression& expression ) override;
+    void visit( const GetVariableExpression& expression ) override;
+    void visit( const CallExpression& expression ) override;
+    void visit( const NewArrayExpression& expression ) override;
+    void visit( const IndexExpression& expression ) override;
+    void visit( const IndexAssignmentExpression& expression ) override;
+
+private:
+    // Walks the body again with the current results of its callees
+    void Infer( uint32_t function );
+    Inferred TypeOf( Expression& expression );
+
+    const std::vector<Instance>& instances;
+    std::vector<std::vector<Type>> parameters;
+    std::vector<Inferred> results;
+    std::vector<std::vector<uint32_t>> callers;
+    std::vector<bool> walked;
+
+    // State of the walk in progress
+    uint32_t current = 0;
+    std::unordered_map<std::string_view, Inferred> variables;
+    Inferred type = Inferred::NONE;
+};
+
+SignatureInference::SignatureInference( const std::vector<Instance>& instances )
+    : instances( instances ), parameters( instances.size() ), results( instances.size(), Inferred::NONE ),
+      callers( instances.size() ), walked( instances.size(), false ) {
+    for ( uint32_t i = 0; i < instances.size(); ++i ) {
+        for ( const auto& [name, annotation] : instances[i].declaration->parameters ) {
+            parameters[i].push_back( AnnotatedType( annotation, instances[i], std::format( "Parameter '{}'", name ) ) );
+        }
+    }
+}
+
+std::vector<Signature> SignatureInference::Run() {
+    std::vector<uint32_t> work( instances.size() );
+    std::vector<bool> queued( instances.size(), true );
+    for ( uint32_t i = 0; i < instances.size(); ++i ) {
+        work[i] = static_cast<uint32_t>( instances.size() ) - 1 - i; // Popped in instance order
+    }
+
+    while ( !work.empty() ) {
+        const uint32_t function = work.back();
+        work.pop_back();
+        queued[function] = false;
+
+        const Inferred before = results[function];
+        Infer( function );
+        if ( results[function] == before ) {
+            continue;
+        }
+        for ( const uint32_t caller : callers[function] ) {
+            if ( !queued[caller] ) {
+                queued[caller] = true;
+                work.push_back( caller );
+            }
+        }
+    }
+
+    std::vector<Signature> signatures( instances.size() );
+    for ( uint32_t i = 0; i < instances.size(); ++i ) {
+        signatures[i].parameters = std::move( parameters[i] );
+        signatures[i].result = ToType( results[i] );
+    }
+    return signatures;
+}
+
+void SignatureInference::Infer( const uint32_t function ) {
+    current = function;
+    variables.clear();
+    const FunctionStatement& declaration = *instances[function].declaration;
+    for ( size_t i = 0; i < declaration.parameters.size(); ++i ) {
+        variables[declaration.parameters[i].first] = Of( parameters[function][i] );
+    }
+    for ( const auto& statement : declaration.body ) {
+        statement->accept( *this );
+    }
+    walked[function] = true;
+}
+
+Inferred SignatureInference::TypeOf( Expression& expression ) {
+    expression.accept( *this );
+    return type;
+}
+
+void SignatureInference::visit( const IfStatement& statement ) {
+    TypeOf( *statement.condition );
+    statement.thenBranch->accept( *this );
+    if ( statement.elseBranch ) {
+        statement.elseBranch->accept( *this );
+    }
+}
+
+void SignatureInference::visit( const WhileStatement& statement ) {
+    TypeOf( *statement.condition );
+    statement.body->accept( *this );
+}
+
+void SignatureInference::visit( const ForStatement& statement ) {
+    TypeOf( *statement.begin );
+    TypeOf( *statement.end );
+    variables[statement.variable] = Inferred::INT;
+    statement.body->accept( *this );
+}
+
+void SignatureInference::visit( const MatchStatement& statement ) {
+    TypeOf( *statement.subject );
+    for ( const MatchArm& arm : statement.arms ) {
+        arm.body->accept( *this );
+    }
+}
+
+void SignatureInference::visit( const ExpressionStatement& statement ) {
+    TypeOf( *statement.expression );
+}
+
+void SignatureInference::visit( const ReturnStatement& statement ) {
+    if ( statement.value ) {
+        results[current] = Join( results[current], TypeOf( *statement.value ) );
+    }
+}
+
+void SignatureInference::visit( const VariableStatement& statement ) {
+    const Inferred initial = statement.initializer ? TypeOf( *statement.initializer ) : Inferred::INT;
+    variables[statement.name] = statement.annotation
+        ? Of( AnnotatedType( *statement.annotation, instances[current], std::format( "Variable '{}'", statement.name ) ) )
+        : initial;
+}
+
+void SignatureInference::visit( const BlockStatement& statement ) {
+    for ( const auto& inner : statement.statements ) {
+        inner->accept( *this );
+    }
+}
+
+// null takes the type of the array it meets
+void SignatureInference::visit( const LiteralExpression& expression ) {
+    type = std::holds_alternative<std::monostate>( expression.value ) ? Inferred::NONE
+        : std::holds_alternative<float>( expression.value ) || std::holds_alternative<double>( expression.value )
+        ? Inferred::FLOAT : Inferred::INT;
+}
+
+void SignatureInference::visit( const AssignmentExpression& expression ) {
+    TypeOf( *expression.value );
+    // The value is converted to the variable's type, or rejected by lowering
+    const auto variable = variables.find( expression.name );
+    type = variable != variables.end() ? variable->second : Inferred::NONE;
+}
+
+void SignatureInference::visit( const BinaryExpression& expression ) {
+    const Inferred left = TypeOf( *expression.left );
+    const Inferred right = TypeOf( *expression.right );
+    switch ( expression.operator_ ) {
+        case TokenType::OPERATOR_PLUS: case TokenType::OPERATOR_MINUS:
+        case TokenType::OPERATOR_MULTIPLY: case TokenType::OPERATOR_DIVIDE:
+        case TokenType::OPERATOR_ELSENULL:
+            type = Join( left, right );
+            break;
+        default:
+            type = Inferred::INT; // Comparisons give 1 or 0
+            break;
+    }
+}
+
+void SignatureInference::visit( const UnaryExpression& expression ) {
+    const Inferred operand = TypeOf( *expression.right );
+    type = expression.operator_ == TokenType::OPERATOR_MINUS ? operand : Inferred::INT;
+}
+
+void SignatureInference::visit( const GetVariableExpression& expression ) {
+    const auto variable = variables.find( expression.name );
+    type = variable != variables.end() ? variable->second : Inferred::NONE;
+}
+
+void SignatureInference::visit( const CallExpression& expression ) {
+    for ( const auto& argument : expression.arguments ) {
+        TypeOf( *argument );
+    }
+
+    const auto callee = instances[current].callees.find( &expression );
+    if ( callee == instances[current].callees.end() ) {
+        type = Inferred::NONE; // Reported by lowering
+        return;
+    }
+    if ( !walked[current] ) {
+        callers[callee->second].push_back( current );
+    }
+    type = results[callee->second];
+}
+
+void SignatureInference::visit( const NewArrayExpression& expression ) {
+    TypeOf( *expression.length );
+    type = Of( ArrayOf( AnnotatedType( expression.elementType, instances[current], "An array element" ) ) );
+}
+
+void SignatureInference::visit( const IndexExpression& expression ) {
+    const Inferred array = TypeOf( *expression.array );
+    TypeOf( *expression.index );
+    type = ElementOf( array );
+}
+
+void SignatureInference::visit( const IndexAssignmentExpression& expression ) {
+    const Inferred array = TypeOf( *expression.array );
+    TypeOf( *expression.index );
+    TypeOf( *expression.value );
+    type = ElementOf( array );
+}
+
+}
+
+std::vector<Signature> Lumin::Compiler::IR::InferSignatures( const std::vector<Instance>& instances ) {
+    return SignatureInference( instances ).Run();
+}
@@ -0,0 +1,149 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <bit>
+#include <ir/Passes.hpp>
+
+using namespace Lumin::Compiler::IR;
+
+namespace {
+
+// Everything that makes two pure instructions compute the same value. Pure
+// instructions have at most two operands.
+struct ValueKey {
+    Op op;
+    Type type; // Tells apart the nulls of different array types
+    ValueId left = NO_ID;
+    ValueId right = NO_ID;
+    int32_t intValue = 0;
+    uint32_t floatBits = 0;
+    uint32_t index = 0;
+
+    bool operator==( const ValueKey& ) const = default;
+};
+
+struct ValueKeyHash {
+    size_t operator()( const ValueKey& key ) const {
+        uint64_t hash = static_cast<uint64_t>( key.op ) * 0x9E3779B97F4A7C15ull;
+        for ( const uint64_t part : { static_cast<uint64_t>( key.left ), static_cast<uint64_t>( key.right ),
+                                      static_cast<uint64_t>( static_cast<uint32_t>( key.intValue ) ),
+                                      static_cast<uint64_t>( key.floatBits ), static_cast<uint64_t>( key.index ) } ) {
+            hash = ( hash ^ part ) * 0x100000001B3ull;
+        }
+        return static_cast<size_t>( hash ^ hash >> 29 );
+    }
+};
+
+bool IsCommutative( const Op op ) {
+    return op == Op::ADD || op == Op::MUL || op == Op::CMP_EQ || op == Op::CMP_NE;
+}
+
+ValueKey MakeKey( const Function& function, const ValueId value ) {
+    const Instruction& instruction = function.values[value];
+    const auto operands = function.Operands( value );
+
+    ValueKey key { instruction.op, instruction.type };
+    key.intValue = instruction.intValue;
+    key.floatBits = std::bit_cast<uint32_t>( instruction.floatValue );
+    key.index = instruction.index;
+    if ( !operands.empty() ) {
+        key.left = function.Resolve( operands[0] );
+    }
+    if ( operands.size() > 1 ) {
+        key.right = function.Resolve( operands[1] );
+        if ( IsCommutative( instruction.op ) && key.right < key.left ) {
+            std::swap( key.left, key.right );
+        }
+    }
+    return key;
+}
+
+}
+
+bool Lumin::Compiler::IR::NumberValues( Function& function ) {
+    const DominatorTree tree = ComputeDominators( function );
+    if ( tree.order.empty() ) {
+        return false;
+    }
+
+    // Chained hash table threaded through the values themselves: a bucket
+    // holds its newest value and next[] the one it shadows. Leaving a
+    // dominator subtree unlinks its values newest first, which restores
+    // every bucket, so the walk allocates nothing per instruction.
+    const size_t bucketCount = std::bit_ceil( std::max<size_t>( 16, function.values.size() ) );
+    std::vector<ValueId> buckets( bucketCount, NO_ID );
+    std::vector<ValueId> next( function.values.size(), NO_ID );
+    std::vector<std::pair<size_t, ValueId>> scope;
+
+    struct Frame {
+        BlockId block;
+        size_t nextChild;
+        size_t scopeStart;
+    };
+    std::vector<Frame> stack;
+    bool changed = false;
+
+    const auto find = [&]( const size_t bucket, const ValueKey& key ) {
+        for ( ValueId candidate = buckets[bucket]; candidate != NO_ID; candidate = next[candidate] ) {
+            if ( MakeKey( function, candidate ) == key ) {
+                return candidate;
+            }
+        }
+        return NO_ID;
+    };
+
+    const auto enter = [&]( const BlockId block ) {
+        stack.push_back( { block, 0, scope.size() } );
+        for ( const ValueId value : function.blocks[block].instructions ) {
+            const Op op = function.values[value].op;
+            // Phis are only equal within one block and would need their
+            // operands compared per predecessor, they are left alone
+            if ( !IsPure( op ) || op == Op::PHI || op == Op::COPY ) {
+                continue;
+            }
+
+            const ValueKey key = MakeKey( function, value );
+            const size_t bucket = ValueKeyHash()( key ) & ( bucketCount - 1 );
+            if ( const ValueId existing = find( bucket, key ); existing != NO_ID ) {
+                function.ReplaceWith( value, existing );
+                changed = true;
+            } else {
+                next[value] = buckets[bucket];
+                buckets[bucket] = value;
+                scope.emplace_back( bucket, value );
+            }
+        }
+    };
+
+    enter( tree.order.front() );
+    while ( !stack.empty() ) {
+        Frame& frame = stack.back();
+        const auto& children = tree.children[frame.block];
+        if ( frame.nextChild < children.size() ) {
+            enter( children[frame.nextChild++] );
+            continue;
+        }
+
+        while ( scope.size() > frame.scopeStart ) {
+            const auto [bucket, value] = scope.back();
+            buckets[bucket] = next[value];
+            scope.pop_back();
+        }
+        stack.pop_back();
+    }
+
+    return changed;
+}
@@ -0,0 +1,545 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <Linker.hpp>
+#include <BytecodeReader.hpp>
+#include <BytecodeWriter.hpp>
+#include <ByteOrder.hpp>
+#include <ConstantPoolBuilder.hpp>
+
+using namespace Lumin::Linker;
+using namespace Lumin::Bytecode;
+
+namespace {
+
+constexpr uint32_t NO_CLASS = UINT32_MAX;
+constexpr uint32_t NO_METHOD = UINT32_MAX;
+
+struct LinkMethod {
+    size_t module;
+    uint32_t classIndex; // Global class index, NO_CLASS for free functions
+    MethodInfo info;
+    std::string name;
+    std::vector<uint8_t> code;
+};
+
+struct LinkClass {
+    size_t module;
+    const ClassInfo* info;
+    std::vector<uint32_t> methods; // Global method indices
+};
+
+const std::string* ConstantText( const LuminFile& module, const uint32_t index ) {
+    if ( index >= module.constantPool.size() ) {
+        return nullptr;
+    }
+    return std::get_if<std::string>( &module.constantPool[index].data );
+}
+
+bool IsLoad( const OpCode opcode ) {
+    return opcode == OpCode::ILOAD || ( opcode >= OpCode::ILOAD_0 && opcode <= OpCode::ILOAD_3 );
+}
+
+void PatchIndex( std::vector<uint8_t>& code, const size_t instruction, const uint32_t index ) {
+    Lumin::Utils::StoreLE( code.data() + instruction + 1, static_cast<uint16_t>( index ) );
+}
+
+// Re-emits a switch against the labels of its targets
+void EmitSwitch( BytecodeWriter& writer, const Instruction& instruction, const std::unordered_map<size_t, Label>& labels ) {
+    std::vector<int32_t> keys;
+    std::vector<Label> targets;
+    for ( uint32_t entry = 0; entry < instruction.SwitchCount(); ++entry ) {
+        keys.push_back( instruction.SwitchKey( entry ) );
+        targets.push_back( labels.at( instruction.SwitchTarget( entry ) ) );
+    }
+
+    const Label fallback = labels.at( instruction.SwitchDefault() );
+    if ( instruction.opcode == OpCode::TABLESWITCH ) {
+        writer.EmitTableSwitch( instruction.Load<int32_t>( 0 ), targets, fallback );
+    } else {
+        writer.EmitLookupSwitch( keys, targets, fallback );
+    }
+}
+
+class ModuleLinker {
+public:
+    ModuleLinker( const std::vector<LuminFile>& modules, const LinkOptions& options, LinkStats& stats )
+        : modules( modules ), options( options ), stats( stats ) {}
+
+    LuminFile Run();
+
+private:
+    void CollectMethods();
+    void ResolveCalls();
+    bool IsInlinable( const LinkMethod& callee ) const;
+    void InlineCalls( LinkMethod& caller, const std::vector<bool>& inlinable );
+    uint32_t FindEntry() const;
+    std::vector<bool> Reachable( uint32_t entry ) const;
+    uint16_t RemapConstant( size_t module, uint32_t index );
+
+    const std::vector<LuminFile>& modules;
+    const LinkOptions& options;
+    LinkStats& stats;
+
+    std::vector<LinkMethod> methods;
+    std::vector<LinkClass> classes;
+    std::vector<std::vector<uint32_t>> moduleMethods; // Module method index to global
+    std::unordered_map<std::string, uint32_t> symbols;
+
+    Lumin::Utils::ConstantPoolBuilder pool;
+    std::vector<std::vector<int32_t>> remappedConstants;
+};
+
+void ModuleLinker::CollectMethods() {
+    const auto addMethod = [&]( const size_t module, const uint32_t classIndex, const MethodInfo& info ) {
+        const LuminFile& file = modules[module];
+        if ( static_cast<uint64_t>( info.codeOffset ) + info.codeLength > file.bytecode.size() ) {
+            throw std::runtime_error( std::format( "Module {}: method body out of bounds", module ) );
+        }
+
+        const std::string* name = ConstantText( file, info.nameIndex );
+        const auto begin = file.bytecode.begin() + info.codeOffset;
+        moduleMethods[module].push_back( static_cast<uint32_t>( methods.size() ) );
+        methods.push_back( { module, classIndex, info, name ? *name : std::string(),
+            std::vector<uint8_t>( begin, begin + info.codeLength ) } );
+    };
+
+    moduleMethods.resize( modules.size() );
+    for ( size_t module = 0; module < modules.size(); ++module ) {
+        const LuminFile& file = modules[module];
+        stats.constantsIn += file.constantPool.size();
+        stats.classesIn += file.classes.size();
+
+        // Same order as the method table a module is loaded with, so module
+        // CALL indices map straight onto moduleMethods
+        for ( const auto& method : file.methods ) {
+            addMethod( module, NO_CLASS, method );
+        }
+        for ( const auto& classInfo : file.classes ) {
+            const auto classIndex = static_cast<uint32_t>( classes.size() );
+            LinkClass& linkClass = classes.emplace_back( module, &classInfo, std::vector<uint32_t> {} );
+            for ( const auto& method : classInfo.methods ) {
+                linkClass.methods.push_back( static_cast<uint32_t>( methods.size() ) );
+                addMethod( module, classIndex, method );
+            }
+        }
+    }
+    stats.methodsIn = methods.size();
+
+    if ( methods.size() > std::numeric_limits<uint16_t>::max() ) {
+        throw std::runtime_error( std::format( "Too many methods to link: {}", methods.size() ) );
+    }
+
+    // Free functions are exported by name and must be unique, a class method
+    // is only found by name when no free function claims it. Private ones,
+    // such as the instantiations of generic functions every module makes
+    // for itself, are only called from their own module.
+    for ( uint32_t i = 0; i < methods.size(); ++i ) {
+        const LinkMethod& method = methods[i];
+        if ( method.classIndex != NO_CLASS || method.name.empty() || ( method.info.flags & FLAG_PRIVATE ) != 0 ) {
+            continue;
+        }
+        if ( const auto [it, inserted] = symbols.try_emplace( method.name, i ); !inserted ) {
+            throw std::runtime_error( std::format( "Duplicate symbol '{}' in modules {} and {}",
+                method.name, methods[it->second].module, method.module ) );
+        }
+    }
+    for ( uint32_t i = 0; i < methods.size(); ++i ) {
+        if ( methods[i].classIndex != NO_CLASS && !methods[i].name.empty() ) {
+            symbols.try_emplace( methods[i].name, i );
+        }
+    }
+}
+
+// Renumbers CALL and TAILCALL operands into the global method table and
+// binds every INVOKE to its target. INVOKE and CALL have the same size, so both are
+// patched in place.
+void ModuleLinker::ResolveCalls() {
+    for ( auto& method : methods ) {
+        const LuminFile& file = modules[method.module];
+        const auto isMethodRef = [&file]( const uint16_t index ) {
+            return index < file.constantPool.size() && file.constantPool[index].tag == ConstantPoolTag::CONST_METHOD_REF;
+        };
+
+        const BytecodeReader reader( std::span<const unsigned char>( method.code ) );
+        reader.Validate( { method.info.maxLocals, moduleMethods[method.module].size(), isMethodRef } );
+
+        for ( const auto& instruction : reader ) {
+            if ( instruction.opcode == OpCode::CALL || instruction.opcode == OpCode::TAILCALL ) {
+                PatchIndex( method.code, instruction.offset, moduleMethods[method.module][instruction.Index()] );
+            } else if ( instruction.opcode == OpCode::INVOKE ) {
+                const uint16_t nameIndex = std::get<uint16_t>( file.constantPool[instruction.Index()].data );
+                const std::string* name = ConstantText( file, nameIndex );
+                const auto target = name ? symbols.find( *name ) : symbols.end();
+                if ( target == symbols.end() ) {
+                    throw std::runtime_error( std::format( "Unresolved method '{}' referenced from '{}'",
+                        name ? *name : "?", method.name ) );
+                }
+
+                method.code[instruction.offset] = static_cast<uint8_t>( OpCode::CALL );
+                PatchIndex( method.code, instruction.offset, target->second );
+                ++stats.resolvedReferences;
+            }
+        }
+    }
+}
+
+// Only straight-line bodies are inlined: no branches, no calls and at most a
+// RETURN as the last instruction, so the body can be pasted over the CALL.
+// Locals other than parameters must be written before they are read, since
+// an inlined body does not get freshly cleared locals.
+bool ModuleLinker::IsInlinable( const LinkMethod& callee ) const {
+    if ( callee.code.empty() || callee.code.size() > options.inlineBudget ) {
+        return false;
+    }
+
+    std::vector<bool> written( callee.info.maxLocals, false );
+    std::fill_n( written.begin(), std::min<size_t>( callee.info.parameterCount, written.size() ), true );
+
+    const BytecodeReader reader( std::span<const unsigned char>( callee.code ) );
+    for ( const auto& instruction : reader ) {
+        switch ( instruction.opcode ) {
+            case OpCode::CALL:
+            case OpCode::TAILCALL:
+            case OpCode::INVOKE:
+            case OpCode::SNAPSHOT:
+                return false;
+            case OpCode::RETURN:
+                if ( instruction.Next() != callee.code.size() ) {
+                    return false;
+                }
+                break;
+            default:
+                if ( IsBranch( instruction.opcode ) || IsSwitch( instruction.opcode ) || IsCountedLoop( instruction.opcode ) ) {
+                    return false;
+                }
+                if ( instruction.IsLocalAccess() ) {
+                    if ( IsLoad( instruction.opcode ) && !written[instruction.Local()] ) {
+                        return false;
+                    }
+                    written[instruction.Local()] = true;
+                }
+                break;
+        }
+    }
+
+    return true;
+}
+
+void ModuleLinker::InlineCalls( LinkMethod& caller, const std::vector<bool>& inlinable ) {
+    const auto inlinedHere = [&]( const Instruction& instruction ) {
+        return instruction.opcode == OpCode::CALL && inlinable[instruction.Index()]
+            && methods[instruction.Index()].module != caller.module;
+    };
+
+    const BytecodeReader reader( std::span<const unsigned char>( caller.code ) );
+    if ( std::ranges::none_of( reader, inlinedHere ) ) {
+        return;
+    }
+
+    // Branches are re-emitted against labels, the writer relaxes them once
+    // the inlined bodies have moved everything around
+    BytecodeWriter writer;
+    writer.Reserve( caller.code.size() * 2 );
+    std::unordered_map<size_t, Label> labels;
+    const auto addLabel = [&]( const size_t target ) {
+        if ( !labels.contains( target ) ) {
+            labels.emplace( target, writer.NewLabel() );
+        }
+    };
+    for ( const auto& instruction : reader ) {
+        if ( IsBranch( instruction.opcode ) ) {
+            addLabel( instruction.BranchTarget() );
+        } else if ( IsCountedLoop( instruction.opcode ) ) {
+            addLabel( instruction.LoopTarget() );
+        } else if ( IsSwitch( instruction.opcode ) ) {
+            addLabel( instruction.SwitchDefault() );
+            for ( uint32_t entry = 0; entry < instruction.SwitchCount(); ++entry ) {
+                addLabel( instruction.SwitchTarget( entry ) );
+            }
+        }
+    }
+
+    // Inlined bodies are straight-line, so their locals are never live at the
+    // same time and every call site shares one block after the caller's own
+    const uint32_t base = caller.info.maxLocals;
+    uint32_t extraLocals = 0;
+    uint32_t extraStack = 0;
+
+    for ( const auto& instruction : reader ) {
+        if ( const auto label = labels.find( instruction.offset ); label != labels.end() ) {
+            writer.Bind( label->second );
+        }
+
+        const auto raw = std::span<const uint8_t>( caller.code ).subspan( instruction.offset, instruction.Size() );
+        if ( IsBranch( instruction.opcode ) ) {
+            writer.EmitBranch( instruction.opcode, labels.at( instruction.BranchTarget() ) );
+            continue;
+        }
+        if ( IsSwitch( instruction.opcode ) ) {
+            EmitSwitch( writer, instruction, labels );
+            continue;
+        }
+        if ( IsCountedLoop( instruction.opcode ) ) {
+            writer.EmitCountedLoop( instruction.opcode, instruction.LoopCounter(), instruction.LoopLimit(),
+                labels.at( instruction.LoopTarget() ) );
+            continue;
+        }
+        if ( !inlinedHere( instruction ) ) {
+            writer.Emit( raw );
+            continue;
+        }
+
+        const LinkMethod& callee = methods[instruction.Index()];
+        if ( base + callee.info.maxLocals > std::numeric_limits<uint16_t>::max() ) {
+            writer.Emit( raw );
+            continue;
+        }
+
+        // Arguments are on the stack in order, the last one on top
+        for ( uint32_t parameter = callee.info.parameterCount; parameter > 0; --parameter ) {
+            writer.EmitIStore( static_cast<uint16_t>( base + parameter - 1 ) );
+        }
+
+        const BytecodeReader body( std::span<const unsigned char>( callee.code ) );
+        for ( const auto& calleeInstruction : body ) {
+            if ( calleeInstruction.opcode == OpCode::RETURN ) {
+                break;
+            }
+            if ( calleeInstruction.IsLocalAccess() ) {
+                const auto local = static_cast<uint16_t>( base + calleeInstruction.Local() );
+                IsLoad( calleeInstruction.opcode ) ? writer.EmitILoad( local ) : writer.EmitIStore( local );
+            } else {
+                writer.Emit( std::span<const uint8_t>( callee.code ).subspan( calleeInstruction.offset, calleeInstruction.Size() ) );
+            }
+        }
+
+        extraLocals = std::max<uint32_t>( extraLocals, callee.info.maxLocals );
+        extraStack = std::max<uint32_t>( extraStack, callee.info.maxStack );
+        ++stats.inlinedCalls;
+    }
+
+    if ( const auto label = labels.find( caller.code.size() ); label != labels.end() ) {
+        writer.Bind( label->second );
+    }
+    writer.Finish();
+
+    caller.code = std::move( writer.bytecode );
+    caller.info.maxLocals = static_cast<uint16_t>( base + extraLocals );
+    caller.info.maxStack = static_cast<uint16_t>( std::min<uint32_t>(
+        caller.info.maxStack + extraStack, std::numeric_limits<uint16_t>::max() ) );
+}
+
+uint32_t ModuleLinker::FindEntry() const {
+    if ( !options.entryName.empty() ) {
+        const auto it = symbols.find( options.entryName );
+        if ( it == symbols.end() ) {
+            throw std::runtime_error( std::format( "Entry method '{}' not found", options.entryName ) );
+        }
+        return it->second;
+    }
+
+    for ( size_t module = 0; module < modules.size(); ++module ) {
+        const uint32_t entry = modules[module].entryMethod;
+        if ( entry != LUMIN_NO_ENTRY_METHOD ) {
+            if ( entry >= moduleMethods[module].size() ) {
+                throw std::runtime_error( std::format( "Module {}: entry method out of range", module ) );
+            }
+            return moduleMethods[module][entry];
+        }
+    }
+
+    return NO_METHOD;
+}
+
+// Walks CALL edges from the entry. Reaching any method of a class keeps the
+// whole class, since its method table is laid out as a unit.
+std::vector<bool> ModuleLinker::Reachable( const uint32_t entry ) const {
+    std::vector<bool> reached( methods.size(), false );
+    std::vector<bool> classReached( classes.size(), false );
+    std::vector<uint32_t> worklist { entry };
+    reached[entry] = true;
+
+    while ( !worklist.empty() ) {
+        const LinkMethod& method = methods[worklist.back()];
+        worklist.pop_back();
+
+        const auto visit = [&]( const uint32_t index ) {
+            if ( !reached[index] ) {
+                reached[index] = true;
+                worklist.push_back( index );
+            }
+        };
+
+        if ( method.classIndex != NO_CLASS && !classReached[method.classIndex] ) {
+            classReached[method.classIndex] = true;
+            std::ranges::for_each( classes[method.classIndex].methods, visit );
+        }
+
+        const BytecodeReader reader( std::span<const unsigned char>( method.code ) );
+        for ( const auto& instruction : reader ) {
+            if ( instruction.opcode == OpCode::CALL || instruction.opcode == OpCode::TAILCALL ) {
+                visit( instruction.Index() );
+            }
+        }
+    }
+
+    return reached;
+}
+
+// Copies a module constant into the merged pool, references are remapped
+// first so equal entries from different modules intern to the same slot
+uint16_t ModuleLinker::RemapConstant( const size_t module, const uint32_t index ) {
+    const auto& constants = modules[module].constantPool;
+    if ( index >= constants.size() ) {
+        return 0;
+    }
+
+    int32_t& remapped = remappedConstants[module][index];
+    if ( remapped >= 0 ) {
+        return static_cast<uint16_t>( remapped );
+    }
+
+    const ConstantPoolEntry& entry = constants[index];
+    if ( const auto* reference = std::get_if<uint16_t>( &entry.data ) ) {
+        const uint16_t target = RemapConstant( module, *reference );
+        remapped = pool.Add( { entry.tag, target } );
+    } else {
+        remapped = pool.Add( entry );
+    }
+
+    return static_cast<uint16_t>( remapped );
+}
+
+LuminFile ModuleLinker::Run() {
+    if ( modules.empty() ) {
+        throw std::runtime_error( "Nothing to link" );
+    }
+
+    CollectMethods();
+    ResolveCalls();
+
+    if ( options.inlineCrossModule ) {
+        std::vector<bool> inlinable( methods.size() );
+        for ( size_t i = 0; i < methods.size(); ++i ) {
+            inlinable[i] = IsInlinable( methods[i] );
+        }
+        for ( auto& method : methods ) {
+            InlineCalls( method, inlinable );
+        }
+    }
+
+    // Without an entry there is no root to walk from, everything is kept
+    const uint32_t entry = FindEntry();
+    const std::vector<bool> kept = options.eliminateDeadCode && entry != NO_METHOD
+        ? Reachable( entry )
+        : std::vector<bool>( methods.size(), true );
+
+    // Final method table: free functions first, then every kept class
+    std::vector<uint32_t> newIndex( methods.size(), NO_METHOD );
+    uint32_t next = 0;
+    for ( uint32_t i = 0; i < methods.size(); ++i ) {
+        if ( kept[i] && methods[i].classIndex == NO_CLASS ) {
+            newIndex[i] = next++;
+        }
+    }
+    std::vector<bool> keptClasses( classes.size() );
+    for ( size_t i = 0; i < classes.size(); ++i ) {
+        const auto& classMethods = classes[i].methods;
+        keptClasses[i] = classMethods.empty() ? !options.eliminateDeadCode || entry == NO_METHOD : kept[classMethods.front()];
+        if ( keptClasses[i] ) {
+            for ( const uint32_t method : classMethods ) {
+                newIndex[method] = next++;
+            }
+        }
+    }
+
+    remappedConstants.resize( modules.size() );
+    for ( size_t module = 0; module < modules.size(); ++module ) {
+        remappedConstants[module].assign( modules[module].constantPool.size(), -1 );
+    }
+
+    LuminFile linked {};
+    linked.magicNumber = LUMIN_MAGIC_NUMBER;
+    linked.versionMajor = LUMIN_VERSION_MAJOR;
+    linked.versionMinor = LUMIN_VERSION_MINOR;
+    linked.flags = modules.front().flags;
+    linked.entryMethod = entry == NO_METHOD ? LUMIN_NO_ENTRY_METHOD : newIndex[entry];
+
+    const auto emitMethod = [&]( LinkMethod& method ) {
+        const BytecodeReader reader( std::span<const unsigned char>( method.code ) );
+        for ( const auto& instruction : reader ) {
+            if ( instruction.opcode == OpCode::CALL || instruction.opcode == OpCode::TAILCALL ) {
+                PatchIndex( method.code, instruction.offset, newIndex[instruction.Index()] );
+            }
+        }
+
+        MethodInfo info = method.info;
+        info.nameIndex = RemapConstant( method.module, info.nameIndex );
+        info.signatureIndex = RemapConstant( method.module, info.signatureIndex );
+        info.codeOffset = static_cast<uint32_t>( linked.bytecode.size() );
+        info.codeLength = static_cast<uint32_t>( method.code.size() );
+        linked.bytecode.insert( linked.bytecode.end(), method.code.begin(), method.code.end() );
+        return info;
+    };
+
+    for ( size_t i = 0; i < methods.size(); ++i ) {
+        if ( methods[i].classIndex == NO_CLASS && newIndex[i] != NO_METHOD ) {
+            linked.methods.push_back( emitMethod( methods[i] ) );
+        }
+    }
+
+    for ( size_t i = 0; i < classes.size(); ++i ) {
+        if ( !keptClasses[i] ) {
+            continue;
+        }
+
+        const LinkClass& linkClass = classes[i];
+        ClassInfo classInfo;
+        classInfo.flags = linkClass.info->flags;
+        classInfo.nameIndex = RemapConstant( linkClass.module, linkClass.info->nameIndex );
+        classInfo.superClassIndex = RemapConstant( linkClass.module, linkClass.info->superClassIndex );
+        for ( FieldInfo field : linkClass.info->fields ) {
+            field.nameIndex = RemapConstant( linkClass.module, field.nameIndex );
+            field.typeIndex = RemapConstant( linkClass.module, field.typeIndex );
+            field.defaultValueIndex = RemapConstant( linkClass.module, field.defaultValueIndex );
+            classInfo.fields.push_back( field );
+        }
+        for ( const uint32_t method : linkClass.methods ) {
+            classInfo.methods.push_back( emitMethod( methods[method] ) );
+        }
+        linked.classes.push_back( std::move( classInfo ) );
+    }
+
+    linked.constantPool = pool.Release();
+
+    stats.methodsOut = next;
+    stats.classesOut = linked.classes.size();
+    stats.constantsOut = linked.constantPool.size();
+    return linked;
+}
+
+}
+
+LuminFile Lumin::Linker::Link( const std::vector<LuminFile>& modules, const LinkOptions& options, LinkStats* stats ) {
+    LinkStats localStats;
+    ModuleLinker linker( modules, options, stats ? *stats : localStats );
+    return linker.Run();
+}
@@ -0,0 +1,103 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+#include <format>
+#include <vector>
+#include <Linker.hpp>
+#include <Utils.hpp>
+
+std::string GetLoggerName() {
+    return "lumin-link";
+}
+
+int main( const int argc, char *argv[] ) {
+    int opt;
+    /*
+     o/output - linked program, a.lmn by default
+     e/entry - name of the entry method, the first module's entry when not given
+     i/inline - inline small functions across module boundaries
+     k/keep-all - keep methods that are unreachable from the entry
+     */
+    constexpr auto options = "o:|output|:e:|entry|:i|inline|k|keep-all|V|verbose|h|help|v|version|";
+    bool verbose = false;
+    std::string outputPath = "a.lmn";
+    Lumin::Linker::LinkOptions linkOptions;
+
+    while ( (opt = lumin::utils::getopt( argc, argv, options ) ) != -1 ) {
+        switch ( opt ) {
+            case 'v':
+                if ( current_option == "version" || current_option == "v" ) {
+                    LOG_INFO( "Lumin Linker Information:" )
+                    LOG_INFO( "  Target Lumin Version: " + std::to_string( LUMIN_VERSION_MAJOR ) +
+                         "." + std::to_string ( LUMIN_VERSION_MINOR ) +  "(Patch " + std::to_string ( LUMIN_VERSION_PATCH ) + ")" );
+                    return 0;
+                }
+                break;
+            case 'h':
+                LOG_INFO( "Usage: lumin-link [-o output] [-e entry] [-i] [-k] module.lmn..." )
+                return 0;
+            case 'V':
+                verbose = true;
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            case 'e':
+                linkOptions.entryName = optarg;
+                break;
+            case 'i':
+                linkOptions.inlineCrossModule = true;
+                break;
+            case 'k':
+                linkOptions.eliminateDeadCode = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if ( optind >= argc ) {
+        LOG_ERROR( "No input modules" )
+        return 1;
+    }
+
+    std::vector<LuminFile> modules;
+    Lumin::Linker::LinkStats stats;
+    try {
+        for ( int i = optind; i < argc; ++i ) {
+            modules.push_back( Lumin::Utils::ReadLuminFile( argv[i] ) );
+            if ( modules.back().magicNumber != LUMIN_MAGIC_NUMBER ) {
+                LOG_ERROR( "Not a Lumin module: " + std::string( argv[i] ) )
+                return 1;
+            }
+        }
+
+        if ( !Lumin::Utils::WriteLuminFile( outputPath, Lumin::Linker::Link( modules, linkOptions, &stats ) ) ) {
+            return 1;
+        }
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( std::format( "Link failed: {}", exception.what() ) )
+        return 1;
+    }
+
+    if ( verbose ) {
+        LOG_INFO( std::format( "Methods: {} -> {}", stats.methodsIn, stats.methodsOut ) )
+        LOG_INFO( std::format( "Classes: {} -> {}", stats.classesIn, stats.classesOut ) )
+        LOG_INFO( std::format( "Constants: {} -> {}", stats.constantsIn, stats.constantsOut ) )
+        LOG_INFO( std::format( "Resolved {} references, inlined {} calls", stats.resolvedReferences, stats.inlinedCalls ) )
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <mutex>
+#include <InternTable.hpp>
+
+using namespace Lumin::VM;
+
+InternTable& InternTable::Global() {
+    static InternTable table;
+    return table;
+}
+
+const std::string* InternTable::Intern( const std::string_view value ) {
+    {
+        std::shared_lock reader( lock );
+        if ( const auto it = strings.find( value ); it != strings.end() ) {
+            return &*it;
+        }
+    }
+
+    // Set nodes never move, the address stays valid for the process lifetime
+    std::unique_lock writer( lock );
+    return &*strings.emplace( value ).first;
+}
+
+size_t InternTable::Size() const {
+    std::shared_lock reader( lock );
+    return strings.size();
+}
@@ -0,0 +1,249 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <format>
+#include <stdexcept>
+#include <LuminRuntime.hpp>
+#include <InternTable.hpp>
+#include <BytecodeReader.hpp>
+
+using namespace Lumin::VM;
+
+LuminRuntime::LuminRuntime( LuminFileView file ) : file( std::move( file ) ) {
+    RegisterStubs();
+}
+
+LuminRuntime::LuminRuntime( const LuminFile& program ) : ownedImage( Utils::SerializeLuminFile( program ) ) {
+    file = Utils::ViewLuminFile( ownedImage, "<memory>" );
+    if ( file.magicNumber != LUMIN_MAGIC_NUMBER ) {
+        throw std::runtime_error( "Invalid in-memory program" );
+    }
+    RegisterStubs();
+}
+
+void LuminRuntime::RegisterStubs() {
+    methodCount = file.methodCount;
+    slots = std::make_unique<MethodSlot[]>( methodCount );
+    for ( size_t i = 0; i < methodCount; ++i ) {
+        slots[i].info = file.Method( i );
+    }
+
+    resolvedConstants = std::make_unique<std::atomic<const void*>[]>( file.constantCount );
+}
+
+const MethodInfo& LuminRuntime::Method( const uint32_t index ) const {
+    if ( index >= methodCount ) {
+        throw std::runtime_error( std::format( "Method index {} out of range", index ) );
+    }
+    return slots[index].info;
+}
+
+const LinkedMethod& LuminRuntime::Resolve( const uint32_t index ) {
+    if ( index >= methodCount ) {
+        throw std::runtime_error( std::format( "Method index {} out of range", index ) );
+    }
+
+    if ( const LinkedMethod* linked = slots[index].linked.load( std::memory_order_acquire ) ) {
+        return *linked;
+    }
+    return Link( index );
+}
+
+// Slow path, taken once per method. Another isolate may have linked it
+// while this one waited for the lock.
+const LinkedMethod& LuminRuntime::Link( const uint32_t index ) {
+    MethodSlot& slot = slots[index];
+    std::lock_guard guard( linkLocks[index % LINK_LOCK_STRIPES] );
+    if ( const LinkedMethod* linked = slot.linked.load( std::memory_order_acquire ) ) {
+        return *linked;
+    }
+
+    const auto code = file.bytecode;
+    const MethodInfo& info = slot.info;
+    if ( info.codeOffset > code.size() || info.codeLength > code.size() - info.codeOffset ) {
+        throw std::runtime_error( std::format( "Method {} body is out of bounds", index ) );
+    }
+
+    const auto body = code.subspan( info.codeOffset, info.codeLength );
+    Verify( info, body );
+
+    slot.storage = std::make_unique<LinkedMethod>( LinkedMethod { index, info, body } );
+    slot.linked.store( slot.storage.get(), std::memory_order_release );
+    materialized.fetch_add( 1, std::memory_order_relaxed );
+
+    return *slot.storage;
+}
+
+void LuminRuntime::ResolveAll() {
+    for ( size_t i = 0; i < methodCount; ++i ) {
+        Resolve( static_cast<uint32_t>( i ) );
+    }
+}
+
+RuntimeCaches LuminRuntime::Caches() const {
+    RuntimeCaches caches;
+    for ( uint32_t i = 0; i < methodCount; ++i ) {
+        if ( slots[i].linked.load( std::memory_order_acquire ) != nullptr ) {
+            caches.linkedMethods.push_back( i );
+        }
+    }
+    for ( uint32_t i = 0; i < file.constantCount; ++i ) {
+        const void* resolved = resolvedConstants[i].load( std::memory_order_acquire );
+        if ( resolved == nullptr ) {
+            continue;
+        }
+        const bool methodRef = file.Constant( i ).tag == ConstantPoolTag::CONST_METHOD_REF;
+        caches.constants.push_back( { i, methodRef ? static_cast<const LinkedMethod*>( resolved )->index : 0 } );
+    }
+    return caches;
+}
+
+void LuminRuntime::RestoreCaches( const RuntimeCaches& caches ) {
+    for ( const uint32_t index : caches.linkedMethods ) {
+        if ( index >= methodCount ) {
+            throw std::runtime_error( std::format( "Method index {} out of range", index ) );
+        }
+        Link( index );
+    }
+
+    for ( const auto& [index, target] : caches.constants ) {
+        switch ( Constant( index ).tag ) {
+            case ConstantPoolTag::CONST_METHOD_REF:
+                resolvedConstants[index].store( &Resolve( target ), std::memory_order_release );
+                break;
+            case ConstantPoolTag::CONST_CLASS:
+                ResolveClass( index );
+                break;
+            default:
+                ResolveString( index );
+                break;
+        }
+    }
+}
+
+ConstantPoolEntryView LuminRuntime::Constant( const uint32_t index ) const {
+    if ( index >= file.constantCount ) {
+        throw std::runtime_error( std::format( "Constant index {} out of range", index ) );
+    }
+    return file.Constant( index );
+}
+
+ConstantPoolEntryView LuminRuntime::CheckedConstant( const uint32_t index, const ConstantPoolTag tag ) const {
+    ConstantPoolEntryView entry = Constant( index );
+    if ( entry.tag != tag ) {
+        throw std::runtime_error( std::format( "Constant {} has tag {}, expected {}",
+            index, static_cast<int>( entry.tag ), static_cast<int>( tag ) ) );
+    }
+    return entry;
+}
+
+// Resolution is idempotent, two isolates racing on the same index compute
+// the same value and either store wins.
+const std::string* LuminRuntime::ResolveString( const uint32_t index ) {
+    if ( index >= file.constantCount ) {
+        throw std::runtime_error( std::format( "Constant index {} out of range", index ) );
+    }
+    if ( const void* resolved = resolvedConstants[index].load( std::memory_order_acquire ) ) {
+        return static_cast<const std::string*>( resolved );
+    }
+
+    const ConstantPoolEntryView entry = file.Constant( index );
+    if ( entry.tag != ConstantPoolTag::CONST_UTF8 && entry.tag != ConstantPoolTag::CONST_STRING ) {
+        throw std::runtime_error( std::format( "Constant {} is not a string", index ) );
+    }
+
+    const std::string* interned = InternTable::Global().Intern( std::get<std::string_view>( entry.data ) );
+    resolvedConstants[index].store( interned, std::memory_order_release );
+    return interned;
+}
+
+const RuntimeClass& LuminRuntime::ResolveClass( const uint32_t index ) {
+    if ( index < file.constantCount ) {
+        if ( const void* resolved = resolvedConstants[index].load( std::memory_order_acquire ) ) {
+            return *static_cast<const RuntimeClass*>( resolved );
+        }
+    }
+
+    const auto nameIndex = std::get<uint16_t>( CheckedConstant( index, ConstantPoolTag::CONST_CLASS ).data );
+    const std::string* name = ResolveString( nameIndex );
+
+    BuildNameTables();
+    const auto found = classesByName.find( name );
+    if ( found == classesByName.end() ) {
+        throw std::runtime_error( "Unknown class " + *name );
+    }
+
+    resolvedConstants[index].store( &found->second, std::memory_order_release );
+    return found->second;
+}
+
+const LinkedMethod& LuminRuntime::ResolveMethodRef( const uint32_t index ) {
+    if ( index < file.constantCount ) {
+        if ( const void* resolved = resolvedConstants[index].load( std::memory_order_acquire ) ) {
+            return *static_cast<const LinkedMethod*>( resolved );
+        }
+    }
+
+    const auto nameIndex = std::get<uint16_t>( CheckedConstant( index, ConstantPoolTag::CONST_METHOD_REF ).data );
+    const std::string* name = ResolveString( nameIndex );
+
+    BuildNameTables();
+    const auto found = methodsByName.find( name );
+    if ( found == methodsByName.end() ) {
+        throw std::runtime_error( "Unknown method " + *name );
+    }
+
+    const LinkedMethod& method = Resolve( found->second );
+    resolvedConstants[index].store( &method, std::memory_order_release );
+    return method;
+}
+
+// Names are interned, so the tables are keyed by pointer and a lookup never
+// hashes the string itself
+void LuminRuntime::BuildNameTables() {
+    std::call_once( nameTablesOnce, [this] {
+        const auto name = [this]( const uint16_t nameIndex ) {
+            return InternTable::Global().Intern(
+                std::get<std::string_view>( CheckedConstant( nameIndex, ConstantPoolTag::CONST_UTF8 ).data ) );
+        };
+
+        methodsByName.reserve( methodCount );
+        for ( uint32_t i = 0; i < methodCount; ++i ) {
+            methodsByName.try_emplace( name( slots[i].info.nameIndex ), i );
+        }
+
+        classesByName.reserve( file.classCount );
+        for ( uint32_t i = 0; i < file.classCount; ++i ) {
+            ClassInfo info = file.Class( i );
+            const std::string* className = name( info.nameIndex );
+            classesByName.try_emplace( className, RuntimeClass { className, std::move( info ) } );
+        }
+    } );
+}
+
+void LuminRuntime::Verify( const MethodInfo& info, const std::span<const unsigned char> body ) const {
+    if ( info.parameterCount > info.maxLocals ) {
+        throw std::runtime_error( "Method takes more parameters than it has locals" );
+    }
+
+    Bytecode::BytecodeReader( body ).Validate( {
+        info.maxLocals,
+        methodCount,
+        [this]( const uint16_t index ) {
+            return index < file.constantCount && file.Constant( index ).tag == ConstantPoolTag::CONST_METHOD_REF;
+        }
+    } );
+}
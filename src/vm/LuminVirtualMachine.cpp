@@ -14,30 +14,109 @@
  limitations under the License.
  */
 
+#include <algorithm>
 #include <format>
 #include <LuminVirtualMachine.hpp>
+#include <BytecodeReader.hpp>
+#include <VectorKernels.hpp>
+#include <ByteOrder.hpp>
 #include <string>
 
 #include "Logging.hpp"
 
 using namespace Lumin::VM;
 
-LuminVirtualMachine::LuminVirtualMachine( const std::vector<byte>& bytecode ) {
-    this->bytecode = bytecode;
+namespace {
+
+// A program without methods, its code section runs from offset 0
+LuminFile BytecodeOnlyProgram( const std::vector<byte>& bytecode ) {
+    LuminFile program {};
+    program.magicNumber = LUMIN_MAGIC_NUMBER;
+    program.versionMajor = LUMIN_VERSION_MAJOR;
+    program.versionMinor = LUMIN_VERSION_MINOR;
+    program.bytecode = bytecode;
+    return program;
+}
+
+}
+
+LuminVirtualMachine::LuminVirtualMachine( const std::vector<byte>& bytecode, LuminVirtualMachineConfig config )
+    : LuminVirtualMachine( std::make_shared<LuminRuntime>( BytecodeOnlyProgram( bytecode ) ), std::move( config ) ) {}
+
+LuminVirtualMachine::LuminVirtualMachine( std::shared_ptr<LuminRuntime> runtime, LuminVirtualMachineConfig config )
+    : config( std::move( config ) ), runtime( std::move( runtime ) ) {
     this->ip = 0;
     this->base_pointer = 0;
+    if ( this->config.Profile ) {
+        profiler = std::make_unique<Profiler>( *this->runtime );
+    }
 
     Init();
+    Start();
 }
 
-void LuminVirtualMachine::Run() {
-    ip = 0;
+LuminVirtualMachine::LuminVirtualMachine(
+    VMSnapshot snapshot,
+    std::shared_ptr<LuminRuntime> runtime,
+    LuminVirtualMachineConfig config
+) : config( std::move( config ) ), runtime( std::move( runtime ) ) {
+    this->ip = snapshot.ip;
+    this->base_pointer = snapshot.basePointer;
+    if ( this->config.Profile ) {
+        profiler = std::make_unique<Profiler>( *this->runtime );
+    }
 
-    while ( ip < bytecode.size() && !freezeExecution) {
-        const auto opcode = static_cast<OpCode>( bytecode[ip++] );
+    for ( const auto& value : snapshot.stack ) {
+        stack.Push( value );
+    }
+    locals = std::move( snapshot.locals );
+    heap.Restore( std::move( snapshot.arrays ), std::move( snapshot.freeSlots ), std::move( snapshot.localArrays ),
+        snapshot.statistics );
+
+    // Linked and resolved as they were, the bodies are verified again
+    this->runtime->RestoreCaches( snapshot.runtime );
+
+    // The handlers index a frame's locals by the verified maxLocals of its method
+    frames.reserve( snapshot.frames.size() );
+    for ( auto& [methodIndex, returnAddress, basePointer, frameLocals] : snapshot.frames ) {
+        const uint16_t maxLocals = this->runtime->Resolve( methodIndex ).info.maxLocals;
+        if ( frameLocals.size() != maxLocals ) {
+            throw std::runtime_error( std::format( "Snapshot frame of method {} has {} locals, the method has {}",
+                methodIndex, frameLocals.size(), maxLocals ) );
+        }
+        auto& frame = frames.emplace_back( methodIndex, returnAddress, basePointer, 0 );
+        frame.local_variables = std::move( frameLocals );
+    }
+    bytecode = frames.empty() ? this->runtime->Code() : this->runtime->Resolve( frames.back().method_index ).code;
+    if ( ip > bytecode.size() ) {
+        throw std::runtime_error( "Snapshot ip is outside of the executing method" );
+    }
+
+    Init();
+}
+
+void LuminVirtualMachine::Start() {
+    bytecode = runtime->Code();
+    if ( runtime->EntryMethod() != LUMIN_NO_ENTRY_METHOD ) {
+        // Returning from the entry method lands at the end of the code and stops
+        ip = bytecode.size();
+        Invoke( runtime->Resolve( runtime->EntryMethod() ) );
+    }
+}
+
+void LuminVirtualMachine::Run() {
+    while ( !freezeExecution ) {
+        // Running off the end of a method body returns from it
+        if ( ip >= bytecode.size() ) {
+            if ( frames.empty() ) {
+                break;
+            }
+            HandleRETURN();
+            continue;
+        }
 
         try {
-            Process( opcode );
+            Process( Decode() );
         } catch ( const std::exception& exception ) {
             LOG_ERROR( std::format( "LuminVM Error {} ( IP: {} )", exception.what(), ip - 1 ) )
 
@@ -48,13 +127,13 @@ void LuminVirtualMachine::Run() {
 void LuminVirtualMachine::Step() {
     LOG_DEBUG( std::format( "Stepping at IP: {}", ip ) )
     if ( ip < bytecode.size() ) {
-        const auto opcode = static_cast<OpCode>( bytecode[ip++] );
-
         try {
-            Process( opcode );
+            Process( Decode() );
         } catch ( const std::exception& exception ) {
             LOG_DEBUG( std::format( "LuminVM Error {} ( IP: {} )", exception.what(), ip - 1 ) )
         }
+    } else if ( !frames.empty() ) {
+        HandleRETURN();
     } else {
         LOG_DEBUG ( std::format( "Cannot step any furter! ( IP: {} )", ip ) )
     }
@@ -65,7 +144,63 @@ void LuminVirtualMachine::Reset() {
     ip = 0;
     stack.Clear();
     frames.clear();
+    heap.Clear();
     base_pointer = 0;
+    Start();
+}
+
+VMSnapshot LuminVirtualMachine::CaptureSnapshot() const {
+    VMSnapshot snapshot;
+    snapshot.ip = ip;
+    snapshot.basePointer = base_pointer;
+    snapshot.stack.reserve( stack.Size() );
+    for ( size_t i = 0; i < stack.Size(); ++i ) {
+        snapshot.stack.push_back( stack[i] );
+    }
+    snapshot.locals = locals;
+    snapshot.arrays = heap.Arrays();
+    snapshot.freeSlots = heap.FreeSlots();
+    snapshot.localArrays = heap.LocalArrays();
+    snapshot.statistics = heap.Statistics();
+    snapshot.runtime = runtime->Caches();
+
+    snapshot.frames.reserve( frames.size() );
+    for ( const auto& frame : frames ) {
+        snapshot.frames.push_back( { frame.method_index, frame.return_address, frame.base_pointer, frame.local_variables } );
+    }
+
+    return snapshot;
+}
+
+Lumin::Utils::ExecutionProfile LuminVirtualMachine::CollectProfile() const {
+    if ( !profiler ) {
+        throw std::logic_error( "The VM was not configured to profile" );
+    }
+    return profiler->Collect( *runtime );
+}
+
+std::vector<NumericValue>& LuminVirtualMachine::CurrentLocals() {
+    return frames.empty() ? locals : frames.back().local_variables;
+}
+
+void LuminVirtualMachine::Invoke( const LinkedMethod& method ) {
+    const size_t argumentCount = method.info.parameterCount;
+    if ( stack.Size() < argumentCount ) {
+        throw std::runtime_error( "Stack underflow" );
+    }
+
+    if ( profiler ) {
+        profiler->Call( frames.empty() ? NO_CALLER : frames.back().method_index, method.index );
+    }
+
+    StackFrame& frame = frames.emplace_back( method.index, ip, base_pointer, method.info.maxLocals );
+    for ( size_t i = argumentCount; i > 0; --i ) {
+        frame.local_variables[i - 1] = stack.Pop();
+    }
+
+    base_pointer = stack.Size();
+    bytecode = method.code;
+    ip = 0;
 }
 
 void LuminVirtualMachine::Init() {
@@ -78,10 +213,74 @@ void LuminVirtualMachine::Init() {
         { OpCode::IADD, &LuminVirtualMachine::HandleIADD },
         { OpCode::ISUB, &LuminVirtualMachine::HandleISUB },
         { OpCode::INEG, &LuminVirtualMachine::HandleINEG },
+        { OpCode::ICMP, &LuminVirtualMachine::HandleICMP },
+        { OpCode::POP, &LuminVirtualMachine::HandlePOP },
         { OpCode::I2F, &LuminVirtualMachine::HandleI2F },
         //
+        { OpCode::ICONST_M1, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_0, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_1, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_2, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_3, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_4, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::ICONST_5, &LuminVirtualMachine::HandleICONST_N },
+        { OpCode::BIPUSH, &LuminVirtualMachine::HandleBIPUSH },
+        { OpCode::SIPUSH, &LuminVirtualMachine::HandleSIPUSH },
+        { OpCode::ILOAD_0, &LuminVirtualMachine::HandleILOAD_N },
+        { OpCode::ILOAD_1, &LuminVirtualMachine::HandleILOAD_N },
+        { OpCode::ILOAD_2, &LuminVirtualMachine::HandleILOAD_N },
+        { OpCode::ILOAD_3, &LuminVirtualMachine::HandleILOAD_N },
+        { OpCode::ISTORE_0, &LuminVirtualMachine::HandleISTORE_N },
+        { OpCode::ISTORE_1, &LuminVirtualMachine::HandleISTORE_N },
+        { OpCode::ISTORE_2, &LuminVirtualMachine::HandleISTORE_N },
+        { OpCode::ISTORE_3, &LuminVirtualMachine::HandleISTORE_N },
+        { OpCode::WIDE, &LuminVirtualMachine::HandleWIDE },
+        //
         { OpCode::FCONST, &LuminVirtualMachine::HandleFCONST },
         { OpCode::FADD, &LuminVirtualMachine::HandleFADD },
+        { OpCode::FSUB, &LuminVirtualMachine::HandleFSUB },
+        { OpCode::FMUL, &LuminVirtualMachine::HandleFMUL },
+        { OpCode::FDIV, &LuminVirtualMachine::HandleFDIV },
+        { OpCode::FNEG, &LuminVirtualMachine::HandleFNEG },
+        { OpCode::FCMP, &LuminVirtualMachine::HandleFCMP },
+        //
+        { OpCode::ACONST_NULL, &LuminVirtualMachine::HandleACONST_NULL },
+        { OpCode::ALLOC_ARRAY, &LuminVirtualMachine::HandleALLOC_ARRAY },
+        { OpCode::ALLOC_LOCAL_ARRAY, &LuminVirtualMachine::HandleALLOC_ARRAY },
+        { OpCode::LOAD_ARRAY, &LuminVirtualMachine::HandleLOAD_ARRAY },
+        { OpCode::STORE_ARRAY, &LuminVirtualMachine::HandleSTORE_ARRAY },
+        { OpCode::LOAD_ARRAY_NONNULL, &LuminVirtualMachine::HandleLOAD_ARRAY },
+        { OpCode::STORE_ARRAY_NONNULL, &LuminVirtualMachine::HandleSTORE_ARRAY },
+        { OpCode::ISNULL, &LuminVirtualMachine::HandleISNULL },
+        { OpCode::VADD, &LuminVirtualMachine::HandleVECTOR },
+        { OpCode::VSUB, &LuminVirtualMachine::HandleVECTOR },
+        { OpCode::VMUL, &LuminVirtualMachine::HandleVECTOR },
+        { OpCode::VDIV, &LuminVirtualMachine::HandleVECTOR },
+        //
+        { OpCode::CALL, &LuminVirtualMachine::HandleCALL },
+        { OpCode::INVOKE, &LuminVirtualMachine::HandleINVOKE },
+        { OpCode::TAILCALL, &LuminVirtualMachine::HandleTAILCALL },
+        { OpCode::RETURN, &LuminVirtualMachine::HandleRETURN },
+        { OpCode::GOTO, &LuminVirtualMachine::HandleGOTO },
+        { OpCode::GOTO_S, &LuminVirtualMachine::HandleGOTO },
+        { OpCode::IFEQ, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFNE, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFLT, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFGT, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFLE, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFGE, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFEQ_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFNE_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFLT_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFGT_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFLE_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::IFGE_S, &LuminVirtualMachine::HandleIF },
+        { OpCode::TABLESWITCH, &LuminVirtualMachine::HandleTABLESWITCH },
+        { OpCode::LOOKUPSWITCH, &LuminVirtualMachine::HandleLOOKUPSWITCH },
+        { OpCode::FOR_RANGE, &LuminVirtualMachine::HandleFOR_RANGE },
+        { OpCode::LOOP_NEXT, &LuminVirtualMachine::HandleLOOP_NEXT },
+        //
+        { OpCode::SNAPSHOT, &LuminVirtualMachine::HandleSNAPSHOT },
     };
 }
 
@@ -90,17 +289,23 @@ void LuminVirtualMachine::Process( OpCode opcode ) {
     if ( it != opcode_handlers.end() ) {
         (this->*(it->second))();
     } else {
-        throw std::runtime_error( "Unimplemented opcode: " + static_cast<int>( opcode ) );
+        throw std::runtime_error( std::format( "Unimplemented opcode: {}", static_cast<int>( opcode ) ) );
     }
 }
 
+OpCode LuminVirtualMachine::Decode() {
+    const size_t offset = ip++;
+    instruction_end = Bytecode::BytecodeReader( bytecode ).Decode( offset ).Next();
+    return static_cast<OpCode>( bytecode[offset] );
+}
+
 template < typename T >
 T LuminVirtualMachine::Read() {
-    if ( ip + sizeof( T ) > bytecode.size() ) {
-        throw std::runtime_error( "Bytecode read out of bounds" );
+    if ( ip + sizeof( T ) > instruction_end ) {
+        throw std::runtime_error( "Operand read past the end of the instruction" );
     }
 
-    T value = *reinterpret_cast<const T*>( &bytecode[ip] );
+    const T value = Utils::LoadLE<T>( bytecode.data() + ip );
     ip += sizeof( T );
 
     return value;
@@ -117,28 +322,25 @@ T LuminVirtualMachine::PopCheckedValue() {
     return value;
 }
 
-template < typename Op >
-NumericValue LuminVirtualMachine::PerformNumericOperation(
-    const NumericValue& a,
-    const NumericValue& b,
-    Op operation
-) {
-    return std::visit([&operation]( auto x, auto y ) -> NumericValue {
-         using X = std::decay_t<decltype( x )>;
-         using Y = std::decay_t<decltype( y )>;
-         if constexpr ( std::is_arithmetic_v<X> && std::is_arithmetic_v<Y> ) {
-             return operation( x, y );
-         } else {
-             throw std::runtime_error( "Incompatible types for operation" );
-         }
-    }, a, b);
+// Pops an operand of a typed instruction, the compiler only emits an opcode for
+// the type it inferred, so any other value on the stack is a bad program
+template < typename T >
+T LuminVirtualMachine::PopOperand( const char* opcode ) {
+    const auto value = PopCheckedValue<NumericValue>();
+    if ( const auto* operand = std::get_if<T>( &value ) ) {
+        return *operand;
+    }
+
+    throw std::runtime_error( std::format( "{} expects {} operands", opcode,
+        std::is_same_v<T, int32_t> ? "int" : "float" ) );
 }
 
+// Integer arithmetic wraps around like two's complement hardware
 void LuminVirtualMachine::HandleIMUL() {
-    const auto a = PopCheckedValue<NumericValue>();
-    const auto b = PopCheckedValue<NumericValue>();
+    const auto a = static_cast<uint32_t>( PopOperand<int32_t>( "IMUL" ) );
+    const auto b = static_cast<uint32_t>( PopOperand<int32_t>( "IMUL" ) );
 
-    stack.Push( PerformNumericOperation( a, b, std::multiplies() ) );
+    stack.Push( static_cast<int32_t>( a * b ) );
 }
 
 void LuminVirtualMachine::HandleICONST() {
@@ -146,43 +348,52 @@ void LuminVirtualMachine::HandleICONST() {
 }
 
 void LuminVirtualMachine::HandleIDIV() {
-    const auto a = PopCheckedValue<NumericValue>();
-    const auto b = PopCheckedValue<NumericValue>();
+    const auto a = PopOperand<int32_t>( "IDIV" );
+    const auto b = PopOperand<int32_t>( "IDIV" );
+
+    if ( b == 0 ) {
+        throw std::runtime_error( "Division by zero" );
+    }
 
-    stack.Push( PerformNumericOperation( a, b, std::divides() ) );
+    // INT32_MIN / -1 overflows, it wraps back to INT32_MIN
+    stack.Push( b == -1 ? static_cast<int32_t>( 0u - static_cast<uint32_t>( a ) ) : a / b );
 }
 
 void LuminVirtualMachine::HandleIADD() {
-    const auto a = PopCheckedValue<NumericValue>();
-    const auto b = PopCheckedValue<NumericValue>();
+    const auto a = static_cast<uint32_t>( PopOperand<int32_t>( "IADD" ) );
+    const auto b = static_cast<uint32_t>( PopOperand<int32_t>( "IADD" ) );
 
-    stack.Push( PerformNumericOperation( a, b, std::plus() ) );
+    stack.Push( static_cast<int32_t>( a + b ) );
 }
 
 void LuminVirtualMachine::HandleISUB() {
-    const auto a = PopCheckedValue<NumericValue>();
-    const auto b = PopCheckedValue<NumericValue>();
+    const auto a = static_cast<uint32_t>( PopOperand<int32_t>( "ISUB" ) );
+    const auto b = static_cast<uint32_t>( PopOperand<int32_t>( "ISUB" ) );
 
-    stack.Push( PerformNumericOperation( a, b, std::minus() ) );
+    stack.Push( static_cast<int32_t>( a - b ) );
 }
 
 void LuminVirtualMachine::HandleINEG() {
-    const auto a = PopCheckedValue<NumericValue>();
+    const auto a = static_cast<uint32_t>( PopOperand<int32_t>( "INEG" ) );
 
-    auto negate = []( auto value ) -> NumericValue {
-        using T = std::decay_t<decltype( value )>;
-        if constexpr ( std::is_arithmetic_v<T> ) {
-            return -value;  // Negate numeric types
-        } else {
-            throw std::runtime_error( "Unsupported type for negation" );
-        }
-    };
+    stack.Push( static_cast<int32_t>( 0u - a ) );
+}
 
-    stack.Push( std::visit( negate, a ) );
+// Pushes -1, 0 or 1 for a compared with b, where a is popped first like the
+// left operand of ISUB
+void LuminVirtualMachine::HandleICMP() {
+    const auto a = PopOperand<int32_t>( "ICMP" );
+    const auto b = PopOperand<int32_t>( "ICMP" );
+
+    stack.Push( static_cast<int32_t>( ( a > b ) - ( a < b ) ) );
 }
 
-void LuminVirtualMachine::HandleISTORE() {
-    const auto index = Read<uint16_t>();
+void LuminVirtualMachine::HandlePOP() {
+    PopCheckedValue<NumericValue>();
+}
+
+void LuminVirtualMachine::StoreLocal( const size_t index ) {
+    auto& locals = CurrentLocals();
 
     if ( index >= locals.size() ) {
         throw std::runtime_error( "Local variable index out of bounds" );
@@ -195,8 +406,8 @@ void LuminVirtualMachine::HandleISTORE() {
     locals[index] = PopCheckedValue<NumericValue>();
 }
 
-void LuminVirtualMachine::HandleILOAD() {
-    const auto index = Read<uint16_t>();
+void LuminVirtualMachine::LoadLocal( const size_t index ) {
+    const auto& locals = CurrentLocals();
 
     if ( index >= locals.size() ) {
         throw std::runtime_error( "Local variable index out of bounds" );
@@ -205,8 +416,68 @@ void LuminVirtualMachine::HandleILOAD() {
     stack.Push( locals[index] );
 }
 
+int32_t& LuminVirtualMachine::IntLocal( const size_t index, const char* opcode ) {
+    auto& locals = CurrentLocals();
+
+    if ( index >= locals.size() ) {
+        throw std::runtime_error( "Local variable index out of bounds" );
+    }
+
+    auto* value = std::get_if<int32_t>( &locals[index] );
+    if ( value == nullptr ) {
+        throw std::runtime_error( std::format( "{} expects int locals", opcode ) );
+    }
+    return *value;
+}
+
+void LuminVirtualMachine::HandleISTORE() {
+    StoreLocal( Read<uint8_t>() );
+}
+
+void LuminVirtualMachine::HandleILOAD() {
+    LoadLocal( Read<uint8_t>() );
+}
+
+// The short forms share a handler, the operand is encoded in the opcode that
+// was just dispatched
+void LuminVirtualMachine::HandleICONST_N() {
+    stack.Push( static_cast<int32_t>( bytecode[ip - 1] ) - static_cast<int32_t>( OpCode::ICONST_0 ) );
+}
+
+void LuminVirtualMachine::HandleBIPUSH() {
+    stack.Push( static_cast<int32_t>( Read<int8_t>() ) );
+}
+
+void LuminVirtualMachine::HandleSIPUSH() {
+    stack.Push( static_cast<int32_t>( Read<int16_t>() ) );
+}
+
+void LuminVirtualMachine::HandleILOAD_N() {
+    LoadLocal( bytecode[ip - 1] - static_cast<size_t>( OpCode::ILOAD_0 ) );
+}
+
+void LuminVirtualMachine::HandleISTORE_N() {
+    StoreLocal( bytecode[ip - 1] - static_cast<size_t>( OpCode::ISTORE_0 ) );
+}
+
+void LuminVirtualMachine::HandleWIDE() {
+    const auto opcode = static_cast<OpCode>( Read<uint8_t>() );
+    const auto index = Read<uint16_t>();
+
+    switch ( opcode ) {
+        case OpCode::ILOAD:
+            LoadLocal( index );
+            break;
+        case OpCode::ISTORE:
+            StoreLocal( index );
+            break;
+        default:
+            throw std::runtime_error( "WIDE applied to an opcode without a local index" );
+    }
+}
+
 void LuminVirtualMachine::HandleI2F() {
-    const auto integer = std::get<int32_t>( PopCheckedValue<NumericValue>() );
+    const auto integer = PopOperand<int32_t>( "I2F" );
     stack.Push( NumericValue( static_cast<float>( integer ) ) );
 }
 
@@ -215,8 +486,397 @@ void LuminVirtualMachine::HandleFCONST() {
 }
 
 void LuminVirtualMachine::HandleFADD() {
-    const auto a = PopCheckedValue<NumericValue>();
-    const auto b = PopCheckedValue<NumericValue>();
+    const auto a = PopOperand<float>( "FADD" );
+    const auto b = PopOperand<float>( "FADD" );
+
+    stack.Push( a + b );
+}
+
+void LuminVirtualMachine::HandleFSUB() {
+    const auto a = PopOperand<float>( "FSUB" );
+    const auto b = PopOperand<float>( "FSUB" );
+
+    stack.Push( a - b );
+}
+
+void LuminVirtualMachine::HandleFMUL() {
+    const auto a = PopOperand<float>( "FMUL" );
+    const auto b = PopOperand<float>( "FMUL" );
+
+    stack.Push( a * b );
+}
+
+void LuminVirtualMachine::HandleFDIV() {
+    const auto a = PopOperand<float>( "FDIV" );
+    const auto b = PopOperand<float>( "FDIV" );
+
+    stack.Push( a / b );
+}
+
+void LuminVirtualMachine::HandleFNEG() {
+    stack.Push( -PopOperand<float>( "FNEG" ) );
+}
+
+// Like ICMP, an unordered comparison (a NaN operand) pushes 0
+void LuminVirtualMachine::HandleFCMP() {
+    const auto a = PopOperand<float>( "FCMP" );
+    const auto b = PopOperand<float>( "FCMP" );
+
+    stack.Push( static_cast<int32_t>( ( a > b ) - ( a < b ) ) );
+}
+
+void LuminVirtualMachine::HandleACONST_NULL() {
+    stack.Push( std::monostate {} );
+}
+
+void LuminVirtualMachine::HandleISNULL() {
+    const auto value = PopCheckedValue<NumericValue>();
+    if ( !std::holds_alternative<ArrayRef>( value ) && !std::holds_alternative<std::monostate>( value ) ) {
+        throw std::runtime_error( "ISNULL expects an array" );
+    }
+    stack.Push( static_cast<int32_t>( std::holds_alternative<std::monostate>( value ) ) );
+}
+
+// The _NONNULL forms of the array opcodes share their handlers, a null one
+// of them is handed breaks the compiler's proof and is not a null access
+// of the program
+ArrayStorage& LuminVirtualMachine::PopArray( const char* opcode ) {
+    const auto value = PopCheckedValue<NumericValue>();
+    if ( const auto* array = std::get_if<ArrayRef>( &value ) ) {
+        return heap.Get( *array );
+    }
+    if ( IsNonNullAccess( static_cast<OpCode>( bytecode[ip - 1] ) ) ) {
+        throw std::runtime_error( std::format( "{}_NONNULL expects a non-null array", opcode ) );
+    }
+    if ( std::holds_alternative<std::monostate>( value ) ) {
+        throw std::runtime_error( std::format( "{} on a null array", opcode ) );
+    }
+    throw std::runtime_error( std::format( "{} expects an array", opcode ) );
+}
+
+// ALLOC_LOCAL_ARRAY too, its array is tied to the executing frame
+void LuminVirtualMachine::HandleALLOC_ARRAY() {
+    const auto opcode = static_cast<OpCode>( bytecode[ip - 1] );
+    const auto element = static_cast<ArrayElement>( Read<uint8_t>() );
+    const auto length = PopOperand<int32_t>( "ALLOC_ARRAY" );
+    if ( length < 0 ) {
+        throw std::runtime_error( std::format( "Negative array length {}", length ) );
+    }
+
+    if ( opcode == OpCode::ALLOC_LOCAL_ARRAY ) {
+        stack.Push( heap.AllocateLocal( element, static_cast<size_t>( length ), frames.size(), ip ) );
+    } else {
+        stack.Push( heap.Allocate( element, static_cast<size_t>( length ) ) );
+    }
+}
+
+// Pops the index, then the array
+void LuminVirtualMachine::HandleLOAD_ARRAY() {
+    const auto index = PopOperand<int32_t>( "LOAD_ARRAY" );
+    std::visit( [this, index]( const auto& elements ) {
+        if ( index < 0 || static_cast<size_t>( index ) >= elements.size() ) {
+            throw std::runtime_error( std::format( "Array index {} out of bounds for length {}", index, elements.size() ) );
+        }
+        stack.Push( elements[static_cast<size_t>( index )] );
+    }, PopArray( "LOAD_ARRAY" ) );
+}
+
+// Pops the value, the index, then the array. The value must already have
+// the element type, the compiler converts it.
+void LuminVirtualMachine::HandleSTORE_ARRAY() {
+    const auto value = PopCheckedValue<NumericValue>();
+    const auto index = PopOperand<int32_t>( "STORE_ARRAY" );
+    std::visit( [&value, index]( auto& elements ) {
+        using T = typename std::decay_t<decltype( elements )>::value_type;
+        const auto* element = std::get_if<T>( &value );
+        if ( element == nullptr ) {
+            throw std::runtime_error( std::format( "STORE_ARRAY expects {} elements",
+                std::is_same_v<T, int32_t> ? "int" : "float" ) );
+        }
+        if ( index < 0 || static_cast<size_t>( index ) >= elements.size() ) {
+            throw std::runtime_error( std::format( "Array index {} out of bounds for length {}", index, elements.size() ) );
+        }
+        elements[static_cast<size_t>( index )] = *element;
+    }, PopArray( "STORE_ARRAY" ) );
+}
+
+// See VectorMode, the operands were checked by the verifier
+void LuminVirtualMachine::HandleVECTOR() {
+    const auto opcode = static_cast<OpCode>( bytecode[ip - 1] );
+    const auto mode = Read<uint8_t>();
+    const auto end = PopOperand<int32_t>( "VECTOR" );
+    const auto begin = PopOperand<int32_t>( "VECTOR" );
+    const NumericValue right = PopCheckedValue<NumericValue>();
+    const NumericValue left = PopCheckedValue<NumericValue>();
+    const NumericValue destination = PopCheckedValue<NumericValue>();
+
+    const int64_t available = std::max<int64_t>( static_cast<int64_t>( end ) - begin, 0 );
+    const auto count = static_cast<size_t>( available - available % VECTOR_LANES );
+    const auto* dstRef = std::get_if<ArrayRef>( &destination );
+    if ( count == 0 || begin < 0 || dstRef == nullptr ) {
+        stack.Push( begin );
+        return;
+    }
+
+    std::visit( [&]( auto& dst ) {
+        using T = typename std::decay_t<decltype( dst )>::value_type;
+        // An operand as a pointer to its element at begin, or the scalar;
+        // false when the scalar loop has to run instead
+        const auto resolve = [&]( const NumericValue& value, const bool scalar, VectorOperand<T>& operand ) {
+            if ( scalar ) {
+                const auto* number = std::get_if<T>( &value );
+                if ( number == nullptr ) {
+                    throw std::runtime_error( "Vector operand does not match the array type" );
+                }
+                operand = { nullptr, *number };
+                return true;
+            }
+
+            const auto* reference = std::get_if<ArrayRef>( &value );
+            if ( reference == nullptr ) {
+                return false;
+            }
+            auto* elements = std::get_if<std::vector<T>>( &heap.Get( *reference ) );
+            if ( elements == nullptr ) {
+                throw std::runtime_error( "Vector operand does not match the array type" );
+            }
+            if ( static_cast<size_t>( begin ) + count > elements->size() ) {
+                return false;
+            }
+            operand = { elements->data() + begin, T {} };
+            return true;
+        };
+
+        VectorOperand<T> leftOperand {};
+        VectorOperand<T> rightOperand {};
+        if ( static_cast<size_t>( begin ) + count > dst.size()
+             || !resolve( left, mode & VECTOR_LEFT_SCALAR, leftOperand )
+             || !resolve( right, mode & VECTOR_RIGHT_SCALAR, rightOperand ) ) {
+            stack.Push( begin );
+            return;
+        }
+
+        VectorOp op;
+        switch ( opcode ) {
+            case OpCode::VADD: op = VectorOp::ADD; break;
+            case OpCode::VSUB: op = VectorOp::SUB; break;
+            case OpCode::VMUL: op = VectorOp::MUL; break;
+            default:
+                if ( !std::is_same_v<T, float> ) {
+                    throw std::runtime_error( "VDIV expects float arrays" );
+                }
+                op = VectorOp::DIV;
+                break;
+        }
+        if ( ( mode & VECTOR_CHECK ) == 0 ) {
+            RunVectorKernel( op, dst.data() + begin, leftOperand, rightOperand, count );
+        }
+        stack.Push( static_cast<int32_t>( begin + static_cast<int32_t>( count ) ) );
+    }, heap.Get( *dstRef ) );
+}
+
+void LuminVirtualMachine::HandleCALL() {
+    const auto index = Read<uint16_t>();
+
+    // Resolve is the trampoline, the first call verifies and links the method
+    Invoke( runtime->Resolve( index ) );
+}
+
+// The callee replaces the method in the executing frame: its locals are
+// cleared and reused, and it returns straight to the caller's caller, so a
+// chain of tail calls runs in one frame
+void LuminVirtualMachine::HandleTAILCALL() {
+    const auto index = Read<uint16_t>();
+    const LinkedMethod& method = runtime->Resolve( index );
+    if ( frames.empty() ) {
+        Invoke( method );
+        return;
+    }
+
+    const size_t argumentCount = method.info.parameterCount;
+    if ( stack.Size() < argumentCount ) {
+        throw std::runtime_error( "Stack underflow" );
+    }
+
+    // Arguments cannot refer to the frame's own arrays, they do not escape
+    heap.ReleaseFrames( frames.size() - 1 );
+
+    StackFrame& frame = frames.back();
+    if ( profiler ) {
+        profiler->Call( frame.method_index, method.index );
+    }
+    frame.method_index = method.index;
+    frame.local_variables.assign( method.info.maxLocals, NumericValue {} );
+    for ( size_t i = argumentCount; i > 0; --i ) {
+        frame.local_variables[i - 1] = stack.Pop();
+    }
+
+    base_pointer = stack.Size();
+    bytecode = method.code;
+    ip = 0;
+}
+
+void LuminVirtualMachine::HandleINVOKE() {
+    const auto index = Read<uint16_t>();
+
+    // The first INVOKE of a reference looks the name up, later ones hit the
+    // runtime's resolved-constant cache
+    Invoke( runtime->ResolveMethodRef( index ) );
+}
+
+// Reads the branch offset and moves ip, the offset is relative to the end of
+// the branch instruction
+void LuminVirtualMachine::Jump( const OpCode opcode ) {
+    const int32_t offset = opcode == LongBranch( opcode ) ? Read<int32_t>() : Read<int8_t>();
+    JumpFrom( ip, offset );
+}
+
+void LuminVirtualMachine::JumpFrom( const size_t end, const int32_t offset ) {
+    const auto target = static_cast<int64_t>( end ) + offset;
+    if ( target < 0 || target > static_cast<int64_t>( bytecode.size() ) ) {
+        throw std::runtime_error( "Branch target out of bounds" );
+    }
+
+    ip = static_cast<size_t>( target );
+}
+
+// Code outside of any method, run without an entry method, is not profiled
+void LuminVirtualMachine::CountBranch( const size_t offset, const bool taken ) {
+    if ( profiler && !frames.empty() ) {
+        profiler->Branch( frames.back().method_index, offset, taken );
+    }
+}
+
+void LuminVirtualMachine::HandleGOTO() {
+    CountBranch( ip - 1, true );
+    Jump( static_cast<OpCode>( bytecode[ip - 1] ) );
+}
+
+// Conditional branches pop an integer and compare it against zero, ICMP
+// leaves -1, 0 or 1 for them
+void LuminVirtualMachine::HandleIF() {
+    const auto opcode = static_cast<OpCode>( bytecode[ip - 1] );
+    const auto value = PopOperand<int32_t>( "IF" );
+
+    bool taken = false;
+    switch ( LongBranch( opcode ) ) {
+        case OpCode::IFEQ: taken = value == 0; break;
+        case OpCode::IFNE: taken = value != 0; break;
+        case OpCode::IFLT: taken = value < 0; break;
+        case OpCode::IFGT: taken = value > 0; break;
+        case OpCode::IFLE: taken = value <= 0; break;
+        case OpCode::IFGE: taken = value >= 0; break;
+        default: break;
+    }
+
+    CountBranch( ip - 1, taken );
+    if ( taken ) {
+        Jump( opcode );
+    } else {
+        ip += static_cast<size_t>( OperandSize( opcode ) );
+    }
+}
+
+// The key minus the lowest key indexes the table, a key below the lowest one
+// wraps around to a large unsigned index and fails the same range check
+void LuminVirtualMachine::HandleTABLESWITCH() {
+    const auto key = PopOperand<int32_t>( "TABLESWITCH" );
+    const auto low = Read<int32_t>();
+    const auto count = Read<uint32_t>();
+    const size_t fallback = ip;
+    const size_t end = fallback + 4 + 4 * static_cast<size_t>( count );
+    if ( end > bytecode.size() ) {
+        throw std::runtime_error( "Bytecode read out of bounds" );
+    }
+
+    const uint32_t entry = static_cast<uint32_t>( key ) - static_cast<uint32_t>( low );
+    const size_t at = entry < count ? fallback + 4 + 4 * static_cast<size_t>( entry ) : fallback;
+    JumpFrom( end, Utils::LoadLE<int32_t>( bytecode.data() + at ) );
+}
+
+// Binary search for the key among the ascending ones
+void LuminVirtualMachine::HandleLOOKUPSWITCH() {
+    const auto key = PopOperand<int32_t>( "LOOKUPSWITCH" );
+    const auto count = Read<uint32_t>();
+    const size_t fallback = ip;
+    const size_t pairs = fallback + 4;
+    const size_t end = pairs + 8 * static_cast<size_t>( count );
+    if ( end > bytecode.size() ) {
+        throw std::runtime_error( "Bytecode read out of bounds" );
+    }
+
+    const auto keyAt = [&]( const size_t entry ) { return Utils::LoadLE<int32_t>( bytecode.data() + pairs + 8 * entry ); };
+    size_t first = 0;
+    size_t last = count;
+    while ( first < last ) {
+        const size_t middle = first + ( last - first ) / 2;
+        if ( keyAt( middle ) < key ) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    const size_t at = first < count && keyAt( first ) == key ? pairs + 8 * first + 4 : fallback;
+    JumpFrom( end, Utils::LoadLE<int32_t>( bytecode.data() + at ) );
+}
+
+void LuminVirtualMachine::HandleFOR_RANGE() {
+    const size_t at = ip - 1;
+    const auto counter = Read<uint16_t>();
+    const auto limit = Read<uint16_t>();
+    const auto offset = Read<int32_t>();
+
+    StoreLocal( limit );
+    const bool done = IntLocal( counter, "FOR_RANGE" ) >= IntLocal( limit, "FOR_RANGE" );
+    CountBranch( at, done );
+    if ( done ) {
+        JumpFrom( ip, offset );
+    }
+}
+
+// Increment, compare and branch of a loop in one dispatch. The increment
+// wraps like IADD, which only a counter the loop did not guard can reach.
+void LuminVirtualMachine::HandleLOOP_NEXT() {
+    const size_t at = ip - 1;
+    const auto counter = Read<uint16_t>();
+    const auto limit = Read<uint16_t>();
+    const auto offset = Read<int32_t>();
+
+    int32_t& value = IntLocal( counter, "LOOP_NEXT" );
+    value = static_cast<int32_t>( static_cast<uint32_t>( value ) + 1u );
+    const bool again = value < IntLocal( limit, "LOOP_NEXT" );
+    CountBranch( at, again );
+    if ( again ) {
+        JumpFrom( ip, offset );
+    }
+}
+
+void LuminVirtualMachine::HandleRETURN() {
+    if ( frames.empty() ) {
+        ip = bytecode.size();
+        return;
+    }
+
+    const StackFrame frame = std::move( frames.back() );
+    frames.pop_back();
+    heap.ReleaseFrames( frames.size() );
+
+    bytecode = frames.empty() ? runtime->Code() : runtime->Resolve( frames.back().method_index ).code;
+    ip = frame.return_address;
+    base_pointer = frame.base_pointer;
+}
+
+void LuminVirtualMachine::HandleSNAPSHOT() {
+    if ( config.SnapshotPath.empty() ) {
+        return;
+    }
+
+    // ip already points past the marker, a resumed VM continues after it
+    if ( !WriteSnapshotFile( config.SnapshotPath, CaptureSnapshot(), runtime->Image() ) ) {
+        throw std::runtime_error( "Failed to write snapshot: " + config.SnapshotPath );
+    }
 
-    stack.Push( PerformNumericOperation( a, b, std::plus() ) );
+    LOG_DEBUG( std::format( "Snapshot written to {} ( IP: {} )", config.SnapshotPath, ip ) )
+    freezeExecution = true;
 }
@@ -0,0 +1,67 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <Profiler.hpp>
+
+using namespace Lumin::VM;
+
+Profiler::Profiler( const LuminRuntime& runtime )
+    : calls( runtime.MethodCount(), 0 ), branches( runtime.MethodCount() ) {
+    for ( uint32_t i = 0; i < runtime.MethodCount(); ++i ) {
+        branches[i].reserve( runtime.Method( i ).codeLength );
+    }
+}
+
+void Profiler::Call( const uint32_t caller, const uint32_t callee ) {
+    ++calls[callee];
+    if ( caller != NO_CALLER ) {
+        ++callEdges[static_cast<uint64_t>( caller ) << 32 | callee];
+    }
+}
+
+void Profiler::Branch( const uint32_t method, const size_t offset, const bool taken ) {
+    auto& counters = branches[method];
+    if ( counters.empty() ) {
+        counters.resize( counters.capacity() );
+    }
+    ++counters[offset][taken];
+}
+
+Lumin::Utils::ExecutionProfile Profiler::Collect( LuminRuntime& runtime ) const {
+    Utils::ExecutionProfile profile;
+    profile.methods.resize( calls.size() );
+    for ( uint32_t i = 0; i < calls.size(); ++i ) {
+        const MethodInfo& info = runtime.Method( i );
+        Utils::MethodProfile& method = profile.methods[i];
+        method.name = *runtime.ResolveString( info.nameIndex );
+        method.codeHash = Utils::HashCode( runtime.Code().subspan( info.codeOffset, info.codeLength ) );
+        method.calls = calls[i];
+        for ( uint32_t offset = 0; offset < branches[i].size(); ++offset ) {
+            const auto [notTaken, taken] = branches[i][offset];
+            if ( taken != 0 || notTaken != 0 ) {
+                method.branches.push_back( { offset, taken, notTaken } );
+            }
+        }
+    }
+
+    for ( const auto& [edge, count] : callEdges ) {
+        profile.calls.push_back( { static_cast<uint32_t>( edge >> 32 ), static_cast<uint32_t>( edge ), count } );
+    }
+    // Hash order is not stable, a sorted profile diffs cleanly
+    std::ranges::sort( profile.calls, {}, []( const Utils::CallCount& call ) { return std::pair( call.caller, call.callee ); } );
+    return profile;
+}
@@ -15,17 +15,59 @@
  limitations under the License.
  */
 
+#include <chrono>
+#include <cstdio>
 #include <format>
+#include <memory>
 #include "LuminVirtualMachine.hpp"
+#include "VectorKernels.hpp"
 #include "Utils.hpp"
 
 std::string GetLoggerName() {
     return "lumin";
 }
 
+// Printed the way a luminc --aot executable prints its result, so the two can be diffed
+static void PrintResult( Lumin::VM::Heap& heap, const NumericValue& value ) {
+    if ( const auto* integer = std::get_if<int32_t>( &value ) ) {
+        std::printf( "%d\n", *integer );
+    } else if ( const auto* real = std::get_if<float>( &value ) ) {
+        std::printf( "%.9g\n", static_cast<double>( *real ) );
+    } else if ( const auto* array = std::get_if<ArrayRef>( &value ) ) {
+        const Lumin::VM::ArrayStorage& storage = heap.Get( *array );
+        std::visit( [&]( const auto& elements ) {
+            using Element = typename std::decay_t<decltype( elements )>::value_type;
+            std::printf( "%s[%zu]\n", std::is_same_v<Element, float> ? "float" : "int", elements.size() );
+        }, storage );
+    } else if ( std::holds_alternative<std::monostate>( value ) ) {
+        std::printf( "null\n" );
+    } else {
+        std::visit( []( const auto& other ) {
+            if constexpr ( std::is_arithmetic_v<std::decay_t<decltype( other )>> ) {
+                std::printf( "%s\n", std::to_string( other ).c_str() );
+            }
+        }, value );
+    }
+}
+
 int main( const int argc, char *argv[] ) {
+    const auto startTime = std::chrono::steady_clock::now();
+
     int opt;
-    constexpr auto options = "f:|feature|:d:|disable:|h|help|V|verbose|v|version|g|debug|";
+    /*
+     s/snapshot - resume from a snapshot
+     snapshot-out - write a snapshot when the program reaches a SNAPSHOT marker
+     e/eager - verify and link every method at startup instead of on first call
+     profile-out - write call and branch counts for luminc --profile-use
+     results - print the values left on the stack once the program ends
+     */
+    constexpr auto options = "f:|feature|:d:|disable:|h|help|V|verbose|v|version|g|debug|s:|snapshot|:|snapshot-out|:e|eager||profile-out|:|results|";
+    bool verbose = false;
+    bool eager = false;
+    bool results = false;
+    std::string snapshotIn;
+    std::string profileOut;
+    Lumin::VM::LuminVirtualMachineConfig config;
 
     while ( (opt = lumin::utils::getopt( argc, argv, options ) ) != -1 ) {
         switch ( opt ) {
@@ -51,6 +93,7 @@ int main( const int argc, char *argv[] ) {
                 break;
             case 'V':
                 LOG_INFO( "Verbose mode enabled" )
+                verbose = true;
                 break;
             case 'g':
                 LOG_INFO( "Debug mode enabled" )
@@ -58,22 +101,109 @@ int main( const int argc, char *argv[] ) {
             case 'f':
                 LOG_INFO( "Feature enabled" )
                 break;
+            case 'e':
+                eager = true;
+                break;
+            case 'r':
+                results = true;
+                break;
+            case 'p':
+                profileOut = optarg;
+                config.Profile = true;
+                break;
+            case 's':
+                if ( current_option == "snapshot-out" ) {
+                    config.SnapshotPath = optarg;
+                } else {
+                    snapshotIn = optarg;
+                }
+                break;
             default:
                 break;
         }
     }
 
+    std::unique_ptr<Lumin::VM::LuminVirtualMachine> VM;
+
+    try {
+        if ( !snapshotIn.empty() ) {
+            Lumin::VM::VMSnapshot snapshot;
+            LuminFileView program;
+            if ( !Lumin::VM::ReadSnapshotFile( snapshotIn, snapshot, program ) ) {
+                return 1;
+            }
+
+            // The program is run straight out of the mapped snapshot
+            const auto runtime = std::make_shared<Lumin::VM::LuminRuntime>( std::move( program ) );
+            VM = std::make_unique<Lumin::VM::LuminVirtualMachine>( std::move( snapshot ), runtime, config );
+        } else if ( optind < argc ) {
+            LuminFileView program = Lumin::Utils::MapLuminFile( argv[optind] );
+            if ( program.magicNumber != LUMIN_MAGIC_NUMBER ) {
+                LOG_ERROR( "Not a Lumin program: " + std::string( argv[optind] ) )
+                return 1;
+            }
+
+            // The runtime keeps the mapping, method bodies are run in place
+            const auto runtime = std::make_shared<Lumin::VM::LuminRuntime>( std::move( program ) );
+            if ( eager ) {
+                runtime->ResolveAll();
+            }
+            VM = std::make_unique<Lumin::VM::LuminVirtualMachine>( runtime, config );
+        } else {
+            const std::vector<Lumin::VM::byte> bytecode {
+                static_cast<Lumin::VM::byte>( OpCode::ICONST ), 0x0A, 0x00, 0x00, 0x00,
+                static_cast<Lumin::VM::byte>( OpCode::I2F ),
+                static_cast<Lumin::VM::byte>( OpCode::FCONST ), 0xDB, 0x0F, 0x49, 0x40,
+                static_cast<Lumin::VM::byte>( OpCode::FADD ),
+            };
+            VM = std::make_unique<Lumin::VM::LuminVirtualMachine>( bytecode, config );
+        }
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( std::format( "Failed to load program: {}", exception.what() ) )
+        return 1;
+    }
 
-    const std::vector<Lumin::VM::byte> bytecode {
-        static_cast<Lumin::VM::byte>( OpCode::ICONST ), 0x0A, 0x00, 0x00, 0x00,
-        static_cast<Lumin::VM::byte>( OpCode::I2F ),
-        static_cast<Lumin::VM::byte>( OpCode::FCONST ), 0xDB, 0x0F, 0x49, 0x40,
-        static_cast<Lumin::VM::byte>( OpCode::FADD ),
-    };
+    if ( verbose ) {
+        const auto startup = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime );
+        LOG_INFO( std::format( "Startup took {} us{}", startup.count(), snapshotIn.empty() ? "" : " (snapshot)" ) )
+        LOG_INFO( std::format( "Vector instructions: {}", Lumin::VM::VectorInstructionSet() ) )
+    }
 
-    const auto VM = std::make_unique<Lumin::VM::LuminVirtualMachine>( bytecode );
     VM->Run();
 
+    if ( results ) {
+        for ( size_t i = 0; i < VM->stack.Size(); ++i ) {
+            PrintResult( VM->heap, VM->stack[i] );
+        }
+        std::fflush( stdout );
+    }
+
+    if ( !profileOut.empty() ) {
+        const Lumin::Utils::ExecutionProfile profile = VM->CollectProfile();
+        if ( !Lumin::Utils::WriteProfileFile( profileOut, profile ) ) {
+            return 1;
+        }
+        if ( verbose ) {
+            uint64_t taken = 0;
+            uint64_t executed = 0;
+            for ( const auto& method : profile.methods ) {
+                for ( const auto& branch : method.branches ) {
+                    taken += branch.taken;
+                    executed += branch.taken + branch.notTaken;
+                }
+            }
+            LOG_INFO( std::format( "Profile written to {}: {} of {} branches and jumps taken", profileOut, taken, executed ) )
+        }
+    }
+
+    if ( verbose ) {
+        LOG_INFO( std::format( "Materialized {} of {} methods",
+            VM->Runtime().MaterializedCount(), VM->Runtime().MethodCount() ) )
+        const Lumin::VM::HeapStatistics& heap = VM->heap.Statistics();
+        LOG_INFO( std::format( "Allocated {} arrays, {} frame-local ( {} released ), at most {} alive",
+            heap.allocated, heap.localAllocated, heap.released, heap.peakLive ) )
+    }
 
     return 0;
 }
@@ -0,0 +1,440 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+#include <type_traits>
+#include <VMSnapshot.hpp>
+#include <ByteOrder.hpp>
+#include <MappedFile.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::VM;
+using Lumin::Bytecode::ArrayElement;
+using Lumin::Utils::AppendLE;
+using Lumin::Utils::LoadLE;
+using Lumin::Utils::StoreLE;
+
+namespace {
+
+// The header fields after magic, version and flags, in file order
+constexpr std::array HEADER_FIELDS {
+    &SnapshotHeader::ip, &SnapshotHeader::basePointer,
+    &SnapshotHeader::programOffset, &SnapshotHeader::programSize,
+    &SnapshotHeader::stackOffset, &SnapshotHeader::stackCount,
+    &SnapshotHeader::localsOffset, &SnapshotHeader::localsCount,
+    &SnapshotHeader::framesOffset, &SnapshotHeader::frameCount,
+    &SnapshotHeader::frameLocalsOffset, &SnapshotHeader::frameLocalsCount,
+    &SnapshotHeader::heapOffset, &SnapshotHeader::arrayCount,
+    &SnapshotHeader::freeSlotsOffset, &SnapshotHeader::freeSlotCount,
+    &SnapshotHeader::localArraysOffset, &SnapshotHeader::localArrayCount,
+    &SnapshotHeader::linkedMethodsOffset, &SnapshotHeader::linkedMethodCount,
+    &SnapshotHeader::constantsOffset, &SnapshotHeader::constantCount,
+    &SnapshotHeader::allocated, &SnapshotHeader::localAllocated,
+    &SnapshotHeader::released, &SnapshotHeader::peakLive,
+};
+
+constexpr size_t HEADER_SIZE = 8 + HEADER_FIELDS.size() * sizeof( uint64_t );
+
+constexpr size_t Align( const size_t offset ) {
+    return ( offset + 7 ) & ~static_cast<size_t>( 7 );
+}
+
+void StoreHeader( unsigned char* at, const SnapshotHeader& header ) {
+    StoreLE( at, header.magic );
+    StoreLE( at + 4, header.version );
+    StoreLE( at + 6, header.flags );
+    for ( size_t i = 0; i < HEADER_FIELDS.size(); ++i ) {
+        StoreLE( at + 8 + i * sizeof( uint64_t ), header.*HEADER_FIELDS[i] );
+    }
+}
+
+SnapshotHeader LoadHeader( const unsigned char* at ) {
+    SnapshotHeader header {};
+    header.magic = LoadLE<uint32_t>( at );
+    header.version = LoadLE<uint16_t>( at + 4 );
+    header.flags = LoadLE<uint16_t>( at + 6 );
+    for ( size_t i = 0; i < HEADER_FIELDS.size(); ++i ) {
+        header.*HEADER_FIELDS[i] = LoadLE<uint64_t>( at + 8 + i * sizeof( uint64_t ) );
+    }
+    return header;
+}
+
+void AppendPadding( std::vector<unsigned char>& image, const size_t bytes ) {
+    image.resize( image.size() + bytes );
+}
+
+// The alternative index, then the payload zero extended to 64 bits
+void AppendValue( std::vector<unsigned char>& image, const NumericValue& value ) {
+    AppendLE( image, static_cast<uint8_t>( value.index() ) );
+    AppendPadding( image, 7 );
+    AppendLE( image, std::visit( []( const auto& x ) -> uint64_t {
+        using T = std::decay_t<decltype( x )>;
+        if constexpr ( std::is_same_v<T, std::monostate> ) {
+            return 0;
+        } else if constexpr ( std::is_same_v<T, ArrayRef> ) {
+            return x.index;
+        } else if constexpr ( std::is_same_v<T, bool> ) {
+            return x ? 1 : 0;
+        } else if constexpr ( std::is_same_v<T, float> ) {
+            return std::bit_cast<uint32_t>( x );
+        } else if constexpr ( std::is_same_v<T, double> ) {
+            return std::bit_cast<uint64_t>( x );
+        } else {
+            return static_cast<std::make_unsigned_t<T>>( x );
+        }
+    }, value ) );
+}
+
+template < size_t I = 0 >
+NumericValue DecodeValue( const uint8_t index, const uint64_t bits ) {
+    if constexpr ( I < std::variant_size_v<NumericValue> ) {
+        if ( index == I ) {
+            using T = std::variant_alternative_t<I, NumericValue>;
+            if constexpr ( std::is_same_v<T, std::monostate> ) {
+                return std::monostate {};
+            } else if constexpr ( std::is_same_v<T, ArrayRef> ) {
+                return ArrayRef { static_cast<uint32_t>( bits ) };
+            } else if constexpr ( std::is_same_v<T, bool> ) {
+                return ( bits & 0xFF ) != 0;
+            } else if constexpr ( std::is_same_v<T, float> ) {
+                return std::bit_cast<float>( static_cast<uint32_t>( bits ) );
+            } else if constexpr ( std::is_same_v<T, double> ) {
+                return std::bit_cast<double>( bits );
+            } else {
+                return static_cast<T>( static_cast<std::make_unsigned_t<T>>( bits ) );
+            }
+        }
+        return DecodeValue<I + 1>( index, bits );
+    } else {
+        throw std::runtime_error( "Invalid value tag in snapshot" );
+    }
+}
+
+void AppendValues( std::vector<unsigned char>& image, const std::vector<NumericValue>& values ) {
+    for ( const auto& value : values ) {
+        AppendValue( image, value );
+    }
+}
+
+// Values are read field by field, the mapping gives no alignment guarantees
+// for files produced on another host.
+bool ReadValues(
+    const unsigned char* base,
+    const size_t fileSize,
+    const uint64_t offset,
+    const uint64_t count,
+    std::vector<NumericValue>& out
+) {
+    if ( offset > fileSize || count > ( fileSize - offset ) / SNAPSHOT_VALUE_SIZE ) {
+        return false;
+    }
+
+    out.reserve( out.size() + count );
+    for ( uint64_t i = 0; i < count; ++i ) {
+        const unsigned char* value = base + offset + i * SNAPSHOT_VALUE_SIZE;
+        out.push_back( DecodeValue( value[0], LoadLE<uint64_t>( value + 8 ) ) );
+    }
+
+    return true;
+}
+
+void AppendArrays( std::vector<unsigned char>& image, const std::vector<ArrayStorage>& arrays ) {
+    for ( const auto& array : arrays ) {
+        std::visit( [&image]( const auto& elements ) {
+            using T = typename std::decay_t<decltype( elements )>::value_type;
+            AppendLE( image, static_cast<uint8_t>( std::is_same_v<T, float> ? ArrayElement::FLOAT : ArrayElement::INT ) );
+            AppendPadding( image, 7 );
+            AppendLE( image, static_cast<uint64_t>( elements.size() ) );
+            for ( const T element : elements ) {
+                AppendLE( image, element );
+            }
+            image.resize( Align( image.size() ) );
+        }, array );
+    }
+}
+
+template < typename T >
+std::vector<T> ReadElements( const unsigned char* at, const uint64_t length ) {
+    std::vector<T> elements( length );
+    for ( uint64_t i = 0; i < length; ++i ) {
+        elements[i] = LoadLE<T>( at + i * sizeof( T ) );
+    }
+    return elements;
+}
+
+bool ReadArrays(
+    const unsigned char* base,
+    const size_t fileSize,
+    uint64_t offset,
+    const uint64_t count,
+    std::vector<ArrayStorage>& out
+) {
+    out.reserve( std::min<uint64_t>( count, fileSize / SNAPSHOT_ARRAY_HEADER_SIZE ) );
+    for ( uint64_t i = 0; i < count; ++i ) {
+        if ( offset > fileSize || fileSize - offset < SNAPSHOT_ARRAY_HEADER_SIZE ) {
+            return false;
+        }
+        const uint8_t element = base[offset];
+        const auto length = LoadLE<uint64_t>( base + offset + 8 );
+        offset += SNAPSHOT_ARRAY_HEADER_SIZE;
+
+        if ( element > static_cast<uint8_t>( ArrayElement::FLOAT ) || length > ( fileSize - offset ) / 4 ) {
+            return false;
+        }
+        if ( element == static_cast<uint8_t>( ArrayElement::FLOAT ) ) {
+            out.emplace_back( ReadElements<float>( base + offset, length ) );
+        } else {
+            out.emplace_back( ReadElements<int32_t>( base + offset, length ) );
+        }
+        offset = Align( offset + length * 4 );
+    }
+    return true;
+}
+
+// Fixed-size records of a section, each decoded by read, false when the
+// section is out of bounds
+template < typename T, typename Read >
+bool ReadRecords(
+    const unsigned char* base,
+    const size_t fileSize,
+    const uint64_t offset,
+    const uint64_t count,
+    const size_t recordSize,
+    std::vector<T>& out,
+    Read read
+) {
+    if ( offset > fileSize || count > ( fileSize - offset ) / recordSize ) {
+        return false;
+    }
+    out.reserve( count );
+    for ( uint64_t i = 0; i < count; ++i ) {
+        out.push_back( read( base + offset + i * recordSize ) );
+    }
+    return true;
+}
+
+uint32_t ReadIndex( const unsigned char* at ) {
+    return LoadLE<uint32_t>( at );
+}
+
+ResolvedConstant ReadConstant( const unsigned char* at ) {
+    return { LoadLE<uint32_t>( at ), LoadLE<uint32_t>( at + 4 ) };
+}
+
+SnapshotLocalArray ReadLocalArray( const unsigned char* at ) {
+    return { LoadLE<uint64_t>( at ), LoadLE<uint64_t>( at + 8 ), LoadLE<uint64_t>( at + 16 ) };
+}
+
+SnapshotFrame ReadFrame( const unsigned char* at ) {
+    return {
+        LoadLE<uint64_t>( at ),
+        LoadLE<uint64_t>( at + 8 ),
+        LoadLE<uint64_t>( at + 16 ),
+        LoadLE<uint64_t>( at + 24 ),
+        LoadLE<uint64_t>( at + 32 )
+    };
+}
+
+}
+
+bool Lumin::VM::WriteSnapshotFile(
+    const std::string& outputPath,
+    const VMSnapshot& snapshot,
+    const std::span<const unsigned char> program
+) {
+    std::ofstream file( outputPath, std::ios::binary );
+    if ( !file ) {
+        LOG_ERROR( "Failed to open snapshot for writing: " + outputPath )
+        return false;
+    }
+
+    SnapshotHeader header {};
+    header.magic = LUMIN_SNAPSHOT_MAGIC;
+    header.version = LUMIN_SNAPSHOT_VERSION;
+    header.ip = snapshot.ip;
+    header.basePointer = snapshot.basePointer;
+    header.allocated = snapshot.statistics.allocated;
+    header.localAllocated = snapshot.statistics.localAllocated;
+    header.released = snapshot.statistics.released;
+    header.peakLive = snapshot.statistics.peakLive;
+
+    std::vector<unsigned char> image( HEADER_SIZE );
+
+    image.resize( Align( image.size() ) );
+    header.programOffset = image.size();
+    header.programSize = program.size();
+    image.insert( image.end(), program.begin(), program.end() );
+
+    image.resize( Align( image.size() ) );
+    header.stackOffset = image.size();
+    header.stackCount = snapshot.stack.size();
+    AppendValues( image, snapshot.stack );
+
+    header.localsOffset = image.size();
+    header.localsCount = snapshot.locals.size();
+    AppendValues( image, snapshot.locals );
+
+    header.framesOffset = image.size();
+    header.frameCount = snapshot.frames.size();
+    uint64_t localsIndex = 0;
+    for ( const auto& frame : snapshot.frames ) {
+        AppendLE( image, static_cast<uint64_t>( frame.methodIndex ) );
+        AppendLE( image, static_cast<uint64_t>( frame.returnAddress ) );
+        AppendLE( image, static_cast<uint64_t>( frame.basePointer ) );
+        AppendLE( image, localsIndex );
+        AppendLE( image, static_cast<uint64_t>( frame.locals.size() ) );
+        localsIndex += frame.locals.size();
+    }
+
+    header.frameLocalsOffset = image.size();
+    header.frameLocalsCount = localsIndex;
+    for ( const auto& frame : snapshot.frames ) {
+        AppendValues( image, frame.locals );
+    }
+
+    header.heapOffset = image.size();
+    header.arrayCount = snapshot.arrays.size();
+    AppendArrays( image, snapshot.arrays );
+
+    header.freeSlotsOffset = image.size();
+    header.freeSlotCount = snapshot.freeSlots.size();
+    for ( const uint32_t slot : snapshot.freeSlots ) {
+        AppendLE( image, slot );
+    }
+    image.resize( Align( image.size() ) );
+
+    header.localArraysOffset = image.size();
+    header.localArrayCount = snapshot.localArrays.size();
+    for ( const auto& local : snapshot.localArrays ) {
+        AppendLE( image, static_cast<uint64_t>( local.depth ) );
+        AppendLE( image, static_cast<uint64_t>( local.site ) );
+        AppendLE( image, static_cast<uint64_t>( local.array.index ) );
+    }
+
+    header.linkedMethodsOffset = image.size();
+    header.linkedMethodCount = snapshot.runtime.linkedMethods.size();
+    for ( const uint32_t method : snapshot.runtime.linkedMethods ) {
+        AppendLE( image, method );
+    }
+    image.resize( Align( image.size() ) );
+
+    header.constantsOffset = image.size();
+    header.constantCount = snapshot.runtime.constants.size();
+    for ( const auto& [index, target] : snapshot.runtime.constants ) {
+        AppendLE( image, index );
+        AppendLE( image, target );
+    }
+
+    StoreHeader( image.data(), header );
+    file.write( reinterpret_cast<const char*>( image.data() ), static_cast<std::streamsize>( image.size() ) );
+
+    return static_cast<bool>( file );
+}
+
+bool Lumin::VM::ReadSnapshotFile( const std::string& inputPath, VMSnapshot& snapshot, LuminFileView& program ) {
+    Utils::MappedFile file( inputPath );
+    if ( !file.IsOpen() ) {
+        return false;
+    }
+
+    const unsigned char* base = file.Data();
+    const size_t size = file.Size();
+
+    if ( size < HEADER_SIZE ) {
+        LOG_ERROR( "Snapshot is truncated: " + inputPath )
+        return false;
+    }
+    const SnapshotHeader header = LoadHeader( base );
+
+    if ( header.magic != LUMIN_SNAPSHOT_MAGIC || header.version != LUMIN_SNAPSHOT_VERSION ) {
+        LOG_ERROR( "Not a compatible Lumin snapshot: " + inputPath )
+        return false;
+    }
+
+    if ( header.programOffset > size || header.programSize > size - header.programOffset ) {
+        LOG_ERROR( "Snapshot program section is out of bounds: " + inputPath )
+        return false;
+    }
+
+    snapshot = {};
+    snapshot.ip = header.ip;
+    snapshot.basePointer = header.basePointer;
+    snapshot.statistics = { header.allocated, header.localAllocated, header.released, header.peakLive };
+
+    try {
+        std::vector<NumericValue> frameLocals;
+        std::vector<SnapshotFrame> frames;
+        if ( !ReadValues( base, size, header.stackOffset, header.stackCount, snapshot.stack )
+            || !ReadValues( base, size, header.localsOffset, header.localsCount, snapshot.locals )
+            || !ReadValues( base, size, header.frameLocalsOffset, header.frameLocalsCount, frameLocals )
+            || !ReadRecords( base, size, header.framesOffset, header.frameCount, SNAPSHOT_FRAME_SIZE, frames, ReadFrame ) ) {
+            LOG_ERROR( "Snapshot value section is out of bounds: " + inputPath )
+            return false;
+        }
+        std::vector<SnapshotLocalArray> localArrays;
+        if ( !ReadArrays( base, size, header.heapOffset, header.arrayCount, snapshot.arrays )
+            || !ReadRecords( base, size, header.freeSlotsOffset, header.freeSlotCount, sizeof( uint32_t ), snapshot.freeSlots, ReadIndex )
+            || !ReadRecords( base, size, header.localArraysOffset, header.localArrayCount, SNAPSHOT_LOCAL_ARRAY_SIZE,
+                localArrays, ReadLocalArray ) ) {
+            LOG_ERROR( "Snapshot heap is out of bounds: " + inputPath )
+            return false;
+        }
+        if ( !ReadRecords( base, size, header.linkedMethodsOffset, header.linkedMethodCount, sizeof( uint32_t ),
+                snapshot.runtime.linkedMethods, ReadIndex )
+            || !ReadRecords( base, size, header.constantsOffset, header.constantCount, SNAPSHOT_CONSTANT_SIZE,
+                snapshot.runtime.constants, ReadConstant ) ) {
+            LOG_ERROR( "Snapshot runtime caches are out of bounds: " + inputPath )
+            return false;
+        }
+        for ( const auto& local : localArrays ) {
+            if ( local.array > UINT32_MAX ) {
+                LOG_ERROR( "Snapshot frame-local array is out of range: " + inputPath )
+                return false;
+            }
+            snapshot.localArrays.push_back( { local.depth, local.site, ArrayRef { static_cast<uint32_t>( local.array ) } } );
+        }
+
+        snapshot.frames.reserve( frames.size() );
+        for ( const SnapshotFrame& frame : frames ) {
+            if ( frame.localsIndex > frameLocals.size() || frame.localsCount > frameLocals.size() - frame.localsIndex ) {
+                LOG_ERROR( "Snapshot frame locals are out of bounds: " + inputPath )
+                return false;
+            }
+
+            const auto first = frameLocals.begin() + static_cast<std::ptrdiff_t>( frame.localsIndex );
+            snapshot.frames.push_back( {
+                static_cast<uint32_t>( frame.methodIndex ),
+                frame.returnAddress,
+                frame.basePointer,
+                { first, first + static_cast<std::ptrdiff_t>( frame.localsCount ) }
+            } );
+        }
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( std::string( "Corrupt snapshot: " ) + exception.what() )
+        return false;
+    }
+
+    program = Utils::ViewLuminFile( file.Bytes().subspan( header.programOffset, header.programSize ), inputPath );
+    if ( program.magicNumber != LUMIN_MAGIC_NUMBER ) {
+        return false;
+    }
+    program.mapping = std::move( file );
+
+    return true;
+}
@@ -0,0 +1,229 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <VectorKernels.hpp>
+
+using namespace Lumin::VM;
+
+namespace {
+
+template < typename T >
+using Kernel = void (*)( T*, const VectorOperand<T>&, const VectorOperand<T>&, size_t );
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define LUMIN_VECTOR_EXTENSIONS 1
+#endif
+
+#ifdef LUMIN_VECTOR_EXTENSIONS
+// GCC vector extensions, the compiler picks the instructions for the target
+// of the function they are inlined into
+typedef uint32_t Uint32x4 __attribute__(( vector_size( 16 ) ));
+typedef uint32_t Uint32x8 __attribute__(( vector_size( 32 ) ));
+typedef float Float32x4 __attribute__(( vector_size( 16 ) ));
+typedef float Float32x8 __attribute__(( vector_size( 32 ) ));
+#endif
+
+// Element type, the type arithmetic is done in and its vectors. Integers are
+// computed unsigned so overflow wraps instead of being undefined.
+struct IntLanes {
+    using Element = int32_t;
+    using Lane = uint32_t;
+#ifdef LUMIN_VECTOR_EXTENSIONS
+    using V4 = Uint32x4;
+    using V8 = Uint32x8;
+#endif
+};
+
+struct FloatLanes {
+    using Element = float;
+    using Lane = float;
+#ifdef LUMIN_VECTOR_EXTENSIONS
+    using V4 = Float32x4;
+    using V8 = Float32x8;
+#endif
+};
+
+// a = a op b, for lanes and whole vectors. By reference, 32-byte vectors
+// passed by value would depend on the target's ABI.
+template < VectorOp OP, typename V >
+[[gnu::always_inline]] inline void Apply( V& a, const V& b ) {
+    if constexpr ( OP == VectorOp::ADD ) {
+        a += b;
+    } else if constexpr ( OP == VectorOp::SUB ) {
+        a -= b;
+    } else if constexpr ( OP == VectorOp::MUL ) {
+        a *= b;
+    } else {
+        a /= b;
+    }
+}
+
+#ifdef LUMIN_VECTOR_EXTENSIONS
+
+// Runs whole vectors of V from index i while they fit below count, returns
+// where it stopped. Always inlined, so the vectors never cross a call and
+// the AVX2 kernel gets VEX code for its 128-bit tail too.
+template < typename V, typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+[[gnu::always_inline]] inline size_t Strip(
+    typename L::Element* dst,
+    const VectorOperand<typename L::Element>& left,
+    const VectorOperand<typename L::Element>& right,
+    size_t i,
+    const size_t count
+) {
+    constexpr size_t LANES = sizeof( V ) / sizeof( typename L::Element );
+    V leftScalar {};
+    V rightScalar {};
+    leftScalar += static_cast<typename L::Lane>( left.scalar );
+    rightScalar += static_cast<typename L::Lane>( right.scalar );
+
+    for ( ; i + LANES <= count; i += LANES ) {
+        V a = leftScalar;
+        V b = rightScalar;
+        if constexpr ( !LEFT_SCALAR ) {
+            std::memcpy( &a, left.elements + i, sizeof( V ) );
+        }
+        if constexpr ( !RIGHT_SCALAR ) {
+            std::memcpy( &b, right.elements + i, sizeof( V ) );
+        }
+        Apply<OP>( a, b );
+        std::memcpy( dst + i, &a, sizeof( V ) );
+    }
+    return i;
+}
+
+template < typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+void Sse2Kernel(
+    typename L::Element* dst,
+    const VectorOperand<typename L::Element>& left,
+    const VectorOperand<typename L::Element>& right,
+    const size_t count
+) {
+    Strip<typename L::V4, L, OP, LEFT_SCALAR, RIGHT_SCALAR>( dst, left, right, 0, count );
+}
+
+// Eight lanes at a time, then the four that are left when count is an odd
+// number of VECTOR_LANES
+template < typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+[[gnu::target( "avx2" )]] void Avx2Kernel(
+    typename L::Element* dst,
+    const VectorOperand<typename L::Element>& left,
+    const VectorOperand<typename L::Element>& right,
+    const size_t count
+) {
+    const size_t i = Strip<typename L::V8, L, OP, LEFT_SCALAR, RIGHT_SCALAR>( dst, left, right, 0, count );
+    Strip<typename L::V4, L, OP, LEFT_SCALAR, RIGHT_SCALAR>( dst, left, right, i, count );
+}
+
+bool HasAvx2() {
+    static const bool supported = __builtin_cpu_supports( "avx2" );
+    return supported;
+}
+
+template < typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+Kernel<typename L::Element> Pick() {
+    return HasAvx2() ? &Avx2Kernel<L, OP, LEFT_SCALAR, RIGHT_SCALAR> : &Sse2Kernel<L, OP, LEFT_SCALAR, RIGHT_SCALAR>;
+}
+
+#else
+
+// Without vector extensions the kernels are plain loops for the compiler to
+// vectorize as far as it can
+template < typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+void ScalarKernel(
+    typename L::Element* dst,
+    const VectorOperand<typename L::Element>& left,
+    const VectorOperand<typename L::Element>& right,
+    const size_t count
+) {
+    using Lane = typename L::Lane;
+    for ( size_t i = 0; i < count; ++i ) {
+        auto a = static_cast<Lane>( LEFT_SCALAR ? left.scalar : left.elements[i] );
+        const auto b = static_cast<Lane>( RIGHT_SCALAR ? right.scalar : right.elements[i] );
+        Apply<OP>( a, b );
+        dst[i] = static_cast<typename L::Element>( a );
+    }
+}
+
+template < typename L, VectorOp OP, bool LEFT_SCALAR, bool RIGHT_SCALAR >
+Kernel<typename L::Element> Pick() {
+    return &ScalarKernel<L, OP, LEFT_SCALAR, RIGHT_SCALAR>;
+}
+
+#endif
+
+template < typename L, VectorOp OP >
+Kernel<typename L::Element> ForMode( const bool leftScalar, const bool rightScalar ) {
+    if ( leftScalar ) {
+        return Pick<L, OP, true, false>();
+    }
+    if ( rightScalar ) {
+        return Pick<L, OP, false, true>();
+    }
+    return Pick<L, OP, false, false>();
+}
+
+template < typename L >
+void Run(
+    const VectorOp op,
+    typename L::Element* dst,
+    const VectorOperand<typename L::Element>& left,
+    const VectorOperand<typename L::Element>& right,
+    const size_t count
+) {
+    const bool leftScalar = left.elements == nullptr;
+    const bool rightScalar = right.elements == nullptr;
+    if ( leftScalar && rightScalar ) {
+        throw std::logic_error( "A vector kernel needs an array operand" );
+    }
+
+    Kernel<typename L::Element> kernel;
+    switch ( op ) {
+        case VectorOp::ADD: kernel = ForMode<L, VectorOp::ADD>( leftScalar, rightScalar ); break;
+        case VectorOp::SUB: kernel = ForMode<L, VectorOp::SUB>( leftScalar, rightScalar ); break;
+        case VectorOp::MUL: kernel = ForMode<L, VectorOp::MUL>( leftScalar, rightScalar ); break;
+        default:
+            if constexpr ( std::is_same_v<typename L::Element, float> ) {
+                kernel = ForMode<L, VectorOp::DIV>( leftScalar, rightScalar );
+                break;
+            } else {
+                // Division by zero has to trap at its element, the scalar loop does that
+                throw std::logic_error( "Integer vector division is not supported" );
+            }
+    }
+    kernel( dst, left, right, count );
+}
+
+}
+
+void Lumin::VM::RunVectorKernel( const VectorOp op, int32_t* dst, const VectorOperand<int32_t>& left, const VectorOperand<int32_t>& right, const size_t count ) {
+    Run<IntLanes>( op, dst, left, right, count );
+}
+
+void Lumin::VM::RunVectorKernel( const VectorOp op, float* dst, const VectorOperand<float>& left, const VectorOperand<float>& right, const size_t count ) {
+    Run<FloatLanes>( op, dst, left, right, count );
+}
+
+const char* Lumin::VM::VectorInstructionSet() {
+#ifdef LUMIN_VECTOR_EXTENSIONS
+    return HasAvx2() ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,56 @@
+# Runs one program in the interpreter and as a luminc --aot executable, at
+# every optimization level, and fails when the two print different things.
+#
+#   cmake -DLUMINC=<luminc> -DLUMIN=<lumin> -DPROGRAM=<file.lm> -DWORK_DIR=<dir> -P Differential.cmake
+#
+# The interpreter logs a runtime error and carries on while the executable
+# exits on it, so an error is compared by its first message only.
+
+foreach(variable LUMINC LUMIN PROGRAM WORK_DIR)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif()
+endforeach()
+
+get_filename_component(name ${PROGRAM} NAME_WE)
+file(MAKE_DIRECTORY ${WORK_DIR})
+string(ASCII 27 escape)
+
+foreach(level 0 1 2)
+    set(bytecode ${WORK_DIR}/${name}.O${level}.lmn)
+    set(native ${WORK_DIR}/${name}.O${level})
+
+    execute_process(COMMAND ${LUMINC} -O${level} -o ${bytecode} ${PROGRAM}
+        RESULT_VARIABLE status OUTPUT_VARIABLE log ERROR_VARIABLE log)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "-O${level}: luminc failed\n${log}")
+    endif()
+
+    execute_process(COMMAND ${LUMINC} --aot -o ${native} ${bytecode}
+        RESULT_VARIABLE status OUTPUT_VARIABLE log ERROR_VARIABLE log)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "-O${level}: luminc --aot failed\n${log}")
+    endif()
+
+    execute_process(COMMAND ${LUMIN} --results ${bytecode} OUTPUT_VARIABLE interpreted)
+    if(interpreted MATCHES "LuminVM Error ([^\n]*) \\( IP: [0-9]+ \\)")
+        set(expected "error: ${CMAKE_MATCH_1}")
+    else()
+        # Log lines are the coloured ones, the results are printed plain
+        string(REGEX REPLACE "${escape}[^\n]*\n" "" expected "${interpreted}")
+    endif()
+
+    execute_process(COMMAND ${native} RESULT_VARIABLE status OUTPUT_VARIABLE compiled ERROR_VARIABLE error)
+    if(status EQUAL 0)
+        set(actual "${compiled}")
+    elseif(error MATCHES "LuminVM Error ([^\n]*)")
+        set(actual "error: ${CMAKE_MATCH_1}")
+    else()
+        set(actual "exited with ${status}\n${error}")
+    endif()
+
+    if(NOT actual STREQUAL expected)
+        message(FATAL_ERROR "-O${level}: the interpreter gives\n${expected}\nbut the executable gives\n${actual}")
+    endif()
+    message(STATUS "-O${level}: ${actual}")
+endforeach()
@@ -0,0 +1,133 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Lexer.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin::Compiler;
+
+std::string GetLoggerName() {
+    return "lexer-test";
+}
+
+namespace {
+
+std::string ReadFile( const std::filesystem::path& path ) {
+    std::ifstream file( path, std::ios::binary );
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// One line per token: its type, its lexeme and the value of a number
+// literal, in the format of the .tokens files
+std::vector<std::string> Dump( const std::string_view source ) {
+    Lexer lexer( source );
+    const TokenStream lexed = lexer.Tokenize();
+
+    std::vector<std::string> lines;
+    for ( size_t i = 0; i < lexed.tokens.size(); ++i ) {
+        const Token& token = lexed.tokens[i];
+        std::string line = std::format( "{} {}", static_cast<int>( token.type ), source.substr( token.offset, token.length ) );
+
+        const auto number = std::ranges::find( lexed.numbers, i, &NumberValue::token );
+        char value[64] = {};
+        switch ( token.type ) {
+            case TokenType::LITERAL_INT: case TokenType::LITERAL_LONG:
+                std::snprintf( value, sizeof( value ), " = %lld", static_cast<long long>( number->integer ) );
+                break;
+            case TokenType::LITERAL_FLOAT:
+                std::snprintf( value, sizeof( value ), " = %.9g", static_cast<double>( static_cast<float>( number->real ) ) );
+                break;
+            case TokenType::LITERAL_DOUBLE:
+                std::snprintf( value, sizeof( value ), " = %.17g", number->real );
+                break;
+            default:
+                break;
+        }
+        lines.push_back( line + value );
+    }
+    return lines;
+}
+
+std::vector<std::string> Lines( const std::string& text ) {
+    std::vector<std::string> lines;
+    std::istringstream stream( text );
+    for ( std::string line; std::getline( stream, line ); ) {
+        lines.push_back( line );
+    }
+    return lines;
+}
+
+}
+
+/*
+ Lexes every .lm file of the corpus directory and compares the tokens with
+ the .tokens file next to it. Those were written by the lexer that kept a
+ std::string per token and left numbers to std::stoi, stoll, stof and
+ stod, so the compact tokens and from_chars have to agree with it.
+ */
+int main( const int argc, char** argv ) {
+    if ( argc < 2 ) {
+        LOG_ERROR( "Usage: lexer-test <corpus directory>" )
+        return 1;
+    }
+
+    int failures = 0;
+    int files = 0;
+    for ( const auto& entry : std::filesystem::directory_iterator( argv[1] ) ) {
+        if ( entry.path().extension() != ".lm" ) {
+            continue;
+        }
+        ++files;
+
+        std::filesystem::path expectedPath = entry.path();
+        expectedPath.replace_extension( ".tokens" );
+        const std::vector<std::string> expected = Lines( ReadFile( expectedPath ) );
+
+        std::vector<std::string> actual;
+        try {
+            actual = Dump( ReadFile( entry.path() ) );
+        } catch ( const std::exception& exception ) {
+            LOG_ERROR( std::format( "{}: {}", entry.path().string(), exception.what() ) )
+            ++failures;
+            continue;
+        }
+
+        const auto [actualEnd, expectedEnd] = std::ranges::mismatch( actual, expected );
+        if ( actualEnd != actual.end() || expectedEnd != expected.end() ) {
+            LOG_ERROR( std::format( "{}: token {} is '{}', expected '{}'", entry.path().string(),
+                actualEnd - actual.begin(),
+                actualEnd != actual.end() ? *actualEnd : "<none>",
+                expectedEnd != expected.end() ? *expectedEnd : "<none>" ) )
+            ++failures;
+        }
+    }
+
+    if ( files == 0 ) {
+        LOG_ERROR( std::format( "No .lm files in {}", argv[1] ) )
+        return 1;
+    }
+    return failures > 0 ? 1 : 0;
+}
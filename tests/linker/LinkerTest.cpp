@@ -0,0 +1,296 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <BytecodeReader.hpp>
+#include <BytecodeWriter.hpp>
+#include <ConstantPoolBuilder.hpp>
+#include <Linker.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+using Bytecode::BytecodeWriter;
+
+std::string GetLoggerName() {
+    return "linker-test";
+}
+
+namespace {
+
+int failures = 0;
+
+void Check( const bool condition, const std::string& what ) {
+    if ( !condition ) {
+        LOG_ERROR( "FAILED: " + what )
+        ++failures;
+    }
+}
+
+// One module as luminc would write it, methods are added in table order
+class Module {
+public:
+    Module() {
+        file.magicNumber = LUMIN_MAGIC_NUMBER;
+        file.versionMajor = LUMIN_VERSION_MAJOR;
+    }
+
+    uint32_t Add( const std::string& name, BytecodeWriter& writer, const uint16_t parameters, const uint16_t locals, const uint16_t flags = 0 ) {
+        writer.Finish();
+        file.methods.push_back( { flags, pool.AddUtf8( name ), 0, 8, locals, parameters,
+            static_cast<uint32_t>( file.bytecode.size() ), static_cast<uint32_t>( writer.bytecode.size() ) } );
+        file.bytecode.insert( file.bytecode.end(), writer.bytecode.begin(), writer.bytecode.end() );
+        return static_cast<uint32_t>( file.methods.size() - 1 );
+    }
+
+    void Invoke( BytecodeWriter& writer, const std::string& name ) {
+        writer.Emit( OpCode::INVOKE );
+        writer.Emit( pool.AddMethodRef( name ) );
+    }
+
+    static void Call( BytecodeWriter& writer, const uint16_t method ) {
+        writer.Emit( OpCode::CALL );
+        writer.Emit( method );
+    }
+
+    void AddClass( const std::string& name ) {
+        file.classes.push_back( { 0, pool.AddUtf8( name ), 0, {}, {} } );
+    }
+
+    LuminFile Build() {
+        file.constantPool = pool.Release();
+        return file;
+    }
+
+    LuminFile file {};
+
+private:
+    Utils::ConstantPoolBuilder pool;
+};
+
+// main() = twice( sq( add( 3, 4 ) ) ), add and sq come from the library.
+// twice is the application's method 0, so main calls it with CALL 0.
+LuminFile Application() {
+    Module module;
+
+    BytecodeWriter twice;
+    twice.EmitILoad( 0 );
+    twice.EmitILoad( 0 );
+    twice.Emit( OpCode::IADD );
+    twice.Emit( OpCode::RETURN );
+    const uint32_t twiceIndex = module.Add( "twice", twice, 1, 1 );
+
+    BytecodeWriter main;
+    main.EmitIConst( 3 );
+    main.EmitIConst( 4 );
+    module.Invoke( main, "add" );
+    module.Invoke( main, "sq" );
+    Module::Call( main, static_cast<uint16_t>( twiceIndex ) );
+    main.Emit( OpCode::RETURN );
+    module.file.entryMethod = module.Add( "main", main, 0, 0 );
+
+    return module.Build();
+}
+
+// A dead method first, so every index in the library moves when linked.
+// sq reaches mul through a module-local CALL 1.
+LuminFile Library() {
+    Module module;
+
+    BytecodeWriter dead;
+    dead.EmitIConst( 0 );
+    dead.Emit( OpCode::RETURN );
+    module.Add( "dead", dead, 0, 0 );
+
+    BytecodeWriter mul;
+    mul.EmitILoad( 0 );
+    mul.EmitILoad( 1 );
+    mul.Emit( OpCode::IMUL );
+    mul.Emit( OpCode::RETURN );
+    module.Add( "mul", mul, 2, 2 );
+
+    BytecodeWriter add;
+    add.EmitILoad( 0 );
+    add.EmitILoad( 1 );
+    add.Emit( OpCode::IADD );
+    add.Emit( OpCode::RETURN );
+    module.Add( "add", add, 2, 2 );
+
+    BytecodeWriter sq;
+    sq.EmitILoad( 0 );
+    sq.EmitILoad( 0 );
+    Module::Call( sq, 1 );
+    sq.Emit( OpCode::RETURN );
+    module.Add( "sq", sq, 1, 1 );
+
+    module.AddClass( "Unused" );
+    return module.Build();
+}
+
+std::string MethodName( const LuminFile& file, const uint32_t method ) {
+    const auto& entry = file.constantPool.at( file.methods.at( method ).nameIndex );
+    return std::get<std::string>( entry.data );
+}
+
+const MethodInfo* FindMethod( const LuminFile& file, const std::string& name ) {
+    const auto it = std::ranges::find_if( file.methods, [&]( const MethodInfo& method ) {
+        return std::get<std::string>( file.constantPool.at( method.nameIndex ).data ) == name;
+    } );
+    return it == file.methods.end() ? nullptr : &*it;
+}
+
+// Names of the methods a linked method calls, in bytecode order
+std::vector<std::string> Callees( const LuminFile& file, const MethodInfo& method, bool& invokes ) {
+    std::vector<std::string> callees;
+    const std::span<const unsigned char> code( file.bytecode.data() + method.codeOffset, method.codeLength );
+    for ( const auto& instruction : Bytecode::BytecodeReader( code ) ) {
+        if ( instruction.opcode == OpCode::CALL || instruction.opcode == OpCode::TAILCALL ) {
+            callees.push_back( MethodName( file, instruction.Index() ) );
+        }
+        invokes |= instruction.opcode == OpCode::INVOKE;
+    }
+    return callees;
+}
+
+NumericValue Run( const LuminFile& file ) {
+    const auto runtime = std::make_shared<VM::LuminRuntime>( file );
+    VM::LuminVirtualMachine vm( runtime, {} );
+    vm.Run();
+    return vm.stack.Empty() ? NumericValue {} : vm.stack.Top();
+}
+
+std::string LinkError( const std::vector<LuminFile>& modules ) {
+    try {
+        Linker::Link( modules );
+    } catch ( const std::runtime_error& error ) {
+        return error.what();
+    }
+    return {};
+}
+
+void TestIndexPatching() {
+    Linker::LinkStats stats;
+    const LuminFile linked = Linker::Link( { Application(), Library() }, {}, &stats );
+
+    const int before = failures;
+    Check( stats.resolvedReferences == 2, std::format( "2 INVOKEs resolved, got {}", stats.resolvedReferences ) );
+    Check( MethodName( linked, linked.entryMethod ) == "main", "the entry method is still main" );
+
+    bool invokes = false;
+    const MethodInfo* main = FindMethod( linked, "main" );
+    const MethodInfo* sq = FindMethod( linked, "sq" );
+    Check( main && Callees( linked, *main, invokes ) == std::vector<std::string> { "add", "sq", "twice" },
+        "main calls add, sq and twice by their linked indices" );
+    Check( sq && Callees( linked, *sq, invokes ) == std::vector<std::string> { "mul" },
+        "the library's CALL 1 is renumbered to mul" );
+    Check( !invokes, "no INVOKE is left after linking" );
+
+    // A misnumbered CALL can recurse forever, so only a well-formed image is run
+    if ( failures == before ) {
+        Check( Run( linked ) == NumericValue { 98 }, "the linked program computes twice( sq( add( 3, 4 ) ) )" );
+    }
+}
+
+void TestDeadCodeAndConstants() {
+    Linker::LinkStats stats;
+    const LuminFile linked = Linker::Link( { Application(), Library() }, {}, &stats );
+
+    Check( !FindMethod( linked, "dead" ), "the unreachable method is dropped" );
+    Check( linked.classes.empty(), "the unreachable class is dropped" );
+    Check( stats.methodsIn == 6 && stats.methodsOut == 5,
+        std::format( "6 methods in and 5 out, got {} and {}", stats.methodsIn, stats.methodsOut ) );
+    Check( stats.constantsOut < stats.constantsIn, "the merged pool is smaller than the module pools" );
+
+    // "add" and "sq" are named in both pools, once as a method ref
+    std::set<std::string> texts;
+    for ( const auto& entry : linked.constantPool ) {
+        if ( const auto* text = std::get_if<std::string>( &entry.data ) ) {
+            Check( texts.insert( *text ).second, std::format( "'{}' is in the merged pool once", *text ) );
+        }
+    }
+}
+
+void TestCrossModuleInlining() {
+    Linker::LinkOptions options;
+    options.inlineCrossModule = true;
+    Linker::LinkStats stats;
+    const LuminFile linked = Linker::Link( { Application(), Library() }, options, &stats );
+
+    // add is straight-line and comes from another module, sq calls mul and
+    // twice is the application's own
+    const int before = failures;
+    Check( stats.inlinedCalls == 1, std::format( "1 call inlined, got {}", stats.inlinedCalls ) );
+    Check( !FindMethod( linked, "add" ), "add is dropped once every call to it is inlined" );
+
+    bool invokes = false;
+    const MethodInfo* main = FindMethod( linked, "main" );
+    const MethodInfo* sq = FindMethod( linked, "sq" );
+    Check( main && Callees( linked, *main, invokes ) == std::vector<std::string> { "sq", "twice" },
+        "main keeps its calls to sq and twice" );
+    Check( sq && Callees( linked, *sq, invokes ) == std::vector<std::string> { "mul" },
+        "sq keeps its call to mul, both are in the library" );
+    Check( main && main->maxLocals >= 2, "main gets the locals of the inlined body" );
+
+    if ( failures == before ) {
+        Check( Run( linked ) == NumericValue { 98 }, "the inlined program computes the same result" );
+    }
+}
+
+void TestUnresolvedSymbol() {
+    const std::string error = LinkError( { Application() } );
+    Check( error == "Unresolved method 'add' referenced from 'main'",
+        std::format( "linking without the library reports add, got '{}'", error ) );
+}
+
+void TestDuplicateSymbol() {
+    const std::string error = LinkError( { Application(), Library(), Library() } );
+    Check( error.starts_with( "Duplicate symbol 'dead' in modules 1 and 2" ),
+        std::format( "linking the library twice reports its first method, got '{}'", error ) );
+
+    // Private methods are only called from their own module, each keeps its own
+    Module first;
+    Module second;
+    for ( Module* module : { &first, &second } ) {
+        BytecodeWriter helper;
+        helper.EmitIConst( 1 );
+        helper.Emit( OpCode::RETURN );
+        module->Add( "helper", helper, 0, 0, FLAG_PRIVATE );
+    }
+    Check( LinkError( { first.Build(), second.Build() } ).empty(), "private methods may share a name" );
+}
+
+}
+
+int main() {
+    TestIndexPatching();
+    TestDeadCodeAndConstants();
+    TestCrossModuleInlining();
+    TestUnresolvedSymbol();
+    TestDuplicateSymbol();
+
+    if ( failures > 0 ) {
+        LOG_ERROR( std::format( "{} linker checks failed", failures ) )
+        return 1;
+    }
+    LOG_INFO( "All linker checks passed" )
+    return 0;
+}
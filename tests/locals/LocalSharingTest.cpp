@@ -0,0 +1,257 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Compiler.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "local-sharing-test";
+}
+
+namespace {
+
+/*
+ Random programs with many short-lived temporaries, loops, branches, calls,
+ a float accumulator and a frame-local array. They never fail at runtime:
+ divisors are non-zero constants, indices are constants in bounds and every
+ loop is bounded.
+ */
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator( const uint32_t seed ) : random( seed ) {}
+
+    std::string Generate() {
+        source.clear();
+        Line( "fun f0( a: int, b: int ) {" );
+        Line( "    if ( a > b ) { return a - b; }" );
+        Line( "    return b * 2 - a;" );
+        Line( "}" );
+        Line( "fun f1( a: int, b: int ) {" );
+        Line( "    return a * 3 + b;" );
+        Line( "}" );
+
+        Line( Pick( { "", "inline ", "noinline " } ) + "fun g( p: int, q: int ) {" );
+        Line( "    var z = 0;" );
+        Line( "    var w = 0.5;" );
+        Line( std::format( "    var t = int[{}];", ARRAY_LENGTH ) );
+        std::vector<std::string> names { "p", "q", "z" };
+        Line( std::format( "    var x = {};", Expression( names, 1 ) ) );
+        names.emplace_back( "x" );
+        Line( std::format( "    var y = {};", Expression( names, 1 ) ) );
+        names.emplace_back( "y" );
+        Block( names, names, "    ", 0 );
+        Line( "    if ( w > 100.0 ) { z = z + 1; }" );
+        Line( std::format( "    return x + y * 7 + z * 13 + t[{}];", Below( ARRAY_LENGTH ) ) );
+        Line( "}" );
+
+        Line( "fun main() {" );
+        Line( std::format( "    return g( {}, {} ) + g( {}, {} ) * 3;", Between( -9, 9 ), Between( -9, 9 ),
+            Between( -9, 9 ), Between( -9, 9 ) ) );
+        Line( "}" );
+        return source;
+    }
+
+private:
+    static constexpr int ARRAY_LENGTH = 8;
+
+    // Uniform without a distribution, whose output differs between standard libraries
+    uint32_t Below( const uint32_t bound ) {
+        return static_cast<uint32_t>( random() % bound );
+    }
+
+    int Between( const int low, const int high ) {
+        return low + static_cast<int>( Below( static_cast<uint32_t>( high - low + 1 ) ) );
+    }
+
+    bool Chance( const uint32_t percent ) {
+        return Below( 100 ) < percent;
+    }
+
+    std::string Pick( const std::vector<std::string>& choices ) {
+        return choices[Below( static_cast<uint32_t>( choices.size() ) )];
+    }
+
+    void Line( const std::string& line ) {
+        source += line;
+        source += '\n';
+    }
+
+    // An int expression, a float only shows up inside a comparison
+    std::string Expression( const std::vector<std::string>& names, const int depth ) {
+        if ( depth > 3 || Chance( 30 ) ) {
+            return Chance( 60 ) ? Pick( names ) : std::to_string( Between( -5, 20 ) );
+        }
+
+        switch ( Below( 8 ) ) {
+            case 0:
+                return std::format( "( {} / {} )", Expression( names, depth + 1 ), Pick( { "1", "2", "3", "7", "-4" } ) );
+            case 1:
+                return std::format( "( - {} )", Expression( names, depth + 1 ) );
+            case 2:
+                if ( depth < 3 ) {
+                    return std::format( "f{}( {}, {} )", Below( 2 ), Expression( names, depth + 1 ), Expression( names, depth + 1 ) );
+                }
+                return Pick( names );
+            case 3:
+                return std::format( "t[{}]", Below( ARRAY_LENGTH ) );
+            case 4:
+                return std::format( "( w {} {} )", Pick( { "<", ">", "<=" } ), Expression( names, depth + 1 ) );
+            case 5:
+                return std::format( "( {} {} {} )", Expression( names, depth + 1 ), Pick( { "<", ">", "==", "!=", "<=", ">=" } ),
+                    Expression( names, depth + 1 ) );
+            default:
+                return std::format( "( {} {} {} )", Expression( names, depth + 1 ), Pick( { "+", "-", "*" } ),
+                    Expression( names, depth + 1 ) );
+        }
+    }
+
+    // Loop counters are only read, so every loop ends
+    void Block( std::vector<std::string> names, std::vector<std::string> assignable, const std::string& indent, const int depth ) {
+        const int statements = Between( 1, 4 );
+        for ( int statement = 0; statement < statements; ++statement ) {
+            const uint32_t kind = Below( 100 );
+            if ( kind < 12 && depth < 3 ) {
+                const std::string counter = std::format( "i{}", temporaries++ );
+                Line( std::format( "{}var {} = {};", indent, counter, Between( -3, 3 ) ) );
+                Line( std::format( "{}while ( {} < {} )", indent, counter, Between( -2, 9 ) ) + " {" );
+                std::vector<std::string> inner = names;
+                inner.push_back( counter );
+                Block( inner, assignable, indent + "    ", depth + 1 );
+                Line( std::format( "{}    {} = {} + {};", indent, counter, counter, Between( 1, 3 ) ) );
+                Line( indent + "}" );
+            } else if ( kind < 22 && depth < 3 ) {
+                const std::string counter = std::format( "i{}", temporaries++ );
+                Line( std::format( "{}for {} in {}..{}", indent, counter, Between( -3, 3 ), Pick( { "4", "7", "q", "( p / 3 )" } ) ) + " {" );
+                std::vector<std::string> inner = names;
+                inner.push_back( counter );
+                Block( inner, assignable, indent + "    ", depth + 1 );
+                Line( indent + "}" );
+            } else if ( kind < 34 && depth < 3 ) {
+                Line( std::format( "{}if ( {} {} {} )", indent, Expression( names, 1 ), Pick( { "<", ">", "==", "!=" } ),
+                    Expression( names, 1 ) ) + " {" );
+                Block( names, assignable, indent + "    ", depth + 1 );
+                if ( Chance( 60 ) ) {
+                    Line( indent + "} else {" );
+                    Block( names, assignable, indent + "    ", depth + 1 );
+                }
+                Line( indent + "}" );
+            } else if ( kind < 40 && depth < 3 ) {
+                Line( std::format( "{}match ( {} )", indent, Pick( names ) ) + " {" );
+                Line( std::format( "{}    {} -> z = z + {};", indent, Between( -2, 2 ), Expression( names, 2 ) ) );
+                Line( std::format( "{}    {} -> x = {};", indent, Between( 3, 6 ), Expression( names, 2 ) ) );
+                Line( std::format( "{}    _ -> y = y - 1;", indent ) );
+                Line( indent + "}" );
+            } else if ( kind < 60 ) {
+                // Short-lived values, the point of sharing locals
+                const std::string temporary = std::format( "v{}", temporaries++ );
+                Line( std::format( "{}var {} = {};", indent, temporary, Expression( names, 1 ) ) );
+                names.push_back( temporary );
+                assignable.push_back( temporary );
+            } else if ( kind < 68 ) {
+                Line( std::format( "{}t[{}] = {};", indent, Below( ARRAY_LENGTH ), Expression( names, 1 ) ) );
+            } else if ( kind < 76 ) {
+                Line( std::format( "{}w = w * 0.5 + {};", indent, Expression( names, 2 ) ) );
+            } else if ( kind < 80 && depth > 0 ) {
+                Line( std::format( "{}return {};", indent, Expression( names, 1 ) ) );
+            } else {
+                Line( std::format( "{}{} = {};", indent, Pick( assignable ), Expression( names, 1 ) ) );
+            }
+        }
+    }
+
+    std::mt19937 random;
+    std::string source;
+    int temporaries = 0;
+};
+
+struct Outcome {
+    std::vector<NumericValue> results;
+    Compiler::FrameCounts frames;
+};
+
+Outcome CompileAndRun( const std::string& source, const int level, const bool shareLocals ) {
+    Compiler::CompilerOptions options;
+    options.optimizationLevel = level;
+    options.emit.shareLocals = shareLocals;
+    Compiler::Compiler compiler( options );
+    const LuminFile program = compiler.Compile( source );
+
+    VM::LuminVirtualMachine vm( std::make_shared<VM::LuminRuntime>( program ), {} );
+    vm.Run();
+
+    Outcome outcome { {}, compiler.Frames() };
+    for ( size_t i = 0; i < vm.stack.Size(); ++i ) {
+        outcome.results.push_back( vm.stack[i] );
+    }
+    return outcome;
+}
+
+}
+
+/*
+ Compiles generated programs with and without shared locals at -O0 to -O2
+ and checks they compute the same, and that sharing never grows a frame.
+ The seed count defaults to 100, the first argument overrides it.
+ */
+int main( const int argc, char** argv ) {
+    const uint32_t seeds = argc > 1 ? static_cast<uint32_t>( std::strtoul( argv[1], nullptr, 10 ) ) : 100;
+
+    int failures = 0;
+    for ( int level = 0; level <= 2; ++level ) {
+        uint32_t shared = 0;
+        uint32_t unshared = 0;
+        for ( uint32_t seed = 1; seed <= seeds; ++seed ) {
+            const std::string source = ProgramGenerator( seed ).Generate();
+            try {
+                const Outcome with = CompileAndRun( source, level, true );
+                const Outcome without = CompileAndRun( source, level, false );
+                shared += with.frames.locals;
+                unshared += without.frames.locals;
+
+                if ( with.results != without.results ) {
+                    LOG_ERROR( std::format( "Seed {} at -O{}: shared locals change the result\n{}", seed, level, source ) )
+                    ++failures;
+                } else if ( with.frames.locals > without.frames.locals ) {
+                    LOG_ERROR( std::format( "Seed {} at -O{}: shared locals grow the frames from {} to {}\n{}",
+                        seed, level, without.frames.locals, with.frames.locals, source ) )
+                    ++failures;
+                }
+            } catch ( const std::exception& exception ) {
+                LOG_ERROR( std::format( "Seed {} at -O{}: {}\n{}", seed, level, exception.what(), source ) )
+                ++failures;
+            }
+        }
+
+        LOG_INFO( std::format( "-O{}: {} locals in all frames, {} without sharing", level, shared, unshared ) )
+        if ( shared >= unshared ) {
+            LOG_ERROR( std::format( "-O{}: no local was shared", level ) )
+            ++failures;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/*
+ Copyright (C) 2025 Lumin Sh
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <BytecodeReader.hpp>
+#include <ByteOrder.hpp>
+#include <Compiler.hpp>
+#include <ConstantPoolBuilder.hpp>
+#include <LuminVirtualMachine.hpp>
+#include <VMSnapshot.hpp>
+#include <Logging.hpp>
+
+using namespace Lumin;
+
+std::string GetLoggerName() {
+    return "snapshot-test";
+}
+
+namespace {
+
+// Snapshots in the middle of the third call of window, with two frame-local
+// arrays alive in it, one in main, and leaf linked through its method ref
+const std::string PROGRAM = R"(
+noinline fun leaf( n: int ) {
+    return n * 3 + 1;
+}
+
+noinline fun window( n: int ) {
+    var w = int[16];
+    var f = float[12];
+    for i in 0..16 { w[i] = leaf( n + i ); }
+    for i in 0..12 { f[i] = 0.5; }
+    if ( n == 2 ) { snapshot(); }
+    var s = 0;
+    for i in 0..16 { s = s + w[i]; }
+    if ( f[n] > 0.25 ) { s = s + 1; }
+    return s;
+}
+
+fun main() {
+    var kept = int[20];
+    var s = 0;
+    for n in 0..5 {
+        kept[n] = window( n );
+        s = s + kept[n];
+    }
+    return s;
+}
+)";
+
+int failures = 0;
+
+// Turns every CALL into an INVOKE of a method ref, as in a module that was
+// not linked, so the run resolves method refs and interns their names
+void Unlink( LuminFile& program ) {
+    Utils::ConstantPoolBuilder pool( program.constantPool );
+    for ( const MethodInfo& method : program.methods ) {
+        const std::span<unsigned char> body( program.bytecode.data() + method.codeOffset, method.codeLength );
+        for ( const auto& instruction : Bytecode::BytecodeReader( body ) ) {
+            if ( instruction.opcode == OpCode::CALL ) {
+                const auto& name = std::get<std::string>( program.constantPool.at( program.methods.at( instruction.Index() ).nameIndex ).data );
+                body[instruction.offset] = static_cast<unsigned char>( OpCode::INVOKE );
+                Utils::StoreLE( body.data() + instruction.offset + 1, pool.AddMethodRef( name ) );
+            }
+        }
+    }
+    program.constantPool = pool.Release();
+}
+
+void Check( const bool condition, const std::string& what ) {
+    if ( !condition ) {
+        LOG_ERROR( what )
+        ++failures;
+    }
+}
+
+std::vector<NumericValue> Results( const VM::LuminVirtualMachine& vm ) {
+    std::vector<NumericValue> results;
+    for ( size_t i = 0; i < vm.stack.Size(); ++i ) {
+        results.push_back( vm.stack[i] );
+    }
+    return results;
+}
+
+void CompareFrames( const VM::VMSnapshot& taken, const VM::VMSnapshot& read ) {
+    Check( taken.ip == read.ip && taken.basePointer == read.basePointer, "ip or base pointer changed" );
+    Check( taken.stack == read.stack, "Operand stack changed" );
+    Check( taken.locals == read.locals, "Locals changed" );
+    Check( taken.frames.size() == read.frames.size(), "Frame count changed" );
+    for ( size_t i = 0; i < std::min( taken.frames.size(), read.frames.size() ); ++i ) {
+        const VM::VMSnapshotFrame& expected = taken.frames[i];
+        const VM::VMSnapshotFrame& actual = read.frames[i];
+        Check( expected.methodIndex == actual.methodIndex
+                && expected.returnAddress == actual.returnAddress
+                && expected.basePointer == actual.basePointer,
+            std::format( "Frame {} changed", i ) );
+        Check( expected.locals == actual.locals, std::format( "Locals of frame {} changed", i ) );
+    }
+}
+
+void CompareHeap( const VM::VMSnapshot& taken, const VM::VMSnapshot& read ) {
+    Check( taken.arrays == read.arrays, "Arrays changed" );
+    Check( taken.freeSlots == read.freeSlots, "Free array slots changed" );
+    Check( !taken.localArrays.empty(), "No frame-local array is alive at the snapshot" );
+    Check( taken.localArrays.size() == read.localArrays.size(), "Frame-local array count changed" );
+    for ( size_t i = 0; i < std::min( taken.localArrays.size(), read.localArrays.size() ); ++i ) {
+        const VM::Heap::LocalArray& expected = taken.localArrays[i];
+        const VM::Heap::LocalArray& actual = read.localArrays[i];
+        Check( expected.depth == actual.depth && expected.site == actual.site && expected.array == actual.array,
+            std::format( "Frame-local array {} changed", i ) );
+    }
+
+    const VM::HeapStatistics& expected = taken.statistics;
+    const VM::HeapStatistics& actual = read.statistics;
+    Check( expected.allocated > 0
+            && expected.allocated == actual.allocated
+            && expected.localAllocated == actual.localAllocated
+            && expected.released == actual.released
+            && expected.peakLive == actual.peakLive,
+        "Heap statistics changed" );
+}
+
+// The restored runtime links the same methods, binds the method refs to the
+// same indices and interns its strings to the entries the first run did
+void CompareCaches( VM::LuminRuntime& original, VM::LuminRuntime& restored, const VM::RuntimeCaches& taken ) {
+    const VM::RuntimeCaches caches = restored.Caches();
+    Check( !taken.linkedMethods.empty() && caches.linkedMethods == taken.linkedMethods, "Linked methods changed" );
+    Check( caches.constants.size() == taken.constants.size(), "Resolved constant count changed" );
+
+    bool methodRef = false;
+    bool string = false;
+    for ( size_t i = 0; i < std::min( caches.constants.size(), taken.constants.size() ); ++i ) {
+        const auto [index, target] = taken.constants[i];
+        Check( caches.constants[i].index == index && caches.constants[i].target == target,
+            std::format( "Resolved constant {} changed", index ) );
+
+        switch ( restored.Constant( index ).tag ) {
+            case ConstantPoolTag::CONST_METHOD_REF:
+                methodRef = true;
+                Check( restored.ResolveMethodRef( index ).index == target, std::format( "Method ref {} is bound elsewhere", index ) );
+                break;
+            case ConstantPoolTag::CONST_UTF8:
+            case ConstantPoolTag::CONST_STRING:
+                string = true;
+                Check( restored.ResolveString( index ) == original.ResolveString( index ),
+                    std::format( "String {} is interned twice", index ) );
+                break;
+            default:
+                break;
+        }
+    }
+    Check( methodRef, "No method ref was resolved at the snapshot" );
+    Check( string, "No string was resolved at the snapshot" );
+}
+
+}
+
+/*
+ Runs a program to its snapshot, reads the snapshot back and resumes it.
+ The state read must be the state written, the resumed run must compute
+ what an uninterrupted run does, and corrupt snapshots must be rejected.
+ The snapshot is written to the path of the first argument.
+ */
+int main( const int argc, char** argv ) {
+    if ( argc < 2 ) {
+        LOG_ERROR( "Usage: snapshot-test <snapshot path>" )
+        return 1;
+    }
+    const std::string path = argv[1];
+
+    try {
+        Compiler::CompilerOptions options;
+        options.optimizationLevel = 2;
+        LuminFile program = Compiler::Compiler( options ).Compile( PROGRAM );
+        Unlink( program );
+
+        VM::LuminVirtualMachine uninterrupted( std::make_shared<VM::LuminRuntime>( program ) );
+        uninterrupted.Run();
+
+        const auto original = std::make_shared<VM::LuminRuntime>( program );
+        VM::LuminVirtualMachine first( original, { .SnapshotPath = path } );
+        first.Run();
+        const VM::VMSnapshot taken = first.CaptureSnapshot();
+
+        VM::VMSnapshot read;
+        LuminFileView image;
+        if ( !VM::ReadSnapshotFile( path, read, image ) ) {
+            LOG_ERROR( "Failed to read the snapshot back" )
+            return 1;
+        }
+        CompareFrames( taken, read );
+        CompareHeap( taken, read );
+        Check( read.runtime.linkedMethods == taken.runtime.linkedMethods, "Linked methods were not written" );
+
+        const auto restored = std::make_shared<VM::LuminRuntime>( std::move( image ) );
+        VM::VMSnapshot corrupt = read;
+        VM::LuminVirtualMachine resumed( std::move( read ), restored );
+        CompareCaches( *original, *restored, taken.runtime );
+
+        resumed.Run();
+        Check( Results( resumed ) == Results( uninterrupted ), "The resumed run computes something else" );
+        const VM::HeapStatistics& statistics = resumed.heap.Statistics();
+        const VM::HeapStatistics& expected = uninterrupted.heap.Statistics();
+        Check( statistics.allocated == expected.allocated && statistics.released == expected.released
+                && statistics.peakLive == expected.peakLive,
+            "The resumed run counts other allocations" );
+
+        // A frame with more locals than its method has
+        corrupt.frames.back().locals.emplace_back( int32_t { 0 } );
+        try {
+            VM::LuminVirtualMachine rejected( std::move( corrupt ), restored );
+            Check( false, "A frame with too many locals was resumed" );
+        } catch ( const std::runtime_error& ) {
+        }
+
+        // Cut short anywhere, header included
+        const auto size = std::filesystem::file_size( path );
+        for ( const auto length : { size - 1, size / 2, uintmax_t { 100 }, uintmax_t { 8 } } ) {
+            std::filesystem::resize_file( path, length );
+            VM::VMSnapshot truncated;
+            LuminFileView truncatedImage;
+            Check( !VM::ReadSnapshotFile( path, truncated, truncatedImage ),
+                std::format( "A snapshot cut to {} bytes was read", length ) );
+        }
+        std::filesystem::remove( path );
+    } catch ( const std::exception& exception ) {
+        LOG_ERROR( std::format( "Snapshot round trip failed: {}", exception.what() ) )
+        return 1;
+    }
+
+    return failures > 0 ? 1 : 0;
+}